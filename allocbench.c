@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulation.h"
+#include "framesnapshot.h"
+#include "dirtyregion.h"
+#include "rendertarget.h"
+#include "tilecompositor.h"
+
+// Maximum count of dirty rects per frame, the same limit the windows use
+#define BENCH_DIRTY_RECTS 32
+// Frames run before the steady state is measured (the broadphase and compositor buffers settle)
+#define BENCH_WARMUP 64
+
+// Heap calls of the linked modules, counted by the wrappers below (the helpers of the compositor allocate as well)
+static volatile long heapCalls = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+/**
+ * Counting wrappers of the heap functions, linked in place of the originals with -Wl,--wrap
+*/
+void* __wrap_malloc(size_t size) {
+  __atomic_fetch_add(&heapCalls, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  __atomic_fetch_add(&heapCalls, 1, __ATOMIC_RELAXED);
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+  __atomic_fetch_add(&heapCalls, 1, __ATOMIC_RELAXED);
+  return __real_realloc(pointer, size);
+}
+
+/**
+ * Returns the count of heap calls so far
+*/
+static long countHeapCalls() {
+  return __atomic_load_n(&heapCalls, __ATOMIC_RELAXED);
+}
+
+/**
+ * Window emulated by the benchmark, the same objects the window loop and the painter keep between frames
+*/
+typedef struct {
+  Simulation* simulation;
+  SnapshotBuffer* snapshots;
+  SpriteSnapshot* painted;
+  DirtyRegion* dirty;
+  RenderTarget* target;
+  TileCompositor* compositor;
+  const CompiledSprite* sprite;
+} BenchWindow;
+
+/**
+ * Compiles a colour keyed disc of size x size pixels
+*/
+static CompiledSprite* createDisc(int size) {
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)size * size);
+  if (!pixels) return NULL;
+  int radius = size / 2;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int dx = x - radius, dy = y - radius;
+      pixels[y * size + x] = dx * dx + dy * dy > radius * radius ? 0xFFFFFFu : 0xFF000000u | (uint32_t)(255 * x / size) << 16 | (uint32_t)(255 * y / size);
+    }
+  }
+  CompiledSprite* sprite = CompileSprite(pixels, size, size, size, 0xFFFFFFu);
+  free(pixels);
+  return sprite;
+}
+
+/**
+ * One frame of the emulated window: step and publish like the window loop, then repaint the dirty rects
+ * into the persistent back buffer like the painter (the back buffer follows the window size)
+*/
+static void runFrame(BenchWindow* window, int width, int height, long long frame) {
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = width, .bottom = height };
+  StepSimulation(window->simulation, bounds);
+  PublishSnapshot(window->snapshots, window->simulation->sprites, SPRITE_FIXED_ONE, frame);
+
+  const SpriteSnapshot* snapshot = AcquireSnapshot(window->snapshots);
+  ResizeRenderTarget(window->target, width, height);
+  ClearDirtyRegion(window->dirty);
+  AddSnapshotRects(window->dirty, window->painted);
+  AddSnapshotRects(window->dirty, snapshot);
+  MergeDirtyRegion(window->dirty, BENCH_DIRTY_RECTS);
+  BeginComposition(window->compositor, &window->target->buffer, 0x222831);
+  for (int i = 0; i < snapshot->count; i++) AddCompositorSprite(window->compositor, window->sprite, snapshot->xPos[i], snapshot->yPos[i]);
+  for (int i = 0; i < window->dirty->count; i++) AddCompositorRect(window->compositor, window->dirty->rects[i]);
+  ComposeTiles(window->compositor);
+  CopySnapshot(window->painted, snapshot);
+}
+
+/**
+ * Headless check of the allocation free steady state of the window loop and the repaint
+ *
+ * Not part of the screensaver build, it only needs the platform neutral modules. The heap functions of all
+ * linked modules are wrapped and counted, it only links with the --wrap flags:
+ * cc -O2 -o allocbench allocbench.c rendertarget.c simulation.c simulationrecord.c spritestore.c broadphase.c randomgenerator.c framesnapshot.c dirtyregion.c tilecompositor.c spriteblit.c workerpool.c framescheduler.c frametrace.c -lm -lpthread -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ * ./allocbench [images] [image size] [frames] [sweep|grid] [helpers]
+ *
+ * Emulates a window on the memory render target: steps and publishes the simulation, merges the dirty rects
+ * and composes them into the persistent back buffer. After the warmup no frame may allocate, a resize in the
+ * middle of the run may reallocate the back buffer exactly once. Prints the heap calls per frame and
+ * exits with 1 if the steady state allocated.
+*/
+int main(int argc, char** argv) {
+  int images = argc > 1 ? atoi(argv[1]) : 200;
+  int size = argc > 2 ? atoi(argv[2]) : 96;
+  int frames = argc > 3 ? atoi(argv[3]) : 2000;
+  const char* kind = argc > 4 ? argv[4] : "sweep";
+  int helpers = argc > 5 ? atoi(argv[5]) : 1;
+  int grid = strcmp(kind, "grid") == 0;
+  if (images < 1 || size < 1 || frames < 1 || helpers < 0 || (!grid && strcmp(kind, "sweep") != 0)) {
+    fprintf(stderr, "usage: %s [images] [image size] [frames] [sweep|grid] [helpers]\n", argv[0]);
+    return 1;
+  }
+
+  SimulationConfig config = { .movementSpeed = 4.0, .bounceIncrement = 10, .bounceDecrementScale = 1.0, .stepRate = SIMULATION_REFERENCE_RATE, .seed = 1 };
+  BenchWindow window = {
+    .simulation = CreateSimulation(images, grid ? BROADPHASE_GRID : BROADPHASE_SWEEP, config),
+    .snapshots = CreateSnapshotBuffer(images),
+    .painted = CreateSpriteSnapshot(images),
+    .dirty = CreateDirtyRegion(BENCH_DIRTY_RECTS * 4),
+    .target = CreateRenderTarget(&MemoryRenderTargetBackend),
+    .compositor = CreateTileCompositor(helpers),
+    .sprite = createDisc(size)
+  };
+  if (!window.simulation || !window.snapshots || !window.painted || !window.dirty || !window.target || !window.compositor || !window.sprite) {
+    fprintf(stderr, "the window could not be created\n");
+    return 1;
+  }
+
+  int width = 1920, height = 1080;
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = width, .bottom = height };
+  for (int i = 0; i < images; i++) SpawnSprite(window.simulation, bounds, size, size);
+
+  int resizeFrame = BENCH_WARMUP + (frames - BENCH_WARMUP) / 2;
+  long long steadyCalls = 0, worstFrame = 0, resizeCalls = 0, resizeAllocations = 0;
+  int failed = 0;
+  for (int f = 0; f < BENCH_WARMUP + frames; f++) {
+    // The window is resized once, like a display change of its monitor
+    if (f == resizeFrame) width = 2560, height = 1440;
+    long long targetAllocations = window.target->allocations;
+    long long start = countHeapCalls();
+    runFrame(&window, width, height, f + 1);
+    long long calls = countHeapCalls() - start;
+
+    if (f == resizeFrame) {
+      resizeCalls = calls;
+      resizeAllocations = window.target->allocations - targetAllocations;
+      if (resizeAllocations != 1) failed = 1;
+    } else if (f >= BENCH_WARMUP) {
+      steadyCalls += calls;
+      if (calls > worstFrame) worstFrame = calls;
+      if (calls > 0 && !failed) {
+        fprintf(stderr, "frame %d: %lld heap calls in the steady state\n", f, calls);
+        failed = 1;
+      }
+    }
+  }
+
+  printf("%d images of %dpx, %s, %d helpers: %.3f heap calls/frame in the steady state (worst frame %lld), "
+    "resize: %lld heap calls and %lld back buffer allocations%s\n",
+    images, size, kind, helpers, (double)steadyCalls / (frames - 1), worstFrame, resizeCalls, resizeAllocations, failed ? ", FAILED" : "");
+
+  CloseSimulation(window.simulation);
+  CloseSnapshotBuffer(window.snapshots);
+  CloseSpriteSnapshot(window.painted);
+  CloseDirtyRegion(window.dirty);
+  CloseRenderTarget(window.target);
+  CloseTileCompositor(window.compositor);
+  CloseCompiledSprite((CompiledSprite*)window.sprite);
+  return failed;
+}
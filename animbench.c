@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "spriteanimation.h"
+#include "framescheduler.h"
+
+/**
+ * Returns the resident set size of the process in MiB (0 if /proc is not available)
+*/
+static double residentSize() {
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (!file) return 0.0;
+  long pages = 0, resident = 0;
+  int read = fscanf(file, "%ld %ld", &pages, &resident);
+  fclose(file);
+  return read == 2 ? resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0) : 0.0;
+}
+
+/**
+ * Compares two durations for qsort
+*/
+static int compareDurations(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Writes a sprite stream of a disc with anti-aliased edge orbiting inside the frame, one frame at a time
+*/
+static int writeStream(const char* path, int size, int frames, uint32_t frameDuration) {
+  FILE* file = fopen(path, "wb");
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)size * size);
+  if (!file || !pixels) return 0;
+  SpriteStreamHeader header = {
+    .magic = SPRITE_STREAM_MAGIC,
+    .version = SPRITE_STREAM_VERSION,
+    .width = (uint32_t)size,
+    .height = (uint32_t)size,
+    .frameCount = (uint32_t)frames,
+    .frameDuration = frameDuration
+  };
+  int written = fwrite(&header, sizeof(header), 1, file) == 1;
+  double radius = size / 4.0;
+  for (int f = 0; written && f < frames; f++) {
+    double angle = 6.283185307179586 * f / frames;
+    double cx = size / 2.0 + cos(angle) * radius, cy = size / 2.0 + sin(angle) * radius;
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        double dx = x + 0.5 - cx, dy = y + 0.5 - cy;
+        double coverage = radius - sqrt(dx * dx + dy * dy);
+        uint32_t alpha = coverage >= 1.0 ? 255 : coverage <= 0.0 ? 0 : (uint32_t)(coverage * 255.0);
+        pixels[y * size + x] = alpha << 24 | (uint32_t)(255 * x / size) << 16 | (uint32_t)(255 * y / size) << 8 | (uint32_t)(f * 255 / frames);
+      }
+    }
+    written = fwrite(pixels, sizeof(uint32_t), (size_t)size * size, file) == (size_t)size * size;
+  }
+  free(pixels);
+  return fclose(file) == 0 && written;
+}
+
+/**
+ * Benchmark of the animated sprites: decode latency, decode-ahead stalls and resident memory during playback
+ *
+ * Not part of the screensaver build, it only needs the platform neutral animation modules (linux only, /proc is read):
+ * cc -O2 -o animbench animbench.c spriteanimation.c mappedfile.c spriteresample.c spriteblit.c workerpool.c framescheduler.c -lm -lpthread
+ * ./animbench [frame size] [frames] [frame ms] [images] [seconds] [stream path]
+ *
+ * A stream of a moving disc is written to the path, then its frames are decoded one by one (decode latency)
+ * and finally played by images of two sizes at 60hz, the way the windows paint them (stalls and resident set).
+ * Exits with 1 if a frame could not be decoded.
+*/
+int main(int argc, char** argv) {
+  int size = argc > 1 ? atoi(argv[1]) : 384;
+  int frames = argc > 2 ? atoi(argv[2]) : 240;
+  double frameTime = argc > 3 ? atof(argv[3]) : 1000.0 / 30;
+  int images = argc > 4 ? atoi(argv[4]) : 200;
+  double seconds = argc > 5 ? atof(argv[5]) : 5.0;
+  const char* path = argc > 6 ? argv[6] : "animbench.sprs";
+  if (size < 2 || frames < 1 || frameTime <= 0.0 || images < 1 || seconds <= 0.0) {
+    fprintf(stderr, "usage: %s [frame size] [frames] [frame ms] [images] [seconds] [stream path]\n", argv[0]);
+    return 1;
+  }
+
+  if (!writeStream(path, size, frames, (uint32_t)(frameTime * 1000.0))) {
+    fprintf(stderr, "could not write %s\n", path);
+    return 1;
+  }
+  double streamSize = (double)sizeof(uint32_t) * size * size * frames / (1024.0 * 1024.0);
+  double baseline = residentSize();
+  SpriteAnimation* animation = OpenSpriteAnimation(path);
+  if (!animation) return 1;
+
+  // Cold decode of every frame at native and at half size (the pages are read from the page cache)
+  int scaled = size / 2;
+  double* durations = malloc(sizeof(double) * frames);
+  if (!durations) return 1;
+  int failed = 0;
+  for (int half = 0; half <= 1; half++) {
+    int width = half ? scaled : size;
+    for (int f = 0; f < frames; f++) {
+      double start = FrameSchedulerNow();
+      CompiledSprite* sprite = DecodeAnimationFrame(animation, f, width, width, RESAMPLE_LANCZOS3);
+      durations[f] = FrameSchedulerNow() - start;
+      if (!sprite) failed = 1;
+      CloseCompiledSprite(sprite);
+    }
+    qsort(durations, frames, sizeof(double), compareDurations);
+    double total = 0.0;
+    for (int f = 0; f < frames; f++) total += durations[f];
+    printf("decode %dx%d: mean %.3f ms, p50 %.3f ms, p99 %.3f ms\n",
+      width, width, total / frames, durations[frames / 2], durations[(int)(frames * 0.99)]);
+  }
+
+  // Play the animation like the windows do: every paint asks all images for the frame of the paint time
+  AnimationTrack* tracks[2] = { AcquireAnimationTrack(animation, 0, RESAMPLE_LANCZOS3), AcquireAnimationTrack(animation, scaled, RESAMPLE_LANCZOS3) };
+  FrameScheduler* scheduler = CreateFrameScheduler(1000.0 / 60);
+  if (!tracks[0] || !tracks[1] || !scheduler) return 1;
+  double peak = 0.0, worst = 0.0, end = FrameSchedulerNow() + seconds * 1000.0;
+  int paints = 0;
+  while (FrameSchedulerNow() < end) {
+    WaitNextFrame(scheduler);
+    double start = FrameSchedulerNow();
+    for (int i = 0; i < images; i++) {
+      if (!AnimationTrackFrame(tracks[i & 1], start)) failed = 1;
+    }
+    double duration = FrameSchedulerNow() - start;
+    if (duration > worst) worst = duration;
+    double resident = residentSize();
+    if (resident > peak) peak = resident;
+    paints++;
+  }
+
+  for (int t = 0; t < 2; t++) {
+    AnimationTrack* track = tracks[t];
+    WaitAnimationTrack(track);
+    printf("playback %dx%d, %d images: %lld hits, %lld stalls, %lld misses, waited %.3f ms, %lld frames decoded (mean %.3f ms)\n",
+      track->width, track->height, images / 2 + (t == 0 ? images % 2 : 0), track->hits, track->stalls, track->misses,
+      track->waitTime, track->decodedFrames, track->decodedFrames ? track->decodeTime / 1000.0 / track->decodedFrames : 0.0);
+  }
+  printf("%d paints, slowest paint %.3f ms, stream %.1f MiB, resident set +%.1f MiB (peak over baseline)%s\n",
+    paints, worst, streamSize, peak - baseline, failed ? " (decode failed)" : "");
+
+  ReleaseAnimationTrack(tracks[0]);
+  ReleaseAnimationTrack(tracks[1]);
+  CloseSpriteAnimation(animation);
+  CloseFrameScheduler(scheduler);
+  free(durations);
+  return failed;
+}
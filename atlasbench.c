@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spriteatlas.h"
+#include "framescheduler.h"
+#include "randomgenerator.h"
+
+/**
+ * Renders a logo of width x height pixels: an ellipse with anti-aliased edge (premultiplied), tinted by the seed
+*/
+static void renderLogo(uint32_t* pixels, int width, int height, uint32_t seed) {
+  double rx = width / 2.0, ry = height / 2.0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      double dx = (x + 0.5 - rx) / rx, dy = (y + 0.5 - ry) / ry;
+      // Distance to the edge in pixels (approximated along the shorter radius)
+      double coverage = (1.0 - sqrt(dx * dx + dy * dy)) * (rx < ry ? rx : ry);
+      uint32_t alpha = coverage >= 1.0 ? 255 : coverage <= 0.0 ? 0 : (uint32_t)(coverage * 255.0);
+      uint32_t red = (seed * 37u + x) & 0xFF, green = (seed * 101u + y) & 0xFF, blue = seed & 0xFF;
+      pixels[y * width + x] = alpha << 24 | (alpha * red / 255) << 16 | (alpha * green / 255) << 8 | alpha * blue / 255;
+    }
+  }
+}
+
+/**
+ * Draws every sprite at its position and returns the duration in ms
+*/
+static double drawFrame(PixelBuffer* target, CompiledSprite** sprites, const int* xPos, const int* yPos, int count, int shift) {
+  SpriteBounds all = { .left = 0, .top = 0, .right = target->width, .bottom = target->height };
+  double start = FrameSchedulerNow();
+  FillPixelBuffer(target, all, 0x222831);
+  for (int i = 0; i < count; i++) BlitCompiledSprite(target, sprites[i], xPos[i] + shift, yPos[i] + shift, all);
+  return FrameSchedulerNow() - start;
+}
+
+/**
+ * Benchmark of the sprite atlas: packing efficiency and blit throughput of atlas sprites against standalone sprites
+ *
+ * Not part of the screensaver build, it only needs the platform neutral sprite modules:
+ * cc -O2 -o atlasbench atlasbench.c spriteatlas.c spriteblit.c framescheduler.c randomgenerator.c -lm -lpthread
+ * ./atlasbench [logos] [min size] [max size] [atlas size] [frames]
+ *
+ * Every logo gets a random size, all of them are packed into one atlas (logos that don't fit stay standalone).
+ * The same scene is then drawn from the atlas sprites and from standalone copies, the pixels are compared.
+ * Exits with 1 if both scenes composed different pixels.
+*/
+int main(int argc, char** argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 500;
+  int minSize = argc > 2 ? atoi(argv[2]) : 32;
+  int maxSize = argc > 3 ? atoi(argv[3]) : 256;
+  int atlasSize = argc > 4 ? atoi(argv[4]) : ATLAS_DEFAULT_SIZE;
+  int frames = argc > 5 ? atoi(argv[5]) : 50;
+  if (count < 1 || minSize < 1 || maxSize < minSize || atlasSize < 1 || frames < 1) {
+    fprintf(stderr, "usage: %s [logos] [min size] [max size] [atlas size] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  int width = 1920, height = 1080;
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)maxSize * maxSize);
+  CompiledSprite** atlasSprites = calloc(count, sizeof(CompiledSprite*));
+  CompiledSprite** standaloneSprites = calloc(count, sizeof(CompiledSprite*));
+  int* xPos = malloc(sizeof(int) * count);
+  int* yPos = malloc(sizeof(int) * count);
+  PixelBuffer target = { .pixels = malloc(sizeof(uint32_t) * (size_t)width * height), .width = width, .height = height, .stride = width };
+  uint32_t* reference = malloc(sizeof(uint32_t) * (size_t)width * height);
+  SpriteAtlas* atlas = CreateSpriteAtlas(atlasSize, atlasSize);
+  if (!pixels || !atlasSprites || !standaloneSprites || !xPos || !yPos || !target.pixels || !reference || !atlas) return 1;
+
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 1);
+
+  // Pack all logos, the packing time includes copying the span pixels into the atlas
+  int standalone = 0;
+  double packTime = 0.0;
+  for (int i = 0; i < count; i++) {
+    int w = minSize + RandomBelow(&random, maxSize - minSize + 1);
+    int h = minSize + RandomBelow(&random, maxSize - minSize + 1);
+    renderLogo(pixels, w, h, (uint32_t)i);
+    atlasSprites[i] = CompileAlphaSprite(pixels, w, h, w);
+    standaloneSprites[i] = CompileAlphaSprite(pixels, w, h, w);
+    if (!atlasSprites[i] || !standaloneSprites[i]) return 1;
+
+    double start = FrameSchedulerNow();
+    if (!PlaceAtlasSprite(atlas, atlasSprites[i])) standalone++;
+    packTime += FrameSchedulerNow() - start;
+
+    xPos[i] = RandomBelow(&random, width + w) - w / 2;
+    yPos[i] = RandomBelow(&random, height + h) - h / 2;
+  }
+  printf("%d logos (%d-%d px) in a %dx%d atlas: %d packed, %d standalone, %d shelves, occupancy %.1f%%, pack %.3f ms\n",
+    count, minSize, maxSize, atlasSize, atlasSize, atlas->spriteCount, standalone, atlas->shelfCount,
+    AtlasOccupancy(atlas) * 100.0, packTime);
+
+  // Draw the same scene from both sprite sets, the standalone sprites first as reference
+  int failed = 0;
+  for (int useAtlas = 0; useAtlas <= 1; useAtlas++) {
+    CompiledSprite** sprites = useAtlas ? atlasSprites : standaloneSprites;
+    double total = 0.0, best = 1e300;
+    long long drawn = 0;
+    for (int f = 0; f < frames; f++) {
+      double duration = drawFrame(&target, sprites, xPos, yPos, count, f % 8);
+      total += duration;
+      if (duration < best) best = duration;
+    }
+    for (int i = 0; i < count; i++) drawn += (long long)sprites[i]->width * sprites[i]->height;
+
+    if (!useAtlas) {
+      memcpy(reference, target.pixels, sizeof(uint32_t) * (size_t)width * height);
+    } else if (memcmp(reference, target.pixels, sizeof(uint32_t) * (size_t)width * height) != 0) {
+      failed = 1;
+    }
+    printf("%s: mean %.3f ms, best %.3f ms, %.0f Mpx/s%s\n",
+      useAtlas ? "atlas" : "standalone", total / frames, best, drawn / (total / frames) / 1000.0,
+      failed ? " (pixels differ)" : "");
+  }
+
+  for (int i = 0; i < count; i++) {
+    CloseCompiledSprite(atlasSprites[i]);
+    CloseCompiledSprite(standaloneSprites[i]);
+  }
+  CloseSpriteAtlas(atlas);
+  free(pixels);
+  free(atlasSprites);
+  free(standaloneSprites);
+  free(xPos);
+  free(yPos);
+  free(target.pixels);
+  free(reference);
+  return failed;
+}
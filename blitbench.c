@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spriteblit.h"
+#include "framescheduler.h"
+#include "randomgenerator.h"
+
+// Size of the target surface (a full hd back buffer)
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+// Colour key of the benchmark sprite
+#define BENCH_KEY 0xFF00FF
+
+/**
+ * Draws a ring with a colour key background, so every row has transparent runs outside, inside and between its spans
+*/
+static void drawRing(uint32_t* pixels, int size) {
+  int center = size / 2;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int dx = x - center, dy = y - center;
+      int distance = dx * dx + dy * dy;
+      int inside = distance < center * center && distance >= center * center / 4;
+      pixels[y * size + x] = inside ? 0xFF000000 | (uint32_t)(x * 255 / size) << 16 | (uint32_t)(y * 255 / size) << 8 | 0x40 : BENCH_KEY;
+    }
+  }
+}
+
+/**
+ * Draws the same ring as premultiplied alpha pixels with anti-aliased (translucent) inner and outer edges
+*/
+static void drawAlphaRing(uint32_t* pixels, int size) {
+  double outer = size / 2.0;
+  double inner = outer / 2.0;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      double dx = x + 0.5 - outer, dy = y + 0.5 - outer;
+      double distance = sqrt(dx * dx + dy * dy);
+      double coverage = fmin(outer - distance, distance - inner);
+      uint32_t alpha = coverage >= 1.0 ? 255 : coverage <= 0.0 ? 0 : (uint32_t)(coverage * 255.0);
+      pixels[y * size + x] = alpha << 24 | (alpha * x / size) << 16 | (alpha * y / size) << 8 | alpha / 4;
+    }
+  }
+}
+
+/**
+ * Random blit positions reaching over all edges of the target and random clip rects (every 4th blit is unclipped)
+*/
+static void placeSprites(int count, int size, int* xPos, int* yPos, SpriteBounds* clips) {
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 5);
+  for (int i = 0; i < count; i++) {
+    xPos[i] = RandomBelow(&random, BENCH_WIDTH + size) - size / 2 - size / 4;
+    yPos[i] = RandomBelow(&random, BENCH_HEIGHT + size) - size / 2 - size / 4;
+    if (i % 4 == 0) {
+      clips[i] = (SpriteBounds){ .left = 0, .top = 0, .right = BENCH_WIDTH, .bottom = BENCH_HEIGHT };
+    } else {
+      clips[i].left = xPos[i] + RandomBelow(&random, size) - size / 4;
+      clips[i].top = yPos[i] + RandomBelow(&random, size) - size / 4;
+      clips[i].right = clips[i].left + RandomBelow(&random, size + 1);
+      clips[i].bottom = clips[i].top + RandomBelow(&random, size + 1);
+    }
+  }
+}
+
+/**
+ * Blits the sprites with the compiled sprite and with the scalar reference (colour key or alpha) for all frames
+ *
+ * Adds the time of both to compiledTime and referenceTime (in ms), returns 0 if the frames differ
+*/
+static int runFrames(PixelBuffer* compiled, PixelBuffer* reference, const CompiledSprite* sprite, const uint32_t* pixels, int size, int alpha,
+  int count, int frames, const int* xPos, const int* yPos, const SpriteBounds* clips, double* compiledTime, double* referenceTime) {
+  SpriteBounds all = { .left = 0, .top = 0, .right = BENCH_WIDTH, .bottom = BENCH_HEIGHT };
+  size_t targetSize = sizeof(uint32_t) * BENCH_WIDTH * BENCH_HEIGHT;
+  int same = 1;
+  for (int f = 0; f < frames; f++) {
+    FillPixelBuffer(compiled, all, 0x222831);
+    FillPixelBuffer(reference, all, 0x222831);
+    // Shift the scene every frame, so the spans start at every alignment
+    double start = FrameSchedulerNow();
+    for (int i = 0; i < count; i++) BlitCompiledSprite(compiled, sprite, xPos[i] + f, yPos[i] + f, clips[i]);
+    double middle = FrameSchedulerNow();
+    for (int i = 0; i < count; i++) {
+      if (alpha) BlitAlphaScalar(reference, pixels, size, size, size, xPos[i] + f, yPos[i] + f, clips[i]);
+      else BlitColorKeyScalar(reference, pixels, size, size, size, BENCH_KEY, xPos[i] + f, yPos[i] + f, clips[i]);
+    }
+    double end = FrameSchedulerNow();
+    *compiledTime += middle - start;
+    *referenceTime += end - middle;
+    if (same && memcmp(compiled->pixels, reference->pixels, targetSize) != 0) {
+      fprintf(stderr, "frame %d: the compiled %s sprite drew different pixels then the reference\n", f, alpha ? "alpha" : "colour key");
+      same = 0;
+    }
+  }
+  return same;
+}
+
+/**
+ * Headless check and benchmark of the compiled span blit against the scalar per pixel colour key and alpha blits
+ *
+ * Not part of the screensaver build, it only needs the platform neutral blit module:
+ * cc -O2 -mavx2 -o blitbench blitbench.c spriteblit.c framescheduler.c randomgenerator.c -lm -lpthread
+ * ./blitbench [sprite size] [sprites per frame] [frames]
+ *
+ * Every frame blits the sprites at random positions (clipped by the target edges and random clip rects)
+ * with both paths into their own back buffer, once as colour key sprite and once as premultiplied alpha sprite
+ * with anti-aliased edges. Prints the time per frame of all paths, the alpha sprite should at least match the
+ * throughput of the per pixel colour key blit it replaces. Exits with 1 if a compiled sprite drew different pixels then its scalar reference.
+*/
+int main(int argc, char** argv) {
+  int size = argc > 1 ? atoi(argv[1]) : 256;
+  int count = argc > 2 ? atoi(argv[2]) : 200;
+  int frames = argc > 3 ? atoi(argv[3]) : 50;
+  if (size < 1 || count < 1 || frames < 1) {
+    fprintf(stderr, "usage: %s [sprite size] [sprites per frame] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  size_t targetSize = sizeof(uint32_t) * BENCH_WIDTH * BENCH_HEIGHT;
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)size * size);
+  uint32_t* alphaPixels = malloc(sizeof(uint32_t) * (size_t)size * size);
+  PixelBuffer compiled = { .pixels = malloc(targetSize), .width = BENCH_WIDTH, .height = BENCH_HEIGHT, .stride = BENCH_WIDTH };
+  PixelBuffer reference = { .pixels = malloc(targetSize), .width = BENCH_WIDTH, .height = BENCH_HEIGHT, .stride = BENCH_WIDTH };
+  int* xPos = malloc(sizeof(int) * count);
+  int* yPos = malloc(sizeof(int) * count);
+  SpriteBounds* clips = malloc(sizeof(SpriteBounds) * count);
+  if (!pixels || !alphaPixels || !compiled.pixels || !reference.pixels || !xPos || !yPos || !clips) return 1;
+
+  drawRing(pixels, size);
+  CompiledSprite* sprite = CompileSprite(pixels, size, size, size, BENCH_KEY);
+  drawAlphaRing(alphaPixels, size);
+  CompiledSprite* alphaSprite = CompileAlphaSprite(alphaPixels, size, size, size);
+  if (!sprite || !alphaSprite) return 1;
+  placeSprites(count, size, xPos, yPos, clips);
+
+  double compiledTime = 0.0, referenceTime = 0.0, alphaTime = 0.0, alphaReferenceTime = 0.0;
+  int failed = !runFrames(&compiled, &reference, sprite, pixels, size, 0, count, frames, xPos, yPos, clips, &compiledTime, &referenceTime);
+  int alphaFailed = !runFrames(&compiled, &reference, alphaSprite, alphaPixels, size, 1, count, frames, xPos, yPos, clips, &alphaTime, &alphaReferenceTime);
+
+  printf("%d sprites of %dpx (%d spans): compiled %.3f ms/frame, colour key reference %.3f ms/frame, x%.2f%s\n",
+    count, size, sprite->spanCount, compiledTime / frames, referenceTime / frames,
+    compiledTime > 0.0 ? referenceTime / compiledTime : 0.0, failed ? ", PIXELS DIFFER" : "");
+  printf("%d alpha sprites of %dpx (%d spans): compiled %.3f ms/frame, alpha reference %.3f ms/frame, x%.2f, "
+    "x%.2f the per pixel colour key throughput, %.0f%% of the compiled colour key throughput%s\n",
+    count, size, alphaSprite->spanCount, alphaTime / frames, alphaReferenceTime / frames,
+    alphaTime > 0.0 ? alphaReferenceTime / alphaTime : 0.0, alphaTime > 0.0 ? referenceTime / alphaTime : 0.0,
+    alphaTime > 0.0 ? compiledTime / alphaTime * 100.0 : 0.0,
+    alphaFailed ? ", PIXELS DIFFER" : "");
+
+  CloseCompiledSprite(alphaSprite);
+  free(alphaPixels);
+  CloseCompiledSprite(sprite);
+  free(pixels);
+  free(compiled.pixels);
+  free(reference.pixels);
+  free(xPos);
+  free(yPos);
+  free(clips);
+  return failed || alphaFailed;
+}
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmpimage.h"
+#include "spriteblit.h"
+#include "framescheduler.h"
+
+// Size of the file and info headers written by the benchmark
+#define HEADERS_SIZE 54
+
+/**
+ * Writes a little endian 16 bit value
+*/
+static void writeU16(unsigned char* data, uint32_t value) {
+  data[0] = (unsigned char)value;
+  data[1] = (unsigned char)(value >> 8);
+}
+
+/**
+ * Writes a little endian 32 bit value
+*/
+static void writeU32(unsigned char* data, uint32_t value) {
+  for (int i = 0; i < 4; i++) data[i] = (unsigned char)(value >> (i * 8));
+}
+
+/**
+ * Color of the test pattern at x, y: a disc on a magenta background (the color key of the screensaver)
+*/
+static uint32_t patternPixel(int x, int y, int width, int height) {
+  int dx = x - width / 2, dy = y - height / 2;
+  int radius = (width < height ? width : height) / 2;
+  if ((long long)dx * dx + (long long)dy * dy > (long long)radius * radius) return 0xFF00FFu;
+  return 0xFF000000u | (uint32_t)(255 * x / width) << 16 | (uint32_t)(255 * y / height) << 8 | (uint32_t)((x ^ y) & 0xFF);
+}
+
+/**
+ * Builds a bmp with a plain info header in memory, bottom-up if height is positive (like most files)
+ *
+ * Returns NULL if the allocation fails, the size of the file is stored in size
+*/
+static unsigned char* buildBmp(int width, int height, int bitsPerPixel, size_t* size) {
+  int rows = height < 0 ? -height : height;
+  size_t rowSize = ((size_t)width * bitsPerPixel + 31) / 32 * 4;
+  *size = HEADERS_SIZE + rowSize * rows;
+  unsigned char* data = calloc(1, *size);
+  if (!data) return NULL;
+  data[0] = 'B';
+  data[1] = 'M';
+  writeU32(data + 2, (uint32_t)*size);
+  writeU32(data + 10, HEADERS_SIZE);
+  writeU32(data + 14, 40);
+  writeU32(data + 18, (uint32_t)width);
+  writeU32(data + 22, (uint32_t)height);
+  writeU16(data + 26, 1);
+  writeU16(data + 28, (uint32_t)bitsPerPixel);
+  writeU32(data + 34, (uint32_t)(rowSize * rows));
+  for (int y = 0; y < rows; y++) {
+    unsigned char* row = data + HEADERS_SIZE + rowSize * (height < 0 ? y : rows - 1 - y);
+    for (int x = 0; x < width; x++) {
+      uint32_t pixel = patternPixel(x, y, width, rows);
+      for (int b = 0; b < bitsPerPixel / 8; b++) row[x * (bitsPerPixel / 8) + b] = (unsigned char)(pixel >> (b * 8));
+    }
+  }
+  return data;
+}
+
+/**
+ * Malformed header of the self-check, applied to a valid 4x4 bmp
+*/
+typedef struct {
+  // Description printed on failure
+  const char* name;
+  // Offset of the field to overwrite and its new value (4 bytes, or 2 if isShort is set)
+  int offset;
+  uint32_t value;
+  int isShort;
+  // Size the file is cut to (-1 keeps the size)
+  int length;
+  // Expected result of ParseBmp
+  BmpStatus expected;
+} MalformedCase;
+
+/**
+ * Parses a valid bmp and a list of malformed ones and compares the results, returns the count of mismatches
+*/
+static int checkMalformed() {
+  static const MalformedCase cases[] = {
+    { "valid", 0, 0, 0, -1, BMP_OK },
+    { "empty file", 0, 0, 0, 0, BMP_ERROR_TRUNCATED },
+    { "cut in the file header", 0, 0, 0, 10, BMP_ERROR_TRUNCATED },
+    { "cut in the info header", 0, 0, 0, 30, BMP_ERROR_TRUNCATED },
+    { "signature", 0, 'B' | 'A' << 8, 1, -1, BMP_ERROR_SIGNATURE },
+    { "file size beyond the end", 2, 1 << 20, 0, -1, BMP_ERROR_TRUNCATED },
+    { "os/2 core header", 14, 12, 0, -1, BMP_ERROR_HEADER },
+    { "unknown header size", 14, 64, 0, -1, BMP_ERROR_HEADER },
+    { "header size beyond the end", 14, 0xFFFFFFF0u, 0, -1, BMP_ERROR_HEADER },
+    { "planes", 26, 2, 1, -1, BMP_ERROR_HEADER },
+    { "palette (8 bit)", 28, 8, 1, -1, BMP_ERROR_FORMAT },
+    { "16 bit", 28, 16, 1, -1, BMP_ERROR_FORMAT },
+    { "0 bit", 28, 0, 1, -1, BMP_ERROR_FORMAT },
+    { "rle8", 30, 1, 0, -1, BMP_ERROR_FORMAT },
+    { "jpeg", 30, 4, 0, -1, BMP_ERROR_FORMAT },
+    { "png", 30, 5, 0, -1, BMP_ERROR_FORMAT },
+    { "bitfields without room for the masks", 30, 3, 0, -1, BMP_ERROR_HEADER },
+    { "zero width", 18, 0, 0, -1, BMP_ERROR_SIZE },
+    { "negative width", 18, (uint32_t)-4, 0, -1, BMP_ERROR_SIZE },
+    { "huge width", 18, BMP_MAX_SIZE + 1, 0, -1, BMP_ERROR_SIZE },
+    { "zero height", 22, 0, 0, -1, BMP_ERROR_SIZE },
+    { "huge height", 22, BMP_MAX_SIZE + 1, 0, -1, BMP_ERROR_SIZE },
+    { "huge top-down height", 22, (uint32_t)-(BMP_MAX_SIZE + 1), 0, -1, BMP_ERROR_SIZE },
+    { "INT32_MIN height", 22, 0x80000000u, 0, -1, BMP_ERROR_SIZE },
+    { "pixel offset inside the headers", 10, 20, 0, -1, BMP_ERROR_HEADER },
+    { "pixel offset beyond the end", 10, 1 << 20, 0, -1, BMP_ERROR_HEADER },
+    { "pixel offset near UINT32_MAX", 10, 0xFFFFFFFFu, 0, -1, BMP_ERROR_HEADER },
+    { "image size too small", 34, 8, 0, -1, BMP_ERROR_HEADER },
+    { "rows beyond the end", 22, 64, 0, -1, BMP_ERROR_PIXELS },
+    { "last row cut", 2, 0, 0, HEADERS_SIZE + 4 * 4 * 4 - 1, BMP_ERROR_PIXELS }
+  };
+
+  size_t size;
+  unsigned char* valid = buildBmp(4, 4, 32, &size);
+  unsigned char* data = malloc(size);
+  if (!valid || !data) return 1;
+  // File size and image size are optional, without them each case hits only the check it is about
+  writeU32(valid + 2, 0);
+  writeU32(valid + 34, 0);
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const MalformedCase* test = &cases[i];
+    memcpy(data, valid, size);
+    if (test->isShort) writeU16(data + test->offset, test->value);
+    else if (test->offset) writeU32(data + test->offset, test->value);
+    size_t length = test->length < 0 ? size : (size_t)test->length;
+    // The cut file is copied to its own allocation, so the sanitizers catch any read beyond it
+    unsigned char* file = malloc(length ? length : 1);
+    if (!file) return failures + 1;
+    memcpy(file, data, length);
+    BmpView view;
+    BmpStatus status = ParseBmp(file, length, &view);
+    if (status != test->expected) {
+      printf("malformed %s: status %d, expected %d\n", test->name, status, test->expected);
+      failures++;
+    }
+    free(file);
+  }
+  free(data);
+  free(valid);
+  return failures;
+}
+
+/**
+ * Builds a 32 bit bmp with a V5 header or with masks behind a plain info header and parses it
+ *
+ * Returns the status of ParseBmp
+*/
+static BmpStatus parseMasked(int headerSize, uint32_t compression, uint32_t redMask, uint32_t alphaMask) {
+  unsigned char data[256] = { 0 };
+  size_t maskCount = compression == 6 ? 4 : 3;
+  uint32_t pixelOffset = 14 + headerSize + (headerSize == 40 ? (uint32_t)maskCount * 4 : 0);
+  data[0] = 'B';
+  data[1] = 'M';
+  writeU32(data + 10, pixelOffset);
+  writeU32(data + 14, (uint32_t)headerSize);
+  writeU32(data + 18, 2);
+  writeU32(data + 22, 2);
+  writeU16(data + 26, 1);
+  writeU16(data + 28, 32);
+  writeU32(data + 30, compression);
+  writeU32(data + 54, redMask);
+  writeU32(data + 58, 0x0000FF00u);
+  writeU32(data + 62, 0x000000FFu);
+  writeU32(data + 66, alphaMask);
+  BmpView view;
+  return ParseBmp(data, pixelOffset + 16, &view);
+}
+
+/**
+ * Checks the accepted and rejected channel masks, returns the count of mismatches
+*/
+static int checkMasks() {
+  struct { int headerSize; uint32_t compression, redMask, alphaMask; BmpStatus expected; } cases[] = {
+    { 40, 3, 0x00FF0000u, 0, BMP_OK },
+    { 40, 6, 0x00FF0000u, 0xFF000000u, BMP_OK },
+    { 124, 3, 0x00FF0000u, 0xFF000000u, BMP_OK },
+    { 108, 3, 0x00FF0000u, 0, BMP_OK },
+    { 40, 3, 0x0000F800u, 0, BMP_ERROR_FORMAT },
+    { 124, 3, 0x00FF0000u, 0x000000FFu, BMP_ERROR_FORMAT },
+    { 124, 3, 0xFF000000u, 0x00FF0000u, BMP_ERROR_FORMAT }
+  };
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    BmpStatus status = parseMasked(cases[i].headerSize, cases[i].compression, cases[i].redMask, cases[i].alphaMask);
+    if (status != cases[i].expected) {
+      printf("masks %zu: status %d, expected %d\n", i, status, cases[i].expected);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+/**
+ * Checks that the view of valid bmps walks the rows top to bottom, returns the count of mismatches
+*/
+static int checkOrientation() {
+  int failures = 0;
+  for (int bits = 24; bits <= 32; bits += 8) {
+    for (int topDown = 0; topDown <= 1; topDown++) {
+      // Odd width, so the 24 bit rows are padded
+      int width = 7, height = 5;
+      size_t size;
+      unsigned char* data = buildBmp(width, topDown ? -height : height, bits, &size);
+      uint32_t pixels[7 * 5];
+      BmpView view;
+      if (!data || ParseBmp(data, size, &view) != BMP_OK || view.width != width || view.height != height) {
+        printf("orientation %d bit, top-down %d: not parsed\n", bits, topDown);
+        failures++;
+        free(data);
+        continue;
+      }
+      ReadBmpPixels(&view, pixels, width);
+      for (int i = 0; i < width * height; i++) {
+        uint32_t expected = patternPixel(i % width, i / width, width, height) & (bits == 32 ? 0xFFFFFFFFu : 0x00FFFFFFu);
+        if (pixels[i] != expected) {
+          printf("orientation %d bit, top-down %d: pixel %d is %08x, expected %08x\n", bits, topDown, i, pixels[i], expected);
+          failures++;
+          break;
+        }
+      }
+      free(data);
+    }
+  }
+  return failures;
+}
+
+/**
+ * Returns 1 if both sprites have the same spans and pixels
+*/
+static int sameSprite(const CompiledSprite* a, const CompiledSprite* b) {
+  if (!a || !b || a->width != b->width || a->height != b->height || a->spanCount != b->spanCount) return 0;
+  if (memcmp(a->rowStart, b->rowStart, sizeof(int) * (a->height + 1)) != 0) return 0;
+  for (int i = 0; i < a->spanCount; i++) {
+    const SpriteSpan* x = &a->spans[i];
+    const SpriteSpan* y = &b->spans[i];
+    if (x->x != y->x || x->length != y->length || x->blend != y->blend) return 0;
+    if (memcmp(a->pixels + x->offset, b->pixels + y->offset, sizeof(uint32_t) * x->length) != 0) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Loads the bmp at path the way the screensaver did before: reads the whole file, converts it and compiles it
+*/
+static CompiledSprite* loadCopied(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return NULL;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  unsigned char* data = malloc(size > 0 ? (size_t)size : 1);
+  CompiledSprite* sprite = NULL;
+  BmpView view;
+  if (data && fread(data, 1, (size_t)size, file) == (size_t)size && ParseBmp(data, (size_t)size, &view) == BMP_OK) {
+    uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)view.width * view.height);
+    if (pixels) {
+      ReadBmpPixels(&view, pixels, view.width);
+      sprite = CompileSprite(pixels, view.width, view.height, view.width, 0xFF00FFu);
+    }
+    free(pixels);
+  }
+  free(data);
+  fclose(file);
+  return sprite;
+}
+
+/**
+ * Loads the bmp at path the way the screensaver does now: maps the file and compiles the sprite from the mapping
+*/
+static CompiledSprite* loadMapped(const char* path) {
+  BmpImage* image = OpenBmpImage(path, NULL);
+  if (!image) return NULL;
+  const BmpView* view = &image->view;
+  CompiledSprite* sprite = CompileSpriteRows(view->rows, view->bitsPerPixel / 8, view->width, view->height, view->stride, 0xFF00FFu);
+  CloseBmpImage(image);
+  return sprite;
+}
+
+/**
+ * Benchmark and self-check of the bmp loader: malformed headers, startup time of large images
+ *
+ * Not part of the screensaver build, it only needs the platform neutral modules:
+ * cc -O2 -o bmpbench bmpbench.c bmpimage.c mappedfile.c spriteblit.c framescheduler.c -lpthread
+ * ./bmpbench [image size] [runs] [directory]
+ *
+ * First ParseBmp is fed malformed headers (truncated files, bad signatures, palettes, rle, bad masks,
+ * zero / negative / huge sizes, offsets beyond the end), each must be rejected with the expected status.
+ * Then bottom-up 24 bit and 32 bit images of the given size are written to the directory, loaded through
+ * the mapping and through a copy of the file, and the median load times are compared (the files are in the page cache,
+ * so this is the cpu and copy cost at startup). Both sprites must be identical.
+ * Exits with 1 if a check fails.
+*/
+int main(int argc, char** argv) {
+  int size = argc > 1 ? atoi(argv[1]) : 4096;
+  int runs = argc > 2 ? atoi(argv[2]) : 5;
+  const char* directory = argc > 3 ? argv[3] : ".";
+  if (size < 1 || size > BMP_MAX_SIZE || runs < 1 || runs > 64) {
+    fprintf(stderr, "usage: %s [image size] [runs] [directory]\n", argv[0]);
+    return 1;
+  }
+
+  int failures = checkMalformed() + checkMasks() + checkOrientation();
+  printf("header checks: %s\n", failures ? "failed" : "passed");
+
+  for (int bits = 24; bits <= 32; bits += 8) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/bmpbench%d.bmp", directory, bits);
+    size_t length;
+    unsigned char* data = buildBmp(size, size, bits, &length);
+    FILE* file = fopen(path, "wb");
+    int written = data && file && fwrite(data, 1, length, file) == length;
+    if (file && fclose(file) != 0) written = 0;
+    free(data);
+    if (!written) {
+      fprintf(stderr, "could not write %s\n", path);
+      return 1;
+    }
+
+    double copied[64], mapped[64];
+    for (int run = 0; run < runs; run++) {
+      double start = FrameSchedulerNow();
+      CompiledSprite* copy = loadCopied(path);
+      copied[run] = FrameSchedulerNow() - start;
+      start = FrameSchedulerNow();
+      CompiledSprite* map = loadMapped(path);
+      mapped[run] = FrameSchedulerNow() - start;
+      if (!sameSprite(copy, map)) {
+        printf("%d bit: mapped sprite differs from the copied one\n", bits);
+        failures++;
+      }
+      CloseCompiledSprite(copy);
+      CloseCompiledSprite(map);
+    }
+    // Insertion sort for the medians, runs is small
+    for (int i = 1; i < runs; i++) {
+      for (int j = i; j > 0 && copied[j] < copied[j - 1]; j--) { double t = copied[j]; copied[j] = copied[j - 1]; copied[j - 1] = t; }
+      for (int j = i; j > 0 && mapped[j] < mapped[j - 1]; j--) { double t = mapped[j]; mapped[j] = mapped[j - 1]; mapped[j - 1] = t; }
+    }
+    printf("%dx%d %d bit (%.1f MiB): copied %.1f ms, mapped %.1f ms (median of %d)\n",
+      size, size, bits, length / (1024.0 * 1024.0), copied[runs / 2], mapped[runs / 2], runs);
+    remove(path);
+  }
+
+  // The directory listing must skip files that are not valid bmps
+  char valid[1024], invalid[1024];
+  snprintf(valid, sizeof(valid), "%s/bmpbench-valid.BMP", directory);
+  snprintf(invalid, sizeof(invalid), "%s/bmpbench-invalid.bmp", directory);
+  size_t length;
+  unsigned char* data = buildBmp(4, 4, 24, &length);
+  FILE* validFile = fopen(valid, "wb");
+  FILE* invalidFile = fopen(invalid, "wb");
+  if (data && validFile && invalidFile) {
+    fwrite(data, 1, length, validFile);
+    fwrite(data, 1, HEADERS_SIZE, invalidFile);
+  }
+  if (validFile) fclose(validFile);
+  if (invalidFile) fclose(invalidFile);
+  free(data);
+  BmpDirectory* list = OpenBmpDirectory(directory);
+  int listed = 0, skipped = 1;
+  for (int i = 0; list && i < list->count; i++) {
+    if (strstr(list->paths[i], "bmpbench-invalid.bmp")) skipped = 0;
+    if (strstr(list->paths[i], "bmpbench-valid.BMP")) listed = 1;
+  }
+  if (!listed || !skipped) failures++;
+  printf("directory listing: %s\n", listed && skipped ? "passed" : "failed");
+  CloseBmpDirectory(list);
+  remove(valid);
+  remove(invalid);
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+#include "bmpimage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+// Size of the BITMAPFILEHEADER
+#define BMP_FILE_HEADER_SIZE 14
+// Size of the BITMAPINFOHEADER, the newer headers (V2 to V5) extend it
+#define BMP_INFO_HEADER_SIZE 40
+// Compressions of uncompressed bitmaps, the bitfields variants only with the standard masks
+#define BMP_RGB 0
+#define BMP_BITFIELDS 3
+#define BMP_ALPHABITFIELDS 6
+
+/**
+ * Reads a little endian 16 bit value
+*/
+static uint32_t readU16(const unsigned char* data) {
+  return (uint32_t)data[0] | (uint32_t)data[1] << 8;
+}
+
+/**
+ * Reads a little endian 32 bit value
+*/
+static uint32_t readU32(const unsigned char* data) {
+  return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+/**
+ * Returns 1 if the header size belongs to a known info header (BITMAPINFOHEADER, V2, V3, V4 or V5)
+*/
+static int knownHeaderSize(uint32_t size) {
+  return size == 40 || size == 52 || size == 56 || size == 108 || size == 124;
+}
+
+/**
+ * Parses the headers of the bmp in data and points the view at its pixel rows, nothing is copied
+ *
+ * Every field is validated against the size of the data, the view never reaches beyond it.
+*/
+BmpStatus ParseBmp(const unsigned char* data, size_t size, BmpView* view) {
+  if (size < BMP_FILE_HEADER_SIZE + 4) return BMP_ERROR_TRUNCATED;
+  if (data[0] != 'B' || data[1] != 'M') return BMP_ERROR_SIGNATURE;
+  uint32_t fileSize = readU32(data + 2);
+  uint32_t pixelOffset = readU32(data + 10);
+  uint32_t headerSize = readU32(data + 14);
+  // The file size is optional (0), if it is present the file must not be shorter
+  if (fileSize != 0 && fileSize > size) return BMP_ERROR_TRUNCATED;
+  // OS/2 core headers (12 bytes) and unknown extensions are rejected, their fields are laid out differently
+  if (!knownHeaderSize(headerSize)) return BMP_ERROR_HEADER;
+  if (size < BMP_FILE_HEADER_SIZE + (size_t)headerSize) return BMP_ERROR_TRUNCATED;
+
+  const unsigned char* info = data + BMP_FILE_HEADER_SIZE;
+  int32_t width = (int32_t)readU32(info + 4);
+  int32_t height = (int32_t)readU32(info + 8);
+  uint32_t planes = readU16(info + 12);
+  uint32_t bitsPerPixel = readU16(info + 14);
+  uint32_t compression = readU32(info + 16);
+  uint32_t imageSize = readU32(info + 20);
+  if (planes != 1) return BMP_ERROR_HEADER;
+  if (bitsPerPixel != 24 && bitsPerPixel != 32) return BMP_ERROR_FORMAT;
+
+  if (compression == BMP_BITFIELDS || compression == BMP_ALPHABITFIELDS) {
+    // Masks are only accepted if they describe the plain BGRA layout, so the rows can be read as they are
+    if (bitsPerPixel != 32) return BMP_ERROR_FORMAT;
+    // The info header carries the masks from V2 on, behind a plain info header they follow the header
+    size_t maskCount = headerSize >= 56 || compression == BMP_ALPHABITFIELDS ? 4 : 3;
+    size_t maskOffset = BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE;
+    size_t maskEnd = maskOffset + maskCount * 4;
+    if (headerSize == BMP_INFO_HEADER_SIZE && maskEnd > pixelOffset) return BMP_ERROR_HEADER;
+    if (maskEnd > size) return BMP_ERROR_TRUNCATED;
+    const unsigned char* masks = data + maskOffset;
+    if (readU32(masks) != 0x00FF0000u || readU32(masks + 4) != 0x0000FF00u || readU32(masks + 8) != 0x000000FFu) return BMP_ERROR_FORMAT;
+    if (maskCount == 4 && readU32(masks + 12) != 0 && readU32(masks + 12) != 0xFF000000u) return BMP_ERROR_FORMAT;
+  } else if (compression != BMP_RGB) {
+    return BMP_ERROR_FORMAT;
+  }
+
+  // A negative height marks a top-down bitmap, INT32_MIN has no positive counterpart and is rejected by the range
+  if (width <= 0 || width > BMP_MAX_SIZE || height == 0 || height > BMP_MAX_SIZE || height < -BMP_MAX_SIZE) return BMP_ERROR_SIZE;
+  int topDown = height < 0;
+  int rows = topDown ? -height : height;
+
+  // Rows are padded to 4 bytes, the sizes fit into 64 bit as width and height are bounded
+  unsigned long long rowSize = ((unsigned long long)width * bitsPerPixel + 31) / 32 * 4;
+  unsigned long long pixelSize = rowSize * rows;
+  if (pixelOffset < BMP_FILE_HEADER_SIZE + headerSize || pixelOffset > size) return BMP_ERROR_HEADER;
+  // The image size is optional for uncompressed bitmaps (0), if it is present it must cover all rows
+  if (imageSize != 0 && imageSize < pixelSize) return BMP_ERROR_HEADER;
+  if (pixelSize > size - pixelOffset) return BMP_ERROR_PIXELS;
+
+  view->width = width;
+  view->height = rows;
+  view->bitsPerPixel = (int)bitsPerPixel;
+  // Bottom-up bitmaps store the top row last, the view walks them backwards
+  view->rows = data + pixelOffset + (topDown ? 0 : rowSize * (rows - 1));
+  view->stride = topDown ? (long long)rowSize : -(long long)rowSize;
+  return BMP_OK;
+}
+
+/**
+ * Maps the bmp file at path (utf-8) and parses it in place
+ *
+ * If the file can't be mapped or isn't a valid bmp it returns NULL and stores the reason in status (status may be NULL)
+*/
+BmpImage* OpenBmpImage(const char* path, BmpStatus* status) {
+  BmpStatus result = BMP_ERROR_OPEN;
+  BmpImage* image = calloc(1, sizeof(BmpImage));
+  if (image) image->file = OpenMappedFile(path);
+  if (image && image->file) result = ParseBmp(image->file->data, image->file->size, &image->view);
+  if (status) *status = result;
+
+  if (result != BMP_OK) {
+    CloseBmpImage(image);
+    return NULL;
+  }
+  return image;
+}
+
+/**
+ * Unmaps the bmp file, the view is invalid afterwards
+*/
+void CloseBmpImage(BmpImage* image) {
+  if (image) {
+    CloseMappedFile(image->file);
+    free(image);
+  }
+}
+
+/**
+ * Converts the pixels of the view into top-down 32 bit pixels (0xAARRGGBB, 24 bit pixels get an alpha of 0)
+ *
+ * stride is the distance between two target rows in pixels
+*/
+void ReadBmpPixels(const BmpView* view, uint32_t* target, int stride) {
+  int bytesPerPixel = view->bitsPerPixel / 8;
+  for (int y = 0; y < view->height; y++) {
+    const unsigned char* src = view->rows + y * view->stride;
+    uint32_t* dst = target + (size_t)y * stride;
+    for (int x = 0; x < view->width; x++, src += bytesPerPixel) {
+      uint32_t pixel = (uint32_t)src[0] | (uint32_t)src[1] << 8 | (uint32_t)src[2] << 16;
+      dst[x] = bytesPerPixel == 4 ? pixel | (uint32_t)src[3] << 24 : pixel;
+    }
+  }
+}
+
+/**
+ * Returns 1 if the file name ends with .bmp (any case)
+*/
+static int hasBmpExtension(const char* name) {
+  size_t length = strlen(name);
+  if (length <= 4) return 0;
+  const char* extension = name + length - 4;
+  return extension[0] == '.' && tolower((unsigned char)extension[1]) == 'b' &&
+    tolower((unsigned char)extension[2]) == 'm' && tolower((unsigned char)extension[3]) == 'p';
+}
+
+/**
+ * Appends the path of the file in the directory to the list if it is a valid bmp, returns 0 if the allocation fails
+*/
+static int addBmpPath(BmpDirectory* list, int* capacity, const char* directory, const char* name) {
+  if (list->count == *capacity) {
+    int grown = *capacity ? *capacity * 2 : 16;
+    char** paths = realloc(list->paths, sizeof(char*) * grown);
+    if (!paths) return 0;
+    list->paths = paths;
+    *capacity = grown;
+  }
+  size_t length = strlen(directory) + strlen(name) + 2;
+  char* path = malloc(length);
+  if (!path) return 0;
+#ifdef _WIN32
+  snprintf(path, length, "%s\\%s", directory, name);
+#else
+  snprintf(path, length, "%s/%s", directory, name);
+#endif
+  // Only the headers are parsed, so invalid files are skipped here instead of failing the image later
+  BmpImage* image = OpenBmpImage(path, NULL);
+  if (!image) {
+    free(path);
+    return 1;
+  }
+  CloseBmpImage(image);
+  list->paths[list->count++] = path;
+  return 1;
+}
+
+/**
+ * Compares two paths for qsort
+*/
+static int comparePaths(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Lists all valid bmp files with the extension .bmp (any case) in the directory (utf-8 path)
+ *
+ * Returns NULL if the directory can't be read, has no valid bmp file or the allocation fails
+*/
+BmpDirectory* OpenBmpDirectory(const char* directory) {
+  BmpDirectory* list = calloc(1, sizeof(BmpDirectory));
+  if (!list) return NULL;
+  int capacity = 0;
+  int failed = 0;
+
+#ifdef _WIN32
+  // Paths are utf-8 like the settings, the wide api is used so any file name can be listed
+  wchar_t pattern[MAX_PATH];
+  char name[MAX_PATH * 3];
+  char narrowPattern[MAX_PATH * 3];
+  snprintf(narrowPattern, sizeof(narrowPattern), "%s\\*", directory);
+  WIN32_FIND_DATAW entry;
+  HANDLE find = INVALID_HANDLE_VALUE;
+  if (MultiByteToWideChar(CP_UTF8, 0, narrowPattern, -1, pattern, MAX_PATH)) find = FindFirstFileW(pattern, &entry);
+  if (find == INVALID_HANDLE_VALUE) failed = 1;
+  while (!failed) {
+    if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+        WideCharToMultiByte(CP_UTF8, 0, entry.cFileName, -1, name, sizeof(name), NULL, NULL) && hasBmpExtension(name)) {
+      failed = !addBmpPath(list, &capacity, directory, name);
+    }
+    if (!FindNextFileW(find, &entry)) break;
+  }
+  if (find != INVALID_HANDLE_VALUE) FindClose(find);
+#else
+  DIR* handle = opendir(directory);
+  if (!handle) failed = 1;
+  struct dirent* entry;
+  while (!failed && (entry = readdir(handle))) {
+    if (hasBmpExtension(entry->d_name)) failed = !addBmpPath(list, &capacity, directory, entry->d_name);
+  }
+  if (handle) closedir(handle);
+#endif
+
+  if (failed || list->count == 0) {
+    CloseBmpDirectory(list);
+    return NULL;
+  }
+  // The directory order is arbitrary, sorting keeps the image order the same on every start
+  qsort(list->paths, list->count, sizeof(char*), comparePaths);
+  return list;
+}
+
+/**
+ * Cleans up the list of files
+*/
+void CloseBmpDirectory(BmpDirectory* directory) {
+  if (directory) {
+    for (int i = 0; i < directory->count; i++) free(directory->paths[i]);
+    free(directory->paths);
+    free(directory);
+  }
+}
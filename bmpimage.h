@@ -0,0 +1,106 @@
+#ifndef BMPIMAGE_H
+#define BMPIMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mappedfile.h"
+
+// Largest width and height accepted from a bmp file
+#define BMP_MAX_SIZE 32768
+
+/**
+ * Result of parsing a bmp file
+*/
+typedef enum {
+  BMP_OK = 0,
+  // The file could not be opened or mapped
+  BMP_ERROR_OPEN = 1,
+  // The file is shorter than the headers
+  BMP_ERROR_TRUNCATED = 2,
+  // The file doesn't start with "BM"
+  BMP_ERROR_SIGNATURE = 3,
+  // Header size, planes, image size or pixel offset are invalid
+  BMP_ERROR_HEADER = 4,
+  // Not an uncompressed 24 or 32 bit bitmap (palettes, rle, png / jpeg and unusual channel masks are rejected)
+  BMP_ERROR_FORMAT = 5,
+  // Width or height is 0, negative (width) or larger than BMP_MAX_SIZE
+  BMP_ERROR_SIZE = 6,
+  // The pixel rows extend beyond the end of the file
+  BMP_ERROR_PIXELS = 7
+} BmpStatus;
+
+/**
+ * Parsed bmp whose pixel rows are read in place
+*/
+typedef struct {
+  // Size of the image in pixels
+  int width;
+  int height;
+  // 24 (BGR) or 32 (BGRA) bits per pixel
+  int bitsPerPixel;
+  // First byte of the top row
+  const unsigned char* rows;
+  // Distance from one row to the row below in bytes (negative for bottom-up bitmaps)
+  long long stride;
+} BmpView;
+
+/**
+ * Memory-mapped bmp file
+*/
+typedef struct {
+  // Mapping of the whole file
+  MappedFile* file;
+  // Pixels of the mapping
+  BmpView view;
+} BmpImage;
+
+/**
+ * Sorted list of the valid bmp files of a directory
+*/
+typedef struct {
+  // Full paths of the files, sorted by name
+  char** paths;
+  // Count of files
+  int count;
+} BmpDirectory;
+
+/**
+ * Parses the headers of the bmp in data and points the view at its pixel rows, nothing is copied
+ *
+ * Every field is validated against the size of the data, the view never reaches beyond it.
+*/
+BmpStatus ParseBmp(const unsigned char* data, size_t size, BmpView* view);
+
+/**
+ * Maps the bmp file at path (utf-8) and parses it in place
+ *
+ * If the file can't be mapped or isn't a valid bmp it returns NULL and stores the reason in status (status may be NULL)
+*/
+BmpImage* OpenBmpImage(const char* path, BmpStatus* status);
+
+/**
+ * Unmaps the bmp file, the view is invalid afterwards
+*/
+void CloseBmpImage(BmpImage* image);
+
+/**
+ * Converts the pixels of the view into top-down 32 bit pixels (0xAARRGGBB, 24 bit pixels get an alpha of 0)
+ *
+ * stride is the distance between two target rows in pixels
+*/
+void ReadBmpPixels(const BmpView* view, uint32_t* target, int stride);
+
+/**
+ * Lists all valid bmp files with the extension .bmp (any case) in the directory (utf-8 path)
+ *
+ * Returns NULL if the directory can't be read, has no valid bmp file or the allocation fails
+*/
+BmpDirectory* OpenBmpDirectory(const char* directory);
+
+/**
+ * Cleans up the list of files
+*/
+void CloseBmpDirectory(BmpDirectory* directory);
+
+#endif
@@ -0,0 +1,662 @@
+#include "broadphase.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+
+#define BP_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define BP_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/**
+ * Create a broadphase for up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+Broadphase* CreateBroadphase(BroadphaseKind kind, int capacity) {
+  Broadphase* broadphase = calloc(1, sizeof(Broadphase));
+  if (!broadphase) return NULL;
+
+  if (capacity < 1) capacity = 1;
+  broadphase->kind = kind;
+  broadphase->capacity = capacity;
+
+  // Use at least twice as many buckets as sprites to keep the chains short
+  broadphase->tableSize = 1;
+  while (broadphase->tableSize < capacity * 2) broadphase->tableSize <<= 1;
+
+  // The segment tree over the ranks needs a power of two leaf count
+  broadphase->treeSize = 1;
+  while (broadphase->treeSize < capacity) broadphase->treeSize <<= 1;
+
+  broadphase->rankX = malloc(sizeof(int) * capacity);
+  broadphase->touched = malloc(sizeof(unsigned char) * capacity);
+  broadphase->nextUntouched = malloc(sizeof(int) * (capacity + 1));
+  broadphase->touchedX = malloc(sizeof(int) * broadphase->treeSize * 2);
+  broadphase->bucketStart = malloc(sizeof(int) * (broadphase->tableSize + 1));
+  broadphase->entries = malloc(sizeof(int) * capacity * 4);
+  broadphase->movedHead = malloc(sizeof(int) * broadphase->tableSize);
+  broadphase->stamp = malloc(sizeof(int) * capacity);
+  broadphase->candidates = malloc(sizeof(int) * capacity);
+  broadphase->sweptOrder = malloc(sizeof(int) * capacity);
+
+  if (!broadphase->rankX || !broadphase->touched || !broadphase->nextUntouched || !broadphase->touchedX ||
+      !broadphase->bucketStart || !broadphase->entries || !broadphase->movedHead || !broadphase->stamp ||
+      !broadphase->candidates || !broadphase->sweptOrder) {
+    CloseBroadphase(broadphase);
+    return NULL;
+  }
+  return broadphase;
+}
+
+/**
+ * Cleans up the broadphase and all its buffers
+*/
+void CloseBroadphase(Broadphase* broadphase) {
+  if (broadphase) {
+    free(broadphase->rankX);
+    free(broadphase->touched);
+    free(broadphase->nextUntouched);
+    free(broadphase->touchedX);
+    free(broadphase->bucketStart);
+    free(broadphase->entries);
+    free(broadphase->movedHead);
+    free(broadphase->movedRank);
+    free(broadphase->movedNext);
+    free(broadphase->stamp);
+    free(broadphase->candidates);
+    free(broadphase->sweptOrder);
+    free(broadphase);
+  }
+}
+
+/**
+ * Insertion sort of the sprite order based on the x position of the sprites
+*/
+static void insertionSort(SpriteStore* sprites) {
+  int i, j;
+  int key;
+  int* order = sprites->order;
+  for (i = 0; i < sprites->count; i++) {
+    key = order[i];
+    j = i - 1;
+
+    // Reverse iterate and move elements up as long as they are larger then the key
+    while (j >= 0 && sprites->xPos[order[j]] > sprites->xPos[key]) {
+      // Move current element (order[j]) one element up
+      order[j + 1] = order[j];
+      j--;
+    }
+    // Set the last element which was moved up to the key
+    order[j + 1] = key;
+  }
+}
+
+/**
+ * Algorithm to resolve the collision of two sprites (a and b are indices into the sprite store)
+*/
+static void resolveCollision(SpriteStore* sprites, int a, int b) {
+  int* xPos = sprites->xPos;
+  int* yPos = sprites->yPos;
+
+  // Retrieve minimum translation vector for x by taking the min right side - max left side
+  int overlapX = BP_MIN(
+    xPos[a] + sprites->width[a], // Right side A
+    xPos[b] + sprites->width[b] // Right side B
+  ) - BP_MAX(
+    xPos[a], // Left side A
+    xPos[b] // Left side B
+  );
+
+  // Retrieve minimum translation vector for y by taking the min bottom side - max top side
+  int overlapY = BP_MIN(
+    yPos[a] + sprites->height[a], // Bottom side A
+    yPos[b] + sprites->height[b] // Bottom side B
+  ) - BP_MAX(
+    yPos[a], // Top side A
+    yPos[b] // Top side B
+  );
+
+  // Check for the smaller overlap
+  // This is very important, because we want to resolve the collision always at the minimum overlap,
+  // otherwise a 1px collision on y could cause a 10px movment on the x axis
+  if (overlapX < overlapY) {
+    // Decollide by moving the objects both by the overlapped side (+ one whole pixel, positions are fixed point)
+    // We check what object is at the right side to ensure that the objects don't apply the overlap to the wrong side
+    if (xPos[a] > xPos[b]) {
+      // ObjectA is on the right side, so we move it to the right and B to the left
+      xPos[a] += (overlapX / 2) + SPRITE_FIXED_ONE;
+      xPos[b] -= (overlapX / 2) + SPRITE_FIXED_ONE;
+    } else {
+      // ObjectB is on the right side, so we move it to the right and A to the left
+      xPos[a] -= (overlapX / 2) + SPRITE_FIXED_ONE;
+      xPos[b] += (overlapX / 2) + SPRITE_FIXED_ONE;
+    }
+    // Change movement direction
+    sprites->xMov[a] = - sprites->xMov[a];
+    sprites->xMov[b] = - sprites->xMov[b];
+  } else {
+    // Decollide by moving the objects both by the overlapped side (+ one whole pixel, positions are fixed point)
+    // We check what object is at the bottom side to ensure that the objects don't apply the overlap to the wrong side
+    if (yPos[a] > yPos[b]) {
+      // ObjectA is on the bottom side, so we move it to the bottom and B to the top
+      yPos[a] += (overlapY / 2) + SPRITE_FIXED_ONE;
+      yPos[b] -= (overlapY / 2) + SPRITE_FIXED_ONE;
+    } else {
+      // ObjectB is on the bottom side, so we move it to the bottom and A to the top
+      yPos[a] -= (overlapY / 2) + SPRITE_FIXED_ONE;
+      yPos[b] += (overlapY / 2) + SPRITE_FIXED_ONE;
+    }
+    // Change movement direction
+    sprites->yMov[a] = - sprites->yMov[a];
+    sprites->yMov[b] = - sprites->yMov[b];
+  }
+  // Add movment boost
+  sprites->inc[a] = sprites->baseInc[a];
+  sprites->inc[b] = sprites->baseInc[b];
+}
+
+/**
+ * Sweep & prune like algorithm is used to check for collisions
+ * the main axis is sorted with insertion sort because it is very efficient for "almost-sorted" lists
+ *
+ * Algorithm is not very efficient but omits O(n^2) average speed by using the sorted list to "split" the collision detection into sections
+*/
+static void sweepAndPrune(Broadphase* broadphase, SpriteStore* sprites) {
+  // Sort all sprites by x axis
+  insertionSort(sprites);
+  int* order = sprites->order;
+  // Now iterate over all the sprites once
+  // Because the list is sorted we only need to iterate over every sprite once,
+  // checking all sprites after i. We know that sprites before i already checked the collision with i
+  for (int i = 0; i < sprites->count; i++) {
+    int local = order[i];
+    // Create some abstraction aliases
+    int localRight = sprites->xPos[local] + sprites->width[local];
+    int localTop = sprites->yPos[local];
+    int localBottom = sprites->yPos[local] + sprites->height[local];
+
+    // Iterate over all sprites and check for collision with the local sprite
+    for (int j = i + 1; j < sprites->count; j++) {
+      int remote = order[j];
+      // Create some abstraction aliases
+      int remoteLeft = sprites->xPos[remote];
+      int remoteTop = sprites->yPos[remote];
+      int remoteBottom = sprites->yPos[remote] + sprites->height[remote];
+
+      // If the remote sprite left side is not colliding with the local right side
+      // the iteration can be aborted because no more remote sprites will collide (we know that because the list is sorted by x axis)
+      if (localRight < remoteLeft) break;
+
+      // Check if y axis collides, we already know that x collides because the loop didn't break
+      if (localBottom >= remoteTop && localTop <= remoteBottom) {
+        // If a collision is detected on both axes we resolve the collision
+        resolveCollision(sprites, local, remote);
+        broadphase->pairCount++;
+      }
+    }
+  }
+}
+
+/**
+ * Floor division, cell coordinates must also round down for negative positions
+*/
+static inline int cellOf(int pos, int cellSize) {
+  return pos >= 0 ? pos / cellSize : -((-pos + cellSize - 1) / cellSize);
+}
+
+/**
+ * Hashes a cell coordinate into a bucket index
+*/
+static inline int bucketOf(Broadphase* broadphase, int cx, int cy) {
+  unsigned int hash = ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u);
+  return (int)(hash & (unsigned int)(broadphase->tableSize - 1));
+}
+
+/**
+ * Finds the first untouched rank at or after rank
+ *
+ * Touched ranks point to their successor, the chains are shortened on every lookup (path halving)
+*/
+static int nextUntouched(Broadphase* broadphase, int rank) {
+  int* next = broadphase->nextUntouched;
+  while (next[rank] != rank) {
+    next[rank] = next[next[rank]];
+    rank = next[rank];
+  }
+  return rank;
+}
+
+/**
+ * Sets the current x position of a touched rank in the max segment tree
+*/
+static void updateTouchedX(Broadphase* broadphase, int rank, int xPos) {
+  int node = broadphase->treeSize + rank;
+  broadphase->touchedX[node] = xPos;
+  for (node >>= 1; node > 0; node >>= 1) {
+    broadphase->touchedX[node] = BP_MAX(broadphase->touchedX[2 * node], broadphase->touchedX[2 * node + 1]);
+  }
+}
+
+/**
+ * Returns the first touched rank at or after from whose x position is larger then threshold, or -1
+*/
+static int firstTouchedRight(Broadphase* broadphase, int node, int low, int high, int from, int threshold) {
+  if (high <= from || broadphase->touchedX[node] <= threshold) return -1;
+  if (high - low == 1) return low;
+  int mid = low + (high - low) / 2;
+  int rank = firstTouchedRight(broadphase, 2 * node, low, mid, from, threshold);
+  if (rank >= 0) return rank;
+  return firstTouchedRight(broadphase, 2 * node + 1, mid, high, from, threshold);
+}
+
+/**
+ * Inserts a touched rank with its current box into the moved grid
+ *
+ * Returns FALSE (0) if the entry buffer could not be grown
+*/
+static int insertMoved(Broadphase* broadphase, SpriteStore* sprites, int rank, int cellSize) {
+  int sprite = sprites->order[rank];
+  int cx0 = cellOf(sprites->xPos[sprite], cellSize);
+  int cx1 = cellOf(sprites->xPos[sprite] + sprites->width[sprite], cellSize);
+  int cy0 = cellOf(sprites->yPos[sprite], cellSize);
+  int cy1 = cellOf(sprites->yPos[sprite] + sprites->height[sprite], cellSize);
+
+  int required = broadphase->movedCount + (cx1 - cx0 + 1) * (cy1 - cy0 + 1);
+  if (required > broadphase->movedCapacity) {
+    int capacity = BP_MAX(required, broadphase->movedCapacity * 2);
+    int* movedRank = realloc(broadphase->movedRank, sizeof(int) * capacity);
+    if (!movedRank) return 0;
+    broadphase->movedRank = movedRank;
+    int* movedNext = realloc(broadphase->movedNext, sizeof(int) * capacity);
+    if (!movedNext) return 0;
+    broadphase->movedNext = movedNext;
+    broadphase->movedCapacity = capacity;
+  }
+
+  for (int cy = cy0; cy <= cy1; cy++) {
+    for (int cx = cx0; cx <= cx1; cx++) {
+      int bucket = bucketOf(broadphase, cx, cy);
+      int entry = broadphase->movedCount++;
+      broadphase->movedRank[entry] = rank;
+      broadphase->movedNext[entry] = broadphase->movedHead[bucket];
+      broadphase->movedHead[bucket] = entry;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Marks a rank as moved by a resolved collision and records its new position
+*/
+static void touchRank(Broadphase* broadphase, SpriteStore* sprites, int rank, int cellSize) {
+  int xPos = sprites->xPos[sprites->order[rank]];
+  if (!broadphase->touched[rank]) {
+    broadphase->touched[rank] = 1;
+    broadphase->nextUntouched[rank] = rank + 1;
+  }
+  broadphase->maxLeftDrift = BP_MAX(broadphase->maxLeftDrift, broadphase->rankX[rank] - xPos);
+  updateTouchedX(broadphase, rank, xPos);
+  // Older entries of the rank stay in the moved grid, they are just deduplicated as candidates
+  if (!broadphase->movedOverflow && !insertMoved(broadphase, sprites, rank, cellSize)) {
+    broadphase->movedOverflow = 1;
+  }
+}
+
+/**
+ * Adds a rank to the candidate list of the local sprite (rank i) if it was not added already
+*/
+static inline void addCandidate(Broadphase* broadphase, int* count, int i, int rank) {
+  if (broadphase->stamp[rank] != i) {
+    broadphase->stamp[rank] = i;
+    broadphase->candidates[(*count)++] = rank;
+  }
+}
+
+/**
+ * Inserts every sprite (by rank) into all hash cells its box covers at the start of the pass
+ *
+ * Buckets are built with a counting sort, so no per cell allocation is necessary
+*/
+static void buildGrid(Broadphase* broadphase, SpriteStore* sprites, int cellSize) {
+  int* order = sprites->order;
+  int* bucketStart = broadphase->bucketStart;
+
+  for (int b = 0; b <= broadphase->tableSize; b++) bucketStart[b] = 0;
+
+  // First pass counts the entries per bucket, second pass places them
+  for (int pass = 0; pass < 2; pass++) {
+    for (int r = 0; r < sprites->count; r++) {
+      int sprite = order[r];
+      int cx0 = cellOf(sprites->xPos[sprite], cellSize);
+      int cx1 = cellOf(sprites->xPos[sprite] + sprites->width[sprite], cellSize);
+      int cy0 = cellOf(sprites->yPos[sprite], cellSize);
+      int cy1 = cellOf(sprites->yPos[sprite] + sprites->height[sprite], cellSize);
+      for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+          int bucket = bucketOf(broadphase, cx, cy);
+          if (pass == 0) bucketStart[bucket + 1]++;
+          else broadphase->entries[bucketStart[bucket]++] = r;
+        }
+      }
+    }
+    if (pass == 0) {
+      // Convert the counts into offsets
+      for (int b = 0; b < broadphase->tableSize; b++) bucketStart[b + 1] += bucketStart[b];
+    }
+  }
+  // Placing advanced every offset to the start of the next bucket, shift them back
+  for (int b = broadphase->tableSize; b > 0; b--) bucketStart[b] = bucketStart[b - 1];
+  bucketStart[0] = 0;
+}
+
+/**
+ * Spatial hash broadphase reproducing the sweep & prune pair order exactly
+ *
+ * The sweep resolves, for every sprite i in x order, all later sprites j up to the first one whose left side
+ * is right of the local right side, if their y ranges overlap. Resolving moves sprites during the pass,
+ * therefore the grid (built from the positions at pass start) is only trusted for untouched sprites.
+ * Sprites moved by a resolution are tracked separately: a segment tree over their x positions finds
+ * the break rank and a second (moved) grid finds them as candidates.
+ * The candidates are then tested with the exact same predicate in rank order.
+*/
+static void spatialHash(Broadphase* broadphase, SpriteStore* sprites) {
+  // The grid needs a stable rank order, the insertion sort is cheap on the almost sorted list
+  insertionSort(sprites);
+  int* order = sprites->order;
+  int count = sprites->count;
+
+  // Cells are one pixel larger then the largest sprite, so every box covers at most 2x2 cells
+  int cellSize = 1;
+  for (int r = 0; r < count; r++) {
+    cellSize = BP_MAX(cellSize, BP_MAX(sprites->width[r], sprites->height[r]) + 1);
+  }
+
+  // Snapshot the sorted x positions and reset the touched state
+  for (int r = 0; r < count; r++) {
+    broadphase->rankX[r] = sprites->xPos[order[r]];
+    broadphase->touched[r] = 0;
+    broadphase->nextUntouched[r] = r;
+    broadphase->stamp[r] = -1;
+  }
+  broadphase->nextUntouched[count] = count;
+  for (int node = 0; node < broadphase->treeSize * 2; node++) broadphase->touchedX[node] = INT_MIN;
+  for (int b = 0; b < broadphase->tableSize; b++) broadphase->movedHead[b] = -1;
+  broadphase->movedCount = 0;
+  broadphase->movedOverflow = 0;
+  broadphase->maxLeftDrift = 0;
+
+  buildGrid(broadphase, sprites, cellSize);
+
+  for (int i = 0; i < count; i++) {
+    int local = order[i];
+    // Create some abstraction aliases (captured before any resolution of this sprite, like in the sweep)
+    int localRight = sprites->xPos[local] + sprites->width[local];
+    int localTop = sprites->yPos[local];
+    int localBottom = sprites->yPos[local] + sprites->height[local];
+
+    // Find the rank the sweep would break at, first the untouched sprites by binary search over the snapshot...
+    int low = i + 1, high = count;
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      if (broadphase->rankX[mid] > localRight) high = mid;
+      else low = mid + 1;
+    }
+    int breakRank = nextUntouched(broadphase, low);
+    // ...then the touched sprites, which may have moved beyond localRight
+    int touchedBreak = firstTouchedRight(broadphase, 1, 0, broadphase->treeSize, i + 1, localRight);
+    if (touchedBreak >= 0 && touchedBreak < breakRank) breakRank = touchedBreak;
+
+    int cy0 = cellOf(localTop, cellSize);
+    int cy1 = cellOf(localBottom, cellSize);
+    int candidateCount = 0;
+
+    // Untouched later sprites start right of the snapshot position of i, so the relevant
+    // x range reaches from there to localRight
+    int queryLeft = broadphase->rankX[i];
+    if (queryLeft <= localRight) {
+      int cx0 = cellOf(queryLeft, cellSize);
+      int cx1 = cellOf(localRight, cellSize);
+      for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+          int bucket = bucketOf(broadphase, cx, cy);
+          for (int e = broadphase->bucketStart[bucket]; e < broadphase->bucketStart[bucket + 1]; e++) {
+            int r = broadphase->entries[e];
+            if (r > i && r < breakRank && !broadphase->touched[r]) addCandidate(broadphase, &candidateCount, i, r);
+          }
+        }
+      }
+    }
+
+    // Touched later sprites started right of the snapshot position of i, but may have drifted left since then
+    if (broadphase->movedOverflow) {
+      // The moved grid is incomplete, fall back to checking every touched rank in range
+      for (int r = i + 1; r < breakRank; r++) {
+        if (broadphase->touched[r]) addCandidate(broadphase, &candidateCount, i, r);
+      }
+    } else if (queryLeft - broadphase->maxLeftDrift <= localRight) {
+      int cx0 = cellOf(queryLeft - broadphase->maxLeftDrift, cellSize);
+      int cx1 = cellOf(localRight, cellSize);
+      for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+          int bucket = bucketOf(broadphase, cx, cy);
+          for (int e = broadphase->movedHead[bucket]; e >= 0; e = broadphase->movedNext[e]) {
+            int r = broadphase->movedRank[e];
+            if (r > i && r < breakRank) addCandidate(broadphase, &candidateCount, i, r);
+          }
+        }
+      }
+    }
+
+    // Restore the sweep order of the candidates (lists are short, insertion sort is fine)
+    for (int a = 1; a < candidateCount; a++) {
+      int key = broadphase->candidates[a];
+      int b = a - 1;
+      while (b >= 0 && broadphase->candidates[b] > key) {
+        broadphase->candidates[b + 1] = broadphase->candidates[b];
+        b--;
+      }
+      broadphase->candidates[b + 1] = key;
+    }
+
+    for (int c = 0; c < candidateCount; c++) {
+      int r = broadphase->candidates[c];
+      int remote = order[r];
+      int remoteTop = sprites->yPos[remote];
+      int remoteBottom = sprites->yPos[remote] + sprites->height[remote];
+
+      // Same y check as in the sweep, x is guaranteed to collide because r is before breakRank
+      if (localBottom >= remoteTop && localTop <= remoteBottom) {
+        resolveCollision(sprites, local, remote);
+        broadphase->pairCount++;
+        // The local sprite is never looked at again during this pass, only the remote needs tracking
+        touchRank(broadphase, sprites, r, cellSize);
+      }
+    }
+  }
+}
+
+/**
+ * Returns the time range (0.0 = previous, 1.0 = current position) in which the 1d interval of b overlaps a
+ *
+ * The motion is relative to a, the interval of a stays at its previous position.
+ * Returns 0 if the intervals never overlap.
+*/
+static int overlapTimes(double aStart, double aSize, double bStart, double bSize, double motion, double* entry, double* exit) {
+  if (motion == 0.0) {
+    // No relative motion, the intervals either overlap during the whole step or never
+    if (bStart >= aStart + aSize || bStart + bSize <= aStart) return 0;
+    *entry = -HUGE_VAL;
+    *exit = HUGE_VAL;
+    return 1;
+  }
+  double first = (aStart + aSize - bStart) / motion;
+  double second = (aStart - bSize - bStart) / motion;
+  *entry = BP_MIN(first, second);
+  *exit = BP_MAX(first, second);
+  return 1;
+}
+
+/**
+ * Moves the sprite to its position at time of impact on one axis and reflects the remaining motion of the step
+*/
+static inline int reflectAt(int previous, int current, double time) {
+  double motion = current - previous;
+  return previous + (int)(motion * time - motion * (1.0 - time));
+}
+
+/**
+ * Pushes a and b apart on one axis (by the overlap + one whole pixel, like the overlap resolution)
+ *
+ * The side is taken from the previous positions, the boxes did not overlap on the contact axis before the impact.
+*/
+static inline void separateAxis(int* pos, const int* prev, const int* size, int a, int b) {
+  int first = prev[a] <= prev[b] ? a : b;
+  int second = first == a ? b : a;
+  int overlap = pos[first] + size[first] - pos[second];
+  pos[first] -= (overlap / 2) + SPRITE_FIXED_ONE;
+  pos[second] += (overlap / 2) + SPRITE_FIXED_ONE;
+}
+
+/**
+ * Resolves a and b at their time of impact if their boxes met during the step
+ *
+ * The positions are treated as linear motion from prevX / prevY to xPos / yPos. At the time of impact
+ * the motion on the contact axis is reflected for the rest of the step, like the overlap resolution does
+ * with the movement direction. This is done even if the boxes overlap at the end of the step, because the
+ * end positions of a sprite that moved further then its size can already be on the far side of the other one
+ * (the overlap resolution would push it out on that side and it tunnelled). Only pairs overlapping at the
+ * start of the step are left to the overlap resolution, so the pass must only be used for fast sprites.
+ * Returns 1 if the pair was resolved.
+*/
+static int resolveSweptCollision(SpriteStore* sprites, int a, int b) {
+  int* xPos = sprites->xPos;
+  int* yPos = sprites->yPos;
+  int* prevX = sprites->prevX;
+  int* prevY = sprites->prevY;
+
+  // Motion of b relative to a
+  double motionX = (double)(xPos[b] - prevX[b]) - (xPos[a] - prevX[a]);
+  double motionY = (double)(yPos[b] - prevY[b]) - (yPos[a] - prevY[a]);
+  double entryX, exitX, entryY, exitY;
+  if (!overlapTimes(prevX[a], sprites->width[a], prevX[b], sprites->width[b], motionX, &entryX, &exitX)) return 0;
+  if (!overlapTimes(prevY[a], sprites->height[a], prevY[b], sprites->height[b], motionY, &entryY, &exitY)) return 0;
+
+  // The boxes overlap once both axes overlap, an entry before the step means they already overlapped at the start
+  double entry = BP_MAX(entryX, entryY);
+  double exit = BP_MIN(exitX, exitY);
+  if (entry >= exit || entry < 0.0 || entry > 1.0) return 0;
+
+  // The axis that started to overlap last is the one the boxes hit on (both axes if they hit corner on corner)
+  if (entryX >= entryY) {
+    xPos[a] = reflectAt(prevX[a], xPos[a], entry);
+    xPos[b] = reflectAt(prevX[b], xPos[b], entry);
+    sprites->xMov[a] = - sprites->xMov[a];
+    sprites->xMov[b] = - sprites->xMov[b];
+  }
+  if (entryY >= entryX) {
+    yPos[a] = reflectAt(prevY[a], yPos[a], entry);
+    yPos[b] = reflectAt(prevY[b], yPos[b], entry);
+    sprites->yMov[a] = - sprites->yMov[a];
+    sprites->yMov[b] = - sprites->yMov[b];
+  }
+  // An impact close to the end of the step (or the rounding) can leave the reflected boxes touching,
+  // the overlap resolution would then reflect the pair a second time and undo the swept resolution
+  if (xPos[a] <= xPos[b] + sprites->width[b] && xPos[b] <= xPos[a] + sprites->width[a] &&
+      yPos[a] <= yPos[b] + sprites->height[b] && yPos[b] <= yPos[a] + sprites->height[a]) {
+    if (entryX >= entryY) separateAxis(xPos, prevX, sprites->width, a, b);
+    else separateAxis(yPos, prevY, sprites->height, a, b);
+  }
+  // Add movment boost
+  sprites->inc[a] = sprites->baseInc[a];
+  sprites->inc[b] = sprites->baseInc[b];
+  return 1;
+}
+
+/**
+ * Left side of the box covering the previous and the current position of the sprite
+*/
+static inline int sweptLeft(SpriteStore* sprites, int sprite) {
+  return BP_MIN(sprites->prevX[sprite], sprites->xPos[sprite]);
+}
+
+/**
+ * Returns 1 if the sprite moved further then its own size on one axis during the step
+*/
+static inline int movedBeyondSize(SpriteStore* sprites, int sprite) {
+  return abs(sprites->xPos[sprite] - sprites->prevX[sprite]) > sprites->width[sprite] ||
+    abs(sprites->yPos[sprite] - sprites->prevY[sprite]) > sprites->height[sprite];
+}
+
+/**
+ * Continuous collision pass, finds sprite pairs whose swept boxes overlap and resolves them at their time of impact
+ *
+ * Two boxes can only pass through each other if at least one of them moved further then its own size,
+ * otherwise a contact during the step still overlaps at its end (or was a shallow corner touch)
+ * and is left to the overlap resolution. Pairs with a fast sprite are resolved at their time of impact,
+ * even if they overlap at the end. Steps without a fast sprite skip the pass completely.
+ *
+ * The swept boxes are swept & pruned over the x axis. The order is seeded from the x order of the last
+ * overlap pass, so the insertion sort only has to fix up the sprites that moved a lot.
+*/
+static void sweptPass(Broadphase* broadphase, SpriteStore* sprites) {
+  int fast = 0;
+  for (int i = 0; i < sprites->count && !fast; i++) fast = movedBeyondSize(sprites, i);
+  if (!fast) return;
+
+  int* order = broadphase->sweptOrder;
+  for (int i = 0; i < sprites->count; i++) order[i] = sprites->order[i];
+
+  for (int i = 1; i < sprites->count; i++) {
+    int key = order[i];
+    int keyLeft = sweptLeft(sprites, key);
+    int j = i - 1;
+    while (j >= 0 && sweptLeft(sprites, order[j]) > keyLeft) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = key;
+  }
+
+  for (int i = 0; i < sprites->count; i++) {
+    int local = order[i];
+    int localRight = BP_MAX(sprites->prevX[local], sprites->xPos[local]) + sprites->width[local];
+    int localTop = BP_MIN(sprites->prevY[local], sprites->yPos[local]);
+    int localBottom = BP_MAX(sprites->prevY[local], sprites->yPos[local]) + sprites->height[local];
+
+    for (int j = i + 1; j < sprites->count; j++) {
+      int remote = order[j];
+      // Same early break as the sweep, later swept boxes start even further right
+      if (localRight < sweptLeft(sprites, remote)) break;
+
+      int remoteTop = BP_MIN(sprites->prevY[remote], sprites->yPos[remote]);
+      int remoteBottom = BP_MAX(sprites->prevY[remote], sprites->yPos[remote]) + sprites->height[remote];
+      if (localBottom >= remoteTop && localTop <= remoteBottom &&
+          (movedBeyondSize(sprites, local) || movedBeyondSize(sprites, remote)) &&
+          resolveSweptCollision(sprites, local, remote)) {
+        broadphase->sweptCount++;
+      }
+    }
+  }
+}
+
+/**
+ * Checks for collisions on the sprites and updates their movement appropriately
+ *
+ * Pairs that touched only in the middle of the step (e.g. fast sprites passing through each other)
+ * are resolved first at their time of impact, then the overlapping pairs are resolved at the end positions.
+ * Both algorithms resolve exactly the same pairs in exactly the same order,
+ * switching the kind does never change the simulation result.
+*/
+void HandleCollisions(Broadphase* broadphase, SpriteStore* sprites) {
+  broadphase->pairCount = 0;
+  broadphase->sweptCount = 0;
+  // The swept order is sized like the other scratch buffers, an outgrown store only gets the overlap resolution
+  if (sprites->count <= broadphase->capacity) sweptPass(broadphase, sprites);
+  // Fall back to the sweep if the store outgrew the scratch buffers
+  if (broadphase->kind == BROADPHASE_GRID && sprites->count <= broadphase->capacity) {
+    spatialHash(broadphase, sprites);
+  } else {
+    sweepAndPrune(broadphase, sprites);
+  }
+  broadphase->pairCount += broadphase->sweptCount;
+}
@@ -0,0 +1,93 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "spritestore.h"
+
+/**
+ * Algorithm used to find colliding sprite pairs
+*/
+typedef enum {
+  // Insertion sorted sweep & prune over the x axis (cheap for few or well spread sprites)
+  BROADPHASE_SWEEP = 0,
+  // Spatial hash with cells sized after the largest sprite (stays linear when many sprites overlap on x)
+  BROADPHASE_GRID = 1
+} BroadphaseKind;
+
+/**
+ * Scratch state of the collision broadphase
+ *
+ * The buffers are kept between frames, so the steady state does not allocate
+*/
+typedef struct {
+  // Selected algorithm
+  BroadphaseKind kind;
+  // Count of sprites the buffers can hold
+  int capacity;
+
+  // X position of the sprites at the start of the pass, indexed by sweep rank (sorted ascending)
+  int* rankX;
+  // Marks ranks whose sprite was moved by a resolved collision during the current pass
+  unsigned char* touched;
+  // Successor links skipping touched ranks (capacity + 1 elements)
+  int* nextUntouched;
+  // Max segment tree over the current x position of touched ranks (INT_MIN for untouched ranks)
+  int* touchedX;
+  // Leaf count of the segment tree (power of two)
+  int treeSize;
+  // Largest distance a touched sprite moved left of its snapshot position
+  int maxLeftDrift;
+
+  // Count of hash buckets (power of two)
+  int tableSize;
+  // Offset of the first entry per bucket of the snapshot grid (tableSize + 1 elements)
+  int* bucketStart;
+  // Ranks inserted into the snapshot grid (every sprite covers up to 4 cells)
+  int* entries;
+
+  // First entry per bucket of the moved grid holding touched sprites at their new position (-1 if empty)
+  int* movedHead;
+  // Rank and next entry of the moved grid entries
+  int* movedRank;
+  int* movedNext;
+  int movedCount;
+  int movedCapacity;
+  // Set if the moved grid could not be grown, touched ranks are then checked linearly
+  int movedOverflow;
+
+  // Last rank that collected a candidate, used to deduplicate candidates found in multiple cells
+  int* stamp;
+  // Candidate ranks of the current sprite
+  int* candidates;
+
+  // Sprite indices sorted by the left side of their swept box (box covering the previous and the current position)
+  int* sweptOrder;
+
+  // Count of pairs resolved in the last pass
+  int pairCount;
+  // Count of those pairs that passed through each other during the step and were resolved at their time of impact
+  int sweptCount;
+} Broadphase;
+
+/**
+ * Create a broadphase for up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+Broadphase* CreateBroadphase(BroadphaseKind kind, int capacity);
+
+/**
+ * Cleans up the broadphase and all its buffers
+*/
+void CloseBroadphase(Broadphase* broadphase);
+
+/**
+ * Checks for collisions on the sprites and updates their movement appropriately
+ *
+ * Pairs that touched only in the middle of the step (e.g. fast sprites passing through each other)
+ * are resolved first at their time of impact, then the overlapping pairs are resolved at the end positions.
+ * Both algorithms resolve exactly the same pairs in exactly the same order,
+ * switching the kind does never change the simulation result.
+*/
+void HandleCollisions(Broadphase* broadphase, SpriteStore* sprites);
+
+#endif
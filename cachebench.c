@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spritecache.h"
+#include "framescheduler.h"
+
+// Resource the loader of the check fails for, like a missing bitmap
+#define BENCH_MISSING_RESOURCE 999
+// Colour key of the loaded sprites
+#define BENCH_KEY 0xFF00FF
+
+/**
+ * Context of the loader, counts the sprites it had to load
+*/
+typedef struct {
+  int calls;
+} BenchLoader;
+
+/**
+ * Draws the pixels of the sprite described by the key: a disc of key->width pixels coloured by its resource
+*/
+static void drawSprite(const SpriteKey* key, uint32_t* pixels) {
+  int size = key->width, radius = key->width / 2;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int dx = x - radius, dy = y - radius;
+      pixels[y * size + x] = dx * dx + dy * dy > radius * radius ? BENCH_KEY : 0xFF000000u | (uint32_t)(key->resource * 37 % 256) << 16 | (uint32_t)x << 8 | (uint32_t)y;
+    }
+  }
+}
+
+/**
+ * Compiles the sprite described by the key (without the cache)
+*/
+static CompiledSprite* compileKey(const SpriteKey* key) {
+  uint32_t* pixels = malloc(sizeof(uint32_t) * key->width * key->width);
+  if (!pixels) return NULL;
+  drawSprite(key, pixels);
+  CompiledSprite* sprite = CompileSprite(pixels, key->width, key->width, key->width, key->transparentColor);
+  free(pixels);
+  return sprite;
+}
+
+/**
+ * Loader of the cache, counts its calls and fails for the missing resource
+*/
+static CompiledSprite* loadSprite(const SpriteKey* key, void* context) {
+  ((BenchLoader*)context)->calls++;
+  if (key->resource == BENCH_MISSING_RESOURCE) return NULL;
+  return compileKey(key);
+}
+
+/**
+ * Key of the image on the monitor, even and odd monitors scale the images to different widths
+*/
+static SpriteKey keyOf(int image, int monitor, int distinct) {
+  return (SpriteKey){ .resource = image % distinct, .width = monitor % 2 ? 96 : 64, .format = SPRITE_FORMAT_COLORKEY,
+    .filter = RESAMPLE_BILINEAR, .transparentColor = BENCH_KEY };
+}
+
+/**
+ * Returns 1 if the cached sprite draws the same pixels as a sprite compiled without the cache (and the atlas)
+*/
+static int drawsLikeKey(const CompiledSprite* sprite, const SpriteKey* key) {
+  CompiledSprite* reference = compileKey(key);
+  size_t size = sizeof(uint32_t) * key->width * key->width;
+  PixelBuffer cached = { .pixels = calloc(1, size), .width = key->width, .height = key->width, .stride = key->width };
+  PixelBuffer expected = { .pixels = calloc(1, size), .width = key->width, .height = key->width, .stride = key->width };
+  SpriteBounds all = { .left = 0, .top = 0, .right = key->width, .bottom = key->width };
+  int same = reference && cached.pixels && expected.pixels;
+  if (same) {
+    BlitCompiledSprite(&cached, sprite, 0, 0, all);
+    BlitCompiledSprite(&expected, reference, 0, 0, all);
+    same = memcmp(cached.pixels, expected.pixels, size) == 0;
+  }
+  CloseCompiledSprite(reference);
+  free(cached.pixels);
+  free(expected.pixels);
+  return same;
+}
+
+/**
+ * Acquires the images of all monitors like the windows do, checks the counters and references and releases them again
+ *
+ * Returns 0 if a check failed, adds the time of all acquisitions to acquireTime (in ms)
+*/
+static int runCache(int monitors, int images, int distinct, int withAtlas, double* acquireTime) {
+  SpriteCache* cache = CreateSpriteCache();
+  SpriteAtlas* atlas = withAtlas ? CreateSpriteAtlas(ATLAS_DEFAULT_SIZE, ATLAS_DEFAULT_SIZE) : NULL;
+  CompiledSprite** acquired = malloc(sizeof(CompiledSprite*) * monitors * images);
+  // First sprite returned for every key and its expected reference count (widths 64 and 96 of every resource)
+  CompiledSprite** first = calloc(distinct * 2, sizeof(CompiledSprite*));
+  int* references = calloc(distinct * 2, sizeof(int));
+  if (!cache || (withAtlas && !atlas) || !acquired || !first || !references) return 0;
+  cache->atlas = atlas;
+
+  BenchLoader loader = { .calls = 0 };
+  int ok = 1, keys = 0;
+  double start = FrameSchedulerNow();
+  for (int m = 0; m < monitors; m++) {
+    for (int i = 0; i < images; i++) acquired[m * images + i] = AcquireCachedSprite(cache, keyOf(i, m, distinct), loadSprite, &loader);
+  }
+  *acquireTime += FrameSchedulerNow() - start;
+
+  for (int m = 0; m < monitors; m++) {
+    for (int i = 0; i < images; i++) {
+      SpriteKey key = keyOf(i, m, distinct);
+      int index = key.resource + (m % 2) * distinct;
+      CompiledSprite* sprite = acquired[m * images + i];
+      if (!first[index]) {
+        first[index] = sprite;
+        keys++;
+        if (!sprite || !drawsLikeKey(sprite, &key)) ok = 0;
+      }
+      // Every acquisition of the key shares the sprite loaded first
+      if (sprite != first[index]) ok = 0;
+      references[index]++;
+    }
+  }
+  long long total = (long long)monitors * images;
+  if (loader.calls != keys || cache->misses != keys || cache->hits != total - keys || cache->count != keys) {
+    fprintf(stderr, "%s atlas: %d keys, %d loads, %lld misses, %lld hits of %lld acquisitions, %d cached\n",
+      withAtlas ? "with" : "without", keys, loader.calls, cache->misses, cache->hits, total, cache->count);
+    ok = 0;
+  }
+  for (int e = 0; e < cache->count; e++) {
+    int index = cache->entries[e].key.resource + (cache->entries[e].key.width == 96) * distinct;
+    if (cache->entries[e].references != references[index]) ok = 0;
+  }
+
+  // A failing loader is a miss, nothing is cached and the next acquisition tries again
+  SpriteKey missing = keyOf(BENCH_MISSING_RESOURCE, 0, BENCH_MISSING_RESOURCE + 1);
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (AcquireCachedSprite(cache, missing, loadSprite, &loader)) ok = 0;
+  }
+  if (loader.calls != keys + 2 || cache->misses != keys + 2 || cache->count != keys) ok = 0;
+
+  // Sprites stay cached until the last monitor using them releases them
+  for (int m = 0; m < monitors; m++) {
+    for (int i = 0; i < images; i++) {
+      SpriteKey key = keyOf(i, m, distinct);
+      int index = key.resource + (m % 2) * distinct;
+      ReleaseCachedSprite(cache, acquired[m * images + i]);
+      if (--references[index] == 0) keys--;
+    }
+    if (cache->count != keys) {
+      fprintf(stderr, "%s atlas: %d sprites cached after releasing monitor %d, expected %d\n", withAtlas ? "with" : "without", cache->count, m, keys);
+      ok = 0;
+    }
+  }
+  ReleaseCachedSprite(cache, NULL);
+
+  // A released key is loaded again
+  long long misses = cache->misses;
+  CompiledSprite* again = AcquireCachedSprite(cache, keyOf(0, 0, distinct), loadSprite, &loader);
+  if (!again || cache->misses != misses + 1 || cache->count != 1) ok = 0;
+  ReleaseCachedSprite(cache, again);
+  if (cache->count != 0) ok = 0;
+
+  CloseSpriteCache(cache);
+  CloseSpriteAtlas(atlas);
+  free(acquired);
+  free(first);
+  free(references);
+  return ok;
+}
+
+/**
+ * Headless check of the hit and miss counters and the reference counting of the sprite cache
+ *
+ * Not part of the screensaver build, it only needs the platform neutral cache, blit and atlas modules:
+ * cc -O2 -o cachebench cachebench.c spritecache.c spriteatlas.c spriteblit.c framescheduler.c -lm -lpthread
+ * ./cachebench [monitors] [images] [distinct images] [rounds]
+ *
+ * Every monitor acquires all images like its windows, the images repeat the distinct resources and odd monitors
+ * scale them to another width. Checks that every distinct key is loaded exactly once (misses == loads, every other
+ * acquisition is a hit sharing the same sprite), that cached sprites draw like uncached ones (with and without atlas),
+ * that a failing loader caches nothing and that a sprite is only released with its last reference.
+ * Prints the time per acquisition and exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int monitors = argc > 1 ? atoi(argv[1]) : 3;
+  int images = argc > 2 ? atoi(argv[2]) : 50;
+  int distinct = argc > 3 ? atoi(argv[3]) : 8;
+  int rounds = argc > 4 ? atoi(argv[4]) : 100;
+  if (monitors < 1 || images < 1 || distinct < 1 || distinct > images || rounds < 1) {
+    fprintf(stderr, "usage: %s [monitors] [images] [distinct images] [rounds]\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  double acquireTime = 0.0;
+  for (int round = 0; round < rounds && !failed; round++) failed = !runCache(monitors, images, distinct, round % 2, &acquireTime);
+
+  printf("%d monitors of %d images (%d distinct): %.1f us/acquisition including the loads, %s\n",
+    monitors, images, distinct, acquireTime * 1000.0 / rounds / ((double)monitors * images), failed ? "FAILED" : "all checks passed");
+  return failed;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tilecompositor.h"
+#include "framescheduler.h"
+#include "randomgenerator.h"
+#include "dirtyregion.h"
+
+// Maximum count of dirty rects per frame, the same limit the windows use
+#define BENCH_DIRTY_RECTS 32
+
+/**
+ * Composes one frame of the scene: every image moved, so its old and new box are dirty (like a paint of the window)
+*/
+static double composeFrame(TileCompositor* compositor, DirtyRegion* region, PixelBuffer* target, const CompiledSprite* sprite,
+  const int* xPos, const int* yPos, int count, int shift, int fullFrame) {
+  double start = FrameSchedulerNow();
+  BeginComposition(compositor, target, 0x222831);
+  for (int i = 0; i < count; i++) AddCompositorSprite(compositor, sprite, xPos[i] + shift, yPos[i] + shift);
+  if (fullFrame) {
+    SpriteBounds all = { .left = 0, .top = 0, .right = target->width, .bottom = target->height };
+    AddCompositorRect(compositor, all);
+  } else {
+    // The boxes are merged like the dirty rects of a window before they are composed
+    ClearDirtyRegion(region);
+    for (int i = 0; i < count; i++) {
+      SpriteBounds dirty = { .left = xPos[i], .top = yPos[i], .right = xPos[i] + sprite->width + 2 * shift, .bottom = yPos[i] + sprite->height + 2 * shift };
+      AddDirtyRect(region, dirty);
+    }
+    MergeDirtyRegion(region, BENCH_DIRTY_RECTS);
+    for (int i = 0; i < region->count; i++) AddCompositorRect(compositor, region->rects[i]);
+  }
+  ComposeTiles(compositor);
+  return FrameSchedulerNow() - start;
+}
+
+/**
+ * Benchmark of the tile compositor from 1 to N threads
+ *
+ * Not part of the screensaver build, it only needs the platform neutral compositing modules:
+ * cc -O2 -o compositorbench compositorbench.c tilecompositor.c spriteblit.c workerpool.c framescheduler.c randomgenerator.c dirtyregion.c -lm -lpthread
+ * ./compositorbench [width] [height] [images] [image size] [frames]
+ *
+ * Every thread count composes the same frames (full repaints and dirty rects of moved images),
+ * the result is compared against the single threaded composition.
+ * Exits with 1 if a thread count composed different pixels.
+*/
+int main(int argc, char** argv) {
+  int width = argc > 1 ? atoi(argv[1]) : 3840;
+  int height = argc > 2 ? atoi(argv[2]) : 2160;
+  int count = argc > 3 ? atoi(argv[3]) : 200;
+  int size = argc > 4 ? atoi(argv[4]) : 384;
+  int frames = argc > 5 ? atoi(argv[5]) : 50;
+  if (width < 1 || height < 1 || count < 0 || size < 1 || frames < 1) {
+    fprintf(stderr, "usage: %s [width] [height] [images] [image size] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  // Disc with anti-aliased edge (premultiplied), so opaque and blend spans are both exercised
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)size * size);
+  PixelBuffer target = { .pixels = malloc(sizeof(uint32_t) * (size_t)width * height), .width = width, .height = height, .stride = width };
+  // Last frame of the single threaded run per mode (dirty rects and full frame)
+  uint32_t* reference[2] = { malloc(sizeof(uint32_t) * (size_t)width * height), malloc(sizeof(uint32_t) * (size_t)width * height) };
+  int* xPos = malloc(sizeof(int) * (count > 0 ? count : 1));
+  int* yPos = malloc(sizeof(int) * (count > 0 ? count : 1));
+  if (!pixels || !target.pixels || !reference[0] || !reference[1] || !xPos || !yPos) return 1;
+  double radius = size / 2.0;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      double dx = x + 0.5 - radius, dy = y + 0.5 - radius;
+      double coverage = radius - sqrt(dx * dx + dy * dy);
+      uint32_t alpha = coverage >= 1.0 ? 255 : coverage <= 0.0 ? 0 : (uint32_t)(coverage * 255.0);
+      pixels[y * size + x] = alpha << 24 | (alpha * x / size) << 16 | (alpha * y / size) << 8 | alpha / 2;
+    }
+  }
+  CompiledSprite* sprite = CompileAlphaSprite(pixels, size, size, size);
+  DirtyRegion* region = CreateDirtyRegion(count > BENCH_DIRTY_RECTS ? count : BENCH_DIRTY_RECTS);
+  if (!sprite || !region) return 1;
+
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 1);
+  for (int i = 0; i < count; i++) {
+    xPos[i] = RandomBelow(&random, width + size) - size / 2;
+    yPos[i] = RandomBelow(&random, height + size) - size / 2;
+  }
+
+  // 1, 2, 4, ... threads and the count of logical processors
+  int processors = GetProcessorCount();
+  int failed = 0;
+  double baseline[2] = { 0.0, 0.0 };
+  for (int threads = 1; ; threads = threads * 2 < processors ? threads * 2 : processors) {
+    TileCompositor* compositor = CreateTileCompositor(threads - 1);
+    if (!compositor) return 1;
+
+    for (int fullFrame = 1; fullFrame >= 0; fullFrame--) {
+      double total = 0.0, best = 1e300;
+      for (int f = 0; f < frames; f++) {
+        double duration = composeFrame(compositor, region, &target, sprite, xPos, yPos, count, f % 8, fullFrame);
+        total += duration;
+        if (duration < best) best = duration;
+      }
+      // Compare the last frame against the single threaded one
+      if (threads == 1) {
+        memcpy(reference[fullFrame], target.pixels, sizeof(uint32_t) * (size_t)width * height);
+        baseline[fullFrame] = total / frames;
+      } else if (memcmp(reference[fullFrame], target.pixels, sizeof(uint32_t) * (size_t)width * height) != 0) {
+        failed = 1;
+      }
+      printf("%dx%d, %d images, %s, %d threads: mean %.3f ms, best %.3f ms, speedup %.2fx%s\n",
+        width, height, count, fullFrame ? "full frame" : "dirty rects", threads, total / frames, best,
+        baseline[fullFrame] / (total / frames), failed ? " (pixels differ)" : "");
+    }
+    CloseTileCompositor(compositor);
+    if (threads == processors) break;
+  }
+
+  CloseCompiledSprite(sprite);
+  CloseDirtyRegion(region);
+  free(pixels);
+  free(target.pixels);
+  free(reference[0]);
+  free(reference[1]);
+  free(xPos);
+  free(yPos);
+  return failed;
+}
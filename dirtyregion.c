@@ -0,0 +1,130 @@
+#include "dirtyregion.h"
+
+#include <stdlib.h>
+
+#define REGION_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define REGION_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Factor of maxRects above which the pairwise merge is skipped and the region collapses directly
+#define COLLAPSE_FACTOR 8
+
+/**
+ * Create an empty dirty region with space for capacity rectangles
+ *
+ * If the allocation fails it returns NULL
+*/
+DirtyRegion* CreateDirtyRegion(int capacity) {
+  DirtyRegion* region = malloc(sizeof(DirtyRegion));
+  if (!region) return NULL;
+
+  region->capacity = capacity > 0 ? capacity : 1;
+  region->count = 0;
+  region->rects = malloc(sizeof(SpriteBounds) * region->capacity);
+  if (!region->rects) {
+    free(region);
+    return NULL;
+  }
+  return region;
+}
+
+/**
+ * Cleans up the dirty region
+*/
+void CloseDirtyRegion(DirtyRegion* region) {
+  if (region) {
+    free(region->rects);
+    free(region);
+  }
+}
+
+/**
+ * Removes all rectangles from the region (keeps the allocation)
+*/
+void ClearDirtyRegion(DirtyRegion* region) {
+  region->count = 0;
+}
+
+/**
+ * Bounding box of two rectangles
+*/
+static inline SpriteBounds unionRect(SpriteBounds a, SpriteBounds b) {
+  SpriteBounds result = {
+    .left = REGION_MIN(a.left, b.left),
+    .top = REGION_MIN(a.top, b.top),
+    .right = REGION_MAX(a.right, b.right),
+    .bottom = REGION_MAX(a.bottom, b.bottom)
+  };
+  return result;
+}
+
+/**
+ * Area of a rectangle
+*/
+static inline long long areaOf(SpriteBounds rect) {
+  return (long long)(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+/**
+ * Adds a rectangle to the region, empty rectangles are ignored
+ *
+ * If the list cannot be grown, the rectangle is merged into the last one, so nothing is lost
+*/
+void AddDirtyRect(DirtyRegion* region, SpriteBounds rect) {
+  if (rect.right <= rect.left || rect.bottom <= rect.top) return;
+
+  if (region->count >= region->capacity) {
+    SpriteBounds* rects = realloc(region->rects, sizeof(SpriteBounds) * region->capacity * 2);
+    if (!rects) {
+      region->rects[region->count - 1] = unionRect(region->rects[region->count - 1], rect);
+      return;
+    }
+    region->rects = rects;
+    region->capacity *= 2;
+  }
+  region->rects[region->count++] = rect;
+}
+
+/**
+ * Merges the rectangles of the region
+ *
+ * Two rectangles are merged if their bounding box is not larger then their combined area
+ * (which is always the case for overlapping and adjacent rectangles of the same height / width).
+ * If more then maxRects rectangles remain, the region collapses to its bounding box.
+*/
+void MergeDirtyRegion(DirtyRegion* region, int maxRects) {
+  // Pairwise merging is quadratic, with way too many rectangles the bounding box is the better deal anyway
+  if (region->count <= maxRects * COLLAPSE_FACTOR) {
+    int merged = 1;
+    // Repeat until stable, a merged rectangle may now qualify for merging with an earlier one
+    while (merged) {
+      merged = 0;
+      for (int i = 0; i < region->count; i++) {
+        for (int j = i + 1; j < region->count; j++) {
+          SpriteBounds bounds = unionRect(region->rects[i], region->rects[j]);
+          if (areaOf(bounds) <= areaOf(region->rects[i]) + areaOf(region->rects[j])) {
+            region->rects[i] = bounds;
+            // Remove j by moving the last rectangle into its slot and check the new j again
+            region->rects[j--] = region->rects[--region->count];
+            merged = 1;
+          }
+        }
+      }
+    }
+  }
+
+  if (region->count > maxRects) {
+    SpriteBounds bounds = region->rects[0];
+    for (int i = 1; i < region->count; i++) bounds = unionRect(bounds, region->rects[i]);
+    region->rects[0] = bounds;
+    region->count = 1;
+  }
+}
+
+/**
+ * Sum of the areas of all rectangles in the region (overlaps are counted multiple times)
+*/
+long long DirtyRegionArea(const DirtyRegion* region) {
+  long long area = 0;
+  for (int i = 0; i < region->count; i++) area += areaOf(region->rects[i]);
+  return area;
+}
@@ -0,0 +1,56 @@
+#ifndef DIRTYREGION_H
+#define DIRTYREGION_H
+
+#include "spritestore.h"
+
+/**
+ * List of rectangles that need to be repainted
+*/
+typedef struct {
+  // Dirty rectangles (right and bottom are the outer edges, empty rects are never stored)
+  SpriteBounds* rects;
+  // Count of rectangles in the list
+  int count;
+  // Count of rectangles the list can hold before it is grown
+  int capacity;
+} DirtyRegion;
+
+/**
+ * Create an empty dirty region with space for capacity rectangles
+ *
+ * If the allocation fails it returns NULL
+*/
+DirtyRegion* CreateDirtyRegion(int capacity);
+
+/**
+ * Cleans up the dirty region
+*/
+void CloseDirtyRegion(DirtyRegion* region);
+
+/**
+ * Removes all rectangles from the region (keeps the allocation)
+*/
+void ClearDirtyRegion(DirtyRegion* region);
+
+/**
+ * Adds a rectangle to the region, empty rectangles are ignored
+ *
+ * If the list cannot be grown, the rectangle is merged into the last one, so nothing is lost
+*/
+void AddDirtyRect(DirtyRegion* region, SpriteBounds rect);
+
+/**
+ * Merges the rectangles of the region
+ *
+ * Two rectangles are merged if their bounding box is not larger then their combined area
+ * (which is always the case for overlapping and adjacent rectangles of the same height / width).
+ * If more then maxRects rectangles remain, the region collapses to its bounding box.
+*/
+void MergeDirtyRegion(DirtyRegion* region, int maxRects);
+
+/**
+ * Sum of the areas of all rectangles in the region (overlaps are counted multiple times)
+*/
+long long DirtyRegionArea(const DirtyRegion* region);
+
+#endif
@@ -1,59 +1,107 @@
 #include "eventhandler.h"
 
-// Size of the static preallocated array used to track windows in the event loop
-// The array holds 8bit ptrs, which means 64 bytes are used on the stack
-// this will likely never be a problem on a system using a screensaver (windows default stack size is 1MB).
-// If the app for whatever reason has more then 64 windows (aka 64 monitors) this value can be increased
-#define MAX_WINDOWS_PER_EVENTLOOP 64
+/**
+ * Reads the rectangles of the windows update region into the reusable regionData buffer
+ * 
+ * Must be called before BeginPaint() as it validates the update region.
+ * Returns the count of rectangles or 0 if the region could not be acquired.
+*/
+int AcquireUpdateRects(HWND hwnd, WindowState *windowState) {
+  HRGN updateRegion = windowState->updateRegion;
+  int count = 0;
+  if (GetUpdateRgn(hwnd, updateRegion, FALSE) > NULLREGION) {
+    // Grow the buffer if the region data does not fit
+    DWORD size = GetRegionData(updateRegion, 0, NULL);
+    if (size > windowState->regionDataSize) {
+      RGNDATA* regionData = realloc(windowState->regionData, size);
+      if (regionData) {
+        windowState->regionData = regionData;
+        windowState->regionDataSize = size;
+      }
+    }
+    if (size <= windowState->regionDataSize && GetRegionData(updateRegion, size, windowState->regionData)) {
+      count = windowState->regionData->rdh.nCount;
+    }
+  }
+  return count;
+}
 
 /**
- * Repaint the full window based on the window state
+ * Repaint the dirty parts of the window based on the window state
+ * 
+ * The window is composed in software into the persistent back buffer of the window state, the images are drawn
+ * from their precompiled opaque spans, so transparent pixels cost nothing. The composition is split into tiles
+ * rendered in parallel by the shared tile compositor.
+ * Only the rectangles of the update region (the invalidated dirty rectangles) are cleared, composed and copied.
+ * The back buffer is only reallocated if the window size changed, the steady state does not allocate.
 */
 void RepaintWindow(HWND hwnd, WindowState *windowState) {
+  double paintStart = FrameSchedulerNow();
+
+  // Acquire the update region rectangles, if this fails the full rcPaint is repainted
+  int rectCount = AcquireUpdateRects(hwnd, windowState);
+
   PAINTSTRUCT ps;
   // Create paint handler device context
   HDC hdc = BeginPaint(hwnd, &ps);
-  // Create memory paint handler device context as buffer between SRC -> state->bitmapHdc & DST -> hdc
-  HDC memDC = CreateCompatibleDC(hdc);
-  // Create compatible bitmap and add it as canvas to the memDC
-  HBITMAP memBitmap = CreateCompatibleBitmap(hdc, ps.rcPaint.right - ps.rcPaint.left, ps.rcPaint.bottom - ps.rcPaint.top);
-  HBITMAP oldmap = SelectObject(memDC, memBitmap);
-
-  // Fill memory paint handler device with the background brush
-  // When erasing the rect this color is removed, therefore we need to fill the whole rcPaint now
-  FillRect(memDC, &ps.rcPaint, windowState->backgroundBrush);
-
-  // Process all images on the window and draw them to the memDC
-  for (int i = 0; i < windowState->imageCount; i++) {
-    ImageState* imageState = windowState->images[i];
-    // Acquire shared lock to image state
-    AcquireSRWLockShared(&imageState->lock);
-    // Move the bitmap to the memDC (removing transparent color)
-    // Draw the bitmap to the rcPaint rect canvas (boundary is set by subtracting left / top of the rcPaint from xPos / yPos)
-    // Here we essentially draw the bitmap (state->bitmapHdc) to the full screen (memDC) on a memory device
-    TransparentBlt(
-      memDC, 
-      imageState->xPos - ps.rcPaint.left, imageState->yPos - ps.rcPaint.top,
-      imageState->bitmap.bmWidth, imageState->bitmap.bmHeight, 
-      imageState->bitmapHdc, 0, 0, imageState->bitmap.bmWidth, imageState->bitmap.bmHeight, windowState->transparentColor
-    );
-    // Release shared lock
-    ReleaseSRWLockShared(&imageState->lock);
+
+  // Ensure the back buffer has the size of the client area
+  RECT clientRect;
+  GetClientRect(hwnd, &clientRect);
+  if (IsRectEmpty(&ps.rcPaint) ||
+      !ResizeRenderTarget(windowState->backBuffer, clientRect.right - clientRect.left, clientRect.bottom - clientRect.top)) {
+    EndPaint(hwnd, &ps);
+    return;
+  }
+  PixelBuffer* backBuffer = &windowState->backBuffer->buffer;
+  HDC memDC = ((GdiSurface*)windowState->backBuffer->surface)->hdc;
+  // Ensure gdi finished all pending operations on the DIB before writing to it
+  GdiFlush();
+
+  RECT* rects = &ps.rcPaint;
+  if (rectCount > 0) {
+    rects = (RECT*)windowState->regionData->Buffer;
+  } else {
+    rectCount = 1;
   }
 
-  // Move the memDC (redrawn screen) one to one to the hdc using the boundaries of the rcPaint
-  BitBlt(
-    hdc, ps.rcPaint.left, ps.rcPaint.top, ps.rcPaint.right - ps.rcPaint.left, ps.rcPaint.bottom - ps.rcPaint.top,
-    memDC, 0, 0, SRCCOPY
-  );
+  // Draw the frame that was invalidated last, it stays unchanged until the next invalidation acquires a new one
+  const SpriteSnapshot* snapshot = PeekSnapshot(windowState->snapshots);
+
+  // Compose the dirty rects into the back buffer, the compositor splits them into tiles rendered in parallel
+  // The images are drawn in snapshot order (image order), so overlapping images look the same as when drawn one after another
+  double blitStart = FrameSchedulerNow();
+  TileCompositor* compositor = windowState->compositor;
+  BeginComposition(compositor, backBuffer, windowState->backgroundPixel);
+  for (int i = 0; i < snapshot->count; i++) {
+    // Parked sprites are not published, every snapshot entry names the image it shows
+    if (snapshot->image[i] >= windowState->imageCount) continue;
+    ImageState* image = windowState->images[snapshot->image[i]];
+    // Animated images show the frame of the paint time, all images of a track share the decoded frame
+    const CompiledSprite* sprite = image->animation ? AnimationTrackFrame(image->animation, blitStart) : image->sprite;
+    if (sprite) AddCompositorSprite(compositor, sprite, snapshot->xPos[i], snapshot->yPos[i]);
+  }
+  for (int r = 0; r < rectCount; r++) {
+    // The back buffer covers the whole client area, so client coordinates are used directly
+    SpriteBounds dirty = { .left = rects[r].left, .top = rects[r].top, .right = rects[r].right, .bottom = rects[r].bottom };
+    AddCompositorRect(compositor, dirty);
+  }
+  ComposeTiles(compositor);
 
-  // Select old Bitmap as canvas, replacing the bitmap here does remove the device context from the original bitmap handle
-  // Without this the original bitmap handle would be in a undefined state as it is still associated with a memDC which is deleted
-  SelectObject(memDC, oldmap);
-  DeleteObject(memBitmap);
-  DeleteObject(memDC);
+  // Move the dirty rects of the back buffer one to one to the hdc
+  for (int r = 0; r < rectCount; r++) {
+    BitBlt(
+      hdc, rects[r].left, rects[r].top, rects[r].right - rects[r].left, rects[r].bottom - rects[r].top,
+      memDC, rects[r].left, rects[r].top, SRCCOPY
+    );
+  }
+  RecordTrace(TRACE_BLIT, windowState->simulation->id, snapshot->frame, blitStart, FrameSchedulerNow());
 
   EndPaint(hwnd, &ps);
+  double paintEnd = FrameSchedulerNow();
+  RecordTrace(TRACE_PAINT, windowState->simulation->id, snapshot->frame, paintStart, paintEnd);
+  // Hand the paint cost to the load governor of the window loop
+  InterlockedExchangeAdd64(&windowState->paintCost, (LONG64)((paintEnd - paintStart) * 1000.0));
 }
 
 /**
@@ -67,30 +115,12 @@ LRESULT CALLBACK CallEventHandler(HWND hwnd, UINT message, WPARAM wParam, LPARAM
   WindowState *windowState = (WindowState*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
   if (!windowState) return DefWindowProc(hwnd, message, wParam, lParam);
 
-  // Static windowStateStack + Length + Counter, tracking all active windows.
-  // Tracking is performed on the stack for simplicity, 
-  // as it is extremely unlikely that dynamic allocation will be necessary in the future.
-  // In this context, each window consistently corresponds to one monitor in a screensaver application.
-
-  // Static windowStateCount, counting window states.
-  // If the counter hits 0 it will trigger the eventloop to exit
-  static int windowStateCount = 0;
-
-  // Static windowStateStackLength, exact length of the windowStateStack
-  static int windowStateStackLength = 0;
-  // Static one shot stack holding all window states
-  // When removing elements from the windowStateStack, ALL elements must be removed at once
-  // and the windowStateStackLength must be set to 0. Removing single elements and then adding more elements
-  // will lead to undefined behavior.
-  static WindowState* windowStateStack[MAX_WINDOWS_PER_EVENTLOOP];
+  // All windows of the eventloop are tracked by the registry the window is registered in,
+  // windows are added and removed one by one, so display changes don't touch the other windows
+  WindowRegistry* registry = windowState->registry;
 
   switch (message) {
     case WM_INITSTATE:
-      // Add the state to the windowStateStack
-      windowStateStack[windowStateStackLength++] = windowState;
-      // Increment windowState count
-      windowStateCount++;
-
       // Acquire unique lock
       AcquireSRWLockExclusive(&windowState->initCursorPositionLock);
       // Retrieve cursor position when window is created
@@ -100,11 +130,25 @@ LRESULT CALLBACK CallEventHandler(HWND hwnd, UINT message, WPARAM wParam, LPARAM
       
       break;
 
-    case WM_INVALIDATE_RECT:
-      // Mark full window as dirty
-      // This will trigger a repaint which itself will draw all images on the window at once
-      InvalidateRect(hwnd, NULL, FALSE);
+    case WM_INVALIDATE_RECT: {
+      // Take the latest frame published by the window loop (lock-free, never waits on the window loop)
+      const SpriteSnapshot* snapshot = AcquireSnapshot(windowState->snapshots);
+      if (snapshot->frame == windowState->painted->frame) break;
+
+      // Mark the images at their last invalidated and at their new position as dirty
+      // This will trigger a repaint which itself will redraw only those rects
+      AddSnapshotRects(windowState->dirty, windowState->painted);
+      AddSnapshotRects(windowState->dirty, snapshot);
+      MergeDirtyRegion(windowState->dirty, MAX_DIRTY_RECTS);
+      for (int i = 0; i < windowState->dirty->count; i++) {
+        SpriteBounds* dirty = &windowState->dirty->rects[i];
+        RECT rect = { .left = dirty->left, .top = dirty->top, .right = dirty->right, .bottom = dirty->bottom };
+        InvalidateRect(hwnd, &rect, FALSE);
+      }
+      ClearDirtyRegion(windowState->dirty);
+      CopySnapshot(windowState->painted, snapshot);
       break;
+    }
 
     case WM_PAINT:
       // Repaint the full window (includeing all images)
@@ -114,14 +158,10 @@ LRESULT CALLBACK CallEventHandler(HWND hwnd, UINT message, WPARAM wParam, LPARAM
     case WM_LBUTTONDOWN: // Left mouse click
     case WM_RBUTTONDOWN: // Right mouse click
     case WM_KEYDOWN: // Any key click // Any mouse movement
-      // Iterate over all windowStates and close them up
-      for (int i = 0; i < windowStateStackLength; i++) {
-        // Call the close operation of the window loop, this will async make the window loop close itself
-        // After closing itself, the window loop posts a WM_EXIT message which initiates the cleanup of the Window
-        CallCloseWindowLoop(windowStateStack[i]);
-      }
-      // Clear one shot stack after closing the windowStates by setting the length to 0
-      windowStateStackLength = 0;
+      // Close all registered windows, this will async make their window loops close themselves
+      // After closing itself, a window loop posts a WM_EXIT message which initiates the cleanup of the Window
+      if (registry) CloseRegisteredWindows(registry);
+      else CallCloseWindowLoop(windowState);
       break;
 
     case WM_MOUSEMOVE:
@@ -141,31 +181,36 @@ LRESULT CALLBACK CallEventHandler(HWND hwnd, UINT message, WPARAM wParam, LPARAM
       ReleaseSRWLockShared(&windowState->initCursorPositionLock);
 
       if (diffX > windowState->cursorPositionThreshold || diffY > windowState->cursorPositionThreshold) {
-        // Iterate over all windowStates and close them up
-        for (int i = 0; i < windowStateStackLength; i++) {
-          // Call the close operation of the window loop, this will async make the window loop close itself
-          // After closing itself, the window loop posts a WM_EXIT message which initiates the cleanup of the Window
-          CallCloseWindowLoop(windowStateStack[i]);
-        }
-        // Clear one shot stack after closing the windowStates by setting the length to 0
-        windowStateStackLength = 0;
+        // Close all registered windows, this will async make their window loops close themselves
+        // After closing itself, a window loop posts a WM_EXIT message which initiates the cleanup of the Window
+        if (registry) CloseRegisteredWindows(registry);
+        else CallCloseWindowLoop(windowState);
       }
       break;
+    case WM_DISPLAYCHANGE:
+      // A monitor was added, removed or changed its resolution (sent to every top-level window)
+      // Only the windows of changed monitors are created, moved or closed, the first window receiving
+      // the message applies the change, for all others the registry is already up to date
+      if (registry) RefreshWindowRegistry(registry);
+      break;
     case WM_EXIT:
       // Destroy window states associated window, this will trigger a WM_DESTROY
       // initializing the destruction of the window, at the same time windowState stays in a valid state
       // until it is fully cleaned up in WM_NCDESTROY
       DestroyWindowStateWindow(windowState);
       break;
-    case WM_NCDESTROY:
+    case WM_NCDESTROY: {
+      // This is the last message a window receives, it is triggered through the DestroyWindow() (likely in CloseWindowState)
+      // The message removes the window from the registry, if no window is left it calls PostQuitMessage to exit the eventloop
+      // A window that was never registered (its loop could not be started) leaves the other windows running
+      int remaining = registry ? UnregisterWindow(registry, windowState) : 0;
       // Close window state which will release all resources
       CloseWindowState(windowState);
-      // This is the last message a window receives, it is triggered through the DestroyWindow() (likely in CloseWindowState)
-      // The message will decrement the window count, if on 0 it calls PostQuitMessage to
-      if (--windowStateCount <= 0) {
+      if (remaining == 0) {
         PostQuitMessage(0); 
       }
       break;
+    }
   }
 
   // Continue with default window procedure
@@ -0,0 +1,249 @@
+#include "framepacer.h"
+
+#include <stdlib.h>
+
+#include "frametrace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/**
+ * Atomically replaces the value and returns the previous one (full barrier)
+*/
+static long exchangeAtomic(volatile long* value, long replacement) {
+#ifdef _WIN32
+  return InterlockedExchange(value, replacement);
+#else
+  return __atomic_exchange_n(value, replacement, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/**
+ * Atomically reads the value
+*/
+static long loadAtomic(volatile long* value) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(value, 0, 0);
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Atomically replaces the head of the added stack if it still equals expected
+*/
+static int swapAdded(FramePacer* pacer, PacedTask* expected, PacedTask* replacement) {
+#ifdef _WIN32
+  return InterlockedCompareExchangePointer((PVOID volatile*)&pacer->added, replacement, expected) == expected;
+#else
+  return __atomic_compare_exchange_n(&pacer->added, &expected, replacement, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Worker job executing one step of a task
+*/
+static void runStep(void* context) {
+  PacedTask* task = context;
+  if (!task->step(task->context)) exchangeAtomic(&task->stopped, 1);
+  task->frames++;
+  // Releases the task, the pacer may dispatch or finish it from now on
+  exchangeAtomic(&task->running, 0);
+}
+
+/**
+ * Moves the added tasks into the task array of the pacer thread
+*/
+static void takeAddedTasks(FramePacer* pacer) {
+  PacedTask* task;
+  do {
+    task = pacer->added;
+  } while (task && !swapAdded(pacer, task, NULL));
+
+  while (task) {
+    PacedTask* next = task->next;
+    if (pacer->taskCount == pacer->taskCapacity) {
+      int capacity = pacer->taskCapacity ? pacer->taskCapacity * 2 : 8;
+      PacedTask** tasks = realloc(pacer->tasks, sizeof(PacedTask*) * capacity);
+      // Without memory the task can't be driven, it is finished right away
+      if (!tasks) {
+        if (task->finish) task->finish(task->context);
+        free(task);
+        task = next;
+        continue;
+      }
+      pacer->tasks = tasks;
+      pacer->taskCapacity = capacity;
+    }
+    pacer->tasks[pacer->taskCount++] = task;
+    // The spin tail of the clock is bounded by its period, so it follows the shortest task period
+    if (pacer->taskCount == 1 || task->period < pacer->clock->period) {
+      SetFrameSchedulerPeriod(pacer->clock, task->period);
+    }
+    task = next;
+  }
+}
+
+/**
+ * Dispatches all due tasks and returns the earliest upcoming deadline
+*/
+static double dispatchTasks(FramePacer* pacer) {
+  double now = FrameSchedulerNow();
+  double earliest = now + PACER_IDLE_PERIOD;
+
+  for (int i = 0; i < pacer->taskCount; i++) {
+    PacedTask* task = pacer->tasks[i];
+
+    if (!loadAtomic(&task->running)) {
+      // Finish stopped tasks once their last step completed
+      if (loadAtomic(&task->stopped)) {
+        if (task->finish) task->finish(task->context);
+        free(task);
+        pacer->tasks[i--] = pacer->tasks[--pacer->taskCount];
+        continue;
+      }
+      if (task->deadline <= now) {
+        exchangeAtomic(&task->running, 1);
+        if (!SubmitWorkerJob(pacer->pool, runStep, task)) {
+          exchangeAtomic(&task->running, 0);
+          task->missed++;
+        }
+      }
+    } else if (task->deadline <= now) {
+      // Previous step is still running, this deadline is skipped
+      task->missed++;
+    }
+
+    if (task->deadline <= now) {
+      // Advance the deadline, if the task is more then one period late restart its schedule from now
+      task->deadline += task->period;
+      if (task->deadline < now) {
+        task->deadline = now + task->period;
+        task->missed++;
+      }
+    }
+    if (task->deadline < earliest) earliest = task->deadline;
+  }
+  return earliest;
+}
+
+/**
+ * Pacer thread loop, sleeps towards the earliest deadline and dispatches the due tasks
+*/
+#ifdef _WIN32
+static DWORD WINAPI runPacer(LPVOID param) {
+#else
+static void* runPacer(void* param) {
+#endif
+  FramePacer* pacer = param;
+  SetTraceThreadName("frame pacer");
+
+  while (!loadAtomic(&pacer->exit)) {
+    takeAddedTasks(pacer);
+    double deadline = dispatchTasks(pacer);
+
+    // Only this thread waits, the workers are blocked until the next dispatch
+    double spinTotal = pacer->clock->spinTotal;
+    WaitFrameDeadline(pacer->clock, deadline);
+    // The spin is the tail of the wait, so it ends now
+    double spinEnd = FrameSchedulerNow();
+    RecordTrace(TRACE_SPIN, -1, pacer->clock->frames, spinEnd - (pacer->clock->spinTotal - spinTotal), spinEnd);
+    RecordTraceCounter(TRACE_JITTER_LAST, spinEnd, pacer->clock->jitterLast);
+    RecordTraceCounter(TRACE_JITTER_MEAN, spinEnd, pacer->clock->jitterMean);
+    RecordTraceCounter(TRACE_JITTER_MAX, spinEnd, pacer->clock->jitterMax);
+  }
+  return 0;
+}
+
+/**
+ * Create a pacer with its own pacing thread and a pool of workerCount workers (<= 0 uses one per logical processor)
+ *
+ * If spin is 0 the pacer thread sleeps up to every deadline instead of spinning the calibrated tail,
+ * this costs no cpu time between the steps but the steps may start late by the timer granularity.
+ * If the allocation or the thread creation fails it returns NULL
+*/
+FramePacer* CreateFramePacer(int workerCount, int spin) {
+  FramePacer* pacer = calloc(1, sizeof(FramePacer));
+  if (!pacer) return NULL;
+
+  pacer->pool = CreateWorkerPool(workerCount);
+  pacer->clock = CreateFrameScheduler(PACER_IDLE_PERIOD);
+  if (!pacer->pool || !pacer->clock) {
+    CloseFramePacer(pacer);
+    return NULL;
+  }
+  // Set before the pacer thread starts waiting on the clock
+  SetFrameSchedulerSpin(pacer->clock, spin);
+
+#ifdef _WIN32
+  pacer->thread = CreateThread(NULL, 0, runPacer, pacer, 0, NULL);
+#else
+  pthread_t* thread = malloc(sizeof(pthread_t));
+  if (thread && pthread_create(thread, NULL, runPacer, pacer) != 0) {
+    free(thread);
+    thread = NULL;
+  }
+  pacer->thread = thread;
+#endif
+  if (!pacer->thread) {
+    CloseFramePacer(pacer);
+    return NULL;
+  }
+  return pacer;
+}
+
+/**
+ * Stops the pacer thread and the workers and cleans up the pacer
+ *
+ * Tasks still registered are released without calling their finish function.
+*/
+void CloseFramePacer(FramePacer* pacer) {
+  if (pacer) {
+    exchangeAtomic(&pacer->exit, 1);
+    if (pacer->thread) {
+#ifdef _WIN32
+      WaitForSingleObject((HANDLE)pacer->thread, INFINITE);
+      CloseHandle((HANDLE)pacer->thread);
+#else
+      pthread_join(*(pthread_t*)pacer->thread, NULL);
+      free(pacer->thread);
+#endif
+    }
+    // Closing the pool waits for the running steps, afterwards the tasks can be released
+    CloseWorkerPool(pacer->pool);
+    CloseFrameScheduler(pacer->clock);
+
+    for (int i = 0; i < pacer->taskCount; i++) free(pacer->tasks[i]);
+    while (pacer->added) {
+      PacedTask* next = pacer->added->next;
+      free(pacer->added);
+      pacer->added = next;
+    }
+    free(pacer->tasks);
+    free(pacer);
+  }
+}
+
+/**
+ * Registers a task executed every period ms, the first step is executed one period after the call
+ *
+ * Can be called from any thread. Returns 0 if the task could not be allocated.
+*/
+int AddPacedTask(FramePacer* pacer, double period, int (*step)(void*), void (*finish)(void*), void* context) {
+  PacedTask* task = calloc(1, sizeof(PacedTask));
+  if (!task) return 0;
+  task->period = period;
+  task->deadline = FrameSchedulerNow() + period;
+  task->step = step;
+  task->finish = finish;
+  task->context = context;
+
+  // Push onto the added stack, the pacer thread takes it over on its next tick
+  do {
+    task->next = pacer->added;
+  } while (!swapAdded(pacer, task->next, task));
+  return 1;
+}
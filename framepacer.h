@@ -0,0 +1,85 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include "framescheduler.h"
+#include "workerpool.h"
+
+// Time the pacer waits when no task is registered (in ms)
+#define PACER_IDLE_PERIOD 50.0
+
+/**
+ * Periodic task driven by a frame pacer
+*/
+typedef struct PacedTask {
+  // Period of the task in ms
+  double period;
+  // Absolute deadline of the next step in ms (FrameSchedulerNow() clock)
+  double deadline;
+  // Executed on a worker at every deadline, returns 0 to stop the task
+  int (*step)(void* context);
+  // Executed on the pacer thread once the task stopped and no step is running anymore
+  void (*finish)(void* context);
+  // Argument passed to step and finish
+  void* context;
+  // Set while a step is queued or running, steps of one task never overlap
+  volatile long running;
+  // Set by the step when the task should stop
+  volatile long stopped;
+  // Count of executed steps
+  long long frames;
+  // Count of deadlines skipped because the previous step was still running or the pacer was late
+  long long missed;
+  // Next task added but not yet taken over by the pacer thread
+  struct PacedTask* next;
+} PacedTask;
+
+/**
+ * Single pacing clock dispatching periodic tasks with individual periods onto a worker pool
+ *
+ * Only the pacer thread sleeps (and spins the short calibrated tail) towards the earliest deadline of all tasks,
+ * the due steps are then executed on the workers. Idle workers block, so the cpu time scales with the work
+ * instead of with the count of tasks.
+*/
+typedef struct {
+  // Workers executing the steps
+  WorkerPool* pool;
+  // Shared clock sleeping towards the earliest deadline
+  FrameScheduler* clock;
+  // Tasks owned by the pacer thread
+  PacedTask** tasks;
+  // Count of tasks owned by the pacer thread
+  int taskCount;
+  // Size of the tasks array
+  int taskCapacity;
+  // Tasks added by other threads, taken over by the pacer thread on its next tick (lock-free stack)
+  PacedTask* volatile added;
+  // Set when the pacer should exit
+  volatile long exit;
+  // Platform thread handle of the pacer thread
+  void* thread;
+} FramePacer;
+
+/**
+ * Create a pacer with its own pacing thread and a pool of workerCount workers (<= 0 uses one per logical processor)
+ *
+ * If spin is 0 the pacer thread sleeps up to every deadline instead of spinning the calibrated tail,
+ * this costs no cpu time between the steps but the steps may start late by the timer granularity.
+ * If the allocation or the thread creation fails it returns NULL
+*/
+FramePacer* CreateFramePacer(int workerCount, int spin);
+
+/**
+ * Stops the pacer thread and the workers and cleans up the pacer
+ *
+ * Tasks still registered are released without calling their finish function.
+*/
+void CloseFramePacer(FramePacer* pacer);
+
+/**
+ * Registers a task executed every period ms, the first step is executed one period after the call
+ *
+ * Can be called from any thread. Returns 0 if the task could not be allocated.
+*/
+int AddPacedTask(FramePacer* pacer, double period, int (*step)(void*), void (*finish)(void*), void* context);
+
+#endif
@@ -0,0 +1,201 @@
+#include "framescheduler.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+// Flag is only defined in recent SDKs (supported since windows 10 1803)
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#endif
+
+// Lower limit of the spin tail in ms, a tiny tail always stays to absorb wakeup latency
+#define MIN_SPIN_TAIL 0.05
+// Initial spin tail in ms, used until the oversleep was measured
+#define INITIAL_SPIN_TAIL 1.0
+// Weight of a new oversleep sample in the smoothed oversleep
+#define OVERSLEEP_WEIGHT 0.1
+// Factor applied to the smoothed oversleep to get the spin tail (headroom for outliers)
+#define SPIN_TAIL_FACTOR 1.5
+
+/**
+ * Current value of the monotonic clock used by the scheduler in ms
+*/
+double FrameSchedulerNow() {
+#ifdef _WIN32
+  static LARGE_INTEGER freq = {0};
+  LARGE_INTEGER now;
+  // Acquire frequency (ticks per second), it is fixed at boot so it is only queried once
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return ((double)now.QuadPart / freq.QuadPart) * 1000;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+#endif
+}
+
+/**
+ * Yields the rest of the timeslice while spinning
+*/
+static void yieldThread() {
+#ifdef _WIN32
+  Sleep(0);
+#else
+  sched_yield();
+#endif
+}
+
+/**
+ * Sleeps on the platform timer until the absolute time target (in ms of FrameSchedulerNow())
+*/
+static void sleepUntil(FrameScheduler* scheduler, double target) {
+#ifdef _WIN32
+  double remaining = target - FrameSchedulerNow();
+  if (remaining <= 0) return;
+  // Negative due times are relative, in 100ns units
+  LARGE_INTEGER due;
+  due.QuadPart = -(LONGLONG)(remaining * 10000);
+  if (SetWaitableTimerEx((HANDLE)scheduler->timer, &due, 0, NULL, NULL, NULL, 0)) {
+    WaitForSingleObject((HANDLE)scheduler->timer, INFINITE);
+  }
+#else
+  struct timespec deadline;
+  deadline.tv_sec = (time_t)(target / 1000);
+  deadline.tv_nsec = (long)((target - deadline.tv_sec * 1000.0) * 1000000);
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  // Absolute sleep is not affected by interruptions, a signal just sleeps again towards the same target
+  // Any other error (e.g. an invalid target) would fail on every retry, the wait then ends early
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
+  (void)scheduler;
+#endif
+}
+
+/**
+ * Create a frame scheduler with the provided period in ms
+ *
+ * The first deadline is one period after the creation
+ * If the timer cannot be created it returns NULL
+*/
+FrameScheduler* CreateFrameScheduler(double period) {
+  FrameScheduler* scheduler = calloc(1, sizeof(FrameScheduler));
+  if (!scheduler) return NULL;
+
+#ifdef _WIN32
+  // Prefer the high resolution timer, older systems only provide the default timer (~15.6ms granularity),
+  // which still works as the spin tail calibrates to the larger oversleep
+  HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  if (!timer) timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+  if (!timer) {
+    free(scheduler);
+    return NULL;
+  }
+  scheduler->timer = timer;
+#endif
+
+  scheduler->period = period;
+  scheduler->spinTail = INITIAL_SPIN_TAIL;
+  scheduler->oversleep = INITIAL_SPIN_TAIL / SPIN_TAIL_FACTOR;
+  scheduler->deadline = FrameSchedulerNow() + period;
+  return scheduler;
+}
+
+/**
+ * Cleans up the frame scheduler and its timer
+*/
+void CloseFrameScheduler(FrameScheduler* scheduler) {
+  if (scheduler) {
+#ifdef _WIN32
+    if (scheduler->timer) CloseHandle((HANDLE)scheduler->timer);
+#endif
+    free(scheduler);
+  }
+}
+
+/**
+ * Changes the frame period, the new period applies from the next deadline on
+*/
+void SetFrameSchedulerPeriod(FrameScheduler* scheduler, double period) {
+  scheduler->period = period;
+}
+
+/**
+ * Enables or disables the spin tail of the waits, must not be called while another thread waits on the scheduler
+ *
+ * Without spin the whole wait is slept, which costs no cpu time but the deadlines may be late by the timer granularity.
+*/
+void SetFrameSchedulerSpin(FrameScheduler* scheduler, int spin) {
+  scheduler->spinDisabled = !spin;
+}
+
+/**
+ * Blocks until the provided absolute deadline (in ms of FrameSchedulerNow()) is reached
+ *
+ * Uses the same calibrated sleep and spin as WaitNextFrame() and tracks the jitter,
+ * but leaves the deadline of the scheduler untouched (useful to wait for deadlines of varying periods).
+ * Returns the lateness in ms.
+*/
+double WaitFrameDeadline(FrameScheduler* scheduler, double deadline) {
+  double now = FrameSchedulerNow();
+
+  // Coarse sleep until shortly before the deadline, without spin the whole wait is slept
+  double wakeTarget = scheduler->spinDisabled ? deadline : deadline - scheduler->spinTail;
+  if (now < wakeTarget) {
+    sleepUntil(scheduler, wakeTarget);
+    now = FrameSchedulerNow();
+
+    // Calibrate the spin tail with the measured oversleep (can be negative if the timer woke up early)
+    double sample = now - wakeTarget;
+    scheduler->oversleep += (sample - scheduler->oversleep) * OVERSLEEP_WEIGHT;
+    scheduler->spinTail = scheduler->oversleep * SPIN_TAIL_FACTOR;
+    if (scheduler->spinTail < MIN_SPIN_TAIL) scheduler->spinTail = MIN_SPIN_TAIL;
+    if (scheduler->spinTail > scheduler->period) scheduler->spinTail = scheduler->period;
+  }
+
+  // Spin for the remaining tail, yielding to other threads in between
+  double spinStart = now;
+  while (!scheduler->spinDisabled && now < deadline) {
+    yieldThread();
+    now = FrameSchedulerNow();
+  }
+  scheduler->spinTotal += now - spinStart;
+
+  // Track the lateness of the frame
+  double lateness = now - deadline;
+  scheduler->jitterLast = lateness;
+  scheduler->frames++;
+  scheduler->jitterMean += (lateness - scheduler->jitterMean) / scheduler->frames;
+  if (lateness > scheduler->jitterMax) scheduler->jitterMax = lateness;
+  return lateness;
+}
+
+/**
+ * Blocks until the next frame deadline is reached and advances the deadline by one period
+ *
+ * Deadlines are absolute, so a late frame does not shift the following frames.
+ * If the deadline was missed by more then one period, the schedule restarts from now.
+ * Returns the lateness of the frame in ms.
+*/
+double WaitNextFrame(FrameScheduler* scheduler) {
+  double lateness = WaitFrameDeadline(scheduler, scheduler->deadline);
+  double now = scheduler->deadline + lateness;
+
+  // Advance the deadline, if the frame is more then one period late restart the schedule from now
+  // instead of rushing through the missed frames
+  scheduler->deadline += scheduler->period;
+  if (scheduler->deadline < now) {
+    scheduler->deadline = now + scheduler->period;
+    scheduler->missed++;
+  }
+  return lateness;
+}
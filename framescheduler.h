@@ -0,0 +1,89 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+/**
+ * Frame pacing scheduler waiting for fixed (fractional ms) frame deadlines
+ *
+ * Waiting is done in two phases: a coarse sleep on a high resolution timer
+ * (waitable timer on windows, clock_nanosleep on linux) until shortly before the deadline,
+ * followed by a short spin for the remaining tail. The length of the tail is calibrated from
+ * the measured oversleep of the timer, so on a precise timer almost no cpu time is spent spinning.
+*/
+typedef struct {
+  // Frame period in ms (fractional, e.g. 16.667 for 60hz)
+  double period;
+  // Absolute deadline of the next frame in ms
+  double deadline;
+  // Time before the deadline where sleeping stops and spinning starts (in ms)
+  double spinTail;
+  // Smoothed oversleep of the coarse sleep (in ms)
+  double oversleep;
+  // Set if waits sleep up to the deadline without spinning the tail (see SetFrameSchedulerSpin())
+  int spinDisabled;
+
+  // Lateness of the last frame relative to its deadline (in ms)
+  double jitterLast;
+  // Mean absolute lateness over all frames (in ms)
+  double jitterMean;
+  // Largest lateness over all frames (in ms)
+  double jitterMax;
+  // Total time spent spinning (in ms)
+  double spinTotal;
+  // Count of waited frames
+  long long frames;
+  // Count of frames where the deadline was already missed and the schedule was reset
+  long long missed;
+
+  // Platform timer handle (waitable timer on windows, unused on linux)
+  void* timer;
+} FrameScheduler;
+
+/**
+ * Create a frame scheduler with the provided period in ms
+ *
+ * The first deadline is one period after the creation
+ * If the timer cannot be created it returns NULL
+*/
+FrameScheduler* CreateFrameScheduler(double period);
+
+/**
+ * Cleans up the frame scheduler and its timer
+*/
+void CloseFrameScheduler(FrameScheduler* scheduler);
+
+/**
+ * Changes the frame period, the new period applies from the next deadline on
+*/
+void SetFrameSchedulerPeriod(FrameScheduler* scheduler, double period);
+
+/**
+ * Enables or disables the spin tail of the waits, must not be called while another thread waits on the scheduler
+ *
+ * Without spin the whole wait is slept, which costs no cpu time but the deadlines may be late by the timer granularity.
+*/
+void SetFrameSchedulerSpin(FrameScheduler* scheduler, int spin);
+
+/**
+ * Blocks until the next frame deadline is reached and advances the deadline by one period
+ *
+ * Deadlines are absolute, so a late frame does not shift the following frames.
+ * If the deadline was missed by more then one period, the schedule restarts from now.
+ * Returns the lateness of the frame in ms.
+*/
+double WaitNextFrame(FrameScheduler* scheduler);
+
+/**
+ * Blocks until the provided absolute deadline (in ms of FrameSchedulerNow()) is reached
+ *
+ * Uses the same calibrated sleep and spin as WaitNextFrame() and tracks the jitter,
+ * but leaves the deadline of the scheduler untouched (useful to wait for deadlines of varying periods).
+ * Returns the lateness in ms.
+*/
+double WaitFrameDeadline(FrameScheduler* scheduler, double deadline);
+
+/**
+ * Current value of the monotonic clock used by the scheduler in ms
+*/
+double FrameSchedulerNow();
+
+#endif
@@ -0,0 +1,234 @@
+#include "framesnapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Flag in the middle state indicating a published frame that was not acquired yet
+#define SNAPSHOT_FRESH 4
+// Mask extracting the buffer index from the middle state
+#define SNAPSHOT_INDEX 3
+
+/**
+ * Atomically replaces the middle state and returns the previous one (full barrier)
+*/
+static long exchangeMiddle(SnapshotBuffer* buffer, long value) {
+#ifdef _WIN32
+  return InterlockedExchange(&buffer->middle, value);
+#else
+  return __atomic_exchange_n(&buffer->middle, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/**
+ * Atomically reads the middle state
+*/
+static long loadMiddle(SnapshotBuffer* buffer) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(&buffer->middle, 0, 0);
+#else
+  return __atomic_load_n(&buffer->middle, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Returns the whole pixel position alpha / SPRITE_FIXED_ONE of the way from previous to current (fixed point)
+*/
+static inline int interpolatePosition(int previous, int current, int alpha) {
+  int position = previous + (int)(((long long)(current - previous) * alpha) >> SPRITE_FIXED_SHIFT);
+  // Round to the nearest pixel, the shift floors negative positions as well
+  return (position + SPRITE_FIXED_ONE / 2) >> SPRITE_FIXED_SHIFT;
+}
+
+/**
+ * Allocates the arrays of a snapshot, returns 0 on failure (already allocated arrays must still be released)
+*/
+static int initSnapshot(SpriteSnapshot* snapshot, int capacity) {
+  if (capacity < 1) capacity = 1;
+  snapshot->capacity = capacity;
+  snapshot->count = 0;
+  snapshot->frame = 0;
+  snapshot->xPos = calloc(capacity, sizeof(int));
+  snapshot->yPos = calloc(capacity, sizeof(int));
+  snapshot->width = calloc(capacity, sizeof(int));
+  snapshot->height = calloc(capacity, sizeof(int));
+  snapshot->image = calloc(capacity, sizeof(int));
+  return snapshot->xPos && snapshot->yPos && snapshot->width && snapshot->height && snapshot->image;
+}
+
+/**
+ * Releases the arrays of a snapshot
+*/
+static void releaseSnapshot(SpriteSnapshot* snapshot) {
+  free(snapshot->xPos);
+  free(snapshot->yPos);
+  free(snapshot->width);
+  free(snapshot->height);
+  free(snapshot->image);
+}
+
+/**
+ * Create a standalone snapshot for up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteSnapshot* CreateSpriteSnapshot(int capacity) {
+  SpriteSnapshot* snapshot = calloc(1, sizeof(SpriteSnapshot));
+  if (!snapshot) return NULL;
+  if (!initSnapshot(snapshot, capacity)) {
+    CloseSpriteSnapshot(snapshot);
+    return NULL;
+  }
+  return snapshot;
+}
+
+/**
+ * Cleans up a snapshot created with CreateSpriteSnapshot()
+*/
+void CloseSpriteSnapshot(SpriteSnapshot* snapshot) {
+  if (snapshot) {
+    releaseSnapshot(snapshot);
+    free(snapshot);
+  }
+}
+
+/**
+ * Create a triple buffer for snapshots of up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+SnapshotBuffer* CreateSnapshotBuffer(int capacity) {
+  SnapshotBuffer* buffer = calloc(1, sizeof(SnapshotBuffer));
+  if (!buffer) return NULL;
+
+  for (int i = 0; i < 3; i++) {
+    if (!initSnapshot(&buffer->buffers[i], capacity)) {
+      CloseSnapshotBuffer(buffer);
+      return NULL;
+    }
+  }
+  // Producer starts with buffer 0, consumer with buffer 1 and buffer 2 is the (empty) middle
+  buffer->writeIndex = 0;
+  buffer->readIndex = 1;
+  buffer->middle = 2;
+  return buffer;
+}
+
+/**
+ * Cleans up the triple buffer and its snapshots
+*/
+void CloseSnapshotBuffer(SnapshotBuffer* buffer) {
+  if (buffer) {
+    for (int i = 0; i < 3; i++) releaseSnapshot(&buffer->buffers[i]);
+    free(buffer);
+  }
+}
+
+/**
+ * Copies the sprites of the store into the producers snapshot and publishes it as the latest frame
+ *
+ * The fixed point positions are interpolated between the previous and the current step by alpha
+ * (0 - SPRITE_FIXED_ONE) and rounded to whole pixels.
+ * Must only be called from the producer thread
+*/
+void PublishSnapshot(SnapshotBuffer* buffer, const SpriteStore* sprites, int alpha, long long frame) {
+  SpriteSnapshot* snapshot = BeginSnapshot(buffer);
+  int count = sprites->count < snapshot->capacity ? sprites->count : snapshot->capacity;
+
+  for (int i = 0; i < count; i++) {
+    snapshot->xPos[i] = interpolatePosition(sprites->prevX[i], sprites->xPos[i], alpha);
+    snapshot->yPos[i] = interpolatePosition(sprites->prevY[i], sprites->yPos[i], alpha);
+    snapshot->width[i] = sprites->width[i] >> SPRITE_FIXED_SHIFT;
+    snapshot->height[i] = sprites->height[i] >> SPRITE_FIXED_SHIFT;
+    // The sprites of a window are never reordered, sprite i always shows image i
+    snapshot->image[i] = i;
+  }
+  snapshot->count = count;
+  CommitSnapshot(buffer, frame);
+}
+
+/**
+ * Returns the producers snapshot to fill it directly, for frames not taken from a single sprite store
+ *
+ * Count and content are written by the caller, CommitSnapshot() publishes it.
+ * Must only be called from the producer thread
+*/
+SpriteSnapshot* BeginSnapshot(SnapshotBuffer* buffer) {
+  return &buffer->buffers[buffer->writeIndex];
+}
+
+/**
+ * Publishes the producers snapshot filled after BeginSnapshot() as the latest frame
+ *
+ * Must only be called from the producer thread
+*/
+void CommitSnapshot(SnapshotBuffer* buffer, long long frame) {
+  buffer->buffers[buffer->writeIndex].frame = frame;
+
+  // Swap the written buffer into the middle and take the previous middle for the next frame
+  long previous = exchangeMiddle(buffer, buffer->writeIndex | SNAPSHOT_FRESH);
+  buffer->writeIndex = previous & SNAPSHOT_INDEX;
+}
+
+/**
+ * Returns the whole pixel position alpha / SPRITE_FIXED_ONE of the way from previous to current (fixed point)
+*/
+int InterpolateSpritePosition(int previous, int current, int alpha) {
+  return interpolatePosition(previous, current, alpha);
+}
+
+/**
+ * Takes the latest published frame if there is a new one and returns the consumers snapshot
+ *
+ * The returned snapshot stays valid and unchanged until the next AcquireSnapshot() call.
+ * Must only be called from the consumer thread.
+*/
+const SpriteSnapshot* AcquireSnapshot(SnapshotBuffer* buffer) {
+  if (loadMiddle(buffer) & SNAPSHOT_FRESH) {
+    // Swap the read buffer into the middle (not fresh) and take the latest frame
+    long previous = exchangeMiddle(buffer, buffer->readIndex);
+    buffer->readIndex = previous & SNAPSHOT_INDEX;
+  }
+  return &buffer->buffers[buffer->readIndex];
+}
+
+/**
+ * Returns the consumers snapshot without taking a new frame
+ *
+ * Must only be called from the consumer thread
+*/
+const SpriteSnapshot* PeekSnapshot(SnapshotBuffer* buffer) {
+  return &buffer->buffers[buffer->readIndex];
+}
+
+/**
+ * Copies the content of a snapshot into another one (capacity of target must be large enough)
+*/
+void CopySnapshot(SpriteSnapshot* target, const SpriteSnapshot* source) {
+  int count = source->count < target->capacity ? source->count : target->capacity;
+  memcpy(target->xPos, source->xPos, sizeof(int) * count);
+  memcpy(target->yPos, source->yPos, sizeof(int) * count);
+  memcpy(target->width, source->width, sizeof(int) * count);
+  memcpy(target->height, source->height, sizeof(int) * count);
+  memcpy(target->image, source->image, sizeof(int) * count);
+  target->count = count;
+  target->frame = source->frame;
+}
+
+/**
+ * Adds the box of every sprite in the snapshot to the region
+*/
+void AddSnapshotRects(DirtyRegion* region, const SpriteSnapshot* snapshot) {
+  for (int i = 0; i < snapshot->count; i++) {
+    SpriteBounds rect = {
+      .left = snapshot->xPos[i],
+      .top = snapshot->yPos[i],
+      .right = snapshot->xPos[i] + snapshot->width[i],
+      .bottom = snapshot->yPos[i] + snapshot->height[i]
+    };
+    AddDirtyRect(region, rect);
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef FRAMESNAPSHOT_H
+#define FRAMESNAPSHOT_H
+
+#include "spritestore.h"
+#include "dirtyregion.h"
+
+/**
+ * Positions and sizes of all sprites of one simulated frame
+*/
+typedef struct {
+  // Box of the sprites in whole pixels
+  int* xPos;
+  int* yPos;
+  int* width;
+  int* height;
+  // Index of the image drawn for the sprites (the sprite index of the simulation or the id of a world sprite)
+  int* image;
+  // Count of sprites in the snapshot
+  int count;
+  // Count of sprites the arrays can hold
+  int capacity;
+  // Number of the simulated frame (0 if nothing was published yet)
+  long long frame;
+} SpriteSnapshot;
+
+/**
+ * Lock-free triple buffer handing whole frame snapshots from one producer to one consumer
+ *
+ * The producer always owns one buffer to write, the consumer always owns one buffer to read
+ * and the third buffer holds the latest published frame. Publishing and acquiring just swap
+ * the owned buffer with the middle one by a single atomic exchange, so neither side ever waits
+ * and the consumer always sees a complete (never torn) frame.
+*/
+typedef struct {
+  // The three snapshot buffers
+  SpriteSnapshot buffers[3];
+  // Index of the middle buffer (bits 0-1) and a flag (bit 2) set if it holds a frame not acquired yet
+  volatile long middle;
+  // Index of the buffer owned by the producer
+  int writeIndex;
+  // Index of the buffer owned by the consumer
+  int readIndex;
+} SnapshotBuffer;
+
+/**
+ * Create a standalone snapshot for up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteSnapshot* CreateSpriteSnapshot(int capacity);
+
+/**
+ * Cleans up a snapshot created with CreateSpriteSnapshot()
+*/
+void CloseSpriteSnapshot(SpriteSnapshot* snapshot);
+
+/**
+ * Create a triple buffer for snapshots of up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+SnapshotBuffer* CreateSnapshotBuffer(int capacity);
+
+/**
+ * Cleans up the triple buffer and its snapshots
+*/
+void CloseSnapshotBuffer(SnapshotBuffer* buffer);
+
+/**
+ * Copies the sprites of the store into the producers snapshot and publishes it as the latest frame
+ *
+ * The fixed point positions are interpolated between the previous and the current step by alpha
+ * (0 - SPRITE_FIXED_ONE) and rounded to whole pixels.
+ * Must only be called from the producer thread
+*/
+void PublishSnapshot(SnapshotBuffer* buffer, const SpriteStore* sprites, int alpha, long long frame);
+
+/**
+ * Returns the producers snapshot to fill it directly, for frames not taken from a single sprite store
+ *
+ * Count and content are written by the caller, CommitSnapshot() publishes it.
+ * Must only be called from the producer thread
+*/
+SpriteSnapshot* BeginSnapshot(SnapshotBuffer* buffer);
+
+/**
+ * Publishes the producers snapshot filled after BeginSnapshot() as the latest frame
+ *
+ * Must only be called from the producer thread
+*/
+void CommitSnapshot(SnapshotBuffer* buffer, long long frame);
+
+/**
+ * Returns the whole pixel position alpha / SPRITE_FIXED_ONE of the way from previous to current (fixed point)
+*/
+int InterpolateSpritePosition(int previous, int current, int alpha);
+
+/**
+ * Takes the latest published frame if there is a new one and returns the consumers snapshot
+ *
+ * The returned snapshot stays valid and unchanged until the next AcquireSnapshot() call.
+ * Must only be called from the consumer thread.
+*/
+const SpriteSnapshot* AcquireSnapshot(SnapshotBuffer* buffer);
+
+/**
+ * Returns the consumers snapshot without taking a new frame
+ *
+ * Must only be called from the consumer thread
+*/
+const SpriteSnapshot* PeekSnapshot(SnapshotBuffer* buffer);
+
+/**
+ * Copies the content of a snapshot into another one (capacity of target must be large enough)
+*/
+void CopySnapshot(SpriteSnapshot* target, const SpriteSnapshot* source);
+
+/**
+ * Adds the box of every sprite in the snapshot to the region
+*/
+void AddSnapshotRects(DirtyRegion* region, const SpriteSnapshot* snapshot);
+
+#endif
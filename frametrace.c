@@ -0,0 +1,237 @@
+#include "frametrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "framescheduler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+// Names of the stages in the trace (same order as TraceStage)
+static const char* stageNames[TRACE_STAGE_COUNT] = {
+  "update", "collision", "post-invalidate", "paint", "blit", "spin"
+};
+// Names of the counters in the trace (same order as TraceCounter)
+static const char* counterNames[TRACE_COUNTER_COUNT] = {
+  "jitter", "jitter mean", "jitter max"
+};
+
+// Set while tracing is enabled
+static volatile long traceEnabled = 0;
+// Incremented with every start, invalidates the rings cached by the threads of an earlier trace
+static volatile long traceGeneration = 0;
+// Count of threads that registered a ring in the current trace
+static volatile long traceThreads = 0;
+// Head of the registered rings (lock-free push only)
+static TraceRing* volatile traceRings = NULL;
+// Start of the trace in ms, timestamps are written relative to it
+static double traceStart = 0;
+// Path of the trace file
+static char tracePath[512];
+
+// Ring of the calling thread and the generation it was registered in
+static TRACE_THREAD_LOCAL TraceRing* threadRing = NULL;
+static TRACE_THREAD_LOCAL long threadGeneration = 0;
+
+/**
+ * Atomically increments the value and returns the new value
+*/
+static long incrementAtomic(volatile long* value) {
+#ifdef _WIN32
+  return InterlockedIncrement(value);
+#else
+  return __atomic_add_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/**
+ * Pushes the ring onto the registered rings
+*/
+static void pushRing(TraceRing* ring) {
+#ifdef _WIN32
+  TraceRing* head;
+  do {
+    head = traceRings;
+    ring->next = head;
+  } while (InterlockedCompareExchangePointer((PVOID volatile*)&traceRings, ring, head) != head);
+#else
+  TraceRing* head = __atomic_load_n(&traceRings, __ATOMIC_ACQUIRE);
+  do {
+    ring->next = head;
+  } while (!__atomic_compare_exchange_n(&traceRings, &head, ring, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+#endif
+}
+
+/**
+ * Returns the ring of the calling thread, the ring is created on the first call in a trace
+ *
+ * Returns NULL if the ring could not be allocated
+*/
+static TraceRing* acquireRing() {
+  if (threadRing && threadGeneration == traceGeneration) return threadRing;
+
+  threadRing = NULL;
+  TraceRing* ring = calloc(1, sizeof(TraceRing));
+  if (!ring) return NULL;
+  ring->events = malloc(sizeof(TraceEvent) * TRACE_RING_EVENTS);
+  if (!ring->events) {
+    free(ring);
+    return NULL;
+  }
+  ring->thread = incrementAtomic(&traceThreads);
+  snprintf(ring->name, sizeof(ring->name), "thread %d", ring->thread);
+  pushRing(ring);
+
+  threadRing = ring;
+  threadGeneration = traceGeneration;
+  return ring;
+}
+
+/**
+ * Enables tracing, the events are written as chrome trace-event json to path on StopTracing()
+ *
+ * Returns 0 if tracing is already enabled or the path is too long
+*/
+int StartTracing(const char* path) {
+  if (traceEnabled || strlen(path) >= sizeof(tracePath)) return 0;
+
+  strcpy(tracePath, path);
+  traceStart = FrameSchedulerNow();
+  traceThreads = 0;
+  traceRings = NULL;
+  incrementAtomic(&traceGeneration);
+  traceEnabled = 1;
+  return 1;
+}
+
+/**
+ * Enables tracing if the TRACE_ENVIRONMENT_VARIABLE is set (its value is used as path)
+ *
+ * Returns 0 if tracing was not enabled
+*/
+int StartTracingFromEnvironment() {
+  const char* path = getenv(TRACE_ENVIRONMENT_VARIABLE);
+  if (!path || !*path) return 0;
+  return StartTracing(path);
+}
+
+/**
+ * Returns 1 if tracing is enabled
+*/
+int TracingEnabled() {
+  return traceEnabled != 0;
+}
+
+/**
+ * Sets the name of the calling thread shown in the trace
+*/
+void SetTraceThreadName(const char* name) {
+  if (!traceEnabled) return;
+  TraceRing* ring = acquireRing();
+  if (ring) snprintf(ring->name, sizeof(ring->name), "%s", name);
+}
+
+/**
+ * Records a stage from start to end (in ms of FrameSchedulerNow()) into the ring of the calling thread
+ *
+ * Does nothing if tracing is disabled
+*/
+void RecordTrace(TraceStage stage, int window, long long frame, double start, double end) {
+  if (!traceEnabled) return;
+  TraceRing* ring = acquireRing();
+  if (!ring) return;
+
+  TraceEvent* event = &ring->events[ring->written % TRACE_RING_EVENTS];
+  event->start = start;
+  event->duration = end - start;
+  event->frame = frame;
+  event->window = window;
+  event->stage = stage;
+  event->counter = 0;
+  ring->written++;
+}
+
+/**
+ * Records the value of the counter at time (in ms of FrameSchedulerNow()) into the ring of the calling thread
+ *
+ * Does nothing if tracing is disabled
+*/
+void RecordTraceCounter(TraceCounter counter, double time, double value) {
+  if (!traceEnabled) return;
+  TraceRing* ring = acquireRing();
+  if (!ring) return;
+
+  TraceEvent* event = &ring->events[ring->written % TRACE_RING_EVENTS];
+  event->start = time;
+  event->duration = value;
+  event->frame = 0;
+  event->window = -1;
+  event->stage = counter;
+  event->counter = 1;
+  ring->written++;
+}
+
+/**
+ * Writes the events of a ring as complete ("X") events and the counter values as counter ("C") events, oldest first
+*/
+static void writeRing(FILE* file, const TraceRing* ring, int* first) {
+  // Thread name metadata, perfetto shows it as track name
+  fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+    *first ? "" : ",", ring->thread, ring->name);
+  *first = 0;
+
+  long long begin = ring->written > TRACE_RING_EVENTS ? ring->written - TRACE_RING_EVENTS : 0;
+  for (long long i = begin; i < ring->written; i++) {
+    const TraceEvent* event = &ring->events[i % TRACE_RING_EVENTS];
+    // Trace-event timestamps are in microseconds
+    if (event->counter) {
+      fprintf(file,
+        ",\n{\"name\":\"%s\",\"cat\":\"pacing\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"ms\":%.3f}}",
+        counterNames[event->stage], ring->thread, (event->start - traceStart) * 1000, event->duration);
+      continue;
+    }
+    fprintf(file,
+      ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+      "\"args\":{\"window\":%d,\"frame\":%lld}}",
+      stageNames[event->stage], ring->thread,
+      (event->start - traceStart) * 1000, event->duration * 1000,
+      event->window, event->frame);
+  }
+}
+
+/**
+ * Disables tracing, writes all recorded events to the trace file and releases the rings
+ *
+ * Must only be called when no other thread records anymore.
+ * Returns 0 if tracing was not enabled or the file could not be written.
+*/
+int StopTracing() {
+  if (!traceEnabled) return 0;
+  traceEnabled = 0;
+
+  FILE* file = fopen(tracePath, "w");
+  if (file) {
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    int first = 1;
+    for (TraceRing* ring = traceRings; ring; ring = ring->next) writeRing(file, ring, &first);
+    fprintf(file, "\n]}\n");
+  }
+
+  // Release the rings, the threads detect their stale ring by the generation on the next trace
+  TraceRing* ring = traceRings;
+  while (ring) {
+    TraceRing* next = ring->next;
+    free(ring->events);
+    free(ring);
+    ring = next;
+  }
+  traceRings = NULL;
+
+  return file && fclose(file) == 0;
+}
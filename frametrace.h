@@ -0,0 +1,123 @@
+#ifndef FRAMETRACE_H
+#define FRAMETRACE_H
+
+// Environment variable holding the path of the trace file, tracing is only enabled if it is set
+#define TRACE_ENVIRONMENT_VARIABLE "SCREENSAVER_TRACE"
+// Count of events kept per thread, older events are overwritten
+#define TRACE_RING_EVENTS 65536
+
+/**
+ * Traced stages of a frame
+*/
+typedef enum {
+  // Movement and wall bounces of the sprites
+  TRACE_UPDATE = 0,
+  // Collision detection and resolution
+  TRACE_COLLISION = 1,
+  // Publishing the frame and posting the invalidation to the ui thread
+  TRACE_POST_INVALIDATE = 2,
+  // Whole repaint of the window
+  TRACE_PAINT = 3,
+  // Composition and copy of one dirty rect during the repaint
+  TRACE_BLIT = 4,
+  // Busy wait of the frame scheduler before the deadline
+  TRACE_SPIN = 5,
+  TRACE_STAGE_COUNT
+} TraceStage;
+
+/**
+ * Traced counters, each one is shown as its own counter track
+*/
+typedef enum {
+  // Lateness of the last wake of the frame scheduler in ms
+  TRACE_JITTER_LAST = 0,
+  // Mean lateness of the wakes of the frame scheduler so far in ms
+  TRACE_JITTER_MEAN = 1,
+  // Largest lateness of the wakes of the frame scheduler so far in ms
+  TRACE_JITTER_MAX = 2,
+  TRACE_COUNTER_COUNT
+} TraceCounter;
+
+/**
+ * One recorded stage or counter value
+*/
+typedef struct {
+  // Start of the stage or time of the counter value in ms (FrameSchedulerNow() clock)
+  double start;
+  // Duration of the stage in ms, the value of a counter
+  double duration;
+  // Frame the stage belongs to
+  long long frame;
+  // Window the stage belongs to
+  int window;
+  // Traced stage (TraceStage) or counter (TraceCounter)
+  int stage;
+  // Set if the event is a counter value
+  int counter;
+} TraceEvent;
+
+/**
+ * Ring buffer of the events recorded by one thread
+ *
+ * Each thread only ever writes its own ring, so recording needs no synchronisation at all.
+*/
+typedef struct TraceRing {
+  // Event storage with TRACE_RING_EVENTS entries
+  TraceEvent* events;
+  // Total count of events written, the ring holds the last TRACE_RING_EVENTS of them
+  long long written;
+  // Index of the thread in the trace
+  int thread;
+  // Name of the thread shown in the trace
+  char name[32];
+  // Next registered ring
+  struct TraceRing* next;
+} TraceRing;
+
+/**
+ * Enables tracing, the events are written as chrome trace-event json to path on StopTracing()
+ *
+ * Returns 0 if tracing is already enabled or the path is too long
+*/
+int StartTracing(const char* path);
+
+/**
+ * Enables tracing if the TRACE_ENVIRONMENT_VARIABLE is set (its value is used as path)
+ *
+ * Returns 0 if tracing was not enabled
+*/
+int StartTracingFromEnvironment();
+
+/**
+ * Returns 1 if tracing is enabled
+*/
+int TracingEnabled();
+
+/**
+ * Sets the name of the calling thread shown in the trace
+*/
+void SetTraceThreadName(const char* name);
+
+/**
+ * Records a stage from start to end (in ms of FrameSchedulerNow()) into the ring of the calling thread
+ *
+ * Does nothing if tracing is disabled
+*/
+void RecordTrace(TraceStage stage, int window, long long frame, double start, double end);
+
+/**
+ * Records the value of the counter at time (in ms of FrameSchedulerNow()) into the ring of the calling thread
+ *
+ * Does nothing if tracing is disabled
+*/
+void RecordTraceCounter(TraceCounter counter, double time, double value);
+
+/**
+ * Disables tracing, writes all recorded events to the trace file and releases the rings
+ *
+ * Must only be called when no other thread records anymore.
+ * Returns 0 if tracing was not enabled or the file could not be written.
+*/
+int StopTracing();
+
+#endif
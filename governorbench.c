@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "loadgovernor.h"
+#include "randomgenerator.h"
+
+/**
+ * Synthetic cost model of one presented frame, split into the simulation steps and the paint, with random jitter
+ *
+ * A presented frame runs the fixed steps of all ticks it stands for, so skipping frames only saves the paint.
+*/
+typedef struct {
+  // Paint cost of a frame without sprites and per live sprite in ms
+  double paintFixed;
+  double paintPerSprite;
+  // Cost of a fixed step per live sprite in ms, for the movement and for a collision pass
+  double movePerSprite;
+  double collidePerSprite;
+  // Fixed steps simulated per second
+  double stepRate;
+  // Maximum relative jitter of the cost (0.2 == +-20%)
+  double jitter;
+} CostModel;
+
+/**
+ * Result of a governed run
+*/
+typedef struct {
+  // Count of level changes, the largest level step of one evaluation and the evaluation of the last change
+  int changes;
+  int largestStep;
+  long long lastChange;
+  // Count of level changes that went up again right after going down (or the other way round)
+  int reversals;
+  // Load of the last evaluation
+  double load;
+} GovernedRun;
+
+/**
+ * Simulation cost of one presented frame at the current level of the governor without jitter
+*/
+static double simulationCost(const CostModel* model, const LoadGovernor* governor) {
+  double steps = model->stepRate * governor->interval * governor->frameDivider / 1000.0;
+  return steps * governor->activeSprites * (model->movePerSprite + model->collidePerSprite / governor->collisionDivider);
+}
+
+/**
+ * Paint cost of one presented frame at the current level of the governor without jitter
+*/
+static double paintCost(const CostModel* model, const LoadGovernor* governor) {
+  return model->paintFixed + model->paintPerSprite * governor->activeSprites;
+}
+
+/**
+ * Cost of one presented frame at the current level of the governor
+*/
+static double frameCost(const CostModel* model, const LoadGovernor* governor, RandomGenerator* random) {
+  double cost = simulationCost(model, governor) + paintCost(model, governor);
+  double jitter = model->jitter * ((double)RandomBelow(random, 2001) / 1000.0 - 1.0);
+  return cost * (1.0 + jitter);
+}
+
+/**
+ * Presents frames with the cost of the model for the given count of evaluations and tracks the level changes
+*/
+static GovernedRun runGovernor(LoadGovernor* governor, const CostModel* model, int evaluations, RandomGenerator* random) {
+  GovernedRun run = { 0 };
+  int lastDirection = 0;
+  for (long long evaluation = 0; evaluation < evaluations; evaluation++) {
+    int level = governor->level;
+    int changed = 0;
+    for (int f = 0; f < GOVERNOR_EVALUATION_FRAMES; f++) changed |= GovernFrame(governor, frameCost(model, governor, random));
+    if (!changed) continue;
+
+    int step = governor->level - level;
+    int direction = step > 0 ? 1 : -1;
+    if (abs(step) > run.largestStep) run.largestStep = abs(step);
+    if (lastDirection && direction != lastDirection) run.reversals++;
+    lastDirection = direction;
+    run.changes++;
+    run.lastChange = evaluation;
+  }
+  run.load = governor->load;
+  return run;
+}
+
+/**
+ * Load of the current level without jitter (cost of a presented frame over the ticks it stands for)
+*/
+static double levelLoad(const CostModel* model, const LoadGovernor* governor) {
+  return (simulationCost(model, governor) + paintCost(model, governor)) / (governor->interval * governor->frameDivider);
+}
+
+/**
+ * Runs one scenario and checks where the governor settles, returns 0 if a check failed
+ *
+ * expectedLevel < 0 only requires the settled level to fit the budget without being cheap enough to recover
+*/
+static int checkScenario(const char* name, double budget, double rate, int sprites, CostModel model, int expectedLevel, RandomGenerator* random) {
+  LoadGovernor* governor = CreateLoadGovernor(budget, 1000.0 / rate, sprites);
+  if (!governor) return 0;
+  int evaluations = 40 * (governor->maxLevel + 1) * GOVERNOR_RECOVER_EVALUATIONS;
+  GovernedRun run = runGovernor(governor, &model, evaluations, random);
+
+  int ok = run.largestStep <= 1;
+  // The presented rate never drops below the minimum by skipping frames
+  ok &= 1000.0 / (governor->interval * (1 << governor->dividerLevels)) >= GOVERNOR_MIN_FRAME_RATE;
+  if (expectedLevel >= 0) {
+    ok &= governor->level == expectedLevel;
+  } else if (budget > 0.0) {
+    // Fits the budget (unless even the last level doesn't) and the level above would not be recovered
+    ok &= levelLoad(&model, governor) <= budget * (1.0 + model.jitter) || governor->level == governor->maxLevel;
+    ok &= governor->level == 0 || levelLoad(&model, governor) >= budget * GOVERNOR_RECOVER_SHARE * (1.0 - model.jitter);
+  }
+  // Settled: no oscillation in the second half of the run
+  ok &= run.lastChange < evaluations / 2 || run.changes == 0;
+
+  double time = governor->interval * governor->frameDivider;
+  printf("%-22s %6.0f%% %5.0fhz %6d sprites: level %2d of %2d, collisions every %d. step, every %d. frame, %6d sprites, "
+    "load %6.1f%% (simulation %5.1f%%, paint %5.1f%%), %2d changes, %d reversals%s\n",
+    name, budget * 100.0, rate, sprites, governor->level, governor->maxLevel, governor->collisionDivider, governor->frameDivider,
+    governor->activeSprites, run.load * 100.0, simulationCost(&model, governor) / time * 100.0, paintCost(&model, governor) / time * 100.0,
+    run.changes, run.reversals, ok ? "" : ", FAILED");
+  CloseLoadGovernor(governor);
+  return ok;
+}
+
+/**
+ * Drives the governor through a load spike and back, returns 0 if it did not step down and recover as designed
+*/
+static int checkRecovery(RandomGenerator* random) {
+  CostModel light = { .paintFixed = 0.2, .paintPerSprite = 0.0002, .movePerSprite = 0.0001, .collidePerSprite = 0.0002, .stepRate = 60.0, .jitter = 0.1 };
+  CostModel heavy = { .paintFixed = 0.2, .paintPerSprite = 0.004, .movePerSprite = 0.002, .collidePerSprite = 0.004, .stepRate = 60.0, .jitter = 0.1 };
+  LoadGovernor* governor = CreateLoadGovernor(0.25, 1000.0 / 60.0, 1000);
+  if (!governor) return 0;
+
+  GovernedRun spike = runGovernor(governor, &heavy, 200, random);
+  int spikeLevel = governor->level;
+  // Stepping down takes one evaluation per level
+  int ok = spikeLevel > 0 && spike.changes == spikeLevel && spike.reversals == 0;
+
+  // Recovering takes GOVERNOR_RECOVER_EVALUATIONS evaluations per level
+  int evaluations = 0;
+  while (governor->level > 0 && evaluations < 1000) {
+    runGovernor(governor, &light, 1, random);
+    evaluations++;
+  }
+  ok &= governor->level == 0 && governor->collisionDivider == 1 && governor->frameDivider == 1 && governor->activeSprites == 1000;
+  ok &= evaluations >= spikeLevel * GOVERNOR_RECOVER_EVALUATIONS && evaluations <= spikeLevel * GOVERNOR_RECOVER_EVALUATIONS + 1;
+
+  printf("spike and recovery: stepped down to level %d in %d evaluations, recovered in %d evaluations%s\n",
+    spikeLevel, (int)spike.lastChange + 1, evaluations, ok ? "" : ", FAILED");
+  CloseLoadGovernor(governor);
+  return ok;
+}
+
+/**
+ * Headless check of the load governor with a synthetic cost model
+ *
+ * Not part of the screensaver build, the governor only does the bookkeeping of the measured cost:
+ * cc -O2 -o governorbench governorbench.c loadgovernor.c randomgenerator.c -lm
+ * ./governorbench [jitter]
+ *
+ * Every presented frame costs the fixed steps it runs (movement and collision passes per live sprite) plus its paint
+ * (a fixed part plus a part per live sprite), with random jitter. Checks that a disabled or sufficient budget never
+ * changes the level, that an exceeded budget settles on a level within the budget one level per evaluation without
+ * oscillating, that a collision bound window settles on skipping collision passes without skipping frames, that
+ * frames are only skipped down to the minimum rate and that a load spike is recovered level by level.
+ * Prints the simulation and the paint share of the settled load, skipped frames only lower the paint share.
+ * Exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  double jitter = argc > 1 ? atof(argv[1]) : 0.2;
+  if (jitter < 0.0 || jitter >= 1.0) {
+    fprintf(stderr, "usage: %s [jitter (0 - 1)]\n", argv[0]);
+    return 1;
+  }
+
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 19);
+  int failed = 0;
+  // Paint cost (fixed, per sprite), step cost per sprite (movement, collision pass) and step rate
+  failed |= !checkScenario("disabled", 0.0, 60.0, 1000, (CostModel){ 5.0, 0.05, 0.01, 0.05, 60.0, jitter }, 0, &random);
+  failed |= !checkScenario("within budget", 0.5, 60.0, 100, (CostModel){ 0.5, 0.005, 0.001, 0.004, 60.0, jitter }, 0, &random);
+  failed |= !checkScenario("collision bound", 0.25, 60.0, 1000, (CostModel){ 0.5, 0.0003, 0.0004, 0.008, 60.0, jitter }, GOVERNOR_COLLISION_LEVELS, &random);
+  failed |= !checkScenario("collision bound 240hz", 0.25, 240.0, 1000, (CostModel){ 0.2, 0.0001, 0.0004, 0.008, 60.0, jitter }, GOVERNOR_COLLISION_LEVELS, &random);
+  failed |= !checkScenario("frame skipping 60hz", 0.25, 60.0, 100, (CostModel){ 4.0, 0.01, 0.0002, 0.0004, 60.0, jitter }, -1, &random);
+  failed |= !checkScenario("frame skipping 144hz", 0.25, 144.0, 100, (CostModel){ 2.0, 0.01, 0.0002, 0.0004, 60.0, jitter }, -1, &random);
+  failed |= !checkScenario("movement bound", 0.25, 60.0, 1000, (CostModel){ 0.5, 0.0003, 0.012, 0.002, 60.0, jitter }, -1, &random);
+  failed |= !checkScenario("parking sprites", 0.25, 60.0, 10000, (CostModel){ 0.2, 0.001, 0.0005, 0.001, 60.0, jitter }, -1, &random);
+  failed |= !checkScenario("parking sprites 240hz", 0.1, 240.0, 10000, (CostModel){ 0.1, 0.0005, 0.0002, 0.0005, 120.0, jitter }, -1, &random);
+  failed |= !checkScenario("impossible budget", 0.01, 60.0, 1000, (CostModel){ 5.0, 0.05, 0.01, 0.05, 60.0, jitter }, -1, &random);
+  failed |= !checkRecovery(&random);
+
+  printf("%s\n", failed ? "FAILED" : "all governor scenarios passed");
+  return failed;
+}
@@ -0,0 +1,93 @@
+#include "loadgovernor.h"
+
+#include <stdlib.h>
+
+/**
+ * Applies the collision divider, the frame divider and the live sprite count of the current level
+*/
+static void applyLevel(LoadGovernor* governor) {
+  int collisionLevel = governor->level < governor->collisionLevels ? governor->level : governor->collisionLevels;
+  int remaining = governor->level - collisionLevel;
+  int dividerLevel = remaining < governor->dividerLevels ? remaining : governor->dividerLevels;
+  int spriteLevel = remaining - dividerLevel;
+  governor->collisionDivider = 1 << collisionLevel;
+  governor->frameDivider = 1 << dividerLevel;
+  governor->activeSprites = governor->spriteCount >> spriteLevel;
+  if (governor->activeSprites < 1 && governor->spriteCount > 0) governor->activeSprites = 1;
+}
+
+/**
+ * Create a governor for a window presenting spriteCount sprites every interval ms
+ *
+ * The budget is the allowed share of the frame time (e.g. 0.25 for a quarter), <= 0 keeps level 0 forever.
+ * If the allocation fails it returns NULL
+*/
+LoadGovernor* CreateLoadGovernor(double budget, double interval, int spriteCount) {
+  LoadGovernor* governor = calloc(1, sizeof(LoadGovernor));
+  if (!governor) return NULL;
+
+  governor->budget = budget;
+  governor->interval = interval > 0.0 ? interval : 1000.0 / 60;
+  governor->spriteCount = spriteCount > 0 ? spriteCount : 0;
+
+  // Collision passes are skipped first, a single sprite has nothing to collide with
+  governor->collisionLevels = governor->spriteCount > 1 ? GOVERNOR_COLLISION_LEVELS : 0;
+  // Skip frames only as long as the presented rate stays above the minimum (e.g. 60hz -> 30, 144hz -> 36)
+  double rate = 1000.0 / governor->interval;
+  while (rate / (1 << (governor->dividerLevels + 1)) >= GOVERNOR_MIN_FRAME_RATE) governor->dividerLevels++;
+  // Then halve the sprites until a single one is left
+  int spriteLevels = 0;
+  while ((governor->spriteCount >> (spriteLevels + 1)) > 0) spriteLevels++;
+  governor->maxLevel = governor->collisionLevels + governor->dividerLevels + spriteLevels;
+
+  applyLevel(governor);
+  return governor;
+}
+
+/**
+ * Cleans up the governor
+*/
+void CloseLoadGovernor(LoadGovernor* governor) {
+  free(governor);
+}
+
+/**
+ * Adds the measured cost in ms of one presented frame, every GOVERNOR_EVALUATION_FRAMES frames
+ * the load is evaluated and the level adjusted
+ *
+ * Returns 1 if the level changed, collisionDivider, frameDivider and activeSprites then hold the values of the new level
+*/
+int GovernFrame(LoadGovernor* governor, double cost) {
+  if (governor->budget <= 0.0) return 0;
+
+  // A presented frame stands for frameDivider ticks of the window
+  governor->cost += cost;
+  governor->time += governor->interval * governor->frameDivider;
+  if (++governor->frames < GOVERNOR_EVALUATION_FRAMES) return 0;
+
+  governor->load = governor->cost / governor->time;
+  governor->cost = 0.0;
+  governor->time = 0.0;
+  governor->frames = 0;
+
+  if (governor->load > governor->budget) {
+    // Over budget, step down right away
+    governor->headroom = 0;
+    if (governor->level == governor->maxLevel) return 0;
+    governor->level++;
+    applyLevel(governor);
+    return 1;
+  }
+
+  if (governor->level > 0 && governor->load < governor->budget * GOVERNOR_RECOVER_SHARE) {
+    // Recover only after the headroom lasted a few evaluations, a single quiet phase shouldn't bring back the load
+    if (++governor->headroom < GOVERNOR_RECOVER_EVALUATIONS) return 0;
+    governor->headroom = 0;
+    governor->level--;
+    applyLevel(governor);
+    return 1;
+  }
+
+  governor->headroom = 0;
+  return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef LOADGOVERNOR_H
+#define LOADGOVERNOR_H
+
+// Count of presented frames measured before the governor decides on a level change
+#define GOVERNOR_EVALUATION_FRAMES 30
+// Count of levels skipping collision passes, each one doubles the collision divider (up to every 4th step)
+#define GOVERNOR_COLLISION_LEVELS 2
+// Lowest frame rate the governor reduces a window to by skipping frames, below it sprites are parked instead
+#define GOVERNOR_MIN_FRAME_RATE 20.0
+// A level is only recovered while the load is below this share of the budget
+// (recovering one level at most doubles the load, so the recovered level stays within the budget)
+#define GOVERNOR_RECOVER_SHARE 0.4
+// Count of evaluations in a row with headroom until a level is recovered (stepping down happens after one)
+#define GOVERNOR_RECOVER_EVALUATIONS 4
+
+/**
+ * Control loop keeping the update and paint cost of one window within a share of its frame time
+ *
+ * The governor walks down a ladder of levels while the measured load exceeds the budget: first the collisions are
+ * only resolved in every second and fourth simulation step, then every second, fourth, ... frame is skipped
+ * (down to GOVERNOR_MIN_FRAME_RATE), then the count of live sprites is halved per level.
+ * The fixed steps of skipped frames are caught up by the next frame, so skipping frames only saves the paint,
+ * the collision levels come first as they save simulation cost without lowering the frame rate.
+ * With headroom it climbs back up, slower than it steps down, so it doesn't oscillate.
+ * The governor only does the bookkeeping, the measured cost is provided by the caller, so the control loop
+ * is independent of any window system and clock.
+*/
+typedef struct {
+  // Allowed share of the frame time spent on update and paint (1.0 == one cpu core), <= 0 disables the governor
+  double budget;
+  // Interval of the presented frames at level 0 in ms
+  double interval;
+  // Count of sprites live at level 0
+  int spriteCount;
+  // Count of levels skipping collision passes (none without at least two sprites to collide)
+  int collisionLevels;
+  // Count of levels skipping frames, each one doubles the frame divider
+  int dividerLevels;
+  // Highest level (all collision and divider levels plus halving the sprites down to one)
+  int maxLevel;
+  // Current level, 0 presents every frame with all sprites and all collision passes
+  int level;
+  // Collisions are only resolved every collisionDivider-th simulation step
+  int collisionDivider;
+  // Only every frameDivider-th tick of the window is advanced and presented
+  int frameDivider;
+  // Count of live sprites of the current level
+  int activeSprites;
+  // Cost of the presented frames of the current evaluation in ms
+  double cost;
+  // Time covered by the presented frames of the current evaluation in ms
+  double time;
+  // Count of presented frames of the current evaluation
+  int frames;
+  // Count of evaluations in a row with enough headroom to recover a level
+  int headroom;
+  // Load of the last evaluation (cost / time)
+  double load;
+} LoadGovernor;
+
+/**
+ * Create a governor for a window presenting spriteCount sprites every interval ms
+ *
+ * The budget is the allowed share of the frame time (e.g. 0.25 for a quarter), <= 0 keeps level 0 forever.
+ * If the allocation fails it returns NULL
+*/
+LoadGovernor* CreateLoadGovernor(double budget, double interval, int spriteCount);
+
+/**
+ * Cleans up the governor
+*/
+void CloseLoadGovernor(LoadGovernor* governor);
+
+/**
+ * Adds the measured cost in ms of one presented frame, every GOVERNOR_EVALUATION_FRAMES frames
+ * the load is evaluated and the level adjusted
+ *
+ * Returns 1 if the level changed, collisionDivider, frameDivider and activeSprites then hold the values of the new level
+*/
+int GovernFrame(LoadGovernor* governor, double cost);
+
+#endif
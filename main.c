@@ -1,18 +1,31 @@
 #include <windows.h>
+#include <time.h>
 
 #include "parser.h"
 #include "eventhandler.h"
 #include "windowhandler.h"
+#include "windowregistry.h"
+#include "settings.h"
 
 // Defines the BITMAP ID to identify the loaded bitmap
 #define IDB_LOGOBITMAP 101
 
+// Upper limit of consecutive bitmap resources used as images
+#define MAX_LOGOBITMAPS 256
+
 // Defines transparent color of the screensaver
 #define IDB_LOGOBITMAP_TRANSPARENT_COLOR RGB(255, 255, 255)
 
 // Defines background color of the screensaver
 #define BACKGROUND_COLOR RGB(34, 40, 49)
 
+// Update interval of the preview window in ms (15hz is plenty for the control panel thumbnail)
+#define PREVIEW_INTERVAL (1000.0 / 15)
+// Upper limit of images shown in the preview window
+#define PREVIEW_MAX_IMAGES 4
+// Upper limit of simulation steps per second in the preview window (one step per tick)
+#define PREVIEW_STEP_RATE 15.0
+
 /**
  * Request holding "environment" relevant data to create a window
 */
@@ -25,6 +38,34 @@ typedef struct {
    * Window class for the window
   */
   wchar_t *windowClass;
+  /**
+   * Shared pacer executing the window loops of all windows
+  */
+  FramePacer* pacer;
+  /**
+   * Shared cache of the scaled images of all windows
+  */
+  SpriteCache* spriteCache;
+  /**
+   * Bmp files shown instead of the bitmap resources (NULL shows the resources)
+  */
+  BmpDirectory* imageDirectory;
+  /**
+   * Shared animation played by all images instead of the bitmap (NULL shows the bitmap)
+  */
+  SpriteAnimation* animation;
+  /**
+   * Shared compositor rendering the windows in parallel tiles (windows are painted one after another on the ui thread)
+  */
+  TileCompositor* compositor;
+  /**
+   * World spanning the monitors of the start, shared by their windows (NULL gives every window its own scene)
+  */
+  SimulationWorld* world;
+  /**
+   * Registry tracking the windows of all monitors
+  */
+  WindowRegistry* registry;
   /**
    * Reference to initial cursor position
   */
@@ -45,14 +86,22 @@ typedef struct {
    * Disables image scale and uses the images native size (better quality)
   */
   BOOL disableImageScale;
+  /**
+   * Filter used to scale the images to the window size
+  */
+  ResampleFilter imageFilter;
+  /**
+   * Draws the images with alpha blended edges (alpha channel of the bitmap or smoothed colour key edges)
+  */
+  BOOL imageAlpha;
   /**
    * Default update interval in ms. This value should be set to 1000 / the displays refresh rate for optimal movement
   */
-  int interval;
+  double interval;
   /**
-   * Speed of the images in pixels per frame
+   * Speed of the images in pixels per frame at 60hz (fractions move the images by sub-pixels)
   */
-  int speed;
+  double speed;
   /**
    * Instant bounce speed incrementation in pixels
   */
@@ -62,9 +111,29 @@ typedef struct {
   */
   double bounceScale;
   /**
-   * Id of the bitmap resource to load and display
+   * Fixed simulation steps per second, frames in between are interpolated
+  */
+  double stepRate;
+  /**
+   * Seed of the scene, window n uses seed + n
+  */
+  uint64_t seed;
+  /**
+   * Algorithm used to detect image collisions
+  */
+  BroadphaseKind broadphase;
+  /**
+   * Share of the frame time in percent a window may spend on update and paint (0 disables the load governor)
+  */
+  double loadBudget;
+  /**
+   * Id of the first bitmap resource (or index of the first file of the image directory) to load and display
   */
   int bitmap;
+  /**
+   * Count of consecutive bitmap resources (or files) starting at bitmap, the images cycle through them
+  */
+  int bitmapCount;
   /**
    * Background color of the window
   */
@@ -76,32 +145,16 @@ typedef struct {
 } WindowCreationRequest;
 
 /**
- * Acquires the value for the specified registry key as double
- * 
- * If the registry entry is not found or can't be converted to double, it returns the specified default value
+ * Reduces the request to the low-power preview profile: a few images at a reduced tick and step rate
+ *
+ * The images are always scaled to the size of the preview window (once, through the cache),
+ * so the thumbnail blits tiny sprites into a back buffer of the same tiny size.
 */
-double getRegDouble(HKEY root, LPCWSTR sub, LPCWSTR val, DWORD type, double def) {
-  HKEY key;
-  double result = def;
-  wchar_t data[255];
-  DWORD dataSize = sizeof(data);
-
-  // Open regkey
-  if (RegOpenKeyEx(root, sub, 0, KEY_READ, &key) == ERROR_SUCCESS) {
-    // Get value entry as
-    if (RegGetValue(key, NULL, val, RRF_RT_ANY, &type, data, &dataSize) == ERROR_SUCCESS) {
-      
-      // Convert data into a double (aka longfloat)
-      wchar_t* end;
-      double convertedValue = wcstod(data, &end);
-      if (end != data) {
-        result = convertedValue;
-      }
-      // If conversion fails, use default value
-    }
-    RegCloseKey(key);
-  }
-  return result;
+void ApplyPreviewProfile(WindowCreationRequest* request) {
+  request->interval = PREVIEW_INTERVAL;
+  if (request->count > PREVIEW_MAX_IMAGES) request->count = PREVIEW_MAX_IMAGES;
+  if (request->stepRate > PREVIEW_STEP_RATE) request->stepRate = PREVIEW_STEP_RATE;
+  request->disableImageScale = FALSE;
 }
 
 /**
@@ -117,97 +170,235 @@ BOOL CreatePreviewWindow(HWND hWindow, WindowCreationRequest* request) {
     request->interval,
     request->bounce,
     request->bounceScale,
+    request->stepRate,
+    request->seed,
+    request->broadphase,
+    request->loadBudget,
+    request->spriteCache,
+    request->imageDirectory,
+    request->animation,
+    request->compositor,
+    NULL, // The preview shows its own scene
+    -1,
     request->windowClass,
     NULL, // Monitor rect is NULL, because no window must be created
     request->initCursorPos,
     request->cursorThreshold,
     request->relativeImageWidth,
     request->disableImageScale,
+    request->imageFilter,
+    request->imageAlpha,
     request->bitmap,
+    request->bitmapCount,
     request->backgroundColor,
     request->transparentColor
   );
   if (!windowState) return FALSE;
 
-  // Create windowThread running the WindowProcessLoop
-  HANDLE windowThread = CreateThread(
-    NULL, // Default security attrs
-    0, // Default stack size
-    StartWindowLoop,
-    (LPVOID)windowState,
-    0, // Default creation flags
-    NULL // No need to acquire the thread identifier
-  );
-  // Immediately close the window handle, this just removes the handle and does not interupt the thread (essentially detaching it)
-  // The thread is cleaned up automatically by the evenloop which will send a exit signal to stop the loop
-  if (windowThread!=NULL) {
-    CloseHandle(windowThread);
-    return TRUE;
+  // The preview window is the only window of the registry, it doesn't belong to a monitor
+  SpriteBounds previewRect = {0};
+  windowState->registry = request->registry;
+  if (!RegisterWindow(request->registry, windowState, 0, previewRect)) {
+    // The child window of the preview is ours, its WM_NCDESTROY closes the windowState
+    DestroyWindowStateWindow(windowState);
+    return FALSE;
   }
-  else return FALSE;
+
+  // Run the WindowProcessLoop on the shared pacer
+  // The loop is stopped by the evenloop which will send a exit signal to stop the loop
+  if (!StartWindowLoop(request->pacer, windowState)) {
+    DestroyWindowStateWindow(windowState);
+    return FALSE;
+  }
+  return TRUE;
 }
 
 /**
- * Procedure called to iterate over monitors, creating a windowState for each
+ * Monitors collected by EnumerateMonitors()
+*/
+typedef struct {
+  // Request providing the default interval
+  WindowCreationRequest* request;
+  // Buffer receiving the monitors
+  DisplayInfo* displays;
+  // Size of the displays buffer
+  int capacity;
+  // Count of enumerated monitors, may exceed the capacity
+  int count;
+} MonitorEnumeration;
+
+/**
+ * Procedure called to iterate over monitors, adding each to the monitor enumeration
  * 
- * On failure it will return FALSE which stops the enumeration
+ * Monitors not fitting into the buffer are only counted, so the caller can retry with a larger buffer
 */
-BOOL CALLBACK CreateMonitorWindow(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor, LPARAM dwData) {
-  WindowCreationRequest* request = (WindowCreationRequest*)dwData;
-  // Fetch monitor info data
+BOOL CALLBACK CollectMonitor(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor, LPARAM dwData) {
+  MonitorEnumeration* enumeration = (MonitorEnumeration*)dwData;
   MONITORINFOEX mi;
   mi.cbSize = sizeof(MONITORINFOEX);
-  if (GetMonitorInfo(hMonitor, (LPMONITORINFO)&mi)) {
-    // Fetch displayFrequency from the monitor info data
-    DEVMODE dm;
-    dm.dmSize = sizeof(DEVMODE);
-    if (EnumDisplaySettings(mi.szDevice, ENUM_CURRENT_SETTINGS, &dm)) {
-      // Set interval to the display frequency to synchronize frames with movement updates
-      request->interval = 1000 / dm.dmDisplayFrequency;
-    }
+  // Monitor handles change when the displays are reconfigured, only the device name identifies a monitor
+  if (!GetMonitorInfo(hMonitor, (LPMONITORINFO)&mi)) return TRUE;
+
+  int index = enumeration->count++;
+  if (index >= enumeration->capacity) return TRUE;
+
+  DisplayInfo* display = &enumeration->displays[index];
+  display->key = DisplayKey(mi.szDevice);
+  display->rect = (SpriteBounds){ .left = lprcMonitor->left, .top = lprcMonitor->top, .right = lprcMonitor->right, .bottom = lprcMonitor->bottom };
+  display->interval = enumeration->request->interval;
+
+  // Fetch displayFrequency from the monitor info data
+  DEVMODE dm;
+  dm.dmSize = sizeof(DEVMODE);
+  // Frequencies of 0 and 1 indicate the hardware default, in this case the default interval is kept
+  if (EnumDisplaySettings(mi.szDevice, ENUM_CURRENT_SETTINGS, &dm) && dm.dmDisplayFrequency > 1) {
+    // Set interval to the display frequency to synchronize frames with movement updates
+    // The division is done in floating point, otherwise 60hz would be truncated to 16ms instead of 16.67ms
+    display->interval = 1000.0 / dm.dmDisplayFrequency;
+  }
+  return TRUE;
+}
+
+/**
+ * Enumerate procedure of the monitor display source, the context is the WindowCreationRequest
+ * 
+ * Returns the count of connected monitors or -1 if the monitors could not be enumerated
+*/
+int EnumerateMonitors(DisplayInfo* displays, int capacity, void* context) {
+  MonitorEnumeration enumeration = { .request = context, .displays = displays, .capacity = capacity, .count = 0 };
+  if (!EnumDisplayMonitors(NULL, NULL, CollectMonitor, (LPARAM)&enumeration)) return -1;
+  return enumeration.count;
+}
+
+/**
+ * Creates the world spanning the monitors connected at the start, with one shard per monitor
+ *
+ * The world holds image_count images per monitor. Returns NULL if the monitors can't be enumerated
+ * or the world can't be created, every monitor then shows its own scene
+*/
+SimulationWorld* CreateDesktopWorld(WindowCreationRequest* request) {
+  DisplayInfo displays[WORLD_MAX_SHARDS];
+  int count = EnumerateMonitors(displays, WORLD_MAX_SHARDS, request);
+  if (count < 1 || count > WORLD_MAX_SHARDS) return NULL;
+
+  SpriteBounds regions[WORLD_MAX_SHARDS];
+  for (int i = 0; i < count; i++) regions[i] = displays[i].rect;
+  SimulationConfig config = {
+    .movementSpeed = request->speed,
+    .bounceIncrement = request->bounce,
+    .bounceDecrementScale = request->bounceScale,
+    .stepRate = request->stepRate,
+    .seed = request->seed
   };
+  // The shards are simulated by the world loop and one helper per further logical processor (up to one per monitor)
+  return CreateSimulationWorld(regions, count, request->count * count, request->broadphase, config, -1);
+}
+
+/**
+ * Add procedure of the monitor display source, creating a windowState covering the monitor
+ * 
+ * On failure it will return NULL
+*/
+void* CreateMonitorWindow(const DisplayInfo* display, void* context) {
+  WindowCreationRequest* request = (WindowCreationRequest*)context;
+  RECT monitorRect = { .left = display->rect.left, .top = display->rect.top, .right = display->rect.right, .bottom = display->rect.bottom };
+
+  // Monitors of the world show their shard of it, monitors connected later (or a shard already shown by a window) get their own scene
+  int shard = request->world ? FindWorldShard(request->world, display->rect) : -1;
+  for (int i = 0; shard >= 0 && i < request->registry->count; i++) {
+    if (((WindowState*)request->registry->windows[i].window)->worldShard == shard) shard = -1;
+  }
 
   // Create the window state object using the hWindow=NULL option to create a new window 
-  // with the dimensions of the lprcMonitor
+  // with the dimensions of the monitorRect
   WindowState* windowState = CreateWindowState(
     request->hInstance,
     NULL,
     request->count,
     request->speed,
-    request->interval,
+    display->interval,
     request->bounce,
     request->bounceScale,
+    request->stepRate,
+    request->seed,
+    request->broadphase,
+    request->loadBudget,
+    request->spriteCache,
+    request->imageDirectory,
+    request->animation,
+    request->compositor,
+    shard >= 0 ? request->world : NULL,
+    shard,
     request->windowClass,
-    lprcMonitor,
+    &monitorRect,
     request->initCursorPos,
     request->cursorThreshold,
     request->relativeImageWidth,
     request->disableImageScale,
+    request->imageFilter,
+    request->imageAlpha,
     request->bitmap,
+    request->bitmapCount,
     request->backgroundColor,
     request->transparentColor
   );
-  if (!windowState) return FALSE;
+  if (!windowState) return NULL;
+  windowState->registry = request->registry;
+
+  // Run the WindowProcessLoop on the shared pacer
+  // The loop is stopped by the evenloop which will send a exit signal to stop the loop
+  if (!StartWindowLoop(request->pacer, windowState)) {
+    // Without loop no WM_EXIT is ever sent, so the window is destroyed directly
+    // It is not registered yet, so its WM_NCDESTROY leaves the event loop of the other windows running
+    DestroyWindowStateWindow(windowState);
+    return NULL;
+  }
 
-  // Hide cursor
+  // Hide cursor, only once the window runs so a failed window doesn't leave the cursor hidden
   ShowCursor(FALSE);
+  return windowState;
+}
 
-  // Create windowThread running the WindowProcessLoop
-  HANDLE windowThread = CreateThread(
-    NULL, // Default security attrs
-    0, // Default stack size
-    StartWindowLoop,
-    (LPVOID)windowState,
-    0, // Default creation flags
-    NULL // No need to acquire the thread identifier
+/**
+ * Move procedure of the monitor display source, fits the window to the new monitor rect
+ * 
+ * The window keeps its simulation and images, the simulation bounds follow the client rect
+ * and the back buffer is resized on the next paint. The shard of a world window follows the monitor,
+ * a monitor moved onto the region of another shard keeps its images on its own.
+*/
+void MoveMonitorWindow(void* window, const DisplayInfo* display, void* context) {
+  WindowState* windowState = (WindowState*)window;
+  if (!windowState->hwnd) return;
+  if (windowState->world) MoveWorldShard(windowState->world, windowState->worldShard, display->rect);
+  SetWindowPos(
+    windowState->hwnd, NULL,
+    display->rect.left, display->rect.top,
+    display->rect.right - display->rect.left, display->rect.bottom - display->rect.top,
+    SWP_NOZORDER | SWP_NOACTIVATE
   );
-  // Immediately close the window handle, this just removes the handle and does not interupt the thread (essentially detaching it)
-  // The thread is cleaned up automatically by the evenloop which will send a exit signal to stop the loop
-  if (windowThread!=NULL) {
-    CloseHandle(windowThread);
-    return TRUE;
-  }
-  else return FALSE;
+  // Repaint the whole window, the images only invalidate the rects they moved over
+  InvalidateRect(windowState->hwnd, NULL, FALSE);
+}
+
+/**
+ * Remove procedure of the display sources, closes the window loop which then initiates the cleanup of the window
+ *
+ * The images of a removed world monitor fly on on the remaining monitors, not when the screensaver exits
+*/
+void CloseMonitorWindow(void* window, void* context) {
+  WindowState* windowState = (WindowState*)window;
+  WindowCreationRequest* request = (WindowCreationRequest*)context;
+  if (windowState->world && !request->registry->shuttingDown) RemoveWorldShard(windowState->world, windowState->worldShard);
+  CallCloseWindowLoop(windowState);
+}
+
+/**
+ * Counts the consecutive bitmap resources starting at firstId (at least 1, so a missing bitmap fails on load)
+*/
+int CountBitmapResources(HINSTANCE hInstance, int firstId) {
+  int count = 1;
+  while (count < MAX_LOGOBITMAPS && FindResource(hInstance, MAKEINTRESOURCE(firstId + count), RT_BITMAP)) count++;
+  return count;
 }
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
@@ -219,29 +410,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
   if (!RegisterClass(&wc)) return FALSE;
 
-  // Seed random with time
-  srand(time(NULL));
-
-  // Initial cursor point
-  POINT initCursorPos = { .x = 0, .y = 0 };
-
-  // Create window creation request
-  WindowCreationRequest windowCreationRequest = {
-    .hInstance = hInstance,
-    .windowClass = L"ScreenSaverWindow",
-    .initCursorPos = &initCursorPos,
-    .cursorThreshold = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"cursor_threshold", REG_SZ, 20),
-    .count = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"image_count", REG_SZ, 2),
-    .relativeImageWidth = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"image_width", REG_SZ, 0.2),
-    .disableImageScale = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"disable_image_scale", REG_DWORD, FALSE),
-    .interval = 1000 / 60, // Default to 60hz
-    .speed = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"image_speed", REG_SZ, 1),
-    .bounce = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"image_bounce", REG_SZ, 10),
-    .bounceScale = getRegDouble(HKEY_CURRENT_USER, L"Software\\screensaver", L"image_bounce_scale", REG_SZ, 0.01),
-    .bitmap = IDB_LOGOBITMAP,
-    .backgroundColor = BACKGROUND_COLOR,
-    .transparentColor = IDB_LOGOBITMAP_TRANSPARENT_COLOR
-  };
+  // Record the frame stages if a trace file is requested through the environment
+  if (StartTracingFromEnvironment()) SetTraceThreadName("ui");
 
   // True if the app should display settings
   BOOL displaySettings = FALSE;
@@ -255,11 +425,99 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
   if (displaySettings) {
     return FALSE;
   }
+  // The preview only fills the thumbnail of the control panel, it runs in the low-power profile
+  BOOL preview = !displayFull && hPreviewWindow;
+
+  // Initial cursor point
+  POINT initCursorPos = { .x = 0, .y = 0 };
+
+  // Create the pacer driving the window loops of all monitors with one clock and one worker per logical processor
+  // The preview loop runs on a single worker and the clock sleeps up to every deadline instead of spinning
+  FramePacer* pacer = preview ? CreateFramePacer(1, FALSE) : CreateFramePacer(0, TRUE);
+  if (!pacer) return FALSE;
+
+  // Create the cache sharing identical scaled images between all images and monitors
+  SpriteCache* spriteCache = CreateSpriteCache();
+  if (!spriteCache) return FALSE;
+
+  // Create the compositor with one helper per further logical processor, the ui thread renders tiles as well
+  // The tiny back buffer of the preview is composed on the ui thread alone
+  TileCompositor* compositor = CreateTileCompositor(preview ? 0 : -1);
+  if (!compositor) return FALSE;
+
+  // Create the atlas holding the pixels of all distinct images, so the compositor reads them from one buffer
+  SpriteAtlas* atlas = CreateSpriteAtlas(ATLAS_DEFAULT_SIZE, ATLAS_DEFAULT_SIZE);
+  if (!atlas) return FALSE;
+  spriteCache->atlas = atlas;
+
+  // Open the animation if one is requested through the environment, its frames are decoded while it plays
+  // The preview shows the still images, decoding full sized frames for a thumbnail isn't worth a decoder thread
+  SpriteAnimation* animation = preview ? NULL : OpenSpriteAnimationFromEnvironment();
+
+  // Load all settings in one pass (or from the binary cache while registry and settings file are unchanged)
+  Settings settings;
+  LoadSettings(&settings);
+
+  // Load the images from the configured directory (if it has any bmp file), otherwise the embedded bitmaps are shown
+  BmpDirectory* imageDirectory = settings.imageDirectory[0] ? OpenBmpDirectory(settings.imageDirectory) : NULL;
+
+  // Create window creation request
+  WindowCreationRequest windowCreationRequest = {
+    .hInstance = hInstance,
+    .windowClass = L"ScreenSaverWindow",
+    .pacer = pacer,
+    .spriteCache = spriteCache,
+    .imageDirectory = imageDirectory,
+    .animation = animation,
+    .compositor = compositor,
+    .initCursorPos = &initCursorPos,
+    .cursorThreshold = settings.cursorThreshold,
+    .count = settings.imageCount,
+    .relativeImageWidth = settings.imageWidth,
+    .disableImageScale = settings.disableImageScale,
+    .imageFilter = settings.imageFilter,
+    .imageAlpha = settings.imageAlpha,
+    .interval = 1000.0 / 60, // Default to 60hz
+    .speed = settings.imageSpeed,
+    .bounce = settings.imageBounce,
+    .bounceScale = settings.imageBounceScale,
+    .stepRate = settings.simulationRate,
+    .seed = settings.simulationSeed,
+    .broadphase = settings.collisionGrid ? BROADPHASE_GRID : BROADPHASE_SWEEP,
+    .loadBudget = settings.loadBudget,
+    // The files of the image directory are numbered from 0 on
+    .bitmap = imageDirectory ? 0 : IDB_LOGOBITMAP,
+    .bitmapCount = imageDirectory ? imageDirectory->count : CountBitmapResources(hInstance, IDB_LOGOBITMAP),
+    .backgroundColor = BACKGROUND_COLOR,
+    .transparentColor = IDB_LOGOBITMAP_TRANSPARENT_COLOR
+  };
+
+  // A seed of 0 picks a new scene on every start, recordings keep the seed that was used
+  if (windowCreationRequest.seed == 0) windowCreationRequest.seed = (uint64_t)time(NULL);
+
+  if (preview) ApplyPreviewProfile(&windowCreationRequest);
+
+  // With span_desktop all monitors of the start share one world, the images fly from one monitor onto the next
+  SimulationWorld* world = displayFull && settings.spanDesktop ? CreateDesktopWorld(&windowCreationRequest) : NULL;
+  windowCreationRequest.world = world;
+
+  // Monitors are only tracked in fullscreen mode, the preview window stays on its parent
+  DisplaySource displaySource = {
+    .enumerate = displayFull ? EnumerateMonitors : NULL,
+    .add = CreateMonitorWindow,
+    .move = MoveMonitorWindow,
+    .remove = CloseMonitorWindow,
+    .context = &windowCreationRequest
+  };
+  // Create the registry tracking all windows, on display changes it adds and removes single monitor windows
+  WindowRegistry* registry = CreateWindowRegistry(&displaySource);
+  if (!registry) return FALSE;
+  windowCreationRequest.registry = registry;
 
   // If display Full is set, create a handle on every monitor
   if (displayFull) {
     // Iterate over all monitors and create a ScreenSaver window for them
-    if (!EnumDisplayMonitors(NULL, NULL, CreateMonitorWindow, (LPARAM)&windowCreationRequest)) return FALSE;
+    if (RefreshWindowRegistry(registry) < 0 || registry->count == 0) return FALSE;
   } else if (hPreviewWindow) {
     // Create a ScreenSaver window from the provided window handle
     if (!CreatePreviewWindow(hPreviewWindow, &windowCreationRequest)) return FALSE;
@@ -278,5 +536,16 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
   // If preview window was used, close its handle
   if (hPreviewWindow) CloseHandle(hPreviewWindow);
 
+  // All window loops have exited at this point, so the pacer can be stopped and the recorded frames written
+  CloseFramePacer(pacer);
+  CloseSimulationWorld(world);
+  CloseSpriteCache(spriteCache);
+  CloseSpriteAtlas(atlas);
+  CloseSpriteAnimation(animation);
+  CloseBmpDirectory(imageDirectory);
+  CloseTileCompositor(compositor);
+  CloseWindowRegistry(registry);
+  StopTracing();
+
   return msg.wParam;
 }
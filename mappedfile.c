@@ -0,0 +1,109 @@
+#include "mappedfile.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Platform handles of the mapping
+*/
+typedef struct {
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int descriptor;
+#endif
+} MappedPlatform;
+
+/**
+ * Maps the file at path (utf-8) read-only
+ *
+ * If the file can't be opened, is empty or can't be mapped it returns NULL
+*/
+MappedFile* OpenMappedFile(const char* path) {
+  MappedFile* file = calloc(1, sizeof(MappedFile));
+  MappedPlatform* platform = calloc(1, sizeof(MappedPlatform));
+  if (!file || !platform) {
+    free(file);
+    free(platform);
+    return NULL;
+  }
+  file->platform = platform;
+
+#ifdef _WIN32
+  platform->file = INVALID_HANDLE_VALUE;
+  wchar_t widePath[MAX_PATH];
+  if (MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath, MAX_PATH)) {
+    platform->file = CreateFileW(widePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  }
+  LARGE_INTEGER size;
+  if (platform->file != INVALID_HANDLE_VALUE && GetFileSizeEx(platform->file, &size) && size.QuadPart > 0 &&
+      (unsigned long long)size.QuadPart <= SIZE_MAX) {
+    file->size = (size_t)size.QuadPart;
+    platform->mapping = CreateFileMappingA(platform->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (platform->mapping) file->data = MapViewOfFile(platform->mapping, FILE_MAP_READ, 0, 0, 0);
+  }
+#else
+  platform->descriptor = open(path, O_RDONLY);
+  struct stat status;
+  if (platform->descriptor >= 0 && fstat(platform->descriptor, &status) == 0 && status.st_size > 0) {
+    file->size = (size_t)status.st_size;
+    void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, platform->descriptor, 0);
+    if (data != MAP_FAILED) file->data = data;
+  }
+#endif
+
+  if (!file->data) {
+    CloseMappedFile(file);
+    return NULL;
+  }
+  return file;
+}
+
+/**
+ * Unmaps the file, pointers into the data are invalid afterwards
+*/
+void CloseMappedFile(MappedFile* file) {
+  if (!file) return;
+  MappedPlatform* platform = file->platform;
+#ifdef _WIN32
+  if (file->data) UnmapViewOfFile(file->data);
+  if (platform->mapping) CloseHandle(platform->mapping);
+  if (platform->file != INVALID_HANDLE_VALUE) CloseHandle(platform->file);
+#else
+  if (file->data) munmap((void*)file->data, file->size);
+  if (platform->descriptor >= 0) close(platform->descriptor);
+#endif
+  free(platform);
+  free(file);
+}
+
+/**
+ * Removes the pages of the range from the resident set of the process (the data stays mapped and readable)
+ *
+ * Used after a range was consumed, so reading a large file once doesn't grow the resident set by the whole file.
+*/
+void ReleaseMappedRange(const MappedFile* file, size_t offset, size_t size) {
+  if (offset >= file->size) return;
+  if (size > file->size - offset) size = file->size - offset;
+
+#ifdef _WIN32
+  // Unlocking pages that are not locked removes them from the working set, the call reports an error that is expected
+  VirtualUnlock((void*)(file->data + offset), size);
+#else
+  // Only whole pages inside the range are released, pages shared with the neighbouring ranges stay resident
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)file->data + offset + page - 1) / page * page;
+  uintptr_t end = ((uintptr_t)file->data + offset + size) / page * page;
+  if (end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+#endif
+}
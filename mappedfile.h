@@ -0,0 +1,40 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+/**
+ * Read-only memory mapping of a whole file
+ *
+ * Pages are only read from disk when they are touched, so large files cost no memory until they are used.
+ * Touched pages are clean file pages, the system can drop them at any time (or explicitly with ReleaseMappedRange()).
+*/
+typedef struct {
+  // First byte of the file
+  const unsigned char* data;
+  // Size of the file in bytes
+  size_t size;
+  // Platform handles of the mapping
+  void* platform;
+} MappedFile;
+
+/**
+ * Maps the file at path (utf-8) read-only
+ *
+ * If the file can't be opened, is empty or can't be mapped it returns NULL
+*/
+MappedFile* OpenMappedFile(const char* path);
+
+/**
+ * Unmaps the file, pointers into the data are invalid afterwards
+*/
+void CloseMappedFile(MappedFile* file);
+
+/**
+ * Removes the pages of the range from the resident set of the process (the data stays mapped and readable)
+ *
+ * Used after a range was consumed, so reading a large file once doesn't grow the resident set by the whole file.
+*/
+void ReleaseMappedRange(const MappedFile* file, size_t offset, size_t size);
+
+#endif
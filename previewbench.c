@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "framepacer.h"
+#include "simulation.h"
+#include "framesnapshot.h"
+#include "dirtyregion.h"
+#include "tilecompositor.h"
+#include "frametrace.h"
+
+// Size of the control panel preview window
+#define PREVIEW_WIDTH 152
+#define PREVIEW_HEIGHT 112
+// Preview profile of the screensaver (see ApplyPreviewProfile() in main.c)
+#define PREVIEW_INTERVAL (1000.0 / 15)
+#define PREVIEW_MAX_IMAGES 4
+#define PREVIEW_STEP_RATE 15.0
+// Maximum count of dirty rects per frame, the same limit the windows use
+#define BENCH_DIRTY_RECTS 32
+
+/**
+ * Pacing and window configuration of one benchmarked mode
+*/
+typedef struct {
+  // Name printed with the results
+  const char* name;
+  // Size of the window and the back buffer in pixels
+  int width;
+  int height;
+  // Count of images
+  int images;
+  // Tick interval of the window loop in ms and simulation steps per second
+  double interval;
+  double stepRate;
+  // Workers of the pacer (<= 0 one per logical processor), spin tail of the pacer clock and compositor helpers
+  int workers;
+  int spin;
+  int helpers;
+} BenchProfile;
+
+/**
+ * Window emulated by the benchmark: the window loop and the paint of the ui thread run in one pacer step
+*/
+typedef struct {
+  Simulation* simulation;
+  SnapshotBuffer* snapshots;
+  SpriteSnapshot* painted;
+  DirtyRegion* dirty;
+  TileCompositor* compositor;
+  PixelBuffer target;
+  const CompiledSprite* sprite;
+  // Tick interval in ms, time of the last step in ms (0 before the first one) and time the loop stops at
+  double interval;
+  double lastAdvance;
+  double end;
+  // Sum of the deviations of the step distances from the interval in ms
+  double jitter;
+  // Count of presented frames
+  long long frames;
+  // Set by the finish function of the pacer task
+  volatile long finished;
+} BenchWindow;
+
+/**
+ * Returns the cpu time of all threads of the process in ms
+*/
+static double processTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Compiles a colour keyed disc of size x size pixels, the sprite is already at its final size like the cached sprites
+*/
+static CompiledSprite* createDisc(int size) {
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)size * size);
+  if (!pixels) return NULL;
+  int radius = size / 2;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int dx = x - radius, dy = y - radius;
+      pixels[y * size + x] = dx * dx + dy * dy > radius * radius ? 0xFFFFFFu : 0xFF000000u | (uint32_t)(255 * x / size) << 16 | (uint32_t)(255 * y / size);
+    }
+  }
+  CompiledSprite* sprite = CompileSprite(pixels, size, size, size, 0xFFFFFFu);
+  free(pixels);
+  return sprite;
+}
+
+/**
+ * One tick of the emulated window: advance and publish like the window loop, then compose the dirty rects like the painter
+*/
+static int stepWindow(void* context) {
+  BenchWindow* window = context;
+  double now = FrameSchedulerNow();
+  if (now >= window->end) return 0;
+
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = window->target.width, .bottom = window->target.height };
+  double elapsed = window->lastAdvance > 0.0 ? now - window->lastAdvance : 0.0;
+  if (window->lastAdvance > 0.0) window->jitter += fabs(elapsed - window->interval);
+  window->lastAdvance = now;
+  int alpha = AdvanceSimulation(window->simulation, bounds, elapsed);
+  double postStart = FrameSchedulerNow();
+  PublishSnapshot(window->snapshots, window->simulation->sprites, alpha, ++window->frames);
+  double paintStart = FrameSchedulerNow();
+  RecordTrace(TRACE_POST_INVALIDATE, window->simulation->id, window->frames, postStart, paintStart);
+
+  const SpriteSnapshot* snapshot = AcquireSnapshot(window->snapshots);
+  ClearDirtyRegion(window->dirty);
+  AddSnapshotRects(window->dirty, window->painted);
+  AddSnapshotRects(window->dirty, snapshot);
+  MergeDirtyRegion(window->dirty, BENCH_DIRTY_RECTS);
+  BeginComposition(window->compositor, &window->target, 0x222831);
+  for (int i = 0; i < snapshot->count; i++) AddCompositorSprite(window->compositor, window->sprite, snapshot->xPos[i], snapshot->yPos[i]);
+  for (int i = 0; i < window->dirty->count; i++) AddCompositorRect(window->compositor, window->dirty->rects[i]);
+  double blitStart = FrameSchedulerNow();
+  ComposeTiles(window->compositor);
+  double blitEnd = FrameSchedulerNow();
+  CopySnapshot(window->painted, snapshot);
+  // The composition of all dirty rects is traced as one blit, like a repaint of the window
+  RecordTrace(TRACE_BLIT, window->simulation->id, snapshot->frame, blitStart, blitEnd);
+  RecordTrace(TRACE_PAINT, window->simulation->id, snapshot->frame, paintStart, FrameSchedulerNow());
+  return 1;
+}
+
+/**
+ * Marks the emulated window as finished (executed on the pacer thread)
+*/
+static void finishWindow(void* context) {
+  BenchWindow* window = context;
+  __atomic_store_n(&window->finished, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Runs the profile for seconds and returns the cpu time of the process per second of wall time in ms (< 0 on failure)
+*/
+static double runProfile(const BenchProfile* profile, int id, double relativeImageWidth, double seconds) {
+  int size = (int)(relativeImageWidth * profile->width);
+  if (size < 1) size = 1;
+  SimulationConfig config = { .movementSpeed = 2.0, .bounceIncrement = 10, .bounceDecrementScale = 1.0, .stepRate = profile->stepRate, .seed = 1 };
+  BenchWindow window = {
+    .simulation = CreateSimulation(profile->images, BROADPHASE_SWEEP, config),
+    .snapshots = CreateSnapshotBuffer(profile->images),
+    .painted = CreateSpriteSnapshot(profile->images),
+    .dirty = CreateDirtyRegion(BENCH_DIRTY_RECTS * 4),
+    .compositor = CreateTileCompositor(profile->helpers),
+    .target = { .pixels = malloc(sizeof(uint32_t) * (size_t)profile->width * profile->height), .width = profile->width, .height = profile->height, .stride = profile->width },
+    .sprite = createDisc(size),
+    .interval = profile->interval
+  };
+  if (!window.simulation || !window.snapshots || !window.painted || !window.dirty || !window.compositor || !window.target.pixels || !window.sprite) return -1.0;
+  // The modes show up as windows of the trace
+  window.simulation->id = id;
+  SpriteBounds spawnBounds = { .left = 0, .top = 0, .right = profile->width, .bottom = profile->height };
+  for (int i = 0; i < profile->images; i++) SpawnSprite(window.simulation, spawnBounds, size, size);
+
+  // The cpu time covers the whole pacer (clock, workers and compositor helpers), like the screensaver process
+  double cpuStart = processTime();
+  double start = FrameSchedulerNow();
+  window.end = start + seconds * 1000.0;
+  FramePacer* pacer = CreateFramePacer(profile->workers, profile->spin);
+  if (!pacer || !AddPacedTask(pacer, profile->interval, stepWindow, finishWindow, &window)) return -1.0;
+  while (!__atomic_load_n(&window.finished, __ATOMIC_ACQUIRE)) usleep(100000);
+  double wall = FrameSchedulerNow() - start;
+  CloseFramePacer(pacer);
+  double cpu = (processTime() - cpuStart) / (wall / 1000.0);
+
+  printf("%-8s %4dx%-4d %3d images of %3d px, %5.1f hz, %s: %lld frames, tick jitter %.3f ms, cpu %.1f ms/s\n",
+    profile->name, profile->width, profile->height, profile->images, size, 1000.0 / profile->interval,
+    profile->spin ? "spin" : "sleep", window.frames, window.frames > 1 ? window.jitter / (window.frames - 1) : 0.0, cpu);
+
+  CloseSimulation(window.simulation);
+  CloseSnapshotBuffer(window.snapshots);
+  CloseSpriteSnapshot(window.painted);
+  CloseDirtyRegion(window.dirty);
+  CloseTileCompositor(window.compositor);
+  CloseCompiledSprite((CompiledSprite*)window.sprite);
+  free(window.target.pixels);
+  return cpu;
+}
+
+/**
+ * Benchmark of the low-power preview against the fullscreen window loop (linux only, the process cpu time is read)
+ *
+ * Not part of the screensaver build, it only needs the platform neutral pacing, simulation and compositing modules:
+ * cc -O2 -o previewbench previewbench.c framepacer.c framescheduler.c workerpool.c frametrace.c simulation.c simulationrecord.c spritestore.c broadphase.c randomgenerator.c framesnapshot.c dirtyregion.c tilecompositor.c spriteblit.c -lm -lpthread
+ * ./previewbench [width] [height] [images] [image width] [seconds]
+ * SCREENSAVER_TRACE=previewbench.json ./previewbench
+ *
+ * Both modes emulate one window (simulation, snapshot, dirty rects and composition of the back buffer):
+ * the fullscreen mode at 60hz on a spinning pacer with all workers and compositor helpers, the preview
+ * with the profile of main.c on a sleeping single worker pacer. Prints the cpu time per second of both
+ * and the share of the preview. Exits with 1 if a mode could not be set up.
+ * If SCREENSAVER_TRACE is set, the stages of all modes (windows 0 - 2) are written to it as chrome trace json.
+*/
+int main(int argc, char** argv) {
+  int width = argc > 1 ? atoi(argv[1]) : 1920;
+  int height = argc > 2 ? atoi(argv[2]) : 1080;
+  int images = argc > 3 ? atoi(argv[3]) : 20;
+  double imageWidth = argc > 4 ? atof(argv[4]) : 0.2;
+  double seconds = argc > 5 ? atof(argv[5]) : 5.0;
+  if (width < 1 || height < 1 || images < 1 || imageWidth <= 0.0 || imageWidth > 1.0 || seconds <= 0.0) {
+    fprintf(stderr, "usage: %s [width] [height] [images] [image width] [seconds]\n", argv[0]);
+    return 1;
+  }
+
+  BenchProfile full = {
+    .name = "full", .width = width, .height = height, .images = images,
+    .interval = 1000.0 / 60, .stepRate = 30.0, .workers = 0, .spin = 1, .helpers = -1
+  };
+  BenchProfile preview = {
+    .name = "preview", .width = PREVIEW_WIDTH, .height = PREVIEW_HEIGHT, .images = images < PREVIEW_MAX_IMAGES ? images : PREVIEW_MAX_IMAGES,
+    .interval = PREVIEW_INTERVAL, .stepRate = PREVIEW_STEP_RATE, .workers = 1, .spin = 0, .helpers = 0
+  };
+  // The full size loop at the preview size, separating the cost of the pacing from the cost of the pixels
+  BenchProfile thumbnail = full;
+  thumbnail.name = "thumb";
+  thumbnail.width = PREVIEW_WIDTH;
+  thumbnail.height = PREVIEW_HEIGHT;
+
+  if (StartTracingFromEnvironment()) SetTraceThreadName("bench");
+  double fullCost = runProfile(&full, 0, imageWidth, seconds);
+  double thumbnailCost = runProfile(&thumbnail, 1, imageWidth, seconds);
+  double previewCost = runProfile(&preview, 2, imageWidth, seconds);
+  // The pacers are closed, no thread records anymore
+  if (TracingEnabled() && !StopTracing()) fprintf(stderr, "the trace could not be written\n");
+  if (fullCost < 0.0 || thumbnailCost < 0.0 || previewCost < 0.0) return 1;
+  printf("preview costs %.1f%% of the fullscreen loop and %.1f%% of the fullscreen loop at preview size\n",
+    fullCost > 0.0 ? previewCost / fullCost * 100.0 : 0.0, thumbnailCost > 0.0 ? previewCost / thumbnailCost * 100.0 : 0.0);
+  return 0;
+}
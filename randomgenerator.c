@@ -0,0 +1,54 @@
+#include "randomgenerator.h"
+
+/**
+ * Rotates the bits of x left by k
+*/
+static inline uint64_t rotateLeft(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Advances the splitmix64 state and returns its next output
+*/
+static uint64_t splitMix(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+/**
+ * Initializes the generator from a 64 bit seed
+ *
+ * The seed is expanded with splitmix64, so also small or similar seeds give unrelated sequences
+*/
+void SeedRandomGenerator(RandomGenerator* generator, uint64_t seed) {
+  // splitmix64 never outputs four zeros in a row, so the state is always valid
+  for (int i = 0; i < 4; i++) generator->state[i] = splitMix(&seed);
+}
+
+/**
+ * Returns the next 64 random bits
+*/
+uint64_t NextRandom(RandomGenerator* generator) {
+  uint64_t* s = generator->state;
+  uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotateLeft(s[3], 45);
+  return result;
+}
+
+/**
+ * Returns a random integer in range [0, bound) (0 if bound is not positive)
+*/
+int RandomBelow(RandomGenerator* generator, int bound) {
+  if (bound <= 0) return 0;
+  // Multiply the upper 32 bits into the range instead of a modulo, the bias is negligible for screen sized bounds
+  return (int)(((NextRandom(generator) >> 32) * (uint64_t)bound) >> 32);
+}
@@ -0,0 +1,34 @@
+#ifndef RANDOMGENERATOR_H
+#define RANDOMGENERATOR_H
+
+#include <stdint.h>
+
+/**
+ * Seedable pseudo random generator (xoshiro256**)
+ *
+ * Every simulation owns its own generator, so windows never share hidden global state (like rand())
+ * and the same seed always produces the same sequence on every platform and thread.
+*/
+typedef struct {
+  // Generator state, never all zero
+  uint64_t state[4];
+} RandomGenerator;
+
+/**
+ * Initializes the generator from a 64 bit seed
+ *
+ * The seed is expanded with splitmix64, so also small or similar seeds give unrelated sequences
+*/
+void SeedRandomGenerator(RandomGenerator* generator, uint64_t seed);
+
+/**
+ * Returns the next 64 random bits
+*/
+uint64_t NextRandom(RandomGenerator* generator);
+
+/**
+ * Returns a random integer in range [0, bound) (0 if bound is not positive)
+*/
+int RandomBelow(RandomGenerator* generator, int bound);
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulation.h"
+#include "framesnapshot.h"
+
+// Presented frame rates compared, the checkpoints fall on a frame of every rate
+static const int benchRates[] = { 60, 144, 240 };
+#define BENCH_RATE_COUNT 3
+// Checkpoints per second the presented positions are compared at (divides every rate)
+#define BENCH_CHECKPOINT_RATE 12
+
+/**
+ * Creates a simulation and spawns count sprites into the fake window rect, returns NULL on failure
+*/
+static Simulation* createScene(int count, SimulationConfig config, SpriteBounds bounds) {
+  Simulation* simulation = CreateSimulation(count, BROADPHASE_SWEEP, config);
+  if (!simulation) return NULL;
+  for (int i = 0; i < count; i++) {
+    if (SpawnSprite(simulation, bounds, 32 + i % 3 * 16, 32 + i % 3 * 16) < 0) {
+      CloseSimulation(simulation);
+      return NULL;
+    }
+  }
+  return simulation;
+}
+
+/**
+ * Returns 1 if both stores hold bit-identical sprite states (including the positions before the last step)
+*/
+static int sameState(const SpriteStore* a, const SpriteStore* b) {
+  size_t size = sizeof(int) * a->count;
+  return a->count == b->count &&
+    memcmp(a->xPos, b->xPos, size) == 0 && memcmp(a->yPos, b->yPos, size) == 0 &&
+    memcmp(a->prevX, b->prevX, size) == 0 && memcmp(a->prevY, b->prevY, size) == 0 &&
+    memcmp(a->xMov, b->xMov, size) == 0 && memcmp(a->yMov, b->yMov, size) == 0 &&
+    memcmp(a->inc, b->inc, size) == 0 && memcmp(a->decSteps, b->decSteps, size) == 0;
+}
+
+/**
+ * Presents the scene at the frame rate for the given seconds through AdvanceSimulation and writes the presented
+ * pixel positions of every checkpoint into positions (x and y per sprite), returns the simulation or NULL on failure
+*/
+static Simulation* presentScene(int count, int rate, int seconds, SimulationConfig config, SpriteBounds bounds, int* positions) {
+  Simulation* simulation = createScene(count, config, bounds);
+  if (!simulation) return NULL;
+  double period = 1000.0 / rate;
+  int checkpointFrames = rate / BENCH_CHECKPOINT_RATE;
+  for (int frame = 1; frame <= rate * seconds; frame++) {
+    int alpha = AdvanceSimulation(simulation, bounds, period);
+    if (frame % checkpointFrames != 0) continue;
+
+    int* checkpoint = positions + (frame / checkpointFrames - 1) * count * 2;
+    const SpriteStore* sprites = simulation->sprites;
+    for (int i = 0; i < count; i++) {
+      checkpoint[i * 2] = InterpolateSpritePosition(sprites->prevX[i], sprites->xPos[i], alpha);
+      checkpoint[i * 2 + 1] = InterpolateSpritePosition(sprites->prevY[i], sprites->yPos[i], alpha);
+    }
+  }
+  return simulation;
+}
+
+/**
+ * Headless check of the fixed step simulation across presented frame rates
+ *
+ * Not part of the screensaver build, it only needs the platform neutral simulation modules:
+ * cc -O2 -o ratebench ratebench.c simulation.c simulationrecord.c spritestore.c broadphase.c randomgenerator.c framesnapshot.c dirtyregion.c framescheduler.c frametrace.c -lm -lpthread
+ * ./ratebench [sprites] [seconds] [step rate]
+ *
+ * Presents the same seeded scene at 60, 144 and 240hz through AdvanceSimulation. Every run must end in exactly
+ * the state of a plain StepSimulation run with the same count of steps, the step counts must match the elapsed
+ * time and the interpolated positions presented at the common frames (12 per second) must not differ by more
+ * than one pixel between the rates. Exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 200;
+  int seconds = argc > 2 ? atoi(argv[2]) : 20;
+  double stepRate = argc > 3 ? atof(argv[3]) : 30.0;
+  if (count < 1 || seconds < 1 || stepRate <= 0.0 || stepRate > BENCH_CHECKPOINT_RATE * SIMULATION_MAX_STEPS) {
+    fprintf(stderr, "usage: %s [sprites] [seconds] [step rate (0 - %d)]\n", argv[0], BENCH_CHECKPOINT_RATE * SIMULATION_MAX_STEPS);
+    return 1;
+  }
+
+  SimulationConfig config = { .movementSpeed = 6.0, .bounceIncrement = 10, .bounceDecrementScale = 1.0, .stepRate = stepRate, .seed = 14 };
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = 1920, .bottom = 1080 };
+  int checkpoints = seconds * BENCH_CHECKPOINT_RATE;
+  int* positions[BENCH_RATE_COUNT];
+  for (int r = 0; r < BENCH_RATE_COUNT; r++) {
+    positions[r] = malloc(sizeof(int) * checkpoints * count * 2);
+    if (!positions[r]) return 1;
+  }
+
+  int failed = 0;
+  long long expectedSteps = (long long)(seconds * stepRate);
+  for (int r = 0; r < BENCH_RATE_COUNT; r++) {
+    Simulation* presented = presentScene(count, benchRates[r], seconds, config, bounds, positions[r]);
+    Simulation* stepped = createScene(count, config, bounds);
+    if (!presented || !stepped) {
+      fprintf(stderr, "the simulation could not be created\n");
+      return 1;
+    }
+    long long steps = presented->stats.frames;
+    for (long long s = 0; s < steps; s++) StepSimulation(stepped, bounds);
+    int identical = sameState(presented->sprites, stepped->sprites);
+
+    // The presented positions of every rate are compared to the ones presented at the first rate
+    int deviation = 0;
+    for (int c = 0; c < checkpoints * count * 2; c++) {
+      int difference = abs(positions[r][c] - positions[0][c]);
+      if (difference > deviation) deviation = difference;
+    }
+    // The accumulated frame periods may round the last step to either side of the elapsed time
+    int stepsOk = steps >= expectedSteps - 1 && steps <= expectedSteps;
+    if (!identical || !stepsOk || deviation > 1) failed = 1;
+
+    printf("%3dhz: %5d frames, %5lld steps (%lld expected), max deviation from %dhz %d px, %s%s\n",
+      benchRates[r], benchRates[r] * seconds, steps, expectedSteps, benchRates[0], deviation,
+      identical ? "identical to StepSimulation" : "DIVERGED from StepSimulation", stepsOk && deviation <= 1 ? "" : ", FAILED");
+    CloseSimulation(presented);
+    CloseSimulation(stepped);
+  }
+
+  for (int r = 0; r < BENCH_RATE_COUNT; r++) free(positions[r]);
+  printf("%d sprites, %d s at %.0f steps per second: %s\n", count, seconds, stepRate,
+    failed ? "FAILED" : "same trajectory at every frame rate");
+  return failed;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulationrecord.h"
+
+// Size of the chunk ending a complete recording (tag, step count and checksum)
+#define BENCH_END_CHUNK_SIZE 17
+// Offset of the first sprite state in a recording (behind the config and the sprite count)
+#define BENCH_FIRST_SPRITE_OFFSET 52
+
+/**
+ * Spawns the scene, records steps with changing bounds, active counts and collision dividers into the file
+ * and returns the live simulation
+ *
+ * The simulation is still recording, its final state is the one the recording has to reproduce
+*/
+static Simulation* recordScene(const char* path, int sprites, int steps, double speed, BroadphaseKind kind, uint64_t seed) {
+  SimulationConfig config = { .movementSpeed = speed, .bounceIncrement = 10, .bounceDecrementScale = 0.01, .stepRate = 30.0, .seed = seed };
+  Simulation* simulation = CreateSimulation(sprites, kind, config);
+  if (!simulation) return NULL;
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = 1920, .bottom = 1080 };
+  for (int i = 0; i < sprites; i++) SpawnSprite(simulation, bounds, 32 + i % 5 * 16, 32 + i % 3 * 16);
+  // Some sprites are parked before the recording starts, the recording has to park them right away
+  SetActiveSprites(simulation, sprites - sprites / 4);
+  // A step into a skipping collision divider leaves its count to the next pass halfway, the recording restarts it
+  SetCollisionDivider(simulation, 2);
+  StepSimulation(simulation, bounds);
+  if (!StartSimulationRecording(simulation, path)) {
+    CloseSimulation(simulation);
+    return NULL;
+  }
+
+  for (int step = 0; step < steps; step++) {
+    // Resizes (like a display change) and load governor changes of the active count and the collision passes
+    if (step % 97 == 0) bounds.right = 1280 + step % 640, bounds.bottom = 720 + step % 360;
+    if (step % 131 == 0) SetActiveSprites(simulation, 1 + step % sprites);
+    if (step % 173 == 0) SetCollisionDivider(simulation, 1 << (step / 173 % 3));
+    StepSimulation(simulation, bounds);
+  }
+  return simulation;
+}
+
+/**
+ * Returns 1 if both simulations hold exactly the same sprite state (active and parked sprites)
+*/
+static int sameState(const Simulation* a, const Simulation* b) {
+  const SpriteStore* x = a->sprites;
+  const SpriteStore* y = b->sprites;
+  if (x->count != y->count || x->total != y->total) return 0;
+  size_t size = sizeof(int) * x->total;
+  return memcmp(x->xPos, y->xPos, size) == 0 && memcmp(x->yPos, y->yPos, size) == 0 &&
+    memcmp(x->prevX, y->prevX, size) == 0 && memcmp(x->prevY, y->prevY, size) == 0 &&
+    memcmp(x->xMov, y->xMov, size) == 0 && memcmp(x->yMov, y->yMov, size) == 0 &&
+    memcmp(x->inc, y->inc, size) == 0 && memcmp(x->decSteps, y->decSteps, size) == 0 &&
+    memcmp(x->width, y->width, size) == 0 && memcmp(x->height, y->height, size) == 0;
+}
+
+/**
+ * Reads the whole file, returns NULL on failure
+*/
+static unsigned char* readFile(const char* path, long* size) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return NULL;
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  unsigned char* data = malloc(*size > 0 ? *size : 1);
+  if (data && fread(data, 1, *size, file) != (size_t)*size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  return data;
+}
+
+/**
+ * Writes size bytes of data into the file, returns 0 on failure
+*/
+static int writeFile(const char* path, const unsigned char* data, long size) {
+  FILE* file = fopen(path, "wb");
+  if (!file) return 0;
+  int ok = fwrite(data, 1, size, file) == (size_t)size;
+  return fclose(file) == 0 && ok;
+}
+
+/**
+ * Records a scene, replays it twice and checks the replays against the live simulation, returns 0 if a check failed
+ *
+ * Also checks that recording the same seed again writes the same bytes, that a truncated recording replays
+ * as incomplete and that a modified initial state is detected.
+*/
+static int checkScene(const char* path, int sprites, int steps, double speed, BroadphaseKind kind) {
+  const char* name = kind == BROADPHASE_GRID ? "grid" : "sweep";
+  Simulation* live = recordScene(path, sprites, steps, speed, kind, 16);
+  if (!live) {
+    fprintf(stderr, "%s: %s could not be recorded\n", name, path);
+    return 0;
+  }
+  uint64_t checksum = SimulationChecksum(live);
+  StopSimulationRecording(live);
+
+  int ok = 1;
+  for (int run = 0; run < 2 && ok; run++) {
+    SimulationReplay replay;
+    Simulation* replayed = ReplaySimulationRecord(path, &replay);
+    ok = replayed && replay.complete && replay.steps == steps && replay.recordedSteps == steps &&
+      replay.recordedChecksum == checksum && replay.checksum == checksum && sameState(live, replayed);
+    if (!ok) fprintf(stderr, "%s, speed %.1f: replay %d diverged from the live simulation\n", name, speed, run);
+    CloseSimulation(replayed);
+  }
+  CloseSimulation(live);
+
+  long size = 0;
+  unsigned char* recorded = readFile(path, &size);
+  if (!recorded || size <= BENCH_END_CHUNK_SIZE) return 0;
+
+  // The same seed spawns the same scene and records the same bytes
+  Simulation* again = recordScene(path, sprites, steps, speed, kind, 16);
+  CloseSimulation(again);
+  long againSize = 0;
+  unsigned char* againRecorded = readFile(path, &againSize);
+  if (!again || !againRecorded || againSize != size || memcmp(recorded, againRecorded, size) != 0) {
+    fprintf(stderr, "%s, speed %.1f: recording the same seed again wrote different bytes\n", name, speed);
+    ok = 0;
+  }
+  free(againRecorded);
+
+  // A recording cut before its end chunk (a killed process) replays all steps but is incomplete
+  SimulationReplay replay;
+  Simulation* truncated = writeFile(path, recorded, size - BENCH_END_CHUNK_SIZE) ? ReplaySimulationRecord(path, &replay) : NULL;
+  if (!truncated || replay.complete || replay.steps != steps) {
+    fprintf(stderr, "%s, speed %.1f: the truncated recording was not replayed as incomplete\n", name, speed);
+    ok = 0;
+  }
+  CloseSimulation(truncated);
+
+  // Moving the first sprite by 64 pixels down must not replay as identical (its x position is clamped by the first
+  // resize, the y position follows it as the second value of the sprite)
+  recorded[BENCH_FIRST_SPRITE_OFFSET + 5] ^= 0x40;
+  Simulation* modified = writeFile(path, recorded, size) ? ReplaySimulationRecord(path, &replay) : NULL;
+  if (!modified || !replay.complete || replay.checksum == replay.recordedChecksum) {
+    fprintf(stderr, "%s, speed %.1f: the modified recording was not detected\n", name, speed);
+    ok = 0;
+  }
+  CloseSimulation(modified);
+
+  free(recorded);
+  remove(path);
+  return ok;
+}
+
+/**
+ * Headless check of the record / replay determinism
+ *
+ * Not part of the screensaver build, it only needs the platform neutral simulation modules:
+ * cc -O2 -o recordbench recordbench.c simulationrecord.c simulation.c randomgenerator.c spritestore.c broadphase.c framescheduler.c frametrace.c -lm -lpthread
+ * ./recordbench [sprites] [steps] [path]
+ *
+ * Records scenes (both broadphase kinds, slow and fast images, resizes, changes of the active count and skipped
+ * collision passes) into a
+ * temporary file at path and replays them twice. Every replay must end in exactly the state of the live simulation
+ * and match the recorded checksum, the same seed must record the same bytes, a truncated recording must replay
+ * as incomplete and a modified one must not replay as identical. Exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int sprites = argc > 1 ? atoi(argv[1]) : 200;
+  int steps = argc > 2 ? atoi(argv[2]) : 5000;
+  const char* path = argc > 3 ? argv[3] : "recordbench.rec";
+  if (sprites < 1 || steps < 1) {
+    fprintf(stderr, "usage: %s [sprites] [steps] [path]\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  static const double speeds[] = { 0.5, 4.0, 40.0 };
+  for (int kind = BROADPHASE_SWEEP; kind <= BROADPHASE_GRID; kind++) {
+    for (int s = 0; s < (int)(sizeof(speeds) / sizeof(speeds[0])); s++) {
+      failed |= !checkScene(path, sprites, steps, speeds[s], (BroadphaseKind)kind);
+    }
+  }
+
+  printf("%d sprites, %d steps, sweep and grid at speeds 0.5, 4 and 40: %s\n", sprites, steps,
+    failed ? "FAILED" : "all replays identical to the live simulation");
+  return failed;
+}
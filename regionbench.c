@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dirtyregion.h"
+#include "framescheduler.h"
+#include "randomgenerator.h"
+
+// Size of the surface the random rects are placed on (small enough to check the coverage per pixel)
+#define CHECK_SIZE 256
+// Maximum count of dirty rects, the same limit the windows use
+#define CHECK_MAX_RECTS 32
+
+/**
+ * Returns 1 if the region holds exactly the expected rects (in any order)
+*/
+static int holdsRects(const DirtyRegion* region, const SpriteBounds* expected, int count) {
+  if (region->count != count) return 0;
+  for (int e = 0; e < count; e++) {
+    int found = 0;
+    for (int i = 0; i < region->count && !found; i++) found = memcmp(&region->rects[i], &expected[e], sizeof(SpriteBounds)) == 0;
+    if (!found) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Runs a fixed merge case and reports a mismatch, returns 0 if it failed
+*/
+static int checkCase(const char* name, const SpriteBounds* rects, int count, int maxRects, const SpriteBounds* expected, int expectedCount) {
+  // Start below the count of rects, so growing the list is covered as well
+  DirtyRegion* region = CreateDirtyRegion(1);
+  if (!region) return 0;
+  for (int i = 0; i < count; i++) AddDirtyRect(region, rects[i]);
+  MergeDirtyRegion(region, maxRects);
+  int ok = holdsRects(region, expected, expectedCount);
+  if (!ok) {
+    fprintf(stderr, "%s: expected %d rects, merged into %d:", name, expectedCount, region->count);
+    for (int i = 0; i < region->count; i++) {
+      fprintf(stderr, " (%d, %d, %d, %d)", region->rects[i].left, region->rects[i].top, region->rects[i].right, region->rects[i].bottom);
+    }
+    fprintf(stderr, "\n");
+  }
+  CloseDirtyRegion(region);
+  return ok;
+}
+
+/**
+ * Marks the pixels of the rect in the coverage mask
+*/
+static void coverRect(unsigned char* mask, SpriteBounds rect) {
+  for (int y = rect.top; y < rect.bottom; y++) memset(mask + y * CHECK_SIZE + rect.left, 1, rect.right - rect.left);
+}
+
+/**
+ * Merges random rects and checks the invariants of the result, returns 0 if one is violated
+ *
+ * Every dirty pixel stays covered, no empty rect is kept, the result stays within the bounding box of the input,
+ * holds at most maxRects rects and (unless it collapsed) no pair left that would still qualify for a merge
+*/
+static int checkRandom(RandomGenerator* random, int round) {
+  static unsigned char dirty[CHECK_SIZE * CHECK_SIZE];
+  static unsigned char covered[CHECK_SIZE * CHECK_SIZE];
+  memset(dirty, 0, sizeof(dirty));
+  memset(covered, 0, sizeof(covered));
+
+  DirtyRegion* region = CreateDirtyRegion(4);
+  if (!region) return 0;
+  // Old and new box of moved sprites, some of them empty, few to way too many for maxRects
+  int count = 1 + RandomBelow(random, round % 2 ? 24 : 400);
+  SpriteBounds bounds = { .left = CHECK_SIZE, .top = CHECK_SIZE, .right = 0, .bottom = 0 };
+  for (int i = 0; i < count; i++) {
+    SpriteBounds rect;
+    rect.left = RandomBelow(random, CHECK_SIZE);
+    rect.top = RandomBelow(random, CHECK_SIZE);
+    rect.right = rect.left + RandomBelow(random, CHECK_SIZE / 4);
+    rect.bottom = rect.top + RandomBelow(random, CHECK_SIZE / 4);
+    if (rect.right > CHECK_SIZE) rect.right = CHECK_SIZE;
+    if (rect.bottom > CHECK_SIZE) rect.bottom = CHECK_SIZE;
+    AddDirtyRect(region, rect);
+    if (rect.right > rect.left && rect.bottom > rect.top) {
+      coverRect(dirty, rect);
+      if (rect.left < bounds.left) bounds.left = rect.left;
+      if (rect.top < bounds.top) bounds.top = rect.top;
+      if (rect.right > bounds.right) bounds.right = rect.right;
+      if (rect.bottom > bounds.bottom) bounds.bottom = rect.bottom;
+    }
+  }
+  MergeDirtyRegion(region, CHECK_MAX_RECTS);
+
+  int ok = region->count <= CHECK_MAX_RECTS;
+  for (int i = 0; i < region->count && ok; i++) {
+    SpriteBounds rect = region->rects[i];
+    ok = rect.right > rect.left && rect.bottom > rect.top &&
+      rect.left >= bounds.left && rect.top >= bounds.top && rect.right <= bounds.right && rect.bottom <= bounds.bottom;
+    if (ok) coverRect(covered, rect);
+  }
+  for (int p = 0; p < CHECK_SIZE * CHECK_SIZE && ok; p++) ok = !dirty[p] || covered[p];
+  // A collapsed region is a single rect, otherwise the merge must have been run to its fixpoint
+  for (int i = 0; i < region->count && ok; i++) {
+    for (int j = i + 1; j < region->count && ok; j++) {
+      SpriteBounds a = region->rects[i], b = region->rects[j];
+      SpriteBounds box = { a.left < b.left ? a.left : b.left, a.top < b.top ? a.top : b.top,
+        a.right > b.right ? a.right : b.right, a.bottom > b.bottom ? a.bottom : b.bottom };
+      long long boxArea = (long long)(box.right - box.left) * (box.bottom - box.top);
+      long long sum = (long long)(a.right - a.left) * (a.bottom - a.top) + (long long)(b.right - b.left) * (b.bottom - b.top);
+      ok = boxArea > sum;
+    }
+  }
+  if (!ok) fprintf(stderr, "random round %d: %d rects merged into %d violate the region invariants\n", round, count, region->count);
+  CloseDirtyRegion(region);
+  return ok;
+}
+
+/**
+ * Headless check and benchmark of the dirty region merging
+ *
+ * Not part of the screensaver build, it only needs the platform neutral region module:
+ * cc -O2 -o regionbench regionbench.c dirtyregion.c framescheduler.c randomgenerator.c -lpthread
+ * ./regionbench [rounds] [sprites] [sprite size]
+ *
+ * Runs fixed merge cases (empty, overlapping, diagonal, adjacent, distant, chained and too many rects) and random rounds checking
+ * that the merged region still covers every dirty pixel within maxRects rects. Then measures the merge of the
+ * old and new boxes of moving sprites on a 4k window and prints the repainted share of the window.
+ * Exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+  int sprites = argc > 2 ? atoi(argv[2]) : 2;
+  int size = argc > 3 ? atoi(argv[3]) : 128;
+  if (rounds < 1 || sprites < 1 || size < 1 || size > 2000) {
+    fprintf(stderr, "usage: %s [rounds] [sprites] [sprite size]\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  {
+    SpriteBounds rects[] = { { 10, 10, 10, 20 }, { 5, 5, 20, 5 } };
+    failed |= !checkCase("empty", rects, 2, CHECK_MAX_RECTS, NULL, 0);
+  }
+  {
+    // Old and new box of a sprite moving by 2 / 1 pixels
+    SpriteBounds rects[] = { { 0, 0, 20, 20 }, { 2, 1, 22, 21 } };
+    SpriteBounds expected[] = { { 0, 0, 22, 21 } };
+    failed |= !checkCase("overlapping", rects, 2, CHECK_MAX_RECTS, expected, 1);
+  }
+  {
+    // Diagonal neighbours only share a corner, their bounding box would repaint more then both
+    SpriteBounds rects[] = { { 0, 0, 20, 20 }, { 10, 10, 30, 30 } };
+    failed |= !checkCase("diagonal", rects, 2, CHECK_MAX_RECTS, rects, 2);
+  }
+  {
+    SpriteBounds rects[] = { { 0, 0, 10, 10 }, { 10, 0, 20, 10 }, { 20, 0, 30, 10 } };
+    SpriteBounds expected[] = { { 0, 0, 30, 10 } };
+    failed |= !checkCase("adjacent", rects, 3, CHECK_MAX_RECTS, expected, 1);
+  }
+  {
+    // Old and new box of a sprite moving by 2 pixels merge, the box of the distant sprite stays on its own
+    SpriteBounds rects[] = { { 100, 100, 164, 164 }, { 102, 101, 166, 165 }, { 3000, 2000, 3064, 2064 } };
+    SpriteBounds expected[] = { { 100, 100, 166, 165 }, { 3000, 2000, 3064, 2064 } };
+    failed |= !checkCase("distant", rects, 3, CHECK_MAX_RECTS, expected, 2);
+  }
+  {
+    // A merge can enable a merge with an earlier rect, the result must not depend on the order
+    SpriteBounds rects[] = { { 0, 0, 10, 10 }, { 20, 0, 30, 10 }, { 10, 0, 20, 10 } };
+    SpriteBounds expected[] = { { 0, 0, 30, 10 } };
+    failed |= !checkCase("chained", rects, 3, CHECK_MAX_RECTS, expected, 1);
+  }
+  {
+    SpriteBounds rects[] = { { 0, 0, 10, 10 }, { 100, 0, 110, 10 }, { 0, 100, 10, 110 } };
+    SpriteBounds expected[] = { { 0, 0, 110, 110 } };
+    failed |= !checkCase("collapsed", rects, 3, 2, expected, 1);
+  }
+
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 11);
+  for (int round = 0; round < rounds && !failed; round++) failed |= !checkRandom(&random, round);
+
+  // Sprites moving on a 4k window, every frame dirties their old and new box
+  DirtyRegion* region = CreateDirtyRegion(CHECK_MAX_RECTS);
+  if (!region) return 1;
+  int frames = 1000;
+  long long area = 0;
+  double start = FrameSchedulerNow();
+  for (int f = 0; f < frames; f++) {
+    ClearDirtyRegion(region);
+    for (int s = 0; s < sprites; s++) {
+      int x = (s * 997 + f * 3) % (3840 - size - 3), y = (s * 661 + f * 2) % (2160 - size - 2);
+      AddDirtyRect(region, (SpriteBounds){ x, y, x + size, y + size });
+      AddDirtyRect(region, (SpriteBounds){ x + 3, y + 2, x + size + 3, y + size + 2 });
+    }
+    MergeDirtyRegion(region, CHECK_MAX_RECTS);
+    area += DirtyRegionArea(region);
+  }
+  double duration = (FrameSchedulerNow() - start) / frames;
+  double share = (double)area / frames / (3840.0 * 2160.0);
+
+  printf("%s, %d random rounds; %d sprites of %dpx on 3840x2160: %.2f%% of the window repainted (%.0fx less fill and copy), merge %.4f ms/frame\n",
+    failed ? "FAILED" : "all cases passed", rounds, sprites, size, share * 100.0, share > 0.0 ? 1.0 / share : 0.0, duration);
+  CloseDirtyRegion(region);
+  return failed;
+}
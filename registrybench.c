@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "windowregistry.h"
+#include "framescheduler.h"
+
+// Maximum count of displays and windows of the fake display source
+#define BENCH_MAX_DISPLAYS 64
+#define BENCH_MAX_WINDOWS 1024
+
+/**
+ * Window created by the fake display source
+*/
+typedef struct {
+  uint64_t key;
+  SpriteBounds rect;
+  // Count of move procedure calls
+  int moves;
+  // Set once the remove procedure was called
+  int removed;
+} FakeWindow;
+
+/**
+ * Fake display source, the displays are set by the check and the procedures only record their calls
+*/
+typedef struct {
+  DisplayInfo displays[BENCH_MAX_DISPLAYS];
+  int displayCount;
+  // Makes the enumeration fail
+  int failEnumerate;
+  // Key of a display whose window can't be created (0 for none)
+  uint64_t failAdd;
+  // Unregisters removed windows right in the remove procedure (like a window destroyed synchronously)
+  int unregisterOnRemove;
+  WindowRegistry* registry;
+  FakeWindow windows[BENCH_MAX_WINDOWS];
+  int windowCount;
+  int adds, moves, removes;
+} FakeSource;
+
+static int enumerateFake(DisplayInfo* displays, int capacity, void* context) {
+  FakeSource* source = context;
+  if (source->failEnumerate) return -1;
+  for (int i = 0; i < source->displayCount && i < capacity; i++) displays[i] = source->displays[i];
+  return source->displayCount;
+}
+
+static void* addFake(const DisplayInfo* display, void* context) {
+  FakeSource* source = context;
+  if (display->key == source->failAdd || source->windowCount == BENCH_MAX_WINDOWS) return NULL;
+  FakeWindow* window = &source->windows[source->windowCount++];
+  *window = (FakeWindow){ .key = display->key, .rect = display->rect, .moves = 0, .removed = 0 };
+  source->adds++;
+  return window;
+}
+
+static void moveFake(void* window, const DisplayInfo* display, void* context) {
+  FakeSource* source = context;
+  ((FakeWindow*)window)->rect = display->rect;
+  ((FakeWindow*)window)->moves++;
+  source->moves++;
+}
+
+static void removeFake(void* window, void* context) {
+  FakeSource* source = context;
+  ((FakeWindow*)window)->removed++;
+  source->removes++;
+  if (source->unregisterOnRemove) UnregisterWindow(source->registry, window);
+}
+
+/**
+ * Sets the displays of the source: count displays side by side with keys 1..count, width may differ per display
+*/
+static void setDisplays(FakeSource* source, int count, int width) {
+  source->displayCount = count;
+  for (int i = 0; i < count; i++) {
+    source->displays[i] = (DisplayInfo){ .key = (uint64_t)i + 1, .rect = { .left = i * width, .top = 0, .right = (i + 1) * width, .bottom = 1080 }, .interval = 1000.0 / 60.0 };
+  }
+}
+
+/**
+ * Refreshes the registry and compares the changes and procedure calls, returns 0 if they differ
+*/
+static int expectRefresh(const char* name, FakeSource* source, int changes, int adds, int moves, int removes) {
+  source->adds = source->moves = source->removes = 0;
+  int result = RefreshWindowRegistry(source->registry);
+  if (result != changes || source->adds != adds || source->moves != moves || source->removes != removes) {
+    fprintf(stderr, "%s: %d changes (%d adds, %d moves, %d removes), expected %d (%d, %d, %d)\n",
+      name, result, source->adds, source->moves, source->removes, changes, adds, moves, removes);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * Returns 1 if every display of the source has exactly one window that is not closing and on its rect
+*/
+static int matchesDisplays(const FakeSource* source) {
+  int open = 0;
+  for (int i = 0; i < source->registry->count; i++) open += !source->registry->windows[i].closing;
+  if (open != source->displayCount) return 0;
+  for (int d = 0; d < source->displayCount; d++) {
+    FakeWindow* window = FindRegisteredWindow(source->registry, source->displays[d].key);
+    if (!window || window->removed || window->key != source->displays[d].key ||
+        memcmp(&window->rect, &source->displays[d].rect, sizeof(SpriteBounds)) != 0) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Unregisters all closing windows, like their WM_NCDESTROY does
+*/
+static void destroyClosing(WindowRegistry* registry) {
+  for (int i = registry->count - 1; i >= 0; i--) {
+    if (registry->windows[i].closing) UnregisterWindow(registry, registry->windows[i].window);
+  }
+}
+
+/**
+ * Runs the display change cases on a registry driven by the fake source, returns 0 if a check failed
+*/
+static int checkCases(FakeSource* source) {
+  int ok = 1;
+  WindowRegistry* registry = source->registry;
+
+  setDisplays(source, 2, 1920);
+  ok &= expectRefresh("start", source, 2, 2, 0, 0) && matchesDisplays(source);
+  ok &= expectRefresh("unchanged", source, 0, 0, 0, 0);
+
+  // A display changes its resolution, its window is moved and keeps running
+  FakeWindow* second = FindRegisteredWindow(registry, 2);
+  source->displays[1].rect.right = 1920 + 2560;
+  source->displays[1].rect.bottom = 1440;
+  ok &= expectRefresh("resolution", source, 1, 0, 1, 0) && matchesDisplays(source);
+  if (FindRegisteredWindow(registry, 2) != second || second->moves != 1) ok = 0;
+
+  // A display is removed, its window is closed but stays registered until it is destroyed
+  FakeWindow* first = FindRegisteredWindow(registry, 1);
+  source->displays[0] = source->displays[1];
+  source->displayCount = 1;
+  ok &= expectRefresh("removed", source, 1, 0, 0, 1) && matchesDisplays(source);
+  if (!first->removed || registry->count != 2) ok = 0;
+
+  // The display is reconnected before its old window is destroyed, it gets a new window
+  setDisplays(source, 2, 1920);
+  source->displays[1].rect = second->rect;
+  ok &= expectRefresh("reconnected", source, 1, 1, 0, 0) && matchesDisplays(source);
+  if (FindRegisteredWindow(registry, 1) == first || registry->count != 3) ok = 0;
+  if (UnregisterWindow(registry, first) != 2) ok = 0;
+
+  // No display (driver reset, all displays asleep) keeps the windows, a failing enumeration changes nothing
+  source->displayCount = 0;
+  ok &= expectRefresh("no display", source, 0, 0, 0, 0);
+  source->displayCount = 2;
+  source->failEnumerate = 1;
+  ok &= expectRefresh("enumeration failed", source, -1, 0, 0, 0);
+  source->failEnumerate = 0;
+  ok &= matchesDisplays(source);
+
+  // More displays then the initial buffer, the buffer grows and all get a window
+  setDisplays(source, REGISTRY_INITIAL_DISPLAYS * 3, 800);
+  ok &= expectRefresh("many displays", source, REGISTRY_INITIAL_DISPLAYS * 3, REGISTRY_INITIAL_DISPLAYS * 3 - 2, 2, 0) && matchesDisplays(source);
+
+  // A window that can't be created is not registered, the next refresh tries again
+  setDisplays(source, REGISTRY_INITIAL_DISPLAYS * 3 + 1, 800);
+  source->failAdd = REGISTRY_INITIAL_DISPLAYS * 3 + 1;
+  ok &= expectRefresh("add failed", source, 0, 0, 0, 0);
+  source->failAdd = 0;
+  ok &= expectRefresh("add retried", source, 1, 1, 0, 0) && matchesDisplays(source);
+
+  // Several windows removed at once, the remove procedure unregisters them synchronously
+  destroyClosing(registry);
+  source->unregisterOnRemove = 1;
+  setDisplays(source, 5, 800);
+  ok &= expectRefresh("removed synchronously", source, REGISTRY_INITIAL_DISPLAYS * 3 + 1 - 5, 0, 0, REGISTRY_INITIAL_DISPLAYS * 3 + 1 - 5) && matchesDisplays(source);
+  if (registry->count != 5) ok = 0;
+  source->unregisterOnRemove = 0;
+
+  // Unregistering a window that was never registered (its loop failed to start) doesn't report an empty registry
+  FakeWindow unregistered = {0};
+  if (UnregisterWindow(registry, &unregistered) != -1 || registry->count != 5) {
+    fprintf(stderr, "unregistering an unknown window changed the registry\n");
+    ok = 0;
+  }
+
+  // Closing all windows (input) removes each window once, the last destroyed window empties the registry
+  CloseRegisteredWindows(registry);
+  CloseRegisteredWindows(registry);
+  // A display change while closing all (e.g. a monitor re-enumerating on wake) must not create windows again
+  int added = source->windowCount;
+  setDisplays(source, 7, 1024);
+  ok &= expectRefresh("display change while closing all", source, 0, 0, 0, 0);
+  if (source->windowCount != added || FindRegisteredWindow(registry, 1)) ok = 0;
+  int removed = 0;
+  for (int i = 0; i < source->windowCount; i++) removed += source->windows[i].removed;
+  if (FindRegisteredWindow(registry, 1) || removed != source->windowCount) {
+    fprintf(stderr, "closing all windows removed %d of %d windows\n", removed, source->windowCount);
+    ok = 0;
+  }
+  int remaining = registry->count;
+  while (registry->count > 0) remaining = UnregisterWindow(registry, registry->windows[0].window);
+  if (remaining != 0) ok = 0;
+  return ok;
+}
+
+/**
+ * Headless check of the window registry with a fake display source
+ *
+ * Not part of the screensaver build, the registry itself doesn't depend on any window system:
+ * cc -O2 -o registrybench registrybench.c windowregistry.c framescheduler.c -lpthread
+ * ./registrybench [displays] [rounds]
+ *
+ * Runs display changes against the registry (start, resolution change, removal, reconnect before the old window
+ * is destroyed, no display, failing enumeration, more displays then the initial buffer, failing window creation,
+ * synchronous removal, closing all windows and a display change while closing all) and checks the procedures called and the windows left.
+ * Then measures a refresh without changes for the given count of displays. Exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int displays = argc > 1 ? atoi(argv[1]) : 4;
+  int rounds = argc > 2 ? atoi(argv[2]) : 100000;
+  if (displays < 1 || displays > BENCH_MAX_DISPLAYS || rounds < 1) {
+    fprintf(stderr, "usage: %s [displays (1 - %d)] [rounds]\n", argv[0], BENCH_MAX_DISPLAYS);
+    return 1;
+  }
+
+  static FakeSource fake;
+  DisplaySource source = { .enumerate = enumerateFake, .add = addFake, .move = moveFake, .remove = removeFake, .context = &fake };
+  fake.registry = CreateWindowRegistry(&source);
+  if (!fake.registry) return 1;
+  int failed = !checkCases(&fake);
+  CloseWindowRegistry(fake.registry);
+
+  // Every window receives WM_DISPLAYCHANGE, all but the first refresh find nothing to change
+  memset(&fake, 0, sizeof(fake));
+  fake.registry = CreateWindowRegistry(&source);
+  if (!fake.registry) return 1;
+  setDisplays(&fake, displays, 1920);
+  RefreshWindowRegistry(fake.registry);
+  double start = FrameSchedulerNow();
+  int changes = 0;
+  for (int r = 0; r < rounds; r++) changes += RefreshWindowRegistry(fake.registry);
+  double duration = (FrameSchedulerNow() - start) / rounds;
+  if (changes != 0) failed = 1;
+  CloseWindowRegistry(fake.registry);
+
+  printf("%s, unchanged refresh of %d displays %.5f ms\n", failed ? "FAILED" : "all registry cases passed", displays, duration);
+  return failed;
+}
@@ -0,0 +1,83 @@
+#include "rendertarget.h"
+
+#include <stdlib.h>
+
+/**
+ * Allocates the surface of the memory backend on the heap
+*/
+static int allocateMemorySurface(RenderTarget* target, int width, int height) {
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)width * height);
+  if (!pixels) return 0;
+
+  target->buffer.pixels = pixels;
+  target->buffer.width = width;
+  target->buffer.height = height;
+  target->buffer.stride = width;
+  return 1;
+}
+
+/**
+ * Releases the surface of the memory backend
+*/
+static void releaseMemorySurface(RenderTarget* target) {
+  free(target->buffer.pixels);
+}
+
+/**
+ * Backend keeping the surface in plain heap memory (usable without any window system)
+*/
+const RenderTargetBackend MemoryRenderTargetBackend = {
+  .allocate = allocateMemorySurface,
+  .release = releaseMemorySurface
+};
+
+/**
+ * Create a render target without surface, the surface is allocated on the first resize
+ *
+ * If the allocation fails it returns NULL
+*/
+RenderTarget* CreateRenderTarget(const RenderTargetBackend* backend) {
+  RenderTarget* target = calloc(1, sizeof(RenderTarget));
+  if (!target) return NULL;
+  target->backend = backend;
+  return target;
+}
+
+/**
+ * Releases the current surface and resets the buffer
+*/
+static void releaseSurface(RenderTarget* target) {
+  if (target->buffer.pixels) target->backend->release(target);
+  target->buffer = (PixelBuffer){0};
+  target->surface = NULL;
+}
+
+/**
+ * Cleans up the render target and its surface
+*/
+void CloseRenderTarget(RenderTarget* target) {
+  if (target) {
+    releaseSurface(target);
+    free(target);
+  }
+}
+
+/**
+ * Ensures the surface has the provided size, the surface is only reallocated if the size differs
+ *
+ * The content of the surface is undefined after a reallocation.
+ * Returns 0 if the surface could not be allocated (the target has no surface then).
+*/
+int ResizeRenderTarget(RenderTarget* target, int width, int height) {
+  if (width <= 0 || height <= 0) return 0;
+  // Steady state, nothing to do
+  if (target->buffer.pixels && target->buffer.width == width && target->buffer.height == height) return 1;
+
+  releaseSurface(target);
+  if (!target->backend->allocate(target, width, height)) {
+    target->buffer = (PixelBuffer){0};
+    return 0;
+  }
+  target->allocations++;
+  return 1;
+}
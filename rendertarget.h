@@ -0,0 +1,57 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include "spriteblit.h"
+
+typedef struct RenderTarget RenderTarget;
+
+/**
+ * Backend providing the pixel memory of a render target
+*/
+typedef struct {
+  // Allocates a surface of width * height pixels and sets target->buffer, returns 0 on failure
+  int (*allocate)(RenderTarget* target, int width, int height);
+  // Releases the surface allocated by allocate (must accept a target without surface)
+  void (*release)(RenderTarget* target);
+} RenderTargetBackend;
+
+/**
+ * Persistent drawing surface, the pixels are only reallocated when the size changes
+*/
+struct RenderTarget {
+  // Pixels of the surface (pixels is NULL while no surface is allocated)
+  PixelBuffer buffer;
+  // Backend allocating the surface
+  const RenderTargetBackend* backend;
+  // Backend specific surface data (e.g. the gdi device context)
+  void* surface;
+  // Count of surface allocations over the lifetime of the target, does not change in the steady state
+  long long allocations;
+};
+
+/**
+ * Backend keeping the surface in plain heap memory (usable without any window system)
+*/
+extern const RenderTargetBackend MemoryRenderTargetBackend;
+
+/**
+ * Create a render target without surface, the surface is allocated on the first resize
+ *
+ * If the allocation fails it returns NULL
+*/
+RenderTarget* CreateRenderTarget(const RenderTargetBackend* backend);
+
+/**
+ * Cleans up the render target and its surface
+*/
+void CloseRenderTarget(RenderTarget* target);
+
+/**
+ * Ensures the surface has the provided size, the surface is only reallocated if the size differs
+ *
+ * The content of the surface is undefined after a reallocation.
+ * Returns 0 if the surface could not be allocated (the target has no surface then).
+*/
+int ResizeRenderTarget(RenderTarget* target, int width, int height);
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdio.h>
+
+#include "simulationrecord.h"
+
+/**
+ * Headless replay of simulation recordings (see SCREENSAVER_RECORD)
+ *
+ * Not part of the screensaver build, it only needs the platform neutral simulation modules:
+ * cc -O2 -o replay replay.c simulationrecord.c simulation.c randomgenerator.c spritestore.c broadphase.c framescheduler.c frametrace.c -lm -lpthread
+ *
+ * Every recording is replayed and its final state compared against the recorded checksum,
+ * so frame time regressions can be bisected against a fixed corpus of scenes.
+ * Exits with 1 if a recording could not be read or diverged.
+*/
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <recording>...\n", argv[0]);
+    return 1;
+  }
+
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    SimulationReplay replay;
+    Simulation* simulation = ReplaySimulationRecord(argv[i], &replay);
+    if (!simulation) {
+      fprintf(stderr, "%s: not a valid recording\n", argv[i]);
+      failed = 1;
+      continue;
+    }
+
+    const char* result = "incomplete";
+    if (replay.complete) {
+      int matches = replay.steps == replay.recordedSteps && replay.checksum == replay.recordedChecksum;
+      result = matches ? "identical" : "diverged";
+      if (!matches) failed = 1;
+    }
+
+    const SimulationStats* stats = &simulation->stats;
+    printf("%s: %d sprites, %lld steps, %s, mean %.4f ms, p50 %.4f ms, p99 %.4f ms, %.1f pairs/step\n",
+      argv[i],
+      simulation->sprites->total,
+      replay.steps,
+      result,
+      stats->frames ? stats->total / stats->frames : 0.0,
+      SimulationPercentile(stats, 0.5),
+      SimulationPercentile(stats, 0.99),
+      stats->frames ? (double)stats->pairs / stats->frames : 0.0);
+    CloseSimulation(simulation);
+  }
+  return failed;
+}
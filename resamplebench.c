@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spriteresample.h"
+#include "framescheduler.h"
+#include "randomgenerator.h"
+
+// Colour key of the benchmark image
+#define BENCH_KEY 0xFFFFFF
+// Columns the target rows are padded with, the padding must stay untouched
+#define BENCH_PADDING 3
+// Value of the padding pixels
+#define BENCH_CANARY 0xDEADBEEFu
+
+/**
+ * Draws a disc with a colour key background and noisy colours, so the edges mix keyed and opaque pixels
+*/
+static void drawImage(uint32_t* pixels, int width, int height, RandomGenerator* random) {
+  int cx = width / 2, cy = height / 2, radius = (width < height ? width : height) / 2;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int dx = x - cx, dy = y - cy;
+      pixels[y * width + x] = dx * dx + dy * dy > radius * radius ? BENCH_KEY :
+        (uint32_t)(x * 255 / width) << 16 | (uint32_t)(y * 255 / height) << 8 | (uint32_t)RandomBelow(random, 256);
+    }
+  }
+}
+
+/**
+ * Resamples the source to width x height with the simd and the scalar path and compares the pixels
+ *
+ * Adds the time of both paths to simdTime and scalarTime (in ms), returns 0 if the pixels differ
+*/
+static int compareResample(const ResampleSource* source, int width, int height, ResampleFilter filter, int repeats, double* simdTime, double* scalarTime) {
+  int stride = width + BENCH_PADDING;
+  size_t size = sizeof(uint32_t) * (size_t)stride * height;
+  uint32_t* simd = malloc(size);
+  uint32_t* scalar = malloc(size);
+  if (!simd || !scalar) return 0;
+  for (size_t i = 0; i < (size_t)stride * height; i++) simd[i] = scalar[i] = BENCH_CANARY;
+
+  int ok = 1;
+  double start = FrameSchedulerNow();
+  for (int r = 0; r < repeats; r++) ok &= ResampleSprite(source, simd, width, height, stride, filter);
+  double middle = FrameSchedulerNow();
+  for (int r = 0; r < repeats; r++) ok &= ResampleSpriteScalar(source, scalar, width, height, stride, filter);
+  double end = FrameSchedulerNow();
+  *simdTime += middle - start;
+  *scalarTime += end - middle;
+
+  if (ok && memcmp(simd, scalar, size) != 0) {
+    size_t i = 0;
+    while (simd[i] == scalar[i]) i++;
+    fprintf(stderr, "%dx%d -> %dx%d filter %d: pixel (%d, %d) is %06X with simd, %06X scalar\n", source->width, source->height,
+      width, height, filter, (int)(i % stride), (int)(i / stride), simd[i], scalar[i]);
+    ok = 0;
+  }
+  for (int y = 0; y < height && ok; y++) {
+    for (int x = width; x < stride; x++) ok &= simd[y * stride + x] == BENCH_CANARY;
+  }
+  free(simd);
+  free(scalar);
+  return ok;
+}
+
+/**
+ * Headless check and benchmark of the simd resampler against its scalar reference
+ *
+ * Not part of the screensaver build, it only needs the platform neutral resample module:
+ * cc -O2 -mavx2 -o resamplebench resamplebench.c spriteresample.c framescheduler.c randomgenerator.c -lm -lpthread
+ * ./resamplebench [image size] [target size] [repeats]
+ *
+ * Both paths run the same multiplications and additions in the same order, only several channels and pixels
+ * at once, so the pixels must be bit-identical. Contracting them into fused multiply adds (-mfma, -march=native)
+ * may change the rounding of one path, build the check without it. Compares all filters on down and up scaled
+ * odd sizes (covering the scalar tails) with padded target rows, then measures the given sizes.
+ * Exits with 1 if the pixels differ or the row padding was written.
+*/
+int main(int argc, char** argv) {
+  int size = argc > 1 ? atoi(argv[1]) : 512;
+  int targetSize = argc > 2 ? atoi(argv[2]) : 384;
+  int repeats = argc > 3 ? atoi(argv[3]) : 20;
+  if (size < 1 || targetSize < 1 || repeats < 1) {
+    fprintf(stderr, "usage: %s [image size] [target size] [repeats]\n", argv[0]);
+    return 1;
+  }
+
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 12);
+  int failed = 0;
+  double simdTime = 0.0, scalarTime = 0.0;
+
+  // Source and target sizes around the simd widths (4 and 8 floats, 1 and 2 pixels) and typical scale factors
+  static const int sources[][2] = { { 1, 1 }, { 7, 5 }, { 33, 31 }, { 128, 96 }, { 257, 130 } };
+  static const int targets[][2] = { { 1, 1 }, { 2, 3 }, { 3, 7 }, { 17, 9 }, { 64, 64 }, { 101, 77 }, { 300, 201 } };
+  for (size_t s = 0; s < sizeof(sources) / sizeof(sources[0]); s++) {
+    int width = sources[s][0], height = sources[s][1];
+    uint32_t* pixels = malloc(sizeof(uint32_t) * width * height);
+    if (!pixels) return 1;
+    drawImage(pixels, width, height, &random);
+    ResampleSource* source = CreateResampleSource(pixels, width, height, width, BENCH_KEY);
+    free(pixels);
+    if (!source) return 1;
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+      for (int filter = RESAMPLE_NEAREST; filter <= RESAMPLE_LANCZOS3; filter++) {
+        failed |= !compareResample(source, targets[t][0], targets[t][1], filter, 1, &simdTime, &scalarTime);
+      }
+    }
+    CloseResampleSource(source);
+  }
+
+  uint32_t* pixels = malloc(sizeof(uint32_t) * size * size);
+  if (!pixels) return 1;
+  drawImage(pixels, size, size, &random);
+  ResampleSource* source = CreateResampleSource(pixels, size, size, size, BENCH_KEY);
+  free(pixels);
+  if (!source) return 1;
+  static const char* names[] = { "nearest", "bilinear", "lanczos3" };
+  for (int filter = RESAMPLE_NEAREST; filter <= RESAMPLE_LANCZOS3; filter++) {
+    simdTime = scalarTime = 0.0;
+    failed |= !compareResample(source, targetSize, targetSize, filter, repeats, &simdTime, &scalarTime);
+    printf("%dpx -> %dpx %s: simd %.3f ms, scalar %.3f ms, x%.2f\n", size, targetSize, names[filter],
+      simdTime / repeats, scalarTime / repeats, simdTime > 0.0 ? scalarTime / simdTime : 0.0);
+  }
+  CloseResampleSource(source);
+
+  printf("%s\n", failed ? "FAILED" : "simd and scalar pixels are identical");
+  return failed;
+}
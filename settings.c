@@ -0,0 +1,338 @@
+#include "settings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Longest setting name or value accepted from any source
+#define SETTINGS_TEXT_LENGTH 256
+
+/**
+ * Value types of the settings
+*/
+typedef enum {
+  SETTING_INT = 0,
+  SETTING_DOUBLE = 1,
+  SETTING_SEED = 2,
+  SETTING_TEXT = 3
+} SettingType;
+
+/**
+ * Describes one setting: its name in the registry / file, where it lives in the struct and its valid range
+*/
+typedef struct {
+  const char* name;
+  SettingType type;
+  size_t offset;
+  double minimum;
+  double maximum;
+  double defaultValue;
+} SettingField;
+
+// All settings, the names are the same for the registry and the settings file
+static const SettingField settingFields[] = {
+  { "cursor_threshold", SETTING_INT, offsetof(Settings, cursorThreshold), 0, 100000, 20 },
+  { "image_count", SETTING_INT, offsetof(Settings, imageCount), 0, 100000, 2 },
+  { "image_width", SETTING_DOUBLE, offsetof(Settings, imageWidth), 0.001, 1.0, 0.2 },
+  { "disable_image_scale", SETTING_INT, offsetof(Settings, disableImageScale), 0, 1, 0 },
+  { "image_filter", SETTING_INT, offsetof(Settings, imageFilter), 0, 2, 2 },
+  { "image_alpha", SETTING_INT, offsetof(Settings, imageAlpha), 0, 1, 0 },
+  { "image_speed", SETTING_DOUBLE, offsetof(Settings, imageSpeed), 0, 1000, 1 },
+  { "image_bounce", SETTING_INT, offsetof(Settings, imageBounce), 0, 1000, 10 },
+  { "image_bounce_scale", SETTING_DOUBLE, offsetof(Settings, imageBounceScale), 0, 1, 0.01 },
+  { "simulation_rate", SETTING_DOUBLE, offsetof(Settings, simulationRate), 1, 1000, 30 },
+  { "simulation_seed", SETTING_SEED, offsetof(Settings, simulationSeed), 0, 0, 0 },
+  { "collision_grid", SETTING_INT, offsetof(Settings, collisionGrid), 0, 1, 0 },
+  { "load_budget", SETTING_DOUBLE, offsetof(Settings, loadBudget), 0, 100, 0 },
+  { "span_desktop", SETTING_INT, offsetof(Settings, spanDesktop), 0, 1, 0 },
+  // Text settings use the maximum as buffer size, the default is always empty
+  { "image_directory", SETTING_TEXT, offsetof(Settings, imageDirectory), 0, SETTINGS_PATH_LENGTH, 0 }
+};
+
+#define SETTING_FIELD_COUNT ((int)(sizeof(settingFields) / sizeof(settingFields[0])))
+
+/**
+ * Sets all settings to their defaults
+*/
+void DefaultSettings(Settings* settings) {
+  memset(settings, 0, sizeof(Settings));
+  for (int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const SettingField* field = &settingFields[i];
+    char* target = (char*)settings + field->offset;
+    if (field->type == SETTING_INT) *(int*)target = (int)field->defaultValue;
+    else if (field->type == SETTING_DOUBLE) *(double*)target = field->defaultValue;
+    else if (field->type == SETTING_SEED) *(uint64_t*)target = (uint64_t)field->defaultValue;
+    else *target = '\0';
+  }
+}
+
+/**
+ * Returns 1 if the rest of the string is only whitespace
+*/
+static int onlySpace(const char* text) {
+  while (isspace((unsigned char)*text)) text++;
+  return *text == '\0';
+}
+
+/**
+ * Parses the value (as written in the registry or the settings file) into the setting with the provided name
+ *
+ * Returns 0 if the name is unknown or the value is not a number within the valid range of the setting
+ * (or too long for a text setting), the setting keeps its value in that case
+*/
+int ApplySetting(Settings* settings, const char* name, const char* value) {
+  for (int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const SettingField* field = &settingFields[i];
+    if (strcmp(field->name, name) != 0) continue;
+
+    char* target = (char*)settings + field->offset;
+    char* end;
+    if (field->type == SETTING_TEXT) {
+      // Truncated paths would point somewhere else, so values that don't fit are rejected
+      size_t length = strlen(value);
+      if (length >= (size_t)field->maximum) return 0;
+      memcpy(target, value, length + 1);
+      return 1;
+    }
+    if (field->type == SETTING_SEED) {
+      // Seeds use the full 64 bit range, also hexadecimal (0x...) is accepted
+      unsigned long long seed = strtoull(value, &end, 0);
+      if (end == value || !onlySpace(end)) return 0;
+      *(uint64_t*)target = seed;
+      return 1;
+    }
+
+    double number = strtod(value, &end);
+    if (end == value || !onlySpace(end)) return 0;
+    if (!(number >= field->minimum && number <= field->maximum)) return 0;
+    if (field->type == SETTING_INT) {
+      // Integer settings must not silently drop a fraction
+      if (number != floor(number)) return 0;
+      *(int*)target = (int)number;
+    } else {
+      *(double*)target = number;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Removes leading and trailing whitespace in place and returns the start of the trimmed text
+*/
+static char* trim(char* text) {
+  while (isspace((unsigned char)*text)) text++;
+  char* end = text + strlen(text);
+  while (end > text && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return text;
+}
+
+/**
+ * Applies all "name = value" lines of an ini style file, sections and lines starting with # or ; are ignored
+ *
+ * Returns the count of applied settings or -1 if the file could not be opened
+*/
+int LoadSettingsFile(Settings* settings, const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) return -1;
+
+  int applied = 0;
+  char line[SETTINGS_TEXT_LENGTH * 2];
+  while (fgets(line, sizeof(line), file)) {
+    char* text = trim(line);
+    if (*text == '\0' || *text == '#' || *text == ';' || *text == '[') continue;
+
+    char* separator = strchr(text, '=');
+    if (!separator) continue;
+    *separator = '\0';
+    char* value = trim(separator + 1);
+    // Values may be quoted like in toml
+    size_t length = strlen(value);
+    if (length >= 2 && value[0] == '"' && value[length - 1] == '"') {
+      value[length - 1] = '\0';
+      value++;
+    }
+    applied += ApplySetting(settings, trim(text), value);
+  }
+  fclose(file);
+  return applied;
+}
+
+/**
+ * Applies all values of the settings registry key, the key is opened once and its values are enumerated
+ *
+ * Returns the count of applied settings or -1 if the key does not exist (always -1 on other platforms)
+*/
+int LoadSettingsRegistry(Settings* settings) {
+#ifdef _WIN32
+  HKEY key;
+  if (RegOpenKeyExW(HKEY_CURRENT_USER, SETTINGS_REGISTRY_KEY, 0, KEY_READ, &key) != ERROR_SUCCESS) return -1;
+
+  int applied = 0;
+  wchar_t name[SETTINGS_TEXT_LENGTH];
+  BYTE data[SETTINGS_TEXT_LENGTH * sizeof(wchar_t)];
+  for (DWORD index = 0;; index++) {
+    DWORD nameLength = SETTINGS_TEXT_LENGTH;
+    DWORD dataSize = sizeof(data) - sizeof(wchar_t);
+    DWORD type;
+    LONG status = RegEnumValueW(key, index, name, &nameLength, NULL, &type, data, &dataSize);
+    if (status == ERROR_NO_MORE_ITEMS) break;
+    // Values too large for the buffer can't be a valid setting anyway
+    if (status != ERROR_SUCCESS) continue;
+
+    char narrowName[SETTINGS_TEXT_LENGTH];
+    char value[SETTINGS_TEXT_LENGTH];
+    if (!WideCharToMultiByte(CP_UTF8, 0, name, -1, narrowName, sizeof(narrowName), NULL, NULL)) continue;
+
+    // Numbers may be stored as DWORD / QWORD or as string, both are converted into the text form of the file
+    if (type == REG_DWORD && dataSize == sizeof(DWORD)) {
+      snprintf(value, sizeof(value), "%lu", *(DWORD*)data);
+    } else if (type == REG_QWORD && dataSize == sizeof(ULONGLONG)) {
+      snprintf(value, sizeof(value), "%llu", *(ULONGLONG*)data);
+    } else if (type == REG_SZ || type == REG_EXPAND_SZ) {
+      // Registry strings are not guaranteed to be terminated
+      ((wchar_t*)data)[dataSize / sizeof(wchar_t)] = L'\0';
+      if (!WideCharToMultiByte(CP_UTF8, 0, (wchar_t*)data, -1, value, sizeof(value), NULL, NULL)) continue;
+    } else {
+      continue;
+    }
+    applied += ApplySetting(settings, narrowName, value);
+  }
+  RegCloseKey(key);
+  return applied;
+#else
+  (void)settings;
+  return -1;
+#endif
+}
+
+/**
+ * Reads the stamp of the registry key and the settings file at path (path may be NULL)
+*/
+SettingsStamp GetSettingsStamp(const char* path) {
+  SettingsStamp stamp = {0};
+#ifdef _WIN32
+  HKEY key;
+  if (RegOpenKeyExW(HKEY_CURRENT_USER, SETTINGS_REGISTRY_KEY, 0, KEY_READ, &key) == ERROR_SUCCESS) {
+    FILETIME writeTime;
+    if (RegQueryInfoKeyW(key, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &writeTime) == ERROR_SUCCESS) {
+      stamp.registryWriteTime = ((uint64_t)writeTime.dwHighDateTime << 32) | writeTime.dwLowDateTime;
+    }
+    RegCloseKey(key);
+  }
+#endif
+  struct stat info;
+  if (path && stat(path, &info) == 0) {
+    stamp.fileWriteTime = (uint64_t)info.st_mtime;
+    stamp.fileSize = (uint64_t)info.st_size;
+  }
+  return stamp;
+}
+
+/**
+ * Header of the binary settings cache, followed by the Settings struct as it is in memory
+*/
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  // Size of the Settings struct, detects a struct change that missed a version increment
+  uint32_t size;
+  uint32_t reserved;
+  SettingsStamp stamp;
+} SettingsCacheHeader;
+
+/**
+ * Reads the settings from the binary cache at path if it was written for the same stamp
+ *
+ * Returns 0 if the cache is missing, stale or invalid
+*/
+int ReadSettingsCache(Settings* settings, const char* path, SettingsStamp stamp) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return 0;
+
+  SettingsCacheHeader header;
+  Settings cached;
+  int valid = fread(&header, sizeof(header), 1, file) == 1 &&
+    header.magic == SETTINGS_CACHE_MAGIC &&
+    header.version == SETTINGS_CACHE_VERSION &&
+    header.size == sizeof(Settings) &&
+    memcmp(&header.stamp, &stamp, sizeof(SettingsStamp)) == 0 &&
+    fread(&cached, sizeof(cached), 1, file) == 1;
+  fclose(file);
+
+  if (valid) *settings = cached;
+  return valid;
+}
+
+/**
+ * Writes the settings with the stamp into the binary cache at path
+ *
+ * Returns 0 if the cache could not be written
+*/
+int WriteSettingsCache(const Settings* settings, const char* path, SettingsStamp stamp) {
+  FILE* file = fopen(path, "wb");
+  if (!file) return 0;
+
+  SettingsCacheHeader header = {
+    .magic = SETTINGS_CACHE_MAGIC,
+    .version = SETTINGS_CACHE_VERSION,
+    .size = sizeof(Settings),
+    .reserved = 0,
+    .stamp = stamp
+  };
+  int written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(settings, sizeof(Settings), 1, file) == 1;
+  // A partially written cache is rejected by the next read, as the struct is missing
+  return fclose(file) == 0 && written;
+}
+
+/**
+ * Returns the path of the settings cache in buffer or NULL if there is no cache location
+*/
+static const char* settingsCachePath(char* buffer, size_t size) {
+  const char* path = getenv(SETTINGS_CACHE_ENVIRONMENT_VARIABLE);
+  if (path && *path) return path;
+#ifdef _WIN32
+  const char* directory = getenv("LOCALAPPDATA");
+  if (directory && *directory) {
+    snprintf(buffer, size, "%s\\screensaver-settings.cache", directory);
+    return buffer;
+  }
+#else
+  (void)buffer;
+  (void)size;
+#endif
+  return NULL;
+}
+
+/**
+ * Loads all settings: defaults, then the registry, then the file of SETTINGS_FILE_ENVIRONMENT_VARIABLE
+ *
+ * While the sources are unchanged the parsed settings are taken from the binary cache instead
+ * (SETTINGS_CACHE_ENVIRONMENT_VARIABLE, on windows %LOCALAPPDATA%\screensaver-settings.cache by default).
+ * Returns 1 if the settings came from the cache.
+*/
+int LoadSettings(Settings* settings) {
+  const char* filePath = getenv(SETTINGS_FILE_ENVIRONMENT_VARIABLE);
+  if (filePath && !*filePath) filePath = NULL;
+
+  char cacheBuffer[512];
+  const char* cachePath = settingsCachePath(cacheBuffer, sizeof(cacheBuffer));
+  SettingsStamp stamp = GetSettingsStamp(filePath);
+  if (cachePath && ReadSettingsCache(settings, cachePath, stamp)) return 1;
+
+  DefaultSettings(settings);
+  LoadSettingsRegistry(settings);
+  if (filePath) LoadSettingsFile(settings, filePath);
+
+  if (cachePath) WriteSettingsCache(settings, cachePath, stamp);
+  return 0;
+}
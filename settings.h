@@ -0,0 +1,121 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+
+// Registry key (below HKEY_CURRENT_USER) holding the settings on windows
+#define SETTINGS_REGISTRY_KEY L"Software\\screensaver"
+// Environment variable holding the path of a settings file, its values override the registry
+#define SETTINGS_FILE_ENVIRONMENT_VARIABLE "SCREENSAVER_CONFIG"
+// Environment variable overriding the path of the binary settings cache
+#define SETTINGS_CACHE_ENVIRONMENT_VARIABLE "SCREENSAVER_CONFIG_CACHE"
+// First 4 bytes of the settings cache ("SSCF" in little endian)
+#define SETTINGS_CACHE_MAGIC 0x46435353u
+// Format version of the settings cache, incremented whenever the Settings struct changes
+#define SETTINGS_CACHE_VERSION 4
+// Size of text settings including the terminator (paths are stored as utf-8)
+#define SETTINGS_PATH_LENGTH 260
+
+/**
+ * All user settings of the screensaver, loaded once at startup
+*/
+typedef struct {
+  // Pixel threshold for cursor movements until the screensaver exits
+  int cursorThreshold;
+  // Count of images per window
+  int imageCount;
+  // Image width relative to the window width
+  double imageWidth;
+  // 1 to keep the native image size
+  int disableImageScale;
+  // Filter used to scale the images (ResampleFilter)
+  int imageFilter;
+  // 1 to alpha blend the images
+  int imageAlpha;
+  // Speed of the images in pixels per frame at 60hz
+  double imageSpeed;
+  // Instant bounce speed incrementation in pixels
+  int imageBounce;
+  // Bounce decremention scale
+  double imageBounceScale;
+  // Fixed simulation steps per second
+  double simulationRate;
+  // Seed of the scene (0 picks a new scene on every start)
+  uint64_t simulationSeed;
+  // 1 to detect collisions with the spatial hash (BroadphaseKind)
+  int collisionGrid;
+  // Share of the frame time in percent a window may spend on update and paint (0 disables the load governor)
+  double loadBudget;
+  // 1 to simulate one world spanning all monitors instead of one scene per monitor
+  int spanDesktop;
+  // Directory of bmp files shown instead of the embedded bitmap (empty uses the embedded bitmap)
+  char imageDirectory[SETTINGS_PATH_LENGTH];
+} Settings;
+
+/**
+ * Identifies the state of all settings sources, the cache is only used while the stamp is unchanged
+*/
+typedef struct {
+  // Last write time of the registry key (0 if it does not exist)
+  uint64_t registryWriteTime;
+  // Modification time and size of the settings file (0 if there is none)
+  uint64_t fileWriteTime;
+  uint64_t fileSize;
+} SettingsStamp;
+
+/**
+ * Sets all settings to their defaults
+*/
+void DefaultSettings(Settings* settings);
+
+/**
+ * Parses the value (as written in the registry or the settings file) into the setting with the provided name
+ *
+ * Returns 0 if the name is unknown or the value is not a number within the valid range of the setting
+ * (or too long for a text setting), the setting keeps its value in that case
+*/
+int ApplySetting(Settings* settings, const char* name, const char* value);
+
+/**
+ * Applies all "name = value" lines of an ini style file, sections and lines starting with # or ; are ignored
+ *
+ * Returns the count of applied settings or -1 if the file could not be opened
+*/
+int LoadSettingsFile(Settings* settings, const char* path);
+
+/**
+ * Applies all values of the settings registry key, the key is opened once and its values are enumerated
+ *
+ * Returns the count of applied settings or -1 if the key does not exist (always -1 on other platforms)
+*/
+int LoadSettingsRegistry(Settings* settings);
+
+/**
+ * Reads the stamp of the registry key and the settings file at path (path may be NULL)
+*/
+SettingsStamp GetSettingsStamp(const char* path);
+
+/**
+ * Reads the settings from the binary cache at path if it was written for the same stamp
+ *
+ * Returns 0 if the cache is missing, stale or invalid
+*/
+int ReadSettingsCache(Settings* settings, const char* path, SettingsStamp stamp);
+
+/**
+ * Writes the settings with the stamp into the binary cache at path
+ *
+ * Returns 0 if the cache could not be written
+*/
+int WriteSettingsCache(const Settings* settings, const char* path, SettingsStamp stamp);
+
+/**
+ * Loads all settings: defaults, then the registry, then the file of SETTINGS_FILE_ENVIRONMENT_VARIABLE
+ *
+ * While the sources are unchanged the parsed settings are taken from the binary cache instead
+ * (SETTINGS_CACHE_ENVIRONMENT_VARIABLE, on windows %LOCALAPPDATA%\screensaver-settings.cache by default).
+ * Returns 1 if the settings came from the cache.
+*/
+int LoadSettings(Settings* settings);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+#include "framescheduler.h"
+
+/**
+ * Writes the text into the file, returns 0 on failure
+*/
+static int writeText(const char* path, const char* text) {
+  FILE* file = fopen(path, "wb");
+  if (!file) return 0;
+  int ok = fputs(text, file) >= 0;
+  return fclose(file) == 0 && ok;
+}
+
+/**
+ * Reports a failed check, returns 0
+*/
+static int fail(const char* check) {
+  fprintf(stderr, "%s\n", check);
+  return 0;
+}
+
+/**
+ * Checks the defaults and the parsing of single values, returns 0 if a check failed
+*/
+static int checkValues() {
+  Settings settings;
+  DefaultSettings(&settings);
+  int ok = 1;
+  if (settings.cursorThreshold != 20 || settings.imageCount != 2 || settings.imageWidth != 0.2 || settings.imageFilter != 2 ||
+      settings.imageSpeed != 1.0 || settings.imageBounce != 10 || settings.imageBounceScale != 0.01 || settings.simulationRate != 30.0 ||
+      settings.simulationSeed != 0 || settings.loadBudget != 0.0 || settings.imageDirectory[0] != '\0') ok = fail("defaults differ from the documented ones");
+
+  // Valid values are applied
+  ok &= ApplySetting(&settings, "image_count", "500") && settings.imageCount == 500 ? 1 : fail("image_count = 500 not applied");
+  ok &= ApplySetting(&settings, "image_speed", " 0.5 ") && settings.imageSpeed == 0.5 ? 1 : fail("image_speed = 0.5 not applied");
+  ok &= ApplySetting(&settings, "simulation_seed", "0xFFFFFFFFFFFFFFFF") && settings.simulationSeed == UINT64_MAX ? 1 : fail("hexadecimal seed not applied");
+  ok &= ApplySetting(&settings, "image_directory", "C:\\images") && strcmp(settings.imageDirectory, "C:\\images") == 0 ? 1 : fail("image_directory not applied");
+
+  // Invalid values are rejected and keep the previous value
+  Settings before = settings;
+  static const char* rejected[][2] = {
+    { "image_count", "-1" }, { "image_count", "2.5" }, { "image_count", "12abc" }, { "image_count", "" },
+    { "image_width", "0" }, { "image_width", "1.5" }, { "image_filter", "3" }, { "load_budget", "nan" },
+    { "simulation_rate", "0" }, { "simulation_seed", "seed" }, { "unknown_setting", "1" }, { "IMAGE_COUNT", "3" }
+  };
+  for (int i = 0; i < (int)(sizeof(rejected) / sizeof(rejected[0])); i++) {
+    if (ApplySetting(&settings, rejected[i][0], rejected[i][1])) {
+      fprintf(stderr, "%s = \"%s\" was applied\n", rejected[i][0], rejected[i][1]);
+      ok = 0;
+    }
+  }
+  char longPath[SETTINGS_PATH_LENGTH + 1];
+  memset(longPath, 'a', SETTINGS_PATH_LENGTH);
+  longPath[SETTINGS_PATH_LENGTH] = '\0';
+  if (ApplySetting(&settings, "image_directory", longPath)) ok = fail("a path longer then the setting was applied");
+  if (memcmp(&before, &settings, sizeof(Settings)) != 0) ok = fail("a rejected value changed the settings");
+  return ok;
+}
+
+/**
+ * Checks the parsing of a settings file, returns 0 if a check failed
+*/
+static int checkFile(const char* path) {
+  const char* text =
+    "# comment\r\n"
+    "; another comment\n"
+    "[screensaver]\n"
+    "  image_count = 40\r\n"
+    "image_width=0.35\n"
+    "image_filter = 1 # not a number, rejected\n"
+    "image_speed = \"2.5\"\n"
+    "image_directory = \"D:\\bitmaps with spaces\"\n"
+    "unknown = 1\n"
+    "no separator\n"
+    "load_budget = 150\n"
+    "\n"
+    "simulation_seed = 0x2A";
+  if (!writeText(path, text)) return fail("the settings file could not be written");
+
+  Settings settings;
+  DefaultSettings(&settings);
+  int applied = LoadSettingsFile(&settings, path);
+  int ok = 1;
+  if (applied != 5) {
+    fprintf(stderr, "%d settings of the file applied, expected 5\n", applied);
+    ok = 0;
+  }
+  if (settings.imageCount != 40 || settings.imageWidth != 0.35 || settings.imageFilter != 2 || settings.imageSpeed != 2.5 ||
+      strcmp(settings.imageDirectory, "D:\\bitmaps with spaces") != 0 || settings.loadBudget != 0.0 || settings.simulationSeed != 42) {
+    ok = fail("the settings file was parsed into the wrong values");
+  }
+  remove(path);
+  if (LoadSettingsFile(&settings, path) != -1) ok = fail("a missing settings file was not reported");
+  return ok;
+}
+
+/**
+ * Checks the binary cache, returns 0 if a check failed
+*/
+static int checkCache(const char* path) {
+  Settings settings, cached;
+  DefaultSettings(&settings);
+  ApplySetting(&settings, "image_count", "77");
+  ApplySetting(&settings, "image_directory", "images");
+  SettingsStamp stamp = { .registryWriteTime = 1, .fileWriteTime = 2, .fileSize = 3 };
+  int ok = 1;
+  if (!WriteSettingsCache(&settings, path, stamp)) return fail("the settings cache could not be written");
+  if (!ReadSettingsCache(&cached, path, stamp) || memcmp(&cached, &settings, sizeof(Settings)) != 0) ok = fail("the settings cache did not read back");
+
+  SettingsStamp changed = stamp;
+  changed.fileSize++;
+  DefaultSettings(&cached);
+  Settings untouched = cached;
+  if (ReadSettingsCache(&cached, path, changed) || memcmp(&cached, &untouched, sizeof(Settings)) != 0) ok = fail("a stale settings cache was used");
+
+  // A cache cut in the middle of the struct (e.g. a full disk) is rejected
+  FILE* file = fopen(path, "rb");
+  unsigned char data[1024];
+  size_t size = file ? fread(data, 1, sizeof(data), file) : 0;
+  if (file) fclose(file);
+  file = fopen(path, "wb");
+  if (file) {
+    fwrite(data, 1, size - 8, file);
+    fclose(file);
+  }
+  if (ReadSettingsCache(&cached, path, stamp)) ok = fail("a truncated settings cache was used");
+  remove(path);
+  if (ReadSettingsCache(&cached, path, stamp)) ok = fail("a missing settings cache was used");
+  return ok;
+}
+
+/**
+ * Checks LoadSettings with the file backend and the cache, measures the parse and the cache path
+ *
+ * Returns 0 if a check failed
+*/
+static int checkLoad(const char* filePath, const char* cachePath, int rounds) {
+  setenv(SETTINGS_FILE_ENVIRONMENT_VARIABLE, filePath, 1);
+  setenv(SETTINGS_CACHE_ENVIRONMENT_VARIABLE, cachePath, 1);
+  remove(cachePath);
+  if (!writeText(filePath, "image_count = 12\nimage_alpha = 1\n")) return fail("the settings file could not be written");
+
+  int ok = 1;
+  Settings parsed, cached;
+  if (LoadSettings(&parsed) != 0 || parsed.imageCount != 12 || parsed.imageAlpha != 1) ok = fail("the settings file was not loaded");
+  if (LoadSettings(&cached) != 1 || memcmp(&parsed, &cached, sizeof(Settings)) != 0) ok = fail("unchanged settings were not taken from the cache");
+
+  // The stamp changes with the size of the file, the cache is rebuilt
+  if (!writeText(filePath, "image_count = 120\nimage_alpha = 1\n")) return fail("the settings file could not be written");
+  if (LoadSettings(&parsed) != 0 || parsed.imageCount != 120) ok = fail("a changed settings file was not parsed again");
+  if (LoadSettings(&cached) != 1 || cached.imageCount != 120) ok = fail("the rebuilt cache was not used");
+
+  // Without a cache location the settings are parsed every time
+  setenv(SETTINGS_CACHE_ENVIRONMENT_VARIABLE, "", 1);
+  if (LoadSettings(&parsed) != 0 || parsed.imageCount != 120) ok = fail("the settings were not parsed without a cache");
+
+  // Parse and cache path of a file setting every value
+  if (!writeText(filePath,
+      "cursor_threshold = 40\nimage_count = 200\nimage_width = 0.1\ndisable_image_scale = 0\nimage_filter = 1\n"
+      "image_alpha = 1\nimage_speed = 3\nimage_bounce = 5\nimage_bounce_scale = 0.02\nsimulation_rate = 60\n"
+      "simulation_seed = 7\ncollision_grid = 1\nload_budget = 50\nspan_desktop = 0\nimage_directory = C:\\images\n")) {
+    return fail("the settings file could not be written");
+  }
+  double start = FrameSchedulerNow();
+  for (int r = 0; r < rounds; r++) LoadSettings(&parsed);
+  double parseTime = (FrameSchedulerNow() - start) / rounds;
+
+  setenv(SETTINGS_CACHE_ENVIRONMENT_VARIABLE, cachePath, 1);
+  LoadSettings(&cached);
+  start = FrameSchedulerNow();
+  int hits = 0;
+  for (int r = 0; r < rounds; r++) hits += LoadSettings(&cached);
+  double cacheTime = (FrameSchedulerNow() - start) / rounds;
+  if (hits != rounds || memcmp(&parsed, &cached, sizeof(Settings)) != 0) ok = fail("the cached settings differ from the parsed ones");
+
+  printf("LoadSettings: parsed %.4f ms, from the cache %.4f ms\n", parseTime, cacheTime);
+  remove(filePath);
+  remove(cachePath);
+  return ok;
+}
+
+/**
+ * Headless check of the settings file backend and the settings cache
+ *
+ * Not part of the screensaver build, it only needs the platform neutral part of the settings module
+ * (the registry is skipped on other platforms):
+ * cc -O2 -o settingsbench settingsbench.c settings.c framescheduler.c -lm -lpthread
+ * ./settingsbench [rounds] [path prefix]
+ *
+ * Checks the defaults, the accepted and rejected values, the parsing of an ini style file (comments, sections,
+ * quotes, crlf, invalid and unknown values), the binary cache (stale, truncated and missing caches are rejected)
+ * and LoadSettings with SCREENSAVER_CONFIG and SCREENSAVER_CONFIG_CACHE pointing at temporary files.
+ * Prints the load time with and without the cache, exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+  const char* prefix = argc > 2 ? argv[2] : "settingsbench";
+  if (rounds < 1) {
+    fprintf(stderr, "usage: %s [rounds] [path prefix]\n", argv[0]);
+    return 1;
+  }
+
+  char filePath[512], cachePath[512];
+  snprintf(filePath, sizeof(filePath), "%s.ini", prefix);
+  snprintf(cachePath, sizeof(cachePath), "%s.cache", prefix);
+
+  int failed = !checkValues();
+  failed |= !checkFile(filePath);
+  failed |= !checkCache(cachePath);
+  failed |= !checkLoad(filePath, cachePath, rounds);
+
+  printf("%s\n", failed ? "FAILED" : "all settings checks passed");
+  return failed;
+}
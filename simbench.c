@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulation.h"
+#include "frametrace.h"
+
+/**
+ * Creates a simulation and spawns count sprites into the fake window rect, returns NULL on failure
+*/
+static Simulation* createScene(int count, int size, BroadphaseKind broadphase, SimulationConfig config, SpriteBounds bounds) {
+  Simulation* simulation = CreateSimulation(count, broadphase, config);
+  if (!simulation) return NULL;
+  for (int i = 0; i < count; i++) {
+    if (SpawnSprite(simulation, bounds, size, size) < 0) {
+      CloseSimulation(simulation);
+      return NULL;
+    }
+  }
+  return simulation;
+}
+
+/**
+ * Returns 1 if both stores hold bit-identical movement states and sweep orders
+*/
+static int sameState(const SpriteStore* a, const SpriteStore* b) {
+  size_t size = sizeof(int) * a->count;
+  return a->count == b->count &&
+    memcmp(a->xPos, b->xPos, size) == 0 && memcmp(a->yPos, b->yPos, size) == 0 &&
+    memcmp(a->xMov, b->xMov, size) == 0 && memcmp(a->yMov, b->yMov, size) == 0 &&
+    memcmp(a->inc, b->inc, size) == 0 && memcmp(a->decSteps, b->decSteps, size) == 0 &&
+    memcmp(a->order, b->order, size) == 0;
+}
+
+/**
+ * Prints the cost statistics of a simulation
+*/
+static void printStats(const Simulation* simulation, const char* kind) {
+  const SimulationStats* stats = &simulation->stats;
+  printf("  %s: %.0f ns/frame, %.1f pairs/frame, p50 %.0f ns, p90 %.0f ns, p99 %.0f ns, max %.0f ns\n",
+    kind,
+    stats->total / stats->frames * 1e6,
+    (double)stats->pairs / stats->frames,
+    SimulationPercentile(stats, 0.5) * 1e6,
+    SimulationPercentile(stats, 0.9) * 1e6,
+    SimulationPercentile(stats, 0.99) * 1e6,
+    SimulationPercentile(stats, 1.0) * 1e6);
+}
+
+/**
+ * Headless benchmark of the simulation step (movement, wall bounces and collisions) in a fake window rect
+ *
+ * Not part of the screensaver build, it only needs the platform neutral simulation modules:
+ * cc -O2 -o simbench simbench.c simulation.c simulationrecord.c spritestore.c broadphase.c randomgenerator.c framescheduler.c frametrace.c -lm -lpthread
+ * ./simbench [sprites] [sprite size] [speed] [bounce] [bounce decrement scale] [frames] [sweep|grid|both] [width] [height]
+ * SCREENSAVER_TRACE=simbench.json ./simbench
+ *
+ * Prints the mean ns/frame, the resolved collision pairs per frame and the percentiles of the
+ * step durations (over the last SIMULATION_STATS_SAMPLES frames), so regressions show up before a rollout.
+ * With both, the same scene is stepped with the sweep and the grid broadphase in lockstep and the sprite
+ * states are compared after every frame, exits with 1 if the grid ever diverged from the sweep.
+ * If SCREENSAVER_TRACE is set, the update and collision stages are written to it as chrome trace json
+ * (window 0 is the sweep, window 1 the grid).
+*/
+int main(int argc, char** argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 1000;
+  int size = argc > 2 ? atoi(argv[2]) : 64;
+  double speed = argc > 3 ? atof(argv[3]) : 6.0;
+  int bounce = argc > 4 ? atoi(argv[4]) : 10;
+  double decrementScale = argc > 5 ? atof(argv[5]) : 1.0;
+  int frames = argc > 6 ? atoi(argv[6]) : 1000;
+  const char* kind = argc > 7 ? argv[7] : "sweep";
+  // The fake window rect defaults to a full hd monitor
+  int width = argc > 8 ? atoi(argv[8]) : 1920;
+  int height = argc > 9 ? atoi(argv[9]) : 1080;
+  int sweep = strcmp(kind, "sweep") == 0 || strcmp(kind, "both") == 0;
+  int grid = strcmp(kind, "grid") == 0 || strcmp(kind, "both") == 0;
+  if (count < 1 || size < 1 || speed < 0.0 || bounce < 0 || decrementScale <= 0.0 || frames < 1 || width < 1 || height < 1 ||
+      (!sweep && !grid)) {
+    fprintf(stderr, "usage: %s [sprites] [sprite size] [speed] [bounce] [bounce decrement scale] [frames] [sweep|grid|both] [width] [height]\n", argv[0]);
+    return 1;
+  }
+
+  SimulationConfig config = { .movementSpeed = speed, .bounceIncrement = bounce, .bounceDecrementScale = decrementScale, .stepRate = SIMULATION_REFERENCE_RATE, .seed = 1 };
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = width, .bottom = height };
+  // Both scenes are spawned from the same seed, so they start bit-identical
+  Simulation* sweepSimulation = sweep ? createScene(count, size, BROADPHASE_SWEEP, config, bounds) : NULL;
+  Simulation* gridSimulation = grid ? createScene(count, size, BROADPHASE_GRID, config, bounds) : NULL;
+  if ((sweep && !sweepSimulation) || (grid && !gridSimulation)) {
+    fprintf(stderr, "the simulation could not be created\n");
+    return 1;
+  }
+
+  if (gridSimulation) gridSimulation->id = 1;
+  if (StartTracingFromEnvironment()) SetTraceThreadName("simbench");
+
+  int diverged = -1;
+  for (int f = 0; f < frames; f++) {
+    if (sweepSimulation) StepSimulation(sweepSimulation, bounds);
+    if (gridSimulation) StepSimulation(gridSimulation, bounds);
+    if (sweepSimulation && gridSimulation && diverged < 0 &&
+        (!sameState(sweepSimulation->sprites, gridSimulation->sprites) ||
+         sweepSimulation->broadphase->pairCount != gridSimulation->broadphase->pairCount)) {
+      diverged = f;
+    }
+  }
+
+  if (TracingEnabled() && !StopTracing()) fprintf(stderr, "the trace could not be written\n");
+  printf("%dx%d, %d sprites of %dpx, speed %.2f, bounce %d / %.2f, %d frames\n",
+    width, height, count, size, speed, bounce, decrementScale, frames);
+  if (sweepSimulation) printStats(sweepSimulation, "sweep");
+  if (gridSimulation) printStats(gridSimulation, "grid");
+  if (sweepSimulation && gridSimulation) {
+    if (diverged >= 0) printf("  grid DIVERGED from the sweep in frame %d\n", diverged);
+    else printf("  grid identical to the sweep, x%.2f\n", sweepSimulation->stats.total / gridSimulation->stats.total);
+  }
+
+  CloseSimulation(sweepSimulation);
+  CloseSimulation(gridSimulation);
+  return diverged >= 0;
+}
@@ -0,0 +1,199 @@
+#include "simulation.h"
+
+#include <stdlib.h>
+
+#include "framescheduler.h"
+#include "frametrace.h"
+#include "simulationrecord.h"
+
+/**
+ * Create a simulation for up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+Simulation* CreateSimulation(int capacity, BroadphaseKind broadphase, SimulationConfig config) {
+  Simulation* simulation = calloc(1, sizeof(Simulation));
+  if (!simulation) return NULL;
+
+  // Steps run at the reference rate if no valid rate is configured
+  if (config.stepRate <= 0.0) config.stepRate = SIMULATION_REFERENCE_RATE;
+  simulation->config = config;
+  simulation->stepPeriod = 1000.0 / config.stepRate;
+  simulation->accumulator = 0.0;
+  simulation->collisionDivider = 1;
+  SeedRandomGenerator(&simulation->random, config.seed);
+  simulation->sprites = CreateSpriteStore(capacity);
+  simulation->broadphase = CreateBroadphase(broadphase, capacity);
+  if (!simulation->sprites || !simulation->broadphase) {
+    CloseSimulation(simulation);
+    return NULL;
+  }
+  return simulation;
+}
+
+/**
+ * Cleans up the simulation, an active recording is finished first
+*/
+void CloseSimulation(Simulation* simulation) {
+  if (simulation) {
+    StopSimulationRecording(simulation);
+    CloseSpriteStore(simulation->sprites);
+    CloseBroadphase(simulation->broadphase);
+    free(simulation);
+  }
+}
+
+/**
+ * Spawns a sprite with the provided size at a random position inside the bounds (+ 5 pixel border)
+ * and a random diagonal direction, both drawn from the generator of the simulation
+ *
+ * Returns the index of the sprite or -1 if the simulation is full
+*/
+int SpawnSprite(Simulation* simulation, SpriteBounds bounds, int width, int height) {
+  // Free space for the start position, at least 1 to keep the range valid for oversized sprites
+  int xRange = bounds.right - bounds.left - width - 10;
+  int yRange = bounds.bottom - bounds.top - height - 10;
+  if (xRange < 1) xRange = 1;
+  if (yRange < 1) yRange = 1;
+
+  // Speeds are configured per reference frame, one step covers reference / stepRate frames of movement
+  double stepScale = SIMULATION_REFERENCE_RATE / simulation->config.stepRate * SPRITE_FIXED_ONE;
+  int speed = (int)(simulation->config.movementSpeed * stepScale + 0.5);
+  int bounceIncrement = (int)(simulation->config.bounceIncrement * stepScale + 0.5);
+  RandomGenerator* random = &simulation->random;
+  // Draw in a fixed order, argument evaluation order is unspecified and would make the scene compiler dependent
+  int xPos = SPRITE_TO_FIXED(bounds.left + 5 + RandomBelow(random, xRange)); // Rand start position (+ 5 pixel border)
+  int yPos = SPRITE_TO_FIXED(bounds.top + 5 + RandomBelow(random, yRange)); // Rand start position (+ 5 pixel border)
+  int xMov = speed * (RandomBelow(random, 2) ? -1 : 1); // Random move start direction
+  int yMov = speed * (RandomBelow(random, 2) ? -1 : 1); // Random move start direction
+  return AddSprite(
+    simulation->sprites,
+    xPos,
+    yPos,
+    xMov,
+    yMov,
+    bounceIncrement,
+    simulation->config.bounceDecrementScale,
+    SPRITE_TO_FIXED(width),
+    SPRITE_TO_FIXED(height)
+  );
+}
+
+/**
+ * Sets the count of simulated and presented sprites, the other sprites are parked until they are active again
+ *
+ * The change is recorded, so replays park the same sprites at the same step
+*/
+void SetActiveSprites(Simulation* simulation, int count) {
+  int previous = simulation->sprites->count;
+  ParkSprites(simulation->sprites, count);
+  if (simulation->recorder && simulation->sprites->count != previous) {
+    RecordActiveSprites(simulation, simulation->sprites->count);
+  }
+}
+
+/**
+ * Resolves the collisions only every divider-th step (< 1 is treated as 1), the sprites keep moving in every step
+ *
+ * The next collision pass runs divider steps after the change. The change is recorded, so replays skip the same passes
+*/
+void SetCollisionDivider(Simulation* simulation, int divider) {
+  simulation->collisionDivider = divider < 1 ? 1 : divider;
+  simulation->collisionSteps = 0;
+  if (simulation->recorder) RecordCollisionDivider(simulation, simulation->collisionDivider);
+}
+
+/**
+ * Advances the simulation by one fixed step (movement, wall bounces and collisions), bounds are in pixels
+ *
+ * The duration and the collision pairs of the step are recorded in the stats,
+ * if tracing is enabled the update and collision stages are recorded as well
+*/
+void StepSimulation(Simulation* simulation, SpriteBounds bounds) {
+  // The recording only needs the bounds, the steps themselves are replayed
+  if (simulation->recorder) RecordSimulationStep(simulation, bounds);
+
+  double start = FrameSchedulerNow();
+
+  // The sprite store works in fixed point units
+  SpriteBounds fixedBounds = {
+    .left = SPRITE_TO_FIXED(bounds.left),
+    .top = SPRITE_TO_FIXED(bounds.top),
+    .right = SPRITE_TO_FIXED(bounds.right),
+    .bottom = SPRITE_TO_FIXED(bounds.bottom)
+  };
+
+  // Calculate the position of all sprites
+  IntegrateSprites(simulation->sprites, fixedBounds);
+  double integrated = FrameSchedulerNow();
+  // Handle sprite collisions, unless the load governor skips this pass
+  int collide = ++simulation->collisionSteps >= simulation->collisionDivider;
+  if (collide) {
+    HandleCollisions(simulation->broadphase, simulation->sprites);
+    simulation->collisionSteps = 0;
+  }
+  double end = FrameSchedulerNow();
+
+  double duration = end - start;
+
+  SimulationStats* stats = &simulation->stats;
+  stats->samples[stats->next] = duration;
+  stats->next = (stats->next + 1) % SIMULATION_STATS_SAMPLES;
+  if (stats->count < SIMULATION_STATS_SAMPLES) stats->count++;
+  stats->frames++;
+  if (collide) stats->pairs += simulation->broadphase->pairCount;
+  stats->total += duration;
+
+  RecordTrace(TRACE_UPDATE, simulation->id, stats->frames, start, integrated);
+  if (collide) RecordTrace(TRACE_COLLISION, simulation->id, stats->frames, integrated, end);
+}
+
+/**
+ * Advances the simulation by the elapsed time in ms, running as many fixed steps as fit into it
+ *
+ * The remainder is carried over to the next call. Returns the interpolation factor between the
+ * previous and the current step positions for rendering (0 - SPRITE_FIXED_ONE).
+*/
+int AdvanceSimulation(Simulation* simulation, SpriteBounds bounds, double elapsed) {
+  if (elapsed > 0.0) simulation->accumulator += elapsed;
+
+  int steps = 0;
+  while (simulation->accumulator >= simulation->stepPeriod) {
+    if (steps == SIMULATION_MAX_STEPS) {
+      // Catching up after a stall would only make the next frame late as well, the lost time is dropped
+      simulation->accumulator = 0.0;
+      break;
+    }
+    StepSimulation(simulation, bounds);
+    simulation->accumulator -= simulation->stepPeriod;
+    steps++;
+  }
+
+  int alpha = (int)(simulation->accumulator / simulation->stepPeriod * SPRITE_FIXED_ONE);
+  return alpha < 0 ? 0 : (alpha > SPRITE_FIXED_ONE ? SPRITE_FIXED_ONE : alpha);
+}
+
+/**
+ * Compare function for qsort on doubles
+*/
+static int compareDouble(const void* a, const void* b) {
+  double left = *(const double*)a;
+  double right = *(const double*)b;
+  return (left > right) - (left < right);
+}
+
+/**
+ * Returns the percentile (0.0 - 1.0) of the recorded frame durations in ms
+*/
+double SimulationPercentile(const SimulationStats* stats, double percentile) {
+  if (stats->count == 0) return 0.0;
+
+  // Sort a copy, so the ring buffer keeps its order
+  double sorted[SIMULATION_STATS_SAMPLES];
+  for (int i = 0; i < stats->count; i++) sorted[i] = stats->samples[i];
+  qsort(sorted, stats->count, sizeof(double), compareDouble);
+
+  if (percentile < 0.0) percentile = 0.0;
+  if (percentile > 1.0) percentile = 1.0;
+  return sorted[(int)(percentile * (stats->count - 1) + 0.5)];
+}
@@ -0,0 +1,141 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdint.h>
+
+#include "spritestore.h"
+#include "broadphase.h"
+#include "randomgenerator.h"
+
+// Count of frame samples kept for the percentile statistics
+#define SIMULATION_STATS_SAMPLES 1024
+// Frame rate the speeds of the config refer to (pixels per frame at 60hz)
+#define SIMULATION_REFERENCE_RATE 60.0
+// Maximum count of fixed steps run by one AdvanceSimulation() call, time beyond is dropped (e.g. after a stall)
+#define SIMULATION_MAX_STEPS 8
+
+/**
+ * Parameters for spawning sprites into a simulation
+*/
+typedef struct {
+  // Speed of the sprites in pixels per frame at SIMULATION_REFERENCE_RATE (fractions are kept as sub-pixel speed)
+  double movementSpeed;
+  // Instant bounce speed incrementation in pixels per frame at SIMULATION_REFERENCE_RATE
+  int bounceIncrement;
+  // Bounce decremention scale (makes the bounce decrement less aggressive)
+  double bounceDecrementScale;
+  // Fixed steps simulated per second, independent of the rate the window is presented with
+  double stepRate;
+  // Seed of the generator placing the spawned sprites, the same seed spawns the same scene
+  uint64_t seed;
+} SimulationConfig;
+
+/**
+ * Cost statistics of the simulated frames
+*/
+typedef struct {
+  // Duration of the last SIMULATION_STATS_SAMPLES frames in ms (ring buffer)
+  double samples[SIMULATION_STATS_SAMPLES];
+  // Index the next sample is written to
+  int next;
+  // Count of valid samples (up to SIMULATION_STATS_SAMPLES)
+  int count;
+  // Count of simulated frames
+  long long frames;
+  // Count of resolved collision pairs over all frames
+  long long pairs;
+  // Total duration of all frames in ms
+  double total;
+} SimulationStats;
+
+/**
+ * Platform neutral simulation of the sprites of one window
+ *
+ * Holds the movement state and the collision broadphase, the window system only provides the bounds per step.
+ * This makes the complete update path usable without any window (e.g. to measure it headless).
+ *
+ * The simulation runs in fixed steps of 1 / stepRate seconds, the presented frames only interpolate
+ * between the last two steps. This way a 60hz and a 240hz monitor show the same trajectory at the same speed
+ * and a high refresh rate doesn't multiply the collision work.
+*/
+typedef struct {
+  // Movement state of the sprites
+  SpriteStore* sprites;
+  // Collision detection state of the sprites
+  Broadphase* broadphase;
+  // Configuration used for spawned sprites
+  SimulationConfig config;
+  // Cost statistics of the steps
+  SimulationStats stats;
+  // Duration of one fixed step in ms
+  double stepPeriod;
+  // Elapsed time in ms not yet consumed by a fixed step
+  double accumulator;
+  // Generator for spawn positions and directions, seeded from the config
+  RandomGenerator random;
+  // Recorder writing the steps into a replay file (NULL if not recording)
+  struct SimulationRecorder* recorder;
+  // Identifier of the simulation in traces (e.g. the window number)
+  int id;
+  // Collisions are only resolved every collisionDivider-th step (1 resolves them in every step)
+  int collisionDivider;
+  // Count of steps since the last collision pass
+  int collisionSteps;
+} Simulation;
+
+/**
+ * Create a simulation for up to capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+Simulation* CreateSimulation(int capacity, BroadphaseKind broadphase, SimulationConfig config);
+
+/**
+ * Cleans up the simulation, an active recording is finished first
+*/
+void CloseSimulation(Simulation* simulation);
+
+/**
+ * Spawns a sprite with the provided size at a random position inside the bounds (+ 5 pixel border)
+ * and a random diagonal direction, both drawn from the generator of the simulation
+ *
+ * Returns the index of the sprite or -1 if the simulation is full
+*/
+int SpawnSprite(Simulation* simulation, SpriteBounds bounds, int width, int height);
+
+/**
+ * Sets the count of simulated and presented sprites, the other sprites are parked until they are active again
+ *
+ * The change is recorded, so replays park the same sprites at the same step
+*/
+void SetActiveSprites(Simulation* simulation, int count);
+
+/**
+ * Resolves the collisions only every divider-th step (< 1 is treated as 1), the sprites keep moving in every step
+ *
+ * The next collision pass runs divider steps after the change. The change is recorded, so replays skip the same passes
+*/
+void SetCollisionDivider(Simulation* simulation, int divider);
+
+/**
+ * Advances the simulation by one fixed step (movement, wall bounces and collisions), bounds are in pixels
+ *
+ * The duration and the collision pairs of the step are recorded in the stats,
+ * if tracing is enabled the update and collision stages are recorded as well
+*/
+void StepSimulation(Simulation* simulation, SpriteBounds bounds);
+
+/**
+ * Advances the simulation by the elapsed time in ms, running as many fixed steps as fit into it
+ *
+ * The remainder is carried over to the next call. Returns the interpolation factor between the
+ * previous and the current step positions for rendering (0 - SPRITE_FIXED_ONE).
+*/
+int AdvanceSimulation(Simulation* simulation, SpriteBounds bounds, double elapsed);
+
+/**
+ * Returns the percentile (0.0 - 1.0) of the recorded frame durations in ms
+*/
+double SimulationPercentile(const SimulationStats* stats, double percentile);
+
+#endif
@@ -0,0 +1,319 @@
+#include "simulationrecord.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Writes an unsigned integer of size bytes in little endian
+*/
+static void writeUnsigned(FILE* file, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) fputc((int)((value >> (8 * i)) & 0xFF), file);
+}
+
+/**
+ * Writes a double with its IEEE 754 bit pattern in little endian
+*/
+static void writeDouble(FILE* file, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  writeUnsigned(file, bits, 8);
+}
+
+/**
+ * Reads an unsigned integer of size bytes in little endian, returns 0 at the end of the file
+*/
+static int readUnsigned(FILE* file, uint64_t* value, int size) {
+  *value = 0;
+  for (int i = 0; i < size; i++) {
+    int byte = fgetc(file);
+    if (byte == EOF) return 0;
+    *value |= (uint64_t)byte << (8 * i);
+  }
+  return 1;
+}
+
+/**
+ * Reads a signed 32 bit integer, returns 0 at the end of the file
+*/
+static int readInt(FILE* file, int* value) {
+  uint64_t bits;
+  if (!readUnsigned(file, &bits, 4)) return 0;
+  *value = (int32_t)(uint32_t)bits;
+  return 1;
+}
+
+/**
+ * Reads a double, returns 0 at the end of the file
+*/
+static int readDouble(FILE* file, double* value) {
+  uint64_t bits;
+  if (!readUnsigned(file, &bits, 8)) return 0;
+  memcpy(value, &bits, sizeof(bits));
+  return 1;
+}
+
+/**
+ * Writes the pending run of steps
+*/
+static void flushSteps(SimulationRecorder* recorder) {
+  if (recorder->pending == 0) return;
+  fputc(RECORD_CHUNK_STEPS, recorder->file);
+  writeUnsigned(recorder->file, recorder->pending, 4);
+  recorder->pending = 0;
+}
+
+/**
+ * Starts recording the simulation into the file at path, the current state becomes the initial state
+ *
+ * Returns 0 if the file could not be created
+*/
+int StartSimulationRecording(Simulation* simulation, const char* path) {
+  StopSimulationRecording(simulation);
+
+  SimulationRecorder* recorder = calloc(1, sizeof(SimulationRecorder));
+  if (!recorder) return 0;
+  recorder->file = fopen(path, "wb");
+  if (!recorder->file) {
+    free(recorder);
+    return 0;
+  }
+
+  FILE* file = recorder->file;
+  const SimulationConfig* config = &simulation->config;
+  writeUnsigned(file, SIMULATION_RECORD_MAGIC, 4);
+  writeUnsigned(file, SIMULATION_RECORD_VERSION, 4);
+  writeUnsigned(file, config->seed, 8);
+  writeDouble(file, config->movementSpeed);
+  writeUnsigned(file, (uint32_t)config->bounceIncrement, 4);
+  writeDouble(file, config->bounceDecrementScale);
+  writeDouble(file, config->stepRate);
+  writeUnsigned(file, (uint32_t)simulation->broadphase->kind, 4);
+
+  // The complete state is stored instead of the spawn parameters, so recordings stay valid if spawning changes
+  const SpriteStore* sprites = simulation->sprites;
+  writeUnsigned(file, (uint32_t)sprites->total, 4);
+  for (int i = 0; i < sprites->total; i++) {
+    const int values[] = {
+      sprites->xPos[i], sprites->yPos[i], sprites->prevX[i], sprites->prevY[i],
+      sprites->xMov[i], sprites->yMov[i], sprites->inc[i], sprites->baseInc[i],
+      sprites->decSteps[i], sprites->width[i], sprites->height[i], sprites->order[i]
+    };
+    for (int v = 0; v < (int)(sizeof(values) / sizeof(values[0])); v++) writeUnsigned(file, (uint32_t)values[v], 4);
+    writeDouble(file, sprites->baseDecScale[i]);
+  }
+
+  // The first step always starts a run with its bounds
+  recorder->bounds = (SpriteBounds){ .left = 0, .top = 0, .right = -1, .bottom = -1 };
+  simulation->recorder = recorder;
+  // The initial state has all sprites active, parked sprites are parked again right away
+  if (sprites->count != sprites->total) RecordActiveSprites(simulation, sprites->count);
+  // Collisions are resolved in every step after the initial state, a skipping divider restarts its count with the recording
+  if (simulation->collisionDivider > 1) SetCollisionDivider(simulation, simulation->collisionDivider);
+  return 1;
+}
+
+/**
+ * Starts recording if the RECORD_ENVIRONMENT_VARIABLE is set, the file is "<value>.<simulation id>"
+ *
+ * Returns 0 if the simulation is not recorded
+*/
+int StartSimulationRecordingFromEnvironment(Simulation* simulation) {
+  const char* prefix = getenv(RECORD_ENVIRONMENT_VARIABLE);
+  if (!prefix || !*prefix) return 0;
+
+  size_t length = strlen(prefix) + 16;
+  char* path = malloc(length);
+  if (!path) return 0;
+  snprintf(path, length, "%s.%d", prefix, simulation->id);
+  int started = StartSimulationRecording(simulation, path);
+  free(path);
+  return started;
+}
+
+/**
+ * Adds one step with the provided bounds to the recording (called by StepSimulation())
+*/
+void RecordSimulationStep(Simulation* simulation, SpriteBounds bounds) {
+  SimulationRecorder* recorder = simulation->recorder;
+  if (!recorder) return;
+
+  if (bounds.left != recorder->bounds.left || bounds.top != recorder->bounds.top ||
+      bounds.right != recorder->bounds.right || bounds.bottom != recorder->bounds.bottom) {
+    // The bounds changed (e.g. the window was resized), close the run and start a new one
+    flushSteps(recorder);
+    fputc(RECORD_CHUNK_BOUNDS, recorder->file);
+    writeUnsigned(recorder->file, (uint32_t)bounds.left, 4);
+    writeUnsigned(recorder->file, (uint32_t)bounds.top, 4);
+    writeUnsigned(recorder->file, (uint32_t)bounds.right, 4);
+    writeUnsigned(recorder->file, (uint32_t)bounds.bottom, 4);
+    recorder->bounds = bounds;
+  }
+  if (recorder->pending == UINT32_MAX) flushSteps(recorder);
+  recorder->pending++;
+  recorder->steps++;
+}
+
+/**
+ * Adds a change of the active sprite count to the recording (called by SetActiveSprites())
+*/
+void RecordActiveSprites(Simulation* simulation, int count) {
+  SimulationRecorder* recorder = simulation->recorder;
+  if (!recorder) return;
+
+  // The change applies between two steps, so the current run is closed first
+  flushSteps(recorder);
+  fputc(RECORD_CHUNK_ACTIVE, recorder->file);
+  writeUnsigned(recorder->file, (uint32_t)count, 4);
+}
+
+/**
+ * Adds a change of the collision divider to the recording (called by SetCollisionDivider())
+*/
+void RecordCollisionDivider(Simulation* simulation, int divider) {
+  SimulationRecorder* recorder = simulation->recorder;
+  if (!recorder) return;
+
+  // The change applies between two steps, so the current run is closed first
+  flushSteps(recorder);
+  fputc(RECORD_CHUNK_COLLISIONS, recorder->file);
+  writeUnsigned(recorder->file, (uint32_t)divider, 4);
+}
+
+/**
+ * Finishes the recording with the checksum of the current state and closes the file
+ *
+ * Does nothing if the simulation is not recorded
+*/
+void StopSimulationRecording(Simulation* simulation) {
+  SimulationRecorder* recorder = simulation->recorder;
+  if (!recorder) return;
+
+  flushSteps(recorder);
+  fputc(RECORD_CHUNK_END, recorder->file);
+  writeUnsigned(recorder->file, (uint64_t)recorder->steps, 8);
+  writeUnsigned(recorder->file, SimulationChecksum(simulation), 8);
+  fclose(recorder->file);
+  free(recorder);
+  simulation->recorder = NULL;
+}
+
+/**
+ * Feeds the bytes of an int array into the FNV-1a hash
+*/
+static uint64_t hashInts(uint64_t hash, const int* values, int count) {
+  for (int i = 0; i < count; i++) {
+    uint32_t value = (uint32_t)values[i];
+    for (int b = 0; b < 4; b++) {
+      hash ^= (value >> (8 * b)) & 0xFF;
+      hash *= 0x100000001B3ull;
+    }
+  }
+  return hash;
+}
+
+/**
+ * Returns a checksum (FNV-1a) over the movement state of all sprites (including parked ones)
+*/
+uint64_t SimulationChecksum(const Simulation* simulation) {
+  const SpriteStore* sprites = simulation->sprites;
+  uint64_t hash = 0xCBF29CE484222325ull;
+  hash = hashInts(hash, sprites->xPos, sprites->total);
+  hash = hashInts(hash, sprites->yPos, sprites->total);
+  hash = hashInts(hash, sprites->xMov, sprites->total);
+  hash = hashInts(hash, sprites->yMov, sprites->total);
+  hash = hashInts(hash, sprites->inc, sprites->total);
+  hash = hashInts(hash, sprites->decSteps, sprites->total);
+  return hash;
+}
+
+/**
+ * Reads the config and the initial state of a recording into a new simulation, returns NULL on failure
+*/
+static Simulation* readInitialState(FILE* file) {
+  uint64_t magic, version, seed, bounceIncrement, broadphase, count;
+  SimulationConfig config = {0};
+  if (!readUnsigned(file, &magic, 4) || magic != SIMULATION_RECORD_MAGIC) return NULL;
+  // Version 2 only added the active chunk and version 3 the collisions chunk, so older recordings are replayed as well
+  if (!readUnsigned(file, &version, 4) || version < 1 || version > SIMULATION_RECORD_VERSION) return NULL;
+  if (!readUnsigned(file, &seed, 8) || !readDouble(file, &config.movementSpeed) ||
+      !readUnsigned(file, &bounceIncrement, 4) || !readDouble(file, &config.bounceDecrementScale) ||
+      !readDouble(file, &config.stepRate) || !readUnsigned(file, &broadphase, 4) ||
+      !readUnsigned(file, &count, 4) || count > INT32_MAX) return NULL;
+  config.seed = seed;
+  config.bounceIncrement = (int32_t)(uint32_t)bounceIncrement;
+
+  Simulation* simulation = CreateSimulation((int)count, (BroadphaseKind)broadphase, config);
+  if (!simulation) return NULL;
+
+  SpriteStore* sprites = simulation->sprites;
+  for (int i = 0; i < (int)count; i++) {
+    int* targets[] = {
+      &sprites->xPos[i], &sprites->yPos[i], &sprites->prevX[i], &sprites->prevY[i],
+      &sprites->xMov[i], &sprites->yMov[i], &sprites->inc[i], &sprites->baseInc[i],
+      &sprites->decSteps[i], &sprites->width[i], &sprites->height[i], &sprites->order[i]
+    };
+    int valid = 1;
+    for (int v = 0; valid && v < (int)(sizeof(targets) / sizeof(targets[0])); v++) valid = readInt(file, targets[v]);
+    if (!valid || !readDouble(file, &sprites->baseDecScale[i]) ||
+        sprites->order[i] < 0 || sprites->order[i] >= (int)count) {
+      CloseSimulation(simulation);
+      return NULL;
+    }
+  }
+  sprites->count = (int)count;
+  sprites->total = (int)count;
+  return simulation;
+}
+
+/**
+ * Loads the recording at path and replays all its steps headless
+ *
+ * The returned simulation holds the final state and the cost statistics of the replayed steps,
+ * the replay result tells whether the final state matches the recorded one.
+ * Returns NULL if the file could not be read or is not a valid recording.
+*/
+Simulation* ReplaySimulationRecord(const char* path, SimulationReplay* replay) {
+  memset(replay, 0, sizeof(SimulationReplay));
+  FILE* file = fopen(path, "rb");
+  if (!file) return NULL;
+
+  Simulation* simulation = readInitialState(file);
+  if (!simulation) {
+    fclose(file);
+    return NULL;
+  }
+
+  // Chunks are replayed until the end chunk, a truncated recording (e.g. killed process) replays what is there
+  SpriteBounds bounds = {0};
+  int chunk;
+  while (!replay->complete && (chunk = fgetc(file)) != EOF) {
+    uint64_t value;
+    if (chunk == RECORD_CHUNK_BOUNDS) {
+      if (!readInt(file, &bounds.left) || !readInt(file, &bounds.top) ||
+          !readInt(file, &bounds.right) || !readInt(file, &bounds.bottom)) break;
+    } else if (chunk == RECORD_CHUNK_STEPS) {
+      if (!readUnsigned(file, &value, 4)) break;
+      for (uint64_t i = 0; i < value; i++) StepSimulation(simulation, bounds);
+      replay->steps += value;
+    } else if (chunk == RECORD_CHUNK_ACTIVE) {
+      if (!readUnsigned(file, &value, 4)) break;
+      SetActiveSprites(simulation, (int)(uint32_t)value);
+    } else if (chunk == RECORD_CHUNK_COLLISIONS) {
+      if (!readUnsigned(file, &value, 4)) break;
+      SetCollisionDivider(simulation, (int)(uint32_t)value);
+    } else if (chunk == RECORD_CHUNK_END) {
+      if (!readUnsigned(file, &value, 8)) break;
+      replay->recordedSteps = (long long)value;
+      if (!readUnsigned(file, &value, 8)) break;
+      replay->recordedChecksum = value;
+      replay->complete = 1;
+    } else {
+      // Unknown chunk, the rest of the file can't be interpreted
+      break;
+    }
+  }
+  fclose(file);
+
+  replay->checksum = SimulationChecksum(simulation);
+  return simulation;
+}
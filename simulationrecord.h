@@ -0,0 +1,116 @@
+#ifndef SIMULATIONRECORD_H
+#define SIMULATIONRECORD_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "simulation.h"
+
+// Environment variable holding the path prefix of the recordings, windows are only recorded if it is set
+#define RECORD_ENVIRONMENT_VARIABLE "SCREENSAVER_RECORD"
+// First 4 bytes of every recording ("SSRC" in little endian)
+#define SIMULATION_RECORD_MAGIC 0x43525353u
+// Format version of the recordings, incremented on every incompatible change
+#define SIMULATION_RECORD_VERSION 3
+
+/**
+ * Chunk tags following the initial state of a recording
+*/
+typedef enum {
+  // New bounds (4 int32) used by all following steps
+  RECORD_CHUNK_BOUNDS = 'B',
+  // Run of steps (uint32 count) with the current bounds
+  RECORD_CHUNK_STEPS = 'S',
+  // New count of active sprites (uint32) used by all following steps, the others are parked (since version 2)
+  RECORD_CHUNK_ACTIVE = 'A',
+  // New collision divider (uint32) used from the next step on, it restarts the count to the next pass (since version 3)
+  RECORD_CHUNK_COLLISIONS = 'C',
+  // End of the recording with the total step count (int64) and the checksum of the final state (uint64)
+  RECORD_CHUNK_END = 'E'
+} RecordChunk;
+
+/**
+ * State of an active recording
+ *
+ * A recording is the config and the complete initial sprite state followed by the bounds of every step,
+ * consecutive steps with the same bounds are stored as one run. So a whole session is a few bytes per sprite
+ * plus a few bytes per window resize, no matter how long it ran.
+ * All values are stored little endian.
+*/
+typedef struct SimulationRecorder {
+  // File the recording is written to
+  FILE* file;
+  // Bounds of the current run of steps
+  SpriteBounds bounds;
+  // Count of steps in the current run (not written yet)
+  uint32_t pending;
+  // Count of all recorded steps
+  long long steps;
+} SimulationRecorder;
+
+/**
+ * Result of a replayed recording
+*/
+typedef struct {
+  // Count of replayed steps
+  long long steps;
+  // 1 if the recording was finished properly (it has an end chunk)
+  int complete;
+  // Step count and final checksum stored in the end chunk (0 if not complete)
+  long long recordedSteps;
+  uint64_t recordedChecksum;
+  // Checksum of the replayed final state
+  uint64_t checksum;
+} SimulationReplay;
+
+/**
+ * Starts recording the simulation into the file at path, the current state becomes the initial state
+ *
+ * Returns 0 if the file could not be created
+*/
+int StartSimulationRecording(Simulation* simulation, const char* path);
+
+/**
+ * Starts recording if the RECORD_ENVIRONMENT_VARIABLE is set, the file is "<value>.<simulation id>"
+ *
+ * Returns 0 if the simulation is not recorded
+*/
+int StartSimulationRecordingFromEnvironment(Simulation* simulation);
+
+/**
+ * Adds one step with the provided bounds to the recording (called by StepSimulation())
+*/
+void RecordSimulationStep(Simulation* simulation, SpriteBounds bounds);
+
+/**
+ * Adds a change of the active sprite count to the recording (called by SetActiveSprites())
+*/
+void RecordActiveSprites(Simulation* simulation, int count);
+
+/**
+ * Adds a change of the collision divider to the recording (called by SetCollisionDivider())
+*/
+void RecordCollisionDivider(Simulation* simulation, int divider);
+
+/**
+ * Finishes the recording with the checksum of the current state and closes the file
+ *
+ * Does nothing if the simulation is not recorded
+*/
+void StopSimulationRecording(Simulation* simulation);
+
+/**
+ * Returns a checksum (FNV-1a) over the movement state of all sprites (including parked ones)
+*/
+uint64_t SimulationChecksum(const Simulation* simulation);
+
+/**
+ * Loads the recording at path and replays all its steps headless
+ *
+ * The returned simulation holds the final state and the cost statistics of the replayed steps,
+ * the replay result tells whether the final state matches the recorded one.
+ * Returns NULL if the file could not be read or is not a valid recording.
+*/
+Simulation* ReplaySimulationRecord(const char* path, SimulationReplay* replay);
+
+#endif
@@ -0,0 +1,812 @@
+#include "simulationworld.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+/**
+ * Phases of a world step, every phase is forked over all shards and joined before the next one starts
+*/
+typedef enum {
+  // Integrate the owned sprites, bounce them off the gaps and list the ones near the border
+  WORLD_PHASE_MOVE = 0,
+  // Copy the border sprites of the neighbours into the halo
+  WORLD_PHASE_HALO = 1,
+  // Resolve the collisions of the owned sprites and the halo copies, drop the copies and hand out the sprites leaving the region
+  WORLD_PHASE_COLLIDE = 2,
+  // Take over the handed sprites and list the owned sprites near the border
+  WORLD_PHASE_TAKEOVER = 3,
+  // Publish the sprites visible in the region
+  WORLD_PHASE_PUBLISH = 4
+} WorldPhase;
+
+/**
+ * Atomically adds to the value and returns the previous value (full barrier)
+*/
+static long fetchAddAtomic(volatile long* value, long addend) {
+#ifdef _WIN32
+  return InterlockedExchangeAdd(value, addend);
+#else
+  return __atomic_fetch_add(value, addend, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/**
+ * Atomically reads the value
+*/
+static long loadAtomic(volatile long* value) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(value, 0, 0);
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Atomically replaces the value with desired if it equals expected, returns 1 on success (full barrier)
+*/
+static int compareExchangeAtomic(volatile long* value, long expected, long desired) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(value, desired, expected) == expected;
+#else
+  return __atomic_compare_exchange_n(value, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Atomically writes the value (release)
+*/
+static void storeAtomic(volatile long* value, long desired) {
+#ifdef _WIN32
+  InterlockedExchange(value, desired);
+#else
+  __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Yields the rest of the timeslice while waiting for the helpers
+*/
+static void yieldThread() {
+#ifdef _WIN32
+  Sleep(0);
+#else
+  sched_yield();
+#endif
+}
+
+/**
+ * Converts a rect in pixels into fixed point units
+*/
+static SpriteBounds toFixed(SpriteBounds bounds) {
+  SpriteBounds fixed = {
+    .left = SPRITE_TO_FIXED(bounds.left),
+    .top = SPRITE_TO_FIXED(bounds.top),
+    .right = SPRITE_TO_FIXED(bounds.right),
+    .bottom = SPRITE_TO_FIXED(bounds.bottom)
+  };
+  return fixed;
+}
+
+/**
+ * Returns the rect grown by margin on every side (shrunk for a negative margin)
+*/
+static SpriteBounds expandBounds(SpriteBounds bounds, int margin) {
+  SpriteBounds expanded = {
+    .left = bounds.left - margin,
+    .top = bounds.top - margin,
+    .right = bounds.right + margin,
+    .bottom = bounds.bottom + margin
+  };
+  return expanded;
+}
+
+/**
+ * Returns 1 if both rects overlap
+*/
+static int boundsOverlap(SpriteBounds a, SpriteBounds b) {
+  return a.left < b.right && a.top < b.bottom && a.right > b.left && a.bottom > b.top;
+}
+
+/**
+ * Returns 1 if inner lies completely inside outer
+*/
+static int boundsInside(SpriteBounds inner, SpriteBounds outer) {
+  return inner.left >= outer.left && inner.top >= outer.top && inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+/**
+ * Returns 1 if the point lies inside the rect (right and bottom are the outer edges)
+*/
+static int pointInside(SpriteBounds bounds, int x, int y) {
+  return x >= bounds.left && x < bounds.right && y >= bounds.top && y < bounds.bottom;
+}
+
+/**
+ * Returns the box covering the previous and the current position of the sprite (fixed point)
+*/
+static SpriteBounds sweptBox(const SpriteStore* store, int index) {
+  int left = store->prevX[index] < store->xPos[index] ? store->prevX[index] : store->xPos[index];
+  int top = store->prevY[index] < store->yPos[index] ? store->prevY[index] : store->yPos[index];
+  int right = store->prevX[index] > store->xPos[index] ? store->prevX[index] : store->xPos[index];
+  int bottom = store->prevY[index] > store->yPos[index] ? store->prevY[index] : store->yPos[index];
+  SpriteBounds box = { .left = left, .top = top, .right = right + store->width[index], .bottom = bottom + store->height[index] };
+  return box;
+}
+
+/**
+ * Returns the attached shard whose region contains the point (fixed point) or -1 if the point lies in no region
+*/
+static int findShardAt(const SimulationWorld* world, int x, int y) {
+  for (int s = 0; s < world->shardCount; s++) {
+    if (!world->shards[s].detached && pointInside(world->shards[s].fixedRegion, x, y)) return s;
+  }
+  return -1;
+}
+
+/**
+ * Returns the attached shard whose region lies nearest to the point (fixed point) or -1 if no shard is attached
+*/
+static int findNearestShard(const SimulationWorld* world, int x, int y) {
+  int nearest = -1;
+  long long nearestDistance = 0;
+  for (int s = 0; s < world->shardCount; s++) {
+    if (world->shards[s].detached) continue;
+    SpriteBounds region = world->shards[s].fixedRegion;
+    long long dx = x < region.left ? region.left - x : (x >= region.right ? x - region.right + 1 : 0);
+    long long dy = y < region.top ? region.top - y : (y >= region.bottom ? y - region.bottom + 1 : 0);
+    long long distance = dx * dx + dy * dy;
+    if (nearest < 0 || distance < nearestDistance) {
+      nearest = s;
+      nearestDistance = distance;
+    }
+  }
+  return nearest;
+}
+
+/**
+ * Returns the count of corners (0 - 4) of the box at x, y (fixed point) lying inside any region
+*/
+static int coveredCorners(const SimulationWorld* world, int x, int y, int width, int height) {
+  int right = x + width - 1;
+  int bottom = y + height - 1;
+  return (findShardAt(world, x, y) >= 0) + (findShardAt(world, right, y) >= 0) +
+    (findShardAt(world, x, bottom) >= 0) + (findShardAt(world, right, bottom) >= 0);
+}
+
+/**
+ * Bounces the sprite off the gaps between the regions
+ *
+ * A step moving corners of the sprite out of the regions is taken back on the axis that caused it and the movement
+ * on that axis is inverted, with the same boost as a bounce off the outer border. Sprites that already started
+ * partly outside (pushed into a gap by a collision) are just corrected into the region of their shard.
+*/
+static void bounceOffGaps(const SimulationWorld* world, SpriteBounds region, SpriteStore* store, int i) {
+  int width = store->width[i];
+  int height = store->height[i];
+  if (coveredCorners(world, store->xPos[i], store->yPos[i], width, height) == 4) return;
+
+  if (coveredCorners(world, store->prevX[i], store->prevY[i], width, height) < 4) {
+    if (store->xPos[i] + width > region.right) store->xPos[i] = region.right - width;
+    if (store->xPos[i] < region.left) store->xPos[i] = region.left;
+    if (store->yPos[i] + height > region.bottom) store->yPos[i] = region.bottom - height;
+    if (store->yPos[i] < region.top) store->yPos[i] = region.top;
+    return;
+  }
+
+  // Prefer the axis whose reversal alone keeps the sprite covered, a corner of the gap is hit on both axes
+  int bounceX = coveredCorners(world, store->prevX[i], store->yPos[i], width, height) == 4;
+  int bounceY = !bounceX && coveredCorners(world, store->xPos[i], store->prevY[i], width, height) == 4;
+  if (!bounceX && !bounceY) bounceX = bounceY = 1;
+
+  store->inc[i] = store->baseInc[i];
+  store->decSteps[i] = 1;
+  if (bounceX) {
+    store->xPos[i] = store->prevX[i];
+    store->xMov[i] = -store->xMov[i];
+  }
+  if (bounceY) {
+    store->yPos[i] = store->prevY[i];
+    store->yMov[i] = -store->yMov[i];
+  }
+}
+
+/**
+ * Compares two handed sprites by id for qsort
+*/
+static int compareHandoffs(const void* a, const void* b) {
+  int left = ((const WorldHandoff*)a)->id;
+  int right = ((const WorldHandoff*)b)->id;
+  return (left > right) - (left < right);
+}
+
+/**
+ * Compares two visible sprites by id for qsort
+*/
+static int compareVisible(const void* a, const void* b) {
+  int left = ((const WorldVisibleSprite*)a)->id;
+  int right = ((const WorldVisibleSprite*)b)->id;
+  return (left > right) - (left < right);
+}
+
+/**
+ * Lists the owned sprites whose swept box reaches into the halo of the region border
+*/
+static void listBorder(SimulationWorld* world, WorldShard* shard) {
+  SpriteStore* store = shard->simulation->sprites;
+  SpriteBounds interior = expandBounds(shard->fixedRegion, -world->halo);
+  shard->borderCount = 0;
+  for (int i = 0; i < shard->owned; i++) {
+    if (!boundsInside(sweptBox(store, i), interior)) shard->border[shard->borderCount++] = i;
+  }
+}
+
+/**
+ * Finds the neighbours of every shard for the current halo width and lists the border sprites of all shards
+*/
+static void prepareWorld(SimulationWorld* world) {
+  if (world->neighboursReady) return;
+  for (int s = 0; s < world->shardCount; s++) {
+    WorldShard* shard = &world->shards[s];
+    // The halo of both sides must fit, so regions within twice the halo width are neighbours
+    SpriteBounds reach = expandBounds(shard->fixedRegion, 2 * world->halo);
+    shard->neighbourCount = 0;
+    for (int t = 0; t < world->shardCount && !shard->detached; t++) {
+      if (t != s && !world->shards[t].detached && boundsOverlap(reach, world->shards[t].fixedRegion)) shard->neighbours[shard->neighbourCount++] = t;
+    }
+    listBorder(world, shard);
+  }
+  world->neighboursReady = 1;
+}
+
+/**
+ * Movement phase of a shard: integrates the owned sprites, bounces them off the gaps and lists the border sprites
+*/
+static void moveShard(SimulationWorld* world, WorldShard* shard) {
+  SpriteStore* store = shard->simulation->sprites;
+  if (shard->detached) {
+    // A detached shard is a scene of its own, its region bounces like the border of a window
+    IntegrateSprites(store, shard->fixedRegion);
+    listBorder(world, shard);
+    return;
+  }
+  // The outer border of the world bounces like the border of a window, the gaps are handled per sprite
+  IntegrateSprites(store, world->fixedBounds);
+  for (int i = 0; i < store->count; i++) {
+    SpriteBounds box = { .left = store->xPos[i], .top = store->yPos[i], .right = store->xPos[i] + store->width[i], .bottom = store->yPos[i] + store->height[i] };
+    if (!boundsInside(box, shard->fixedRegion)) bounceOffGaps(world, shard->fixedRegion, store, i);
+  }
+  listBorder(world, shard);
+}
+
+/**
+ * Halo phase of a shard: appends copies of the neighbour border sprites whose swept box reaches into the halo
+*/
+static void gatherHalo(SimulationWorld* world, WorldShard* shard) {
+  SpriteStore* store = shard->simulation->sprites;
+  SpriteBounds reach = expandBounds(shard->fixedRegion, world->halo);
+  SpriteState state;
+  for (int n = 0; n < shard->neighbourCount; n++) {
+    WorldShard* neighbour = &world->shards[shard->neighbours[n]];
+    const SpriteStore* source = neighbour->simulation->sprites;
+    for (int b = 0; b < neighbour->borderCount; b++) {
+      int j = neighbour->border[b];
+      if (!boundsOverlap(sweptBox(source, j), reach)) continue;
+      ReadSpriteState(source, j, &state);
+      int index = AddSpriteState(store, &state);
+      if (index < 0) return;
+      shard->ids[index] = neighbour->ids[j];
+      shard->haloCopies++;
+    }
+  }
+}
+
+/**
+ * Collision phase of a shard: resolves the collisions of the owned sprites and the halo, drops the halo again
+ * and hands the sprites whose center left the region to the shard of their new region
+*/
+static void collideShard(SimulationWorld* world, WorldShard* shard) {
+  Simulation* simulation = shard->simulation;
+  SpriteStore* store = simulation->sprites;
+  HandleCollisions(simulation->broadphase, store);
+  // The copies were only pushed to push the owned sprites back, their owners resolved the pairs with their own halo
+  TruncateSprites(store, shard->owned);
+  simulation->stats.frames++;
+  simulation->stats.pairs += simulation->broadphase->pairCount;
+  if (shard->detached) return;
+
+  // Handed out after the collisions, so a sprite pushed over the border changes its owner in the same step
+  // Backwards, so the last sprite taking the place of a handed sprite was already checked
+  for (int i = store->count - 1; i >= 0; i--) {
+    int centerX = store->xPos[i] + store->width[i] / 2;
+    int centerY = store->yPos[i] + store->height[i] / 2;
+    if (pointInside(shard->fixedRegion, centerX, centerY)) continue;
+    // A center above a gap (the sprite only overhangs it) stays with its shard
+    int target = findShardAt(world, centerX, centerY);
+    if (target < 0) continue;
+
+    WorldHandoffQueue* inbox = &world->shards[target].inbox;
+    long slot = fetchAddAtomic(&inbox->count, 1);
+    // The queue holds the whole world, a full queue would mean a lost sprite so it is kept instead
+    if (slot >= inbox->capacity) continue;
+    inbox->entries[slot].id = shard->ids[i];
+    ReadSpriteState(store, i, &inbox->entries[slot].state);
+
+    int last = store->total - 1;
+    RemoveSprite(store, i);
+    shard->ids[i] = shard->ids[last];
+  }
+}
+
+/**
+ * Takeover phase of a shard: adds the handed sprites in id order and lists the border sprites for the publish
+*/
+static void takeOverShard(SimulationWorld* world, WorldShard* shard) {
+  SpriteStore* store = shard->simulation->sprites;
+  WorldHandoffQueue* inbox = &shard->inbox;
+  int count = (int)loadAtomic(&inbox->count);
+  if (count > inbox->capacity) count = inbox->capacity;
+
+  // The order of the reservations depends on the thread timing, the id order doesn't
+  qsort(inbox->entries, count, sizeof(WorldHandoff), compareHandoffs);
+  for (int i = 0; i < count; i++) {
+    int index = AddSpriteState(store, &inbox->entries[i].state);
+    if (index >= 0) shard->ids[index] = inbox->entries[i].id;
+  }
+  storeAtomic(&inbox->count, 0);
+  shard->handoffs += count;
+
+  shard->owned = store->count;
+  listBorder(world, shard);
+}
+
+/**
+ * Adds the sprite to the visible list if its interpolated box overlaps the region
+*/
+static void addVisible(WorldShard* shard, int* count, const SpriteStore* store, int index, int id, int alpha) {
+  int x = InterpolateSpritePosition(store->prevX[index], store->xPos[index], alpha);
+  int y = InterpolateSpritePosition(store->prevY[index], store->yPos[index], alpha);
+  int width = store->width[index] >> SPRITE_FIXED_SHIFT;
+  int height = store->height[index] >> SPRITE_FIXED_SHIFT;
+  SpriteBounds box = { .left = x, .top = y, .right = x + width, .bottom = y + height };
+  if (!boundsOverlap(box, shard->region)) return;
+
+  WorldVisibleSprite* visible = &shard->visible[(*count)++];
+  visible->id = id;
+  visible->x = x - shard->region.left;
+  visible->y = y - shard->region.top;
+  visible->width = width;
+  visible->height = height;
+}
+
+/**
+ * Publish phase of a shard: publishes the owned sprites and the border sprites of the neighbours overlapping the region
+*/
+static void publishShard(SimulationWorld* world, WorldShard* shard) {
+  const SpriteStore* store = shard->simulation->sprites;
+  int count = 0;
+  for (int i = 0; i < store->count; i++) addVisible(shard, &count, store, i, shard->ids[i], world->alpha);
+  // Sprites overlapping the region from a neighbour are always border sprites, their box reaches over the region border
+  for (int n = 0; n < shard->neighbourCount; n++) {
+    WorldShard* neighbour = &world->shards[shard->neighbours[n]];
+    for (int b = 0; b < neighbour->borderCount; b++) {
+      int j = neighbour->border[b];
+      addVisible(shard, &count, neighbour->simulation->sprites, j, neighbour->ids[j], world->alpha);
+    }
+  }
+  // Id order is the draw order, so a sprite crossing the border overlaps the others the same way on both monitors
+  qsort(shard->visible, count, sizeof(WorldVisibleSprite), compareVisible);
+
+  SpriteSnapshot* snapshot = BeginSnapshot(shard->snapshots);
+  if (count > snapshot->capacity) count = snapshot->capacity;
+  for (int i = 0; i < count; i++) {
+    snapshot->xPos[i] = shard->visible[i].x;
+    snapshot->yPos[i] = shard->visible[i].y;
+    snapshot->width[i] = shard->visible[i].width;
+    snapshot->height[i] = shard->visible[i].height;
+    snapshot->image[i] = shard->visible[i].id;
+  }
+  snapshot->count = count;
+  CommitSnapshot(shard->snapshots, world->frame);
+}
+
+/**
+ * Runs the current phase on the shard
+*/
+static void runShardPhase(SimulationWorld* world, WorldShard* shard) {
+  switch (world->phase) {
+    case WORLD_PHASE_MOVE: moveShard(world, shard); break;
+    case WORLD_PHASE_HALO: gatherHalo(world, shard); break;
+    case WORLD_PHASE_COLLIDE: collideShard(world, shard); break;
+    case WORLD_PHASE_TAKEOVER: takeOverShard(world, shard); break;
+    case WORLD_PHASE_PUBLISH: publishShard(world, shard); break;
+  }
+}
+
+/**
+ * Takes shards from the shared counter until all shards of the phase are taken
+*/
+static void runShardJobs(SimulationWorld* world) {
+  for (;;) {
+    long job = fetchAddAtomic(&world->nextJob, 1);
+    if (job >= world->shardCount) break;
+    runShardPhase(world, &world->shards[job]);
+  }
+}
+
+/**
+ * Worker job of a helper, runs shards until none is left and then signals the calling thread
+*/
+static void shardHelper(void* context) {
+  SimulationWorld* world = context;
+  runShardJobs(world);
+  fetchAddAtomic(&world->pending, -1);
+}
+
+/**
+ * Runs the phase on all shards (forked onto the helpers) and returns once every shard finished it
+*/
+static void runPhase(SimulationWorld* world, WorldPhase phase) {
+  world->phase = phase;
+  world->nextJob = 0;
+  int helpers = world->shardCount - 1 < world->helperCount ? world->shardCount - 1 : world->helperCount;
+  world->pending = helpers;
+  for (int h = 0; h < helpers; h++) {
+    // A full queue just leaves more shards to the calling thread
+    if (!SubmitWorkerJob(world->pool, shardHelper, world)) fetchAddAtomic(&world->pending, -1);
+  }
+  runShardJobs(world);
+  // The helpers finish the shards they already took, the phase is complete once all of them returned
+  while (loadAtomic(&world->pending) > 0) yieldThread();
+}
+
+/**
+ * Sets the bounds of the world to the bounding box of the attached regions, they are kept if no shard is attached
+*/
+static void updateBounds(SimulationWorld* world) {
+  int first = 1;
+  for (int s = 0; s < world->shardCount; s++) {
+    SpriteBounds region = world->shards[s].region;
+    if (world->shards[s].detached) continue;
+    if (first || region.left < world->bounds.left) world->bounds.left = region.left;
+    if (first || region.top < world->bounds.top) world->bounds.top = region.top;
+    if (first || region.right > world->bounds.right) world->bounds.right = region.right;
+    if (first || region.bottom > world->bounds.bottom) world->bounds.bottom = region.bottom;
+    first = 0;
+  }
+  world->fixedBounds = toFixed(world->bounds);
+}
+
+/**
+ * Moves the sprite into the region (fixed point), it shows up there without interpolating from its old position
+*/
+static void clampIntoRegion(SpriteStore* store, int i, SpriteBounds region) {
+  if (store->xPos[i] + store->width[i] > region.right) store->xPos[i] = region.right - store->width[i];
+  if (store->xPos[i] < region.left) store->xPos[i] = region.left;
+  if (store->yPos[i] + store->height[i] > region.bottom) store->yPos[i] = region.bottom - store->height[i];
+  if (store->yPos[i] < region.top) store->yPos[i] = region.top;
+  store->prevX[i] = store->xPos[i];
+  store->prevY[i] = store->yPos[i];
+}
+
+/**
+ * Hands the sprites of the shard to the attached shard their center lies in after the regions changed
+ *
+ * Sprites not completely inside the attached regions (left in a new gap or on a removed region) are moved into the
+ * region of the shard their center lies in or else the nearest one. If no shard is attached the sprites stay.
+*/
+static void settleShard(SimulationWorld* world, int s) {
+  WorldShard* shard = &world->shards[s];
+  SpriteStore* store = shard->simulation->sprites;
+  for (int i = store->count - 1; i >= 0; i--) {
+    int centerX = store->xPos[i] + store->width[i] / 2;
+    int centerY = store->yPos[i] + store->height[i] / 2;
+    int target = findShardAt(world, centerX, centerY);
+    if (target < 0) target = findNearestShard(world, centerX, centerY);
+    if (target < 0) break;
+
+    WorldShard* owner = &world->shards[target];
+    if (target != s || coveredCorners(world, store->xPos[i], store->yPos[i], store->width[i], store->height[i]) < 4) {
+      clampIntoRegion(store, i, owner->fixedRegion);
+    }
+    if (target == s) continue;
+
+    SpriteState state;
+    ReadSpriteState(store, i, &state);
+    int index = AddSpriteState(owner->simulation->sprites, &state);
+    // Every store holds the whole world, so the sprite always fits
+    if (index < 0) continue;
+    owner->ids[index] = shard->ids[i];
+    owner->owned = owner->simulation->sprites->count;
+    owner->handoffs++;
+
+    int last = store->total - 1;
+    RemoveSprite(store, i);
+    shard->ids[i] = shard->ids[last];
+  }
+  shard->owned = store->count;
+}
+
+/**
+ * Waits until no other thread advances the world and takes it over
+*/
+static void lockWorld(SimulationWorld* world) {
+  while (!compareExchangeAtomic(&world->busy, 0, 1)) yieldThread();
+}
+
+/**
+ * Create a world over the regions (in pixels, e.g. the monitor rects on the virtual desktop) for up to capacity sprites
+ *
+ * helperCount is the count of helper threads, 0 steps on the calling thread only, < 0 uses one helper per further
+ * logical processor (capped to the count of regions). If there are no regions, more than WORLD_MAX_SHARDS,
+ * overlapping regions or the allocation fails it returns NULL
+*/
+SimulationWorld* CreateSimulationWorld(
+  const SpriteBounds* regions,
+  int regionCount,
+  int capacity,
+  BroadphaseKind broadphase,
+  SimulationConfig config,
+  int helperCount) {
+
+  if (regionCount < 1 || regionCount > WORLD_MAX_SHARDS || capacity < 1) return NULL;
+  // Every point of the world must have exactly one owner
+  for (int s = 0; s < regionCount; s++) {
+    if (regions[s].right <= regions[s].left || regions[s].bottom <= regions[s].top) return NULL;
+    for (int t = s + 1; t < regionCount; t++) {
+      if (boundsOverlap(regions[s], regions[t])) return NULL;
+    }
+  }
+
+  SimulationWorld* world = calloc(1, sizeof(SimulationWorld));
+  if (!world) return NULL;
+  if (config.stepRate <= 0.0) config.stepRate = SIMULATION_REFERENCE_RATE;
+  world->config = config;
+  world->stepPeriod = 1000.0 / config.stepRate;
+  world->capacity = capacity;
+  SeedRandomGenerator(&world->random, config.seed);
+
+  world->shards = calloc(regionCount, sizeof(WorldShard));
+  if (!world->shards) {
+    free(world);
+    return NULL;
+  }
+  world->shardCount = regionCount;
+  for (int s = 0; s < regionCount; s++) {
+    WorldShard* shard = &world->shards[s];
+    shard->region = regions[s];
+    shard->fixedRegion = toFixed(regions[s]);
+    // Every shard gets its own spawn sequence, but the same seed always reproduces the whole world
+    SimulationConfig shardConfig = config;
+    shardConfig.seed = config.seed + s;
+    // The owned sprites and the halo copies can each be the whole world at most
+    shard->simulation = CreateSimulation(capacity * 2, broadphase, shardConfig);
+    shard->ids = malloc(sizeof(int) * capacity * 2);
+    shard->border = malloc(sizeof(int) * capacity);
+    shard->inbox.entries = malloc(sizeof(WorldHandoff) * capacity);
+    shard->inbox.capacity = capacity;
+    shard->snapshots = CreateSnapshotBuffer(capacity);
+    shard->visible = malloc(sizeof(WorldVisibleSprite) * capacity);
+    if (!shard->simulation || !shard->ids || !shard->border || !shard->inbox.entries || !shard->snapshots || !shard->visible) {
+      CloseSimulationWorld(world);
+      return NULL;
+    }
+    shard->simulation->id = s;
+  }
+  updateBounds(world);
+
+  // The calling thread simulates shards as well, more helpers than further shards would only wait
+  if (helperCount < 0) helperCount = GetProcessorCount() - 1;
+  if (helperCount > regionCount - 1) helperCount = regionCount - 1;
+  if (helperCount > MAX_WORKERS) helperCount = MAX_WORKERS;
+  if (helperCount > 0) {
+    world->pool = CreateWorkerPool(helperCount);
+    if (!world->pool) {
+      CloseSimulationWorld(world);
+      return NULL;
+    }
+    world->helperCount = world->pool->threadCount;
+  }
+  return world;
+}
+
+/**
+ * Stops the helpers and cleans up the world and its shards
+*/
+void CloseSimulationWorld(SimulationWorld* world) {
+  if (world) {
+    if (world->pool) CloseWorkerPool(world->pool);
+    for (int s = 0; s < world->shardCount; s++) {
+      WorldShard* shard = &world->shards[s];
+      CloseSimulation(shard->simulation);
+      free(shard->ids);
+      free(shard->border);
+      free(shard->inbox.entries);
+      CloseSnapshotBuffer(shard->snapshots);
+      free(shard->visible);
+    }
+    free(world->shards);
+    free(world);
+  }
+}
+
+/**
+ * Returns the index of the attached shard covering exactly the region (in pixels) or -1 if the region is not a shard of the world
+*/
+int FindWorldShard(const SimulationWorld* world, SpriteBounds region) {
+  for (int s = 0; s < world->shardCount; s++) {
+    SpriteBounds shard = world->shards[s].region;
+    if (world->shards[s].detached) continue;
+    if (shard.left == region.left && shard.top == region.top && shard.right == region.right && shard.bottom == region.bottom) return s;
+  }
+  return -1;
+}
+
+/**
+ * Moves the region of the shard to the new rect of its monitor (in pixels), e.g. after a resolution change
+ *
+ * Sprites left outside of all regions are moved into the nearest one, sprites whose center now lies in another
+ * region change their owner. If the new region overlaps another shard the shard is detached and keeps its sprites
+ * in the new region on its own. Waits for a running advance, must not be called by a thread advancing the world.
+*/
+void MoveWorldShard(SimulationWorld* world, int shard, SpriteBounds region) {
+  if (shard < 0 || shard >= world->shardCount || region.right <= region.left || region.bottom <= region.top) return;
+  lockWorld(world);
+
+  WorldShard* moved = &world->shards[shard];
+  moved->region = region;
+  moved->fixedRegion = toFixed(region);
+  for (int t = 0; t < world->shardCount && !moved->detached; t++) {
+    // Every point of the world must keep exactly one owner
+    if (t != shard && !world->shards[t].detached && boundsOverlap(region, world->shards[t].region)) moved->detached = 1;
+  }
+  if (moved->detached) {
+    SpriteStore* store = moved->simulation->sprites;
+    for (int i = 0; i < store->count; i++) clampIntoRegion(store, i, moved->fixedRegion);
+  }
+  updateBounds(world);
+  for (int s = 0; s < world->shardCount; s++) {
+    if (!world->shards[s].detached) settleShard(world, s);
+  }
+  world->neighboursReady = 0;
+
+  storeAtomic(&world->busy, 0);
+}
+
+/**
+ * Detaches the shard of a removed monitor, its sprites are moved into the nearest region of the attached shards
+ *
+ * The frames of the shard stay valid until the world is closed. If no attached shard is left the sprites stay
+ * with the detached shard. Waits for a running advance, must not be called by a thread advancing the world.
+*/
+void RemoveWorldShard(SimulationWorld* world, int shard) {
+  if (shard < 0 || shard >= world->shardCount) return;
+  lockWorld(world);
+
+  world->shards[shard].detached = 1;
+  updateBounds(world);
+  settleShard(world, shard);
+  // The removed region may have been the only part of the world between other regions, it is a gap now
+  for (int s = 0; s < world->shardCount; s++) {
+    if (!world->shards[s].detached) settleShard(world, s);
+  }
+  world->neighboursReady = 0;
+
+  storeAtomic(&world->busy, 0);
+}
+
+/**
+ * Spawns a sprite with the provided size (in pixels) into a random shard, weighted by the area of the regions
+ *
+ * Returns the id of the sprite or -1 if the world is full. Must not be called while the world is stepped.
+*/
+int SpawnWorldSprite(SimulationWorld* world, int width, int height) {
+  if (world->total >= world->capacity) return -1;
+
+  // Large monitors get proportionally more sprites, so the density is the same on every monitor
+  unsigned long long area = 0;
+  for (int s = 0; s < world->shardCount; s++) {
+    SpriteBounds region = world->shards[s].region;
+    if (!world->shards[s].detached) area += (unsigned long long)(region.right - region.left) * (region.bottom - region.top);
+  }
+  if (area == 0) return -1;
+  unsigned long long pick = NextRandom(&world->random) % area;
+  int target = 0;
+  for (; target < world->shardCount; target++) {
+    SpriteBounds region = world->shards[target].region;
+    if (world->shards[target].detached) continue;
+    unsigned long long size = (unsigned long long)(region.right - region.left) * (region.bottom - region.top);
+    if (pick < size) break;
+    pick -= size;
+  }
+
+  WorldShard* shard = &world->shards[target];
+  int index = SpawnSprite(shard->simulation, shard->region, width, height);
+  if (index < 0) return -1;
+  int id = world->total++;
+  shard->ids[index] = id;
+  shard->owned = shard->simulation->sprites->count;
+
+  // The halo has to cover the largest sprite on both sides of a border
+  int halo = 2 * SPRITE_TO_FIXED(width > height ? width : height);
+  if (halo > world->halo) world->halo = halo;
+  world->neighboursReady = 0;
+  return id;
+}
+
+/**
+ * Advances the world by one fixed step (movement, halo, collisions and handoff, takeover)
+*/
+void StepSimulationWorld(SimulationWorld* world) {
+  prepareWorld(world);
+  runPhase(world, WORLD_PHASE_MOVE);
+  runPhase(world, WORLD_PHASE_HALO);
+  runPhase(world, WORLD_PHASE_COLLIDE);
+  runPhase(world, WORLD_PHASE_TAKEOVER);
+  world->steps++;
+}
+
+/**
+ * Advances the world by the elapsed time in ms, running as many fixed steps as fit into it
+ *
+ * Returns the interpolation factor between the previous and the current step positions (see AdvanceSimulation())
+*/
+int AdvanceSimulationWorld(SimulationWorld* world, double elapsed) {
+  if (elapsed > 0.0) world->accumulator += elapsed;
+
+  int steps = 0;
+  while (world->accumulator >= world->stepPeriod) {
+    if (steps == SIMULATION_MAX_STEPS) {
+      // Same as a single simulation, the time lost in a stall is dropped instead of caught up
+      world->accumulator = 0.0;
+      break;
+    }
+    StepSimulationWorld(world);
+    world->accumulator -= world->stepPeriod;
+    steps++;
+  }
+
+  int alpha = (int)(world->accumulator / world->stepPeriod * SPRITE_FIXED_ONE);
+  return alpha < 0 ? 0 : (alpha > SPRITE_FIXED_ONE ? SPRITE_FIXED_ONE : alpha);
+}
+
+/**
+ * Publishes the sprites visible in the region of every shard into its snapshots, relative to the origin of the region
+ *
+ * The sprites are interpolated by alpha and sorted by id, overlapping sprites are drawn in the same order on every monitor
+*/
+void PublishSimulationWorld(SimulationWorld* world, int alpha) {
+  prepareWorld(world);
+  world->alpha = alpha;
+  world->frame++;
+  runPhase(world, WORLD_PHASE_PUBLISH);
+}
+
+/**
+ * Advances the world to now (in ms) and publishes the frames of all shards
+ *
+ * Called by the loops of all windows of the world. A call arriving while another thread advances the world
+ * returns right away and the window paints the latest frames of its shard, the advance in progress publishes
+ * the next ones. A call within WORLD_SYNC_SLACK ms of the last advance takes its frames as well, so the windows
+ * of monitors ticking together show the same step. Returns 1 if the call advanced the world itself
+*/
+int SyncSimulationWorld(SimulationWorld* world, double now) {
+  // A window loop never waits for the others, the frames already published are at most one advance old
+  if (!compareExchangeAtomic(&world->busy, 0, 1)) return 0;
+
+  if (world->lastAdvance > 0.0 && now - world->lastAdvance < WORLD_SYNC_SLACK) {
+    storeAtomic(&world->busy, 0);
+    return 0;
+  }
+  double elapsed = world->lastAdvance > 0.0 ? now - world->lastAdvance : 0.0;
+  world->lastAdvance = now;
+  int alpha = AdvanceSimulationWorld(world, elapsed);
+  PublishSimulationWorld(world, alpha);
+
+  storeAtomic(&world->busy, 0);
+  return 1;
+}
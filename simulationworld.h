@@ -0,0 +1,223 @@
+#ifndef SIMULATIONWORLD_H
+#define SIMULATIONWORLD_H
+
+#include "simulation.h"
+#include "framesnapshot.h"
+#include "workerpool.h"
+
+// Maximum count of shards (monitor regions) of a world
+#define WORLD_MAX_SHARDS 64
+// Windows syncing within this time in ms after the last advance take its frames instead of advancing again
+#define WORLD_SYNC_SLACK 1.0
+
+/**
+ * Sprite handed from one shard to another, together with its world id
+*/
+typedef struct {
+  // World id of the sprite (the index of its image)
+  int id;
+  // Complete movement state of the sprite
+  SpriteState state;
+} WorldHandoff;
+
+/**
+ * Lock-free queue of the sprites handed to a shard during the movement phase
+ *
+ * Every producing shard reserves its entry with a single atomic increment and writes it, producers never wait
+ * on each other. The owner only reads the queue after all producers finished the phase, sorted by id,
+ * so the result doesn't depend on which thread handed its sprite over first.
+*/
+typedef struct {
+  // Handed sprites, entries from count on are unused
+  WorldHandoff* entries;
+  // Count of entries the queue can hold (the capacity of the world, so a queue never overflows)
+  int capacity;
+  // Count of reserved entries
+  volatile long count;
+} WorldHandoffQueue;
+
+/**
+ * Box of a sprite visible in a region, relative to the origin of the region in pixels
+*/
+typedef struct {
+  // World id of the sprite
+  int id;
+  // Interpolated box of the sprite
+  int x;
+  int y;
+  int width;
+  int height;
+} WorldVisibleSprite;
+
+/**
+ * Part of the world simulated by one thread at a time, covering the region of one monitor
+*/
+typedef struct {
+  // Region of the monitor on the virtual desktop in pixels and in fixed point units
+  SpriteBounds region;
+  SpriteBounds fixedRegion;
+  // Sprites owned by the shard (their center lies in the region), followed by the halo copies during the collision phase
+  Simulation* simulation;
+  // World id of every sprite of the simulation
+  int* ids;
+  // Count of owned sprites, the halo copies behind them are dropped after the collision phase
+  int owned;
+  // Owned sprites within the halo width of the region border (their indices), the neighbours copy them into their halo
+  int* border;
+  int borderCount;
+  // Sprites handed over by the other shards, taken over in the next phase
+  WorldHandoffQueue inbox;
+  // Shards whose region lies within the halo of this region
+  int neighbours[WORLD_MAX_SHARDS];
+  int neighbourCount;
+  // Frames of the region (relative to its origin) published for the window of the monitor
+  SnapshotBuffer* snapshots;
+  // Scratch list of the sprites visible in the region, sorted by id before it is published
+  WorldVisibleSprite* visible;
+  // Count of sprites taken over from other shards and of halo copies over all steps
+  long long handoffs;
+  long long haloCopies;
+  // Set once the shard left the world: its monitor was removed (its sprites were handed to the other shards)
+  // or moved onto the region of another shard (it keeps simulating its sprites in its own region, like a window scene)
+  int detached;
+} WorldShard;
+
+/**
+ * Single simulation spanning the regions of all monitors, so sprites fly from one monitor onto the next
+ *
+ * The world is sharded per monitor region. Every step runs in phases, each one forked over the shards
+ * onto the calling thread and the helpers of the pool (like the tiles of the compositor):
+ * movement (the owned sprites are integrated and the ones near the border are listed), halo (every shard copies
+ * the border sprites of its neighbours next to its own), collisions (all pairs are resolved, the copies are dropped
+ * and sprites whose center left the region are handed to the owner of their new region through its lock-free inbox)
+ * and takeover (the inbox is drained in id order).
+ * A shard only ever writes its own state during a phase, the phases are separated by the join of the helpers.
+ *
+ * Both shards of a pair crossing a border resolve the collision, each one keeps the result for its own sprite.
+ * They start from the same positions, but each shard only sees its own halo and resolves its pairs in its own order,
+ * so a pair whose sprites collide with different neighbours can be left overlapping until a later step (like
+ * the chains within a shard). The result of a step doesn't depend on the count of helpers.
+ *
+ * The region between the monitors (e.g. a gap or the corner of an L shaped layout) is not part of the world,
+ * sprites bounce off it like off the outer border. The regions follow the display changes of the running world,
+ * see MoveWorldShard() and RemoveWorldShard().
+*/
+typedef struct {
+  // Shards of the world, one per monitor region
+  WorldShard* shards;
+  int shardCount;
+  // Bounding box of the regions of all attached shards in pixels and in fixed point units
+  SpriteBounds bounds;
+  SpriteBounds fixedBounds;
+  // Count of sprites the world can hold and count of spawned sprites (the ids are 0 to total - 1)
+  int capacity;
+  int total;
+  // Width of the halo in fixed point units (twice the largest sprite size)
+  int halo;
+  // Set once the neighbours of all shards are known for the current halo width
+  int neighboursReady;
+  // Configuration of the spawned sprites, the shards run with the same one
+  SimulationConfig config;
+  // Generator choosing the shard of the spawned sprites
+  RandomGenerator random;
+
+  // Duration of one fixed step in ms, elapsed time not yet consumed by a step and time of the last advance (0 before the first one)
+  double stepPeriod;
+  double accumulator;
+  double lastAdvance;
+  // Count of simulated steps and number of the last published frame
+  long long steps;
+  long long frame;
+  // Set while a thread advances the world or changes its regions, the windows of the other monitors skip their advance
+  volatile long busy;
+
+  // Helpers simulating shards next to the calling thread (NULL if stepping on the calling thread only)
+  WorkerPool* pool;
+  int helperCount;
+  // Phase executed by the current fork, its interpolation factor if it publishes frames
+  int phase;
+  int alpha;
+  // Index of the next shard to take and count of helpers still running on the current phase
+  volatile long nextJob;
+  volatile long pending;
+} SimulationWorld;
+
+/**
+ * Create a world over the regions (in pixels, e.g. the monitor rects on the virtual desktop) for up to capacity sprites
+ *
+ * helperCount is the count of helper threads, 0 steps on the calling thread only, < 0 uses one helper per further
+ * logical processor (capped to the count of regions). If there are no regions, more than WORLD_MAX_SHARDS,
+ * overlapping regions or the allocation fails it returns NULL
+*/
+SimulationWorld* CreateSimulationWorld(
+  const SpriteBounds* regions,
+  int regionCount,
+  int capacity,
+  BroadphaseKind broadphase,
+  SimulationConfig config,
+  int helperCount);
+
+/**
+ * Stops the helpers and cleans up the world and its shards
+*/
+void CloseSimulationWorld(SimulationWorld* world);
+
+/**
+ * Returns the index of the attached shard covering exactly the region (in pixels) or -1 if the region is not a shard of the world
+*/
+int FindWorldShard(const SimulationWorld* world, SpriteBounds region);
+
+/**
+ * Moves the region of the shard to the new rect of its monitor (in pixels), e.g. after a resolution change
+ *
+ * Sprites left outside of all regions are moved into the nearest one, sprites whose center now lies in another
+ * region change their owner. If the new region overlaps another shard the shard is detached and keeps its sprites
+ * in the new region on its own. Waits for a running advance, must not be called by a thread advancing the world.
+*/
+void MoveWorldShard(SimulationWorld* world, int shard, SpriteBounds region);
+
+/**
+ * Detaches the shard of a removed monitor, its sprites are moved into the nearest region of the attached shards
+ *
+ * The frames of the shard stay valid until the world is closed. If no attached shard is left the sprites stay
+ * with the detached shard. Waits for a running advance, must not be called by a thread advancing the world.
+*/
+void RemoveWorldShard(SimulationWorld* world, int shard);
+
+/**
+ * Spawns a sprite with the provided size (in pixels) into a random shard, weighted by the area of the regions
+ *
+ * Returns the id of the sprite or -1 if the world is full. Must not be called while the world is stepped.
+*/
+int SpawnWorldSprite(SimulationWorld* world, int width, int height);
+
+/**
+ * Advances the world by one fixed step (movement, halo, collisions and handoff, takeover)
+*/
+void StepSimulationWorld(SimulationWorld* world);
+
+/**
+ * Advances the world by the elapsed time in ms, running as many fixed steps as fit into it
+ *
+ * Returns the interpolation factor between the previous and the current step positions (see AdvanceSimulation())
+*/
+int AdvanceSimulationWorld(SimulationWorld* world, double elapsed);
+
+/**
+ * Publishes the sprites visible in the region of every shard into its snapshots, relative to the origin of the region
+ *
+ * The sprites are interpolated by alpha and sorted by id, overlapping sprites are drawn in the same order on every monitor
+*/
+void PublishSimulationWorld(SimulationWorld* world, int alpha);
+
+/**
+ * Advances the world to now (in ms) and publishes the frames of all shards
+ *
+ * Called by the loops of all windows of the world. A call arriving while another thread advances the world
+ * returns right away and the window paints the latest frames of its shard, the advance in progress publishes
+ * the next ones. A call within WORLD_SYNC_SLACK ms of the last advance takes its frames as well, so the windows
+ * of monitors ticking together show the same step. Returns 1 if the call advanced the world itself
+*/
+int SyncSimulationWorld(SimulationWorld* world, double now);
+
+#endif
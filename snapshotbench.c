@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "framesnapshot.h"
+#include "framescheduler.h"
+
+// Positions are encoded modulo this value, so they stay far away from an overflow of the fixed point units
+#define BENCH_POSITION_RANGE 1000000
+
+/**
+ * State shared by the producer and the consumer thread
+*/
+typedef struct {
+  SnapshotBuffer* snapshots;
+  // Sprites the producer publishes from (capacity sprites, the count changes every frame)
+  SpriteStore* sprites;
+  int capacity;
+  // Frames published by the producer
+  long long frames;
+  // Set by the producer once it published all frames
+  volatile long done;
+} BenchShared;
+
+/**
+ * Count of sprites published with the frame
+*/
+static int countOf(long long frame, int capacity) {
+  return 1 + (int)(frame % capacity);
+}
+
+/**
+ * Returns 1 if every value of the snapshot belongs to the frame it is tagged with
+*/
+static int consistent(const SpriteSnapshot* snapshot, int capacity) {
+  long long frame = snapshot->frame;
+  if (snapshot->count != countOf(frame, capacity)) return 0;
+  int base = (int)(frame % BENCH_POSITION_RANGE);
+  for (int i = 0; i < snapshot->count; i++) {
+    if (snapshot->xPos[i] != base + i || snapshot->yPos[i] != base - i || snapshot->width[i] != 1 + (base + i) % 64 ||
+        snapshot->height[i] != 1 + (base + 2 * i) % 64 || snapshot->image[i] != i) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Producer thread: writes every frame into the sprite store like a step of the simulation and publishes it
+*/
+static void* produce(void* context) {
+  BenchShared* shared = context;
+  SpriteStore* sprites = shared->sprites;
+  for (long long frame = 1; frame <= shared->frames; frame++) {
+    int base = (int)(frame % BENCH_POSITION_RANGE);
+    sprites->count = countOf(frame, shared->capacity);
+    for (int i = 0; i < sprites->count; i++) {
+      // The previous position is stale on purpose, alpha SPRITE_FIXED_ONE publishes the current one
+      sprites->prevX[i] = 0;
+      sprites->prevY[i] = 0;
+      sprites->xPos[i] = SPRITE_TO_FIXED(base + i);
+      sprites->yPos[i] = SPRITE_TO_FIXED(base - i);
+      sprites->width[i] = SPRITE_TO_FIXED(1 + (base + i) % 64);
+      sprites->height[i] = SPRITE_TO_FIXED(1 + (base + 2 * i) % 64);
+    }
+    PublishSnapshot(shared->snapshots, sprites, SPRITE_FIXED_ONE, frame);
+  }
+  __atomic_store_n(&shared->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/**
+ * Headless stress test of the lock-free snapshot triple buffer
+ *
+ * Not part of the screensaver build, it only needs the platform neutral snapshot module:
+ * cc -O2 -o snapshotbench snapshotbench.c framesnapshot.c dirtyregion.c spritestore.c framescheduler.c -lm -lpthread
+ * ./snapshotbench [sprites] [frames]
+ *
+ * A producer thread publishes frames as fast as it can, every value of a frame (count, positions, sizes and images)
+ * is derived from its frame number. The consumer thread acquires snapshots concurrently and checks that every
+ * snapshot belongs to a single frame, that the frame numbers never go backwards and that an acquired snapshot
+ * stays unchanged until the next acquire (checked once more after the producer had time to publish).
+ * Exits with 1 if a torn or changing snapshot was seen. Also worth running with -fsanitize=thread.
+*/
+int main(int argc, char** argv) {
+  int capacity = argc > 1 ? atoi(argv[1]) : 256;
+  long long frames = argc > 2 ? atoll(argv[2]) : 2000000;
+  if (capacity < 1 || frames < 1) {
+    fprintf(stderr, "usage: %s [sprites] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  BenchShared shared = {
+    .snapshots = CreateSnapshotBuffer(capacity),
+    .sprites = CreateSpriteStore(capacity),
+    .capacity = capacity,
+    .frames = frames,
+    .done = 0
+  };
+  if (!shared.snapshots || !shared.sprites) {
+    fprintf(stderr, "the snapshots could not be created\n");
+    return 1;
+  }
+
+  double start = FrameSchedulerNow();
+  pthread_t producer;
+  if (pthread_create(&producer, NULL, produce, &shared) != 0) return 1;
+
+  long long acquired = 0, fresh = 0, torn = 0, changed = 0, backwards = 0, last = 0;
+  for (;;) {
+    int done = __atomic_load_n(&shared.done, __ATOMIC_ACQUIRE);
+    const SpriteSnapshot* snapshot = AcquireSnapshot(shared.snapshots);
+    acquired++;
+    // Frame 0 is the empty buffer before the first publish
+    if (snapshot->frame != 0) {
+      if (!consistent(snapshot, capacity)) torn++;
+      if (snapshot->frame < last) backwards++;
+      if (snapshot->frame > last) fresh++;
+      last = snapshot->frame;
+
+      // Give the producer time to publish a few frames, the snapshot of the consumer must not change meanwhile
+      if (acquired % 64 == 0) {
+        long long frame = snapshot->frame;
+        for (volatile int spin = 0; spin < 20000; spin++) {}
+        if (snapshot->frame != frame || !consistent(snapshot, capacity)) changed++;
+      }
+    }
+    // The last acquire after the producer finished must see the last frame
+    if (done) break;
+  }
+  pthread_join(producer, NULL);
+  double duration = FrameSchedulerNow() - start;
+
+  int failed = torn > 0 || changed > 0 || backwards > 0 || last != frames;
+  printf("%lld frames of up to %d sprites in %.0f ms: %lld acquires, %lld new frames, %lld torn, %lld changed while held, "
+    "%lld backwards, last frame %lld%s\n",
+    frames, capacity, duration, acquired, fresh, torn, changed, backwards, last, failed ? ", FAILED" : "");
+
+  CloseSnapshotBuffer(shared.snapshots);
+  CloseSpriteStore(shared.sprites);
+  return failed;
+}
@@ -0,0 +1,321 @@
+#include "spriteanimation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "framescheduler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+/**
+ * Atomically reads the value
+*/
+static long loadAtomic(volatile long* value) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(value, 0, 0);
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Atomically writes the value, all writes before are visible to a thread reading the value
+*/
+static void storeAtomic(volatile long* value, long desired) {
+#ifdef _WIN32
+  InterlockedExchange(value, desired);
+#else
+  __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Atomically adds to the 64 bit value
+*/
+static void addAtomic64(volatile long long* value, long long addend) {
+#ifdef _WIN32
+  InterlockedExchangeAdd64(value, addend);
+#else
+  __atomic_fetch_add(value, addend, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * Yields the rest of the timeslice while waiting for the decoder
+*/
+static void yieldThread() {
+#ifdef _WIN32
+  Sleep(0);
+#else
+  sched_yield();
+#endif
+}
+
+/**
+ * Maps the sprite stream at path and starts its decoder thread
+ *
+ * If the file is not a valid sprite stream or the allocation fails it returns NULL
+*/
+SpriteAnimation* OpenSpriteAnimation(const char* path) {
+  MappedFile* file = OpenMappedFile(path);
+  if (!file) return NULL;
+
+  // Validate the header before any frame is read from the mapping
+  SpriteStreamHeader header;
+  int valid = file->size >= sizeof(SpriteStreamHeader);
+  if (valid) {
+    memcpy(&header, file->data, sizeof(SpriteStreamHeader));
+    valid = header.magic == SPRITE_STREAM_MAGIC && header.version == SPRITE_STREAM_VERSION &&
+      header.width > 0 && header.width <= ANIMATION_MAX_SIZE && header.height > 0 && header.height <= ANIMATION_MAX_SIZE &&
+      header.frameCount > 0 && header.frameDuration > 0 &&
+      (file->size - sizeof(SpriteStreamHeader)) / header.frameCount / header.width / header.height / sizeof(uint32_t) >= 1;
+  }
+  SpriteAnimation* animation = valid ? calloc(1, sizeof(SpriteAnimation)) : NULL;
+  if (!animation) {
+    CloseMappedFile(file);
+    return NULL;
+  }
+  animation->file = file;
+  animation->header = header;
+
+  // One decoder is enough, it only has to stay ahead of the frame rate of the animation
+  animation->decoder = CreateWorkerPool(1);
+  if (!animation->decoder) {
+    CloseSpriteAnimation(animation);
+    return NULL;
+  }
+  return animation;
+}
+
+/**
+ * Opens the sprite stream of ANIMATION_ENVIRONMENT_VARIABLE, returns NULL if it is not set or invalid
+*/
+SpriteAnimation* OpenSpriteAnimationFromEnvironment() {
+  const char* path = getenv(ANIMATION_ENVIRONMENT_VARIABLE);
+  if (!path || !*path) return NULL;
+  return OpenSpriteAnimation(path);
+}
+
+/**
+ * Stops the decoder and cleans up the animation, all tracks must be released before
+*/
+void CloseSpriteAnimation(SpriteAnimation* animation) {
+  if (animation) {
+    CloseWorkerPool(animation->decoder);
+    CloseMappedFile(animation->file);
+    free(animation->tracks);
+    free(animation);
+  }
+}
+
+/**
+ * Returns the track of the animation scaled to width (0 keeps the native size) and increments its reference count
+ *
+ * Returns NULL if the allocation fails
+*/
+AnimationTrack* AcquireAnimationTrack(SpriteAnimation* animation, int width, ResampleFilter filter) {
+  int nativeWidth = (int)animation->header.width;
+  int nativeHeight = (int)animation->header.height;
+  // The height keeps the aspect ratio of the frames, like the scaled logo
+  int height = width > 0 ? (int)((double)width / nativeWidth * nativeHeight) : nativeHeight;
+  if (width <= 0) width = nativeWidth;
+  if (height < 1) height = 1;
+
+  for (int i = 0; i < animation->trackCount; i++) {
+    AnimationTrack* track = animation->tracks[i];
+    if (track->width == width && track->height == height && track->filter == (int)filter) {
+      track->references++;
+      return track;
+    }
+  }
+
+  if (animation->trackCount == animation->trackCapacity) {
+    int capacity = animation->trackCapacity ? animation->trackCapacity * 2 : 4;
+    AnimationTrack** tracks = realloc(animation->tracks, sizeof(AnimationTrack*) * capacity);
+    if (!tracks) return NULL;
+    animation->tracks = tracks;
+    animation->trackCapacity = capacity;
+  }
+  AnimationTrack* track = calloc(1, sizeof(AnimationTrack));
+  if (!track) return NULL;
+  track->animation = animation;
+  track->width = width;
+  track->height = height;
+  track->filter = filter;
+  track->references = 1;
+  for (int i = 0; i < ANIMATION_RING_FRAMES; i++) {
+    track->slots[i].frame = -1;
+    track->slots[i].state = ANIMATION_SLOT_EMPTY;
+    track->slots[i].track = track;
+  }
+  animation->tracks[animation->trackCount++] = track;
+  return track;
+}
+
+/**
+ * Waits until the decoder finished the frame of the slot (returns immediately if the slot isn't decoding)
+*/
+static void waitSlot(AnimationSlot* slot) {
+  while (loadAtomic(&slot->state) == ANIMATION_SLOT_DECODING) yieldThread();
+}
+
+/**
+ * Waits until the decoder finished all frames of the track that are decoded ahead (e.g. before reading the statistics)
+*/
+void WaitAnimationTrack(AnimationTrack* track) {
+  for (int i = 0; i < ANIMATION_RING_FRAMES; i++) waitSlot(&track->slots[i]);
+}
+
+/**
+ * Decrements the reference count of the track, the track and its frames are released when no references are left
+*/
+void ReleaseAnimationTrack(AnimationTrack* track) {
+  if (!track || --track->references > 0) return;
+
+  // Frames still decoding ahead write into the slots, so they are awaited before the track is freed
+  WaitAnimationTrack(track);
+  for (int i = 0; i < ANIMATION_RING_FRAMES; i++) CloseCompiledSprite(track->slots[i].sprite);
+  SpriteAnimation* animation = track->animation;
+  for (int i = 0; i < animation->trackCount; i++) {
+    if (animation->tracks[i] != track) continue;
+    // Order of the tracks is irrelevant, the last one fills the gap
+    animation->tracks[i] = animation->tracks[--animation->trackCount];
+    break;
+  }
+  free(track);
+}
+
+/**
+ * Decodes the frame of the animation at width x height (premultiplied alpha, ready to be blitted)
+ *
+ * The pages of the frame are released from the resident set afterwards.
+ * Returns NULL if the allocation fails.
+*/
+CompiledSprite* DecodeAnimationFrame(SpriteAnimation* animation, int frame, int width, int height, ResampleFilter filter) {
+  int nativeWidth = (int)animation->header.width;
+  int nativeHeight = (int)animation->header.height;
+  size_t frameSize = sizeof(uint32_t) * (size_t)nativeWidth * nativeHeight;
+  size_t offset = sizeof(SpriteStreamHeader) + frameSize * frame;
+  // The header is 4 byte aligned and the mapping starts on a page, so the pixels can be read in place
+  const uint32_t* source = (const uint32_t*)(animation->file->data + offset);
+
+  CompiledSprite* sprite = NULL;
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)width * height);
+  if (pixels && width == nativeWidth && height == nativeHeight) {
+    // Native size only converts straight into premultiplied alpha, no filter is involved
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+      uint32_t pixel = source[i];
+      uint32_t alpha = pixel >> 24;
+      uint32_t red = ((pixel >> 16) & 0xFF) * alpha / 255;
+      uint32_t green = ((pixel >> 8) & 0xFF) * alpha / 255;
+      uint32_t blue = (pixel & 0xFF) * alpha / 255;
+      pixels[i] = alpha << 24 | red << 16 | green << 8 | blue;
+    }
+    sprite = CompileAlphaSprite(pixels, width, height, width);
+  } else if (pixels) {
+    ResampleSource* resampleSource = CreateResampleSourceAlpha(source, nativeWidth, nativeHeight, nativeWidth);
+    if (resampleSource && ResampleSpritePremultiplied(resampleSource, pixels, width, height, width, filter)) {
+      sprite = CompileAlphaSprite(pixels, width, height, width);
+    }
+    CloseResampleSource(resampleSource);
+  }
+  free(pixels);
+
+  // The frame is not read again until the animation loops, so its pages don't have to stay resident
+  ReleaseMappedRange(animation->file, offset, frameSize);
+  return sprite;
+}
+
+/**
+ * Decodes the frame of the slot into the slot and marks it ready
+*/
+static void decodeSlot(AnimationSlot* slot) {
+  AnimationTrack* track = slot->track;
+  double start = FrameSchedulerNow();
+  slot->sprite = DecodeAnimationFrame(track->animation, slot->frame, track->width, track->height, track->filter);
+  addAtomic64(&track->decodedFrames, 1);
+  addAtomic64(&track->decodeTime, (long long)((FrameSchedulerNow() - start) * 1000.0));
+  storeAtomic(&slot->state, ANIMATION_SLOT_READY);
+}
+
+/**
+ * Decode job of the decoder thread, the context is the slot
+*/
+static void decodeSlotJob(void* context) {
+  decodeSlot((AnimationSlot*)context);
+}
+
+/**
+ * Returns the index of the frame shown at time in ms, the animation loops forever
+*/
+static int frameAt(const SpriteAnimation* animation, double time) {
+  int frameCount = (int)animation->header.frameCount;
+  int frame = (int)((long long)(time * 1000.0 / animation->header.frameDuration) % frameCount);
+  return frame < 0 ? frame + frameCount : frame;
+}
+
+/**
+ * Returns the frame of the track shown at time (in ms, e.g. FrameSchedulerNow()) and decodes the next frames ahead
+ *
+ * The frame stays valid until the track is asked for a later frame, so all images of a paint can use the same time.
+ * Returns NULL if the frame could not be decoded.
+*/
+const CompiledSprite* AnimationTrackFrame(AnimationTrack* track, double time) {
+  SpriteAnimation* animation = track->animation;
+  int frame = frameAt(animation, time);
+
+  AnimationSlot* slot = &track->slots[frame % ANIMATION_RING_FRAMES];
+  if (slot->frame == frame && loadAtomic(&slot->state) == ANIMATION_SLOT_READY) {
+    track->hits++;
+  } else if (slot->frame == frame) {
+    // Decoded ahead but not finished yet, waiting is still shorter than decoding it again
+    double start = FrameSchedulerNow();
+    waitSlot(slot);
+    track->waitTime += FrameSchedulerNow() - start;
+    track->stalls++;
+  } else {
+    // Not decoded ahead (first frame or the clock jumped), the slot is reused once its old frame is done
+    double start = FrameSchedulerNow();
+    waitSlot(slot);
+    CloseCompiledSprite(slot->sprite);
+    slot->sprite = NULL;
+    slot->frame = frame;
+    decodeSlot(slot);
+    track->waitTime += FrameSchedulerNow() - start;
+    track->misses++;
+  }
+
+  // The frames of the next paints are decoded ahead, if the paints are further apart than the frames
+  // the skipped frames are never decoded (all images of a paint request the same time, so only later times count)
+  if (time > track->lastTime) {
+    track->interval = time - track->lastTime;
+    track->lastTime = time;
+  }
+  double frameDuration = animation->header.frameDuration / 1000.0;
+  double step = track->interval > frameDuration && track->interval < 1000.0 ? track->interval : frameDuration;
+
+  // Queue the next frames on the decoder, slots still decoding are left alone
+  for (int k = 1; k <= ANIMATION_DECODE_AHEAD; k++) {
+    int next = frameAt(animation, time + k * step);
+    AnimationSlot* ahead = &track->slots[next % ANIMATION_RING_FRAMES];
+    // Short animations wrap around onto the shown frame
+    if (ahead == slot) continue;
+    if (ahead->frame == next || loadAtomic(&ahead->state) == ANIMATION_SLOT_DECODING) continue;
+
+    CloseCompiledSprite(ahead->sprite);
+    ahead->sprite = NULL;
+    ahead->frame = next;
+    storeAtomic(&ahead->state, ANIMATION_SLOT_DECODING);
+    if (!SubmitWorkerJob(animation->decoder, decodeSlotJob, ahead)) {
+      // Queue is full, the frame is decoded synchronously once it is shown
+      ahead->frame = -1;
+      storeAtomic(&ahead->state, ANIMATION_SLOT_EMPTY);
+    }
+  }
+  return slot->sprite;
+}
+
@@ -0,0 +1,169 @@
+#ifndef SPRITEANIMATION_H
+#define SPRITEANIMATION_H
+
+#include <stdint.h>
+
+#include "mappedfile.h"
+#include "spriteblit.h"
+#include "spriteresample.h"
+#include "workerpool.h"
+
+// Environment variable holding the path of a sprite stream, all images play the animation instead of the logo
+#define ANIMATION_ENVIRONMENT_VARIABLE "SCREENSAVER_ANIMATION"
+// First 4 bytes of a sprite stream ("SPRS" in little endian)
+#define SPRITE_STREAM_MAGIC 0x53525053u
+// Format version of the sprite stream
+#define SPRITE_STREAM_VERSION 1
+// Count of decoded frames kept per track (the shown frame, the decode-ahead frames and one frame of slack
+// for windows with a lower refresh rate that still show the previous frame)
+#define ANIMATION_RING_FRAMES 4
+// Count of frames decoded ahead of the shown frame
+#define ANIMATION_DECODE_AHEAD 2
+// Largest edge of a frame in pixels, larger streams are rejected
+#define ANIMATION_MAX_SIZE 16384
+
+// States of a slot of the frame ring
+#define ANIMATION_SLOT_EMPTY 0
+#define ANIMATION_SLOT_DECODING 1
+#define ANIMATION_SLOT_READY 2
+
+/**
+ * Header of a sprite stream file, followed by frameCount frames of width x height pixels
+ *
+ * Pixels are 32 bit straight alpha (0xAARRGGBB, little endian), rows packed without padding.
+ * All fields are little endian.
+*/
+typedef struct {
+  // SPRITE_STREAM_MAGIC
+  uint32_t magic;
+  // SPRITE_STREAM_VERSION
+  uint32_t version;
+  // Size of every frame in pixels
+  uint32_t width;
+  uint32_t height;
+  // Count of frames
+  uint32_t frameCount;
+  // Duration of every frame in microseconds
+  uint32_t frameDuration;
+} SpriteStreamHeader;
+
+/**
+ * Slot of the frame ring of a track
+*/
+typedef struct {
+  // Index of the frame in the slot (-1 if empty)
+  int frame;
+  // State of the slot (ANIMATION_SLOT_*), set to ready by the decoder once the frame is decoded
+  volatile long state;
+  // Decoded frame (NULL if decoding failed)
+  CompiledSprite* sprite;
+  // Track owning the slot (context of the decode job)
+  struct AnimationTrack* track;
+} AnimationSlot;
+
+/**
+ * One size of an animation, shared by all images showing the animation at that size
+ *
+ * Frames are decoded on demand into a small ring, the next frames are decoded ahead on the decoder thread
+ * of the animation. All images play the animation in lockstep on the same clock, so they share the decoded frames.
+ * A track is only used from one thread (the ui thread), the decoder only fills the slots handed to it.
+*/
+typedef struct AnimationTrack {
+  // Animation the track belongs to
+  struct SpriteAnimation* animation;
+  // Size of the decoded frames in pixels
+  int width;
+  int height;
+  // Filter used to scale the frames (ResampleFilter)
+  int filter;
+  // Count of acquired references, the track is released when it drops to 0
+  int references;
+  // Ring of decoded frames, frame n lives in slot n % ANIMATION_RING_FRAMES
+  AnimationSlot slots[ANIMATION_RING_FRAMES];
+  // Latest time a frame was requested at and the distance to the time before (the paint interval) in ms
+  double lastTime;
+  double interval;
+
+  // Count of requested frames that were already decoded
+  long long hits;
+  // Count of requested frames that had to be decoded synchronously
+  long long misses;
+  // Count of requested frames that were still being decoded ahead
+  long long stalls;
+  // Time spent waiting for decoded frames in ms (synchronous decodes and stalls)
+  double waitTime;
+  // Count of decoded frames and their total decode time in µs (updated by the decoder)
+  volatile long long decodedFrames;
+  volatile long long decodeTime;
+} AnimationTrack;
+
+/**
+ * Memory-mapped sprite stream with its tracks and decoder thread
+ *
+ * The frames are read straight from the mapping, the pages of a decoded frame are released again afterwards,
+ * so the resident memory is bounded by the frame rings and doesn't grow with the length of the animation.
+*/
+typedef struct SpriteAnimation {
+  // Mapped sprite stream
+  MappedFile* file;
+  // Header of the stream (copied out of the mapping)
+  SpriteStreamHeader header;
+  // Thread decoding the frames ahead
+  WorkerPool* decoder;
+  // Tracks of the animation (unordered, one per distinct size)
+  AnimationTrack** tracks;
+  int trackCount;
+  int trackCapacity;
+} SpriteAnimation;
+
+/**
+ * Maps the sprite stream at path and starts its decoder thread
+ *
+ * If the file is not a valid sprite stream or the allocation fails it returns NULL
+*/
+SpriteAnimation* OpenSpriteAnimation(const char* path);
+
+/**
+ * Opens the sprite stream of ANIMATION_ENVIRONMENT_VARIABLE, returns NULL if it is not set or invalid
+*/
+SpriteAnimation* OpenSpriteAnimationFromEnvironment();
+
+/**
+ * Stops the decoder and cleans up the animation, all tracks must be released before
+*/
+void CloseSpriteAnimation(SpriteAnimation* animation);
+
+/**
+ * Returns the track of the animation scaled to width (0 keeps the native size) and increments its reference count
+ *
+ * Returns NULL if the allocation fails
+*/
+AnimationTrack* AcquireAnimationTrack(SpriteAnimation* animation, int width, ResampleFilter filter);
+
+/**
+ * Decrements the reference count of the track, the track and its frames are released when no references are left
+*/
+void ReleaseAnimationTrack(AnimationTrack* track);
+
+/**
+ * Waits until the decoder finished all frames of the track that are decoded ahead (e.g. before reading the statistics)
+*/
+void WaitAnimationTrack(AnimationTrack* track);
+
+/**
+ * Returns the frame of the track shown at time (in ms, e.g. FrameSchedulerNow()) and decodes the next frames ahead
+ *
+ * The frame stays valid until the track is asked for a later frame, so all images of a paint can use the same time.
+ * Returns NULL if the frame could not be decoded.
+*/
+const CompiledSprite* AnimationTrackFrame(AnimationTrack* track, double time);
+
+/**
+ * Decodes the frame of the animation at width x height (premultiplied alpha, ready to be blitted)
+ *
+ * The pages of the frame are released from the resident set afterwards.
+ * Returns NULL if the allocation fails.
+*/
+CompiledSprite* DecodeAnimationFrame(SpriteAnimation* animation, int frame, int width, int height, ResampleFilter filter);
+
+#endif
@@ -0,0 +1,119 @@
+#include "spriteatlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Create an empty atlas of width x height pixels
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteAtlas* CreateSpriteAtlas(int width, int height) {
+  if (width < 1 || height < 1) return NULL;
+  SpriteAtlas* atlas = calloc(1, sizeof(SpriteAtlas));
+  if (!atlas) return NULL;
+
+  // Not cleared on purpose, only the pixels of placed spans are ever read, the rest is never touched
+  atlas->pixels = malloc(sizeof(uint32_t) * (size_t)width * height);
+  if (!atlas->pixels) {
+    free(atlas);
+    return NULL;
+  }
+  atlas->width = width;
+  atlas->height = height;
+  return atlas;
+}
+
+/**
+ * Cleans up the atlas, sprites placed into it must be closed before
+*/
+void CloseSpriteAtlas(SpriteAtlas* atlas) {
+  if (atlas) {
+    free(atlas->pixels);
+    free(atlas->shelves);
+    free(atlas);
+  }
+}
+
+/**
+ * Reserves a sub-rect of width x height pixels (best fitting shelf or a new one)
+ *
+ * Returns 0 if the atlas has no space left
+*/
+int PackAtlasRect(SpriteAtlas* atlas, int width, int height, SpriteBounds* rect) {
+  if (width < 1 || height < 1 || width > atlas->width || height > atlas->height) return 0;
+
+  // Best fit: the shelf with enough room wasting the fewest rows above the sprite
+  AtlasShelf* best = NULL;
+  for (int i = 0; i < atlas->shelfCount; i++) {
+    AtlasShelf* shelf = &atlas->shelves[i];
+    if (shelf->height < height || atlas->width - shelf->used < width) continue;
+    if (!best || shelf->height < best->height) best = shelf;
+  }
+
+  // A much taller shelf would waste more than half of the reserved area, a new shelf is opened then if possible
+  int top = atlas->shelfCount ? atlas->shelves[atlas->shelfCount - 1].top + atlas->shelves[atlas->shelfCount - 1].height : 0;
+  int canOpen = top + height <= atlas->height;
+  if ((!best || best->height > 2 * height) && canOpen) {
+    if (atlas->shelfCount == atlas->shelfCapacity) {
+      int capacity = atlas->shelfCapacity ? atlas->shelfCapacity * 2 : 16;
+      AtlasShelf* shelves = realloc(atlas->shelves, sizeof(AtlasShelf) * capacity);
+      if (!shelves) return 0;
+      atlas->shelves = shelves;
+      atlas->shelfCapacity = capacity;
+    }
+    best = &atlas->shelves[atlas->shelfCount++];
+    best->top = top;
+    best->height = height;
+    best->used = 0;
+  }
+  if (!best) return 0;
+
+  rect->left = best->used;
+  rect->top = best->top;
+  rect->right = best->used + width;
+  rect->bottom = best->top + height;
+  best->used += width;
+  atlas->packedArea += (long long)width * height;
+  return 1;
+}
+
+/**
+ * Moves the pixels of the compiled sprite into a new sub-rect of the atlas
+ *
+ * The sprite keeps its spans, only their offsets are rebased onto the atlas and its own pixel pool is released.
+ * Returns 0 if the atlas has no space left, the sprite then keeps its own pixels.
+*/
+int PlaceAtlasSprite(SpriteAtlas* atlas, CompiledSprite* sprite) {
+  if (sprite->sharedPixels) return 0;
+  // Offsets are ints, an atlas beyond 2^31 pixels can't be addressed by the spans
+  if ((long long)atlas->width * atlas->height > 0x7FFFFFFFll) return 0;
+
+  SpriteBounds rect;
+  if (!PackAtlasRect(atlas, sprite->width, sprite->height, &rect)) return 0;
+
+  // Copy every span to its position in the sub-rect, the transparent gaps are left untouched
+  for (int row = 0; row < sprite->height; row++) {
+    int base = (rect.top + row) * atlas->width + rect.left;
+    for (int s = sprite->rowStart[row]; s < sprite->rowStart[row + 1]; s++) {
+      SpriteSpan* span = &sprite->spans[s];
+      memcpy(&atlas->pixels[base + span->x], &sprite->pixels[span->offset], sizeof(uint32_t) * span->length);
+      span->offset = base + span->x;
+    }
+  }
+
+  free(sprite->pixels);
+  sprite->pixels = atlas->pixels;
+  sprite->sharedPixels = 1;
+  atlas->spriteCount++;
+  return 1;
+}
+
+/**
+ * Returns the share of the used atlas rows covered by sprites (1.0 == no space wasted)
+*/
+double AtlasOccupancy(const SpriteAtlas* atlas) {
+  if (atlas->shelfCount == 0) return 0.0;
+  const AtlasShelf* last = &atlas->shelves[atlas->shelfCount - 1];
+  return (double)atlas->packedArea / ((double)atlas->width * (last->top + last->height));
+}
@@ -0,0 +1,81 @@
+#ifndef SPRITEATLAS_H
+#define SPRITEATLAS_H
+
+#include <stdint.h>
+
+#include "spriteblit.h"
+
+// Default edge length of the atlas in pixels
+// The pixels are only touched where sprites are packed, so the unused part costs no physical memory. A wider atlas
+// spreads the rows of a sprite over more pages, at 4096 the blits were measurably slower than from standalone sprites
+#define ATLAS_DEFAULT_SIZE 2048
+
+/**
+ * Horizontal shelf of the atlas, sprites are placed next to each other from left to right
+*/
+typedef struct {
+  // First row of the shelf
+  int top;
+  // Height of the shelf (the height of its first sprite)
+  int height;
+  // Count of columns already used
+  int used;
+} AtlasShelf;
+
+/**
+ * Single contiguous pixel buffer holding the pixels of many compiled sprites
+ *
+ * Every sprite gets a sub-rect of the atlas (shelf packing), its spans then address the atlas pixels directly.
+ * This way composing many distinct sprites reads from one allocation instead of one pool per sprite.
+ * Space is only reclaimed when the atlas is closed, the atlas must outlive all sprites placed into it.
+ * The atlas is not synchronized, sprites are only placed from one thread.
+*/
+typedef struct {
+  // Pixels of the atlas (rows of width pixels)
+  uint32_t* pixels;
+  // Size of the atlas in pixels
+  int width;
+  int height;
+  // Shelves from top to bottom
+  AtlasShelf* shelves;
+  int shelfCount;
+  int shelfCapacity;
+  // Area of all placed sub-rects in pixels
+  long long packedArea;
+  // Count of placed sprites
+  int spriteCount;
+} SpriteAtlas;
+
+/**
+ * Create an empty atlas of width x height pixels
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteAtlas* CreateSpriteAtlas(int width, int height);
+
+/**
+ * Cleans up the atlas, sprites placed into it must be closed before
+*/
+void CloseSpriteAtlas(SpriteAtlas* atlas);
+
+/**
+ * Reserves a sub-rect of width x height pixels (best fitting shelf or a new one)
+ *
+ * Returns 0 if the atlas has no space left
+*/
+int PackAtlasRect(SpriteAtlas* atlas, int width, int height, SpriteBounds* rect);
+
+/**
+ * Moves the pixels of the compiled sprite into a new sub-rect of the atlas
+ *
+ * The sprite keeps its spans, only their offsets are rebased onto the atlas and its own pixel pool is released.
+ * Returns 0 if the atlas has no space left, the sprite then keeps its own pixels.
+*/
+int PlaceAtlasSprite(SpriteAtlas* atlas, CompiledSprite* sprite);
+
+/**
+ * Returns the share of the used atlas rows covered by sprites (1.0 == no space wasted)
+*/
+double AtlasOccupancy(const SpriteAtlas* atlas);
+
+#endif
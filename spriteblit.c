@@ -0,0 +1,444 @@
+#include "spriteblit.h"
+
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SPRITEBLIT_SSE2
+#endif
+
+// Only the rgb channels are compared against the colour key, the fourth byte of a DIB pixel is undefined
+#define RGB_MASK 0x00FFFFFFu
+
+// Kinds of pixels of an alpha sprite
+#define PIXEL_TRANSPARENT 0
+#define PIXEL_OPAQUE 1
+#define PIXEL_BLEND 2
+
+// Opaque runs shorter than this are folded into neighbouring blend spans (a span costs more than a few blends)
+#define SPAN_MIN_OPAQUE 8
+// Transparent gaps up to this length are folded into blend spans (blending a transparent pixel keeps the target)
+#define SPAN_MERGE_GAP 4
+
+#define BLIT_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define BLIT_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/**
+ * Reads the pixel at col of a row with 3 (BGR) or 4 (BGRA) bytes per pixel as 0x00RRGGBB / 0xAARRGGBB
+*/
+static inline uint32_t readRowPixel(const unsigned char* row, int bytesPerPixel, int col) {
+  const unsigned char* pixel = row + (size_t)col * bytesPerPixel;
+  uint32_t value = (uint32_t)pixel[0] | (uint32_t)pixel[1] << 8 | (uint32_t)pixel[2] << 16;
+  return bytesPerPixel == 4 ? value | (uint32_t)pixel[3] << 24 : value;
+}
+
+/**
+ * Compiles a sprite from 32 bit pixels, all pixels matching transparentColor (rgb only) are dropped
+ *
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+CompiledSprite* CompileSprite(const uint32_t* pixels, int width, int height, int stride, uint32_t transparentColor) {
+  return CompileSpriteRows((const unsigned char*)pixels, 4, width, height, (long long)stride * 4, transparentColor);
+}
+
+/**
+ * Compiles a sprite from rows of 24 bit (BGR) or 32 bit (BGRA) pixels, all pixels matching transparentColor (rgb only) are dropped
+ *
+ * The rows are read in place (e.g. straight from a mapped bmp file), they don't have to be aligned.
+ * stride is the distance between two source rows in bytes, negative for bottom-up images (rows points to the top row)
+ * If the allocation fails it returns NULL
+*/
+CompiledSprite* CompileSpriteRows(const unsigned char* rows, int bytesPerPixel, int width, int height, long long stride, uint32_t transparentColor) {
+  transparentColor &= RGB_MASK;
+
+  // First pass counts spans and opaque pixels, so that everything is allocated exactly once
+  int spanCount = 0;
+  int pixelCount = 0;
+  for (int row = 0; row < height; row++) {
+    const unsigned char* src = rows + row * stride;
+    int inSpan = 0;
+    for (int col = 0; col < width; col++) {
+      int opaque = (readRowPixel(src, bytesPerPixel, col) & RGB_MASK) != transparentColor;
+      if (opaque) pixelCount++;
+      if (opaque && !inSpan) spanCount++;
+      inSpan = opaque;
+    }
+  }
+
+  CompiledSprite* sprite = calloc(1, sizeof(CompiledSprite));
+  if (!sprite) return NULL;
+  sprite->width = width;
+  sprite->height = height;
+  sprite->spanCount = spanCount;
+  // Allocate at least one element, so an empty sprite is still distinguishable from a failed allocation
+  sprite->pixels = malloc(sizeof(uint32_t) * BLIT_MAX(pixelCount, 1));
+  sprite->spans = malloc(sizeof(SpriteSpan) * BLIT_MAX(spanCount, 1));
+  sprite->rowStart = malloc(sizeof(int) * (height + 1));
+  if (!sprite->pixels || !sprite->spans || !sprite->rowStart) {
+    CloseCompiledSprite(sprite);
+    return NULL;
+  }
+
+  // Second pass records the spans and packs the opaque pixels
+  int span = 0;
+  int offset = 0;
+  for (int row = 0; row < height; row++) {
+    const unsigned char* src = rows + row * stride;
+    sprite->rowStart[row] = span;
+    int col = 0;
+    while (col < width) {
+      // Skip the transparent run
+      while (col < width && (readRowPixel(src, bytesPerPixel, col) & RGB_MASK) == transparentColor) col++;
+      if (col >= width) break;
+      // Record the opaque run
+      int start = col;
+      uint32_t pixel;
+      while (col < width && ((pixel = readRowPixel(src, bytesPerPixel, col)) & RGB_MASK) != transparentColor) {
+        sprite->pixels[offset + col - start] = pixel;
+        col++;
+      }
+      sprite->spans[span].x = start;
+      sprite->spans[span].length = col - start;
+      sprite->spans[span].offset = offset;
+      sprite->spans[span].blend = 0;
+      offset += col - start;
+      span++;
+    }
+  }
+  sprite->rowStart[height] = span;
+  return sprite;
+}
+
+/**
+ * Returns the kind of a premultiplied alpha pixel
+*/
+static inline int alphaKind(uint32_t pixel) {
+  uint32_t alpha = pixel >> 24;
+  if (alpha == 0) return PIXEL_TRANSPARENT;
+  return alpha == 255 ? PIXEL_OPAQUE : PIXEL_BLEND;
+}
+
+/**
+ * Returns the end of the run of pixels with the same kind starting at col
+*/
+static inline int runEnd(const uint32_t* src, int width, int col) {
+  int kind = alphaKind(src[col]);
+  while (col < width && alphaKind(src[col]) == kind) col++;
+  return col;
+}
+
+/**
+ * Finds the next span of an alpha sprite row starting at *col and advances *col behind it
+ *
+ * Short opaque runs, blend runs and short transparent gaps between them are merged into one blend span,
+ * so the antialiased edge of a row usually ends up as a single blend span beside one long opaque span.
+ * Returns 0 if the row has no further visible pixels.
+*/
+static int nextAlphaSpan(const uint32_t* src, int width, int* col, int* start, int* end, int* blend) {
+  int x = *col;
+  while (x < width && alphaKind(src[x]) == PIXEL_TRANSPARENT) x++;
+  if (x >= width) return 0;
+
+  *start = x;
+  *end = runEnd(src, width, x);
+  *blend = alphaKind(src[x]) == PIXEL_BLEND;
+  // A span is cheap to blend if it is translucent anyway or only a few pixels long
+  int cheap = *blend || *end - *start < SPAN_MIN_OPAQUE;
+
+  while (cheap) {
+    int next = *end;
+    while (next < width && alphaKind(src[next]) == PIXEL_TRANSPARENT) next++;
+    if (next >= width || next - *end > SPAN_MERGE_GAP) break;
+    int nextEnd = runEnd(src, width, next);
+    // Long opaque runs keep their own span, so they are copied
+    if (alphaKind(src[next]) == PIXEL_OPAQUE && nextEnd - next >= SPAN_MIN_OPAQUE) break;
+    *end = nextEnd;
+    *blend = 1;
+  }
+  *col = *end;
+  return 1;
+}
+
+/**
+ * Compiles a sprite from 32 bit premultiplied alpha pixels (0xAARRGGBB, color channels <= alpha)
+ *
+ * Pixels with alpha 0 are dropped, runs with alpha 255 become opaque spans and all others blend spans.
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+CompiledSprite* CompileAlphaSprite(const uint32_t* pixels, int width, int height, int stride) {
+  int start, end, blend;
+
+  // First pass counts spans and stored pixels, so that everything is allocated exactly once
+  int spanCount = 0;
+  int pixelCount = 0;
+  for (int row = 0; row < height; row++) {
+    const uint32_t* src = pixels + (long long)row * stride;
+    int col = 0;
+    while (nextAlphaSpan(src, width, &col, &start, &end, &blend)) {
+      spanCount++;
+      pixelCount += end - start;
+    }
+  }
+
+  CompiledSprite* sprite = calloc(1, sizeof(CompiledSprite));
+  if (!sprite) return NULL;
+  sprite->width = width;
+  sprite->height = height;
+  sprite->spanCount = spanCount;
+  // Allocate at least one element, so an empty sprite is still distinguishable from a failed allocation
+  sprite->pixels = malloc(sizeof(uint32_t) * BLIT_MAX(pixelCount, 1));
+  sprite->spans = malloc(sizeof(SpriteSpan) * BLIT_MAX(spanCount, 1));
+  sprite->rowStart = malloc(sizeof(int) * (height + 1));
+  if (!sprite->pixels || !sprite->spans || !sprite->rowStart) {
+    CloseCompiledSprite(sprite);
+    return NULL;
+  }
+
+  // Second pass records the spans and packs their pixels
+  int span = 0;
+  int offset = 0;
+  for (int row = 0; row < height; row++) {
+    const uint32_t* src = pixels + (long long)row * stride;
+    sprite->rowStart[row] = span;
+    int col = 0;
+    while (nextAlphaSpan(src, width, &col, &start, &end, &blend)) {
+      for (int i = start; i < end; i++) sprite->pixels[offset + i - start] = src[i];
+      sprite->spans[span].x = start;
+      sprite->spans[span].length = end - start;
+      sprite->spans[span].offset = offset;
+      sprite->spans[span].blend = blend;
+      offset += end - start;
+      span++;
+    }
+  }
+  sprite->rowStart[height] = span;
+  return sprite;
+}
+
+/**
+ * Cleans up a compiled sprite
+*/
+void CloseCompiledSprite(CompiledSprite* sprite) {
+  if (sprite) {
+    if (!sprite->sharedPixels) free(sprite->pixels);
+    free(sprite->spans);
+    free(sprite->rowStart);
+    free(sprite);
+  }
+}
+
+/**
+ * Clips the rect to the surface of the target
+*/
+static SpriteBounds clipToTarget(PixelBuffer* target, SpriteBounds rect) {
+  rect.left = BLIT_MAX(rect.left, 0);
+  rect.top = BLIT_MAX(rect.top, 0);
+  rect.right = BLIT_MIN(rect.right, target->width);
+  rect.bottom = BLIT_MIN(rect.bottom, target->height);
+  return rect;
+}
+
+/**
+ * Copies count pixels from src to dst with the widest available vector unit
+*/
+static inline void copyPixels(uint32_t* dst, const uint32_t* src, int count) {
+  int i = 0;
+#if defined(__AVX2__)
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+  }
+#endif
+#if defined(SPRITEBLIT_SSE2)
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+  }
+#endif
+  for (; i < count; i++) dst[i] = src[i];
+}
+
+/**
+ * Blends one premultiplied pixel over the target pixel (dst = src + dst * (255 - alpha) / 255)
+ *
+ * The division by 255 is done exact (rounded) with (t + (t >> 8)) >> 8, the vector kernels use the same arithmetic.
+ * Two channels are processed at once in the 16 bit halves of a 32 bit integer (t never exceeds 16 bit).
+*/
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src) {
+  uint32_t inverse = 255 - (src >> 24);
+  uint32_t rb = (dst & 0x00FF00FF) * inverse + 0x00800080;
+  uint32_t ag = ((dst >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+  ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+  // Premultiplied channels never exceed the alpha, so the sum can't carry into the next channel
+  return src + (ag | rb);
+}
+
+#if defined(SPRITEBLIT_SSE2)
+/**
+ * Blends 2 premultiplied pixels widened to 16 bit lanes over 2 target pixels
+*/
+static inline __m128i blend128(__m128i dst, __m128i src) {
+  // Broadcast the alpha lane of every pixel to its 4 channels
+  __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+  __m128i t = _mm_add_epi16(_mm_mullo_epi16(dst, inverse), _mm_set1_epi16(128));
+  t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+  return _mm_add_epi16(src, t);
+}
+#endif
+
+#if defined(__AVX2__)
+/**
+ * Blends 4 premultiplied pixels widened to 16 bit lanes over 4 target pixels
+*/
+static inline __m256i blend256(__m256i dst, __m256i src) {
+  __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+  __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(dst, inverse), _mm256_set1_epi16(128));
+  t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+  return _mm256_add_epi16(src, t);
+}
+#endif
+
+/**
+ * Blends count premultiplied pixels from src over dst with the widest available vector unit
+*/
+static inline void blendPixels(uint32_t* dst, const uint32_t* src, int count) {
+  int i = 0;
+#if defined(__AVX2__)
+  __m256i zero8 = _mm256_setzero_si256();
+  for (; i + 8 <= count; i += 8) {
+    __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+    // Unpack works per 128 bit lane, the pack below restores the same order
+    __m256i lo = blend256(_mm256_unpacklo_epi8(d, zero8), _mm256_unpacklo_epi8(s, zero8));
+    __m256i hi = blend256(_mm256_unpackhi_epi8(d, zero8), _mm256_unpackhi_epi8(s, zero8));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+  }
+#endif
+#if defined(SPRITEBLIT_SSE2)
+  __m128i zero4 = _mm_setzero_si128();
+  for (; i + 4 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+    __m128i lo = blend128(_mm_unpacklo_epi8(d, zero4), _mm_unpacklo_epi8(s, zero4));
+    __m128i hi = blend128(_mm_unpackhi_epi8(d, zero4), _mm_unpackhi_epi8(s, zero4));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < count; i++) dst[i] = blendPixel(dst[i], src[i]);
+}
+
+/**
+ * Fills the rect (clipped to the target) with a solid color
+*/
+void FillPixelBuffer(PixelBuffer* target, SpriteBounds rect, uint32_t color) {
+  rect = clipToTarget(target, rect);
+  int count = rect.right - rect.left;
+  if (count <= 0) return;
+
+  for (int row = rect.top; row < rect.bottom; row++) {
+    uint32_t* dst = target->pixels + (long long)row * target->stride + rect.left;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i color8 = _mm256_set1_epi32((int)color);
+    for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), color8);
+#endif
+#if defined(SPRITEBLIT_SSE2)
+    __m128i color4 = _mm_set1_epi32((int)color);
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), color4);
+#endif
+    for (; i < count; i++) dst[i] = color;
+  }
+}
+
+/**
+ * Draws a compiled sprite with its top left corner at x / y, clipped to the clip rect and the target
+*/
+void BlitCompiledSprite(PixelBuffer* target, const CompiledSprite* sprite, int x, int y, SpriteBounds clip) {
+  clip = clipToTarget(target, clip);
+
+  // Only visit the sprite rows inside the clip rect
+  int firstRow = BLIT_MAX(0, clip.top - y);
+  int lastRow = BLIT_MIN(sprite->height, clip.bottom - y);
+
+  for (int row = firstRow; row < lastRow; row++) {
+    uint32_t* dst = target->pixels + (long long)(y + row) * target->stride;
+    for (int s = sprite->rowStart[row]; s < sprite->rowStart[row + 1]; s++) {
+      const SpriteSpan* span = &sprite->spans[s];
+      // Clip the span horizontally
+      int left = BLIT_MAX(x + span->x, clip.left);
+      int right = BLIT_MIN(x + span->x + span->length, clip.right);
+      if (left >= right) continue;
+      // Opaque runs are copied, only the translucent edge runs pay for the blend
+      const uint32_t* src = sprite->pixels + span->offset + (left - x - span->x);
+      if (span->blend) blendPixels(dst + left, src, right - left);
+      else copyPixels(dst + left, src, right - left);
+    }
+  }
+}
+
+/**
+ * Scalar reference of BlitCompiledSprite(), testing every source pixel against the colour key
+*/
+void BlitColorKeyScalar(
+  PixelBuffer* target,
+  const uint32_t* pixels,
+  int width,
+  int height,
+  int stride,
+  uint32_t transparentColor,
+  int x,
+  int y,
+  SpriteBounds clip) {
+
+  clip = clipToTarget(target, clip);
+  transparentColor &= RGB_MASK;
+
+  for (int row = 0; row < height; row++) {
+    if (y + row < clip.top || y + row >= clip.bottom) continue;
+    const uint32_t* src = pixels + (long long)row * stride;
+    uint32_t* dst = target->pixels + (long long)(y + row) * target->stride;
+    for (int col = 0; col < width; col++) {
+      if (x + col < clip.left || x + col >= clip.right) continue;
+      if ((src[col] & RGB_MASK) != transparentColor) dst[x + col] = src[col];
+    }
+  }
+}
+
+/**
+ * Scalar reference of the blend spans of BlitCompiledSprite(), blends every premultiplied source pixel over the target
+*/
+void BlitAlphaScalar(
+  PixelBuffer* target,
+  const uint32_t* pixels,
+  int width,
+  int height,
+  int stride,
+  int x,
+  int y,
+  SpriteBounds clip) {
+
+  clip = clipToTarget(target, clip);
+
+  for (int row = 0; row < height; row++) {
+    if (y + row < clip.top || y + row >= clip.bottom) continue;
+    const uint32_t* src = pixels + (long long)row * stride;
+    uint32_t* dst = target->pixels + (long long)(y + row) * target->stride;
+    for (int col = 0; col < width; col++) {
+      if (x + col < clip.left || x + col >= clip.right) continue;
+      // Per channel formulation of the blend, independent of the packed arithmetic of the kernels
+      uint32_t inverse = 255 - (src[col] >> 24);
+      uint32_t result = 0;
+      for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t t = ((dst[x + col] >> shift) & 0xFF) * inverse + 128;
+        result |= (((src[col] >> shift) & 0xFF) + ((t + (t >> 8)) >> 8)) << shift;
+      }
+      dst[x + col] = result;
+    }
+  }
+}
@@ -0,0 +1,126 @@
+#ifndef SPRITEBLIT_H
+#define SPRITEBLIT_H
+
+#include <stdint.h>
+
+#include "spritestore.h"
+
+/**
+ * Software pixel surface with 32 bit pixels (0x00RRGGBB, the layout of a 32bpp DIB)
+*/
+typedef struct {
+  // First pixel of the top row
+  uint32_t* pixels;
+  // Size of the surface in pixels
+  int width;
+  int height;
+  // Distance between two rows in pixels
+  int stride;
+} PixelBuffer;
+
+/**
+ * Horizontal run of opaque pixels in a compiled sprite row
+*/
+typedef struct {
+  // Column of the first pixel of the run
+  int x;
+  // Count of pixels in the run
+  int length;
+  // Index of the first pixel of the run in the compiled sprite pixel pool
+  int offset;
+  // 1 if the run is translucent and blended over the target, 0 if the run is opaque and copied
+  int blend;
+} SpriteSpan;
+
+/**
+ * Sprite precompiled into per row lists of opaque and translucent spans
+ *
+ * The colour key (or alpha) test is done once when compiling, drawing the sprite is then
+ * a plain copy of the opaque runs and a premultiplied "over" blend of the translucent runs.
+ * Fully transparent pixels are not stored at all.
+*/
+typedef struct {
+  // Size of the sprite in pixels
+  int width;
+  int height;
+  // Visible pixels of all spans, packed in span order
+  uint32_t* pixels;
+  // All spans, ordered by row and column
+  SpriteSpan* spans;
+  // Index of the first span of every row (height + 1 elements, the last one is the span count)
+  int* rowStart;
+  // Count of spans
+  int spanCount;
+  // Set if the pixels belong to a sprite atlas (span offsets then address the atlas), they are not freed with the sprite
+  int sharedPixels;
+} CompiledSprite;
+
+/**
+ * Compiles a sprite from 32 bit pixels, all pixels matching transparentColor (rgb only) are dropped
+ *
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+CompiledSprite* CompileSprite(const uint32_t* pixels, int width, int height, int stride, uint32_t transparentColor);
+
+/**
+ * Compiles a sprite from rows of 24 bit (BGR) or 32 bit (BGRA) pixels, all pixels matching transparentColor (rgb only) are dropped
+ *
+ * The rows are read in place (e.g. straight from a mapped bmp file), they don't have to be aligned.
+ * stride is the distance between two source rows in bytes, negative for bottom-up images (rows points to the top row)
+ * If the allocation fails it returns NULL
+*/
+CompiledSprite* CompileSpriteRows(const unsigned char* rows, int bytesPerPixel, int width, int height, long long stride, uint32_t transparentColor);
+
+/**
+ * Compiles a sprite from 32 bit premultiplied alpha pixels (0xAARRGGBB, color channels <= alpha)
+ *
+ * Pixels with alpha 0 are dropped, runs with alpha 255 become opaque spans and all others blend spans.
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+CompiledSprite* CompileAlphaSprite(const uint32_t* pixels, int width, int height, int stride);
+
+/**
+ * Cleans up a compiled sprite
+*/
+void CloseCompiledSprite(CompiledSprite* sprite);
+
+/**
+ * Fills the rect (clipped to the target) with a solid color
+*/
+void FillPixelBuffer(PixelBuffer* target, SpriteBounds rect, uint32_t color);
+
+/**
+ * Draws a compiled sprite with its top left corner at x / y, clipped to the clip rect and the target
+*/
+void BlitCompiledSprite(PixelBuffer* target, const CompiledSprite* sprite, int x, int y, SpriteBounds clip);
+
+/**
+ * Scalar reference of BlitCompiledSprite(), testing every source pixel against the colour key
+*/
+void BlitColorKeyScalar(
+  PixelBuffer* target,
+  const uint32_t* pixels,
+  int width,
+  int height,
+  int stride,
+  uint32_t transparentColor,
+  int x,
+  int y,
+  SpriteBounds clip);
+
+/**
+ * Scalar reference of the blend spans of BlitCompiledSprite(), blends every premultiplied source pixel over the target
+*/
+void BlitAlphaScalar(
+  PixelBuffer* target,
+  const uint32_t* pixels,
+  int width,
+  int height,
+  int stride,
+  int x,
+  int y,
+  SpriteBounds clip);
+
+#endif
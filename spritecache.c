@@ -0,0 +1,85 @@
+#include "spritecache.h"
+
+#include <stdlib.h>
+
+/**
+ * Create an empty sprite cache
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteCache* CreateSpriteCache() {
+  return calloc(1, sizeof(SpriteCache));
+}
+
+/**
+ * Cleans up the cache and all sprites still cached
+*/
+void CloseSpriteCache(SpriteCache* cache) {
+  if (cache) {
+    for (int i = 0; i < cache->count; i++) CloseCompiledSprite(cache->entries[i].sprite);
+    free(cache->entries);
+    free(cache);
+  }
+}
+
+/**
+ * Returns 1 if both keys describe the same sprite
+*/
+static int equalKeys(const SpriteKey* a, const SpriteKey* b) {
+  return a->resource == b->resource && a->width == b->width &&
+    a->format == b->format && a->filter == b->filter && a->transparentColor == b->transparentColor;
+}
+
+/**
+ * Returns the sprite for the key and increments its reference count
+ *
+ * On a miss the sprite is loaded with the loader and moved into the atlas of the cache (if it has space left).
+ * Returns NULL if the loader fails.
+*/
+CompiledSprite* AcquireCachedSprite(SpriteCache* cache, SpriteKey key, SpriteLoader loader, void* context) {
+  for (int i = 0; i < cache->count; i++) {
+    if (equalKeys(&cache->entries[i].key, &key)) {
+      cache->hits++;
+      cache->entries[i].references++;
+      return cache->entries[i].sprite;
+    }
+  }
+
+  cache->misses++;
+  if (cache->count == cache->capacity) {
+    int capacity = cache->capacity ? cache->capacity * 2 : 4;
+    SpriteCacheEntry* entries = realloc(cache->entries, sizeof(SpriteCacheEntry) * capacity);
+    if (!entries) return NULL;
+    cache->entries = entries;
+    cache->capacity = capacity;
+  }
+
+  CompiledSprite* sprite = loader(&key, context);
+  if (!sprite) return NULL;
+  // A full atlas is not an error, the sprite is simply drawn from its own pixels
+  if (cache->atlas) PlaceAtlasSprite(cache->atlas, sprite);
+
+  SpriteCacheEntry* entry = &cache->entries[cache->count++];
+  entry->key = key;
+  entry->sprite = sprite;
+  entry->references = 1;
+  return sprite;
+}
+
+/**
+ * Decrements the reference count of the sprite, the sprite is released when no references are left
+*/
+void ReleaseCachedSprite(SpriteCache* cache, CompiledSprite* sprite) {
+  if (!sprite) return;
+  for (int i = 0; i < cache->count; i++) {
+    SpriteCacheEntry* entry = &cache->entries[i];
+    if (entry->sprite != sprite) continue;
+
+    if (--entry->references <= 0) {
+      CloseCompiledSprite(entry->sprite);
+      // Order of the entries is irrelevant, the last one fills the gap
+      cache->entries[i] = cache->entries[--cache->count];
+    }
+    return;
+  }
+}
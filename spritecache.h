@@ -0,0 +1,97 @@
+#ifndef SPRITECACHE_H
+#define SPRITECACHE_H
+
+#include <stdint.h>
+
+#include "spriteblit.h"
+#include "spriteatlas.h"
+#include "spriteresample.h"
+
+/**
+ * Pixel formats of cached sprites
+*/
+typedef enum {
+  // Opaque spans, pixels matching the transparent color are dropped
+  SPRITE_FORMAT_COLORKEY = 0,
+  // Premultiplied alpha, from the alpha channel of the bitmap or from the colour key coverage of the edges
+  SPRITE_FORMAT_PREMULTIPLIED = 1
+} SpriteFormat;
+
+/**
+ * Identifies one distinct scaled sprite
+*/
+typedef struct {
+  // Id of the bitmap resource (or index of the file in the image directory)
+  int resource;
+  // Target width in pixels (0 keeps the native size)
+  int width;
+  // Pixel format of the compiled sprite (SpriteFormat)
+  int format;
+  // Filter used to scale the sprite (ResampleFilter)
+  int filter;
+  // Color removed from the sprite (0x00RRGGBB)
+  uint32_t transparentColor;
+} SpriteKey;
+
+/**
+ * Loads, scales and compiles the sprite described by the key, returns NULL on failure
+*/
+typedef CompiledSprite* (*SpriteLoader)(const SpriteKey* key, void* context);
+
+/**
+ * Cached sprite with its reference count
+*/
+typedef struct {
+  SpriteKey key;
+  CompiledSprite* sprite;
+  // Count of acquired references, the sprite is released when it drops to 0
+  int references;
+} SpriteCacheEntry;
+
+/**
+ * Reference counted cache of compiled sprites, every distinct key is loaded exactly once
+ *
+ * The cache is not synchronized, it must only be used from one thread (the ui thread creating the windows).
+*/
+typedef struct {
+  // Cached sprites (unordered, the count of distinct sprites is tiny)
+  SpriteCacheEntry* entries;
+  // Count of cached sprites
+  int count;
+  // Size of the entries array
+  int capacity;
+  // Count of acquisitions served from the cache
+  long long hits;
+  // Count of acquisitions that had to load the sprite
+  long long misses;
+  // Atlas receiving the pixels of loaded sprites (NULL keeps every sprite in its own pool), not managed by the cache
+  // Released sprites don't return their atlas space, the atlas must outlive the cache
+  SpriteAtlas* atlas;
+} SpriteCache;
+
+/**
+ * Create an empty sprite cache
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteCache* CreateSpriteCache();
+
+/**
+ * Cleans up the cache and all sprites still cached
+*/
+void CloseSpriteCache(SpriteCache* cache);
+
+/**
+ * Returns the sprite for the key and increments its reference count
+ *
+ * On a miss the sprite is loaded with the loader and moved into the atlas of the cache (if it has space left).
+ * Returns NULL if the loader fails.
+*/
+CompiledSprite* AcquireCachedSprite(SpriteCache* cache, SpriteKey key, SpriteLoader loader, void* context);
+
+/**
+ * Decrements the reference count of the sprite, the sprite is released when no references are left
+*/
+void ReleaseCachedSprite(SpriteCache* cache, CompiledSprite* sprite);
+
+#endif
@@ -0,0 +1,362 @@
+#include "spriteresample.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SPRITERESAMPLE_SSE2
+#endif
+
+#define RESAMPLE_PI 3.14159265358979323846
+
+/**
+ * Precomputed filter taps of one axis
+ *
+ * Output coordinate i reads the taps source coordinates starting at start[i],
+ * weighted with weights[i * taps + k]. The weights of every output coordinate sum up to 1.
+*/
+typedef struct {
+  int* start;
+  float* weights;
+  // Count of taps per output coordinate
+  int taps;
+} FilterWeights;
+
+/**
+ * Create a resample source from 32 bit pixels (0x00RRGGBB), pixels matching transparentColor (rgb only) are transparent
+ *
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+ResampleSource* CreateResampleSource(const uint32_t* pixels, int width, int height, int stride, uint32_t transparentColor) {
+  ResampleSource* source = malloc(sizeof(ResampleSource));
+  if (!source) return NULL;
+  source->pixels = malloc(sizeof(float) * 4 * (size_t)width * height);
+  if (!source->pixels) {
+    free(source);
+    return NULL;
+  }
+  source->width = width;
+  source->height = height;
+  source->transparentColor = transparentColor & 0x00FFFFFF;
+
+  for (int y = 0; y < height; y++) {
+    const uint32_t* row = pixels + (size_t)y * stride;
+    float* out = source->pixels + (size_t)y * width * 4;
+    for (int x = 0; x < width; x++) {
+      uint32_t pixel = row[x] & 0x00FFFFFF;
+      // Keyed pixels are fully transparent, premultiplied their color is 0 as well
+      float alpha = pixel == source->transparentColor ? 0.0f : 1.0f;
+      out[x * 4 + 0] = ((pixel >> 16) & 0xFF) * alpha;
+      out[x * 4 + 1] = ((pixel >> 8) & 0xFF) * alpha;
+      out[x * 4 + 2] = (pixel & 0xFF) * alpha;
+      out[x * 4 + 3] = alpha;
+    }
+  }
+  return source;
+}
+
+/**
+ * Create a resample source from 32 bit straight alpha pixels (0xAARRGGBB)
+ *
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+ResampleSource* CreateResampleSourceAlpha(const uint32_t* pixels, int width, int height, int stride) {
+  ResampleSource* source = malloc(sizeof(ResampleSource));
+  if (!source) return NULL;
+  source->pixels = malloc(sizeof(float) * 4 * (size_t)width * height);
+  if (!source->pixels) {
+    free(source);
+    return NULL;
+  }
+  source->width = width;
+  source->height = height;
+  // There is no colour key, keyed output gets black for uncovered pixels
+  source->transparentColor = 0;
+
+  for (int y = 0; y < height; y++) {
+    const uint32_t* row = pixels + (size_t)y * stride;
+    float* out = source->pixels + (size_t)y * width * 4;
+    for (int x = 0; x < width; x++) {
+      uint32_t pixel = row[x];
+      float alpha = (pixel >> 24) / 255.0f;
+      out[x * 4 + 0] = ((pixel >> 16) & 0xFF) * alpha;
+      out[x * 4 + 1] = ((pixel >> 8) & 0xFF) * alpha;
+      out[x * 4 + 2] = (pixel & 0xFF) * alpha;
+      out[x * 4 + 3] = alpha;
+    }
+  }
+  return source;
+}
+
+/**
+ * Cleans up a resample source
+*/
+void CloseResampleSource(ResampleSource* source) {
+  if (source) {
+    free(source->pixels);
+    free(source);
+  }
+}
+
+/**
+ * Filter kernel evaluated at the distance x (in source pixels of the unscaled filter)
+*/
+static double evaluateKernel(ResampleFilter filter, double x) {
+  x = fabs(x);
+  if (filter != RESAMPLE_LANCZOS3) return x < 1.0 ? 1.0 - x : 0.0;
+  // Lanczos-3
+  if (x < 1e-8) return 1.0;
+  if (x >= 3.0) return 0.0;
+  double px = RESAMPLE_PI * x;
+  return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+}
+
+/**
+ * Support radius of the unscaled filter kernel
+*/
+static double kernelRadius(ResampleFilter filter) {
+  return filter == RESAMPLE_LANCZOS3 ? 3.0 : 1.0;
+}
+
+/**
+ * Releases the arrays of the filter weights
+*/
+static void releaseWeights(FilterWeights* weights) {
+  free(weights->start);
+  free(weights->weights);
+}
+
+/**
+ * Computes the normalized filter taps mapping srcSize source to dstSize output coordinates
+ *
+ * When downscaling the kernel is widened by the scale, so every source pixel contributes (no aliasing).
+ * Returns 0 if the allocation fails (already allocated arrays must still be released).
+*/
+static int computeWeights(FilterWeights* weights, int srcSize, int dstSize, ResampleFilter filter) {
+  double scale = (double)srcSize / dstSize;
+  double filterScale = scale > 1.0 ? scale : 1.0;
+  double support = kernelRadius(filter) * filterScale;
+
+  weights->taps = filter == RESAMPLE_NEAREST ? 1 : (int)ceil(support) * 2 + 1;
+  if (weights->taps > srcSize) weights->taps = srcSize;
+  weights->start = malloc(sizeof(int) * dstSize);
+  weights->weights = malloc(sizeof(float) * dstSize * weights->taps);
+  if (!weights->start || !weights->weights) return 0;
+
+  for (int i = 0; i < dstSize; i++) {
+    // Center of the output pixel in source coordinates
+    double center = (i + 0.5) * scale;
+    float* w = &weights->weights[i * weights->taps];
+
+    if (filter == RESAMPLE_NEAREST) {
+      int nearest = (int)center;
+      weights->start[i] = nearest < srcSize ? nearest : srcSize - 1;
+      w[0] = 1.0f;
+      continue;
+    }
+
+    // The taps window is kept inside the source, taps outside the kernel support get a weight of 0
+    int start = (int)floor(center - support);
+    if (start > srcSize - weights->taps) start = srcSize - weights->taps;
+    if (start < 0) start = 0;
+    weights->start[i] = start;
+
+    double sum = 0;
+    for (int k = 0; k < weights->taps; k++) {
+      double value = evaluateKernel(filter, (start + k + 0.5 - center) / filterScale);
+      w[k] = (float)value;
+      sum += value;
+    }
+    if (sum != 0) {
+      for (int k = 0; k < weights->taps; k++) w[k] = (float)(w[k] / sum);
+    } else {
+      // Unreachable for valid kernels, fall back to the nearest pixel
+      for (int k = 0; k < weights->taps; k++) w[k] = 0.0f;
+      int nearest = (int)center - start;
+      w[nearest < weights->taps ? nearest : weights->taps - 1] = 1.0f;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Horizontal pass of one row, filters count rgba pixels from the source row into the output row
+*/
+static void filterRow(const FilterWeights* weights, const float* row, float* out, int count, int simd) {
+#if defined(SPRITERESAMPLE_SSE2)
+  if (simd) {
+    // One rgba pixel is exactly one SSE register
+    for (int x = 0; x < count; x++) {
+      const float* w = &weights->weights[x * weights->taps];
+      const float* src = row + weights->start[x] * 4;
+      __m128 acc = _mm_setzero_ps();
+      for (int k = 0; k < weights->taps; k++) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(src + k * 4)));
+      }
+      _mm_storeu_ps(out + x * 4, acc);
+    }
+    return;
+  }
+#endif
+  (void)simd;
+  for (int x = 0; x < count; x++) {
+    const float* w = &weights->weights[x * weights->taps];
+    const float* src = row + weights->start[x] * 4;
+    float acc[4] = {0, 0, 0, 0};
+    for (int k = 0; k < weights->taps; k++) {
+      for (int c = 0; c < 4; c++) acc[c] = acc[c] + w[k] * src[k * 4 + c];
+    }
+    for (int c = 0; c < 4; c++) out[x * 4 + c] = acc[c];
+  }
+}
+
+/**
+ * Vertical pass of one output row, accumulates the weighted rows into out (length floats)
+*/
+static void filterColumn(const float* const* rows, const float* w, int taps, float* out, int length, int simd) {
+  int i = 0;
+  if (simd) {
+#if defined(__AVX2__)
+    for (; i + 8 <= length; i += 8) {
+      __m256 acc = _mm256_setzero_ps();
+      for (int k = 0; k < taps; k++) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(w[k]), _mm256_loadu_ps(rows[k] + i)));
+      }
+      _mm256_storeu_ps(out + i, acc);
+    }
+#endif
+#if defined(SPRITERESAMPLE_SSE2)
+    for (; i + 4 <= length; i += 4) {
+      __m128 acc = _mm_setzero_ps();
+      for (int k = 0; k < taps; k++) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(rows[k] + i)));
+      }
+      _mm_storeu_ps(out + i, acc);
+    }
+#endif
+  }
+  // Scalar tail (and scalar reference)
+  for (; i < length; i++) {
+    float acc = 0;
+    for (int k = 0; k < taps; k++) acc = acc + w[k] * rows[k][i];
+    out[i] = acc;
+  }
+}
+
+/**
+ * Converts a premultiplied rgba float channel back to an 8 bit channel
+*/
+static inline uint32_t toChannel(float value, float alpha) {
+  float channel = value / alpha + 0.5f;
+  // Lanczos rings slightly outside of the valid range
+  if (channel < 0.0f) return 0;
+  if (channel > 255.0f) return 255;
+  return (uint32_t)channel;
+}
+
+/**
+ * Converts a premultiplied rgba float pixel to a premultiplied 32 bit pixel, the channels are kept <= alpha
+*/
+static inline uint32_t toPremultiplied(const float* pixel) {
+  float alphaValue = pixel[3] * 255.0f + 0.5f;
+  uint32_t alpha = alphaValue <= 0.0f ? 0 : alphaValue >= 255.0f ? 255 : (uint32_t)alphaValue;
+  uint32_t color = alpha << 24;
+  for (int c = 0; c < 3; c++) {
+    float value = pixel[c] + 0.5f;
+    uint32_t channel = value <= 0.0f ? 0 : (uint32_t)value;
+    if (channel > alpha) channel = alpha;
+    color |= channel << (16 - c * 8);
+  }
+  return color;
+}
+
+/**
+ * Separable resampling, horizontal pass into an intermediate image followed by the vertical pass
+*/
+static int resample(const ResampleSource* source, uint32_t* target, int width, int height, int stride,
+                    ResampleFilter filter, int simd, int premultiplied) {
+  if (width <= 0 || height <= 0 || source->width <= 0 || source->height <= 0) return 0;
+
+  FilterWeights horizontal = {0}, vertical = {0};
+  // Source rows filtered horizontally to the target width
+  float* intermediate = malloc(sizeof(float) * 4 * (size_t)width * source->height);
+  // One vertically filtered target row
+  float* line = malloc(sizeof(float) * 4 * (size_t)width);
+  int ok = intermediate && line &&
+    computeWeights(&horizontal, source->width, width, filter) &&
+    computeWeights(&vertical, source->height, height, filter);
+  const float** rows = ok ? malloc(sizeof(float*) * vertical.taps) : NULL;
+
+  if (rows) {
+    for (int y = 0; y < source->height; y++) {
+      filterRow(&horizontal, source->pixels + (size_t)y * source->width * 4,
+                intermediate + (size_t)y * width * 4, width, simd);
+    }
+
+    for (int y = 0; y < height; y++) {
+      for (int k = 0; k < vertical.taps; k++) {
+        rows[k] = intermediate + (size_t)(vertical.start[y] + k) * width * 4;
+      }
+      filterColumn(rows, &vertical.weights[y * vertical.taps], vertical.taps, line, width * 4, simd);
+
+      uint32_t* out = target + (size_t)y * stride;
+      for (int x = 0; x < width; x++) {
+        float* pixel = line + x * 4;
+        if (premultiplied) {
+          out[x] = toPremultiplied(pixel);
+          continue;
+        }
+        // Pixels mostly covered by keyed source pixels stay transparent, the edge keeps the opaque color
+        if (pixel[3] < 0.5f) {
+          out[x] = source->transparentColor;
+          continue;
+        }
+        uint32_t color = (toChannel(pixel[0], pixel[3]) << 16) | (toChannel(pixel[1], pixel[3]) << 8) | toChannel(pixel[2], pixel[3]);
+        // An opaque pixel must never hit the key by accident, otherwise it would be dropped
+        if (color == source->transparentColor) color ^= 1;
+        out[x] = color;
+      }
+    }
+  }
+
+  free(rows);
+  free(intermediate);
+  free(line);
+  releaseWeights(&horizontal);
+  releaseWeights(&vertical);
+  return rows != NULL;
+}
+
+/**
+ * Resamples the source into width x height target pixels (0x00RRGGBB) with the separable filter
+ *
+ * Target pixels covered less then half by opaque source pixels are set to the transparent color of the source,
+ * all others get the coverage weighted color of the opaque source pixels.
+ * Returns 0 if the scratch memory could not be allocated.
+*/
+int ResampleSprite(const ResampleSource* source, uint32_t* target, int width, int height, int stride, ResampleFilter filter) {
+  return resample(source, target, width, height, stride, filter, 1, 0);
+}
+
+/**
+ * Resamples the source into width x height premultiplied alpha target pixels (0xAARRGGBB) with the separable filter
+ *
+ * The coverage of keyed source pixels becomes the alpha, so colour-keyed edges turn into smooth translucent edges.
+ * Returns 0 if the scratch memory could not be allocated.
+*/
+int ResampleSpritePremultiplied(const ResampleSource* source, uint32_t* target, int width, int height, int stride, ResampleFilter filter) {
+  return resample(source, target, width, height, stride, filter, 1, 1);
+}
+
+/**
+ * Scalar reference of ResampleSprite()
+*/
+int ResampleSpriteScalar(const ResampleSource* source, uint32_t* target, int width, int height, int stride, ResampleFilter filter) {
+  return resample(source, target, width, height, stride, filter, 0, 0);
+}
@@ -0,0 +1,78 @@
+#ifndef SPRITERESAMPLE_H
+#define SPRITERESAMPLE_H
+
+#include <stdint.h>
+
+/**
+ * Reconstruction filters of the resampler
+*/
+typedef enum {
+  // Nearest neighbour (same result as a plain StretchBlt)
+  RESAMPLE_NEAREST = 0,
+  // Triangle filter, widened when downscaling (box-like averaging)
+  RESAMPLE_BILINEAR = 1,
+  // Windowed sinc with 3 lobes, sharpest result
+  RESAMPLE_LANCZOS3 = 2
+} ResampleFilter;
+
+/**
+ * Source image prepared for resampling
+ *
+ * The pixels are converted once into premultiplied float rgba, colour-keyed pixels get an alpha of 0.
+ * So the key color never bleeds into the edges, it only reduces the coverage of edge pixels.
+ * One source can be resampled to any count of target sizes.
+*/
+typedef struct {
+  // Premultiplied rgba floats, 4 per pixel, rows packed without padding
+  float* pixels;
+  // Size of the source in pixels
+  int width;
+  int height;
+  // Color treated as transparent (0x00RRGGBB)
+  uint32_t transparentColor;
+} ResampleSource;
+
+/**
+ * Create a resample source from 32 bit pixels (0x00RRGGBB), pixels matching transparentColor (rgb only) are transparent
+ *
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+ResampleSource* CreateResampleSource(const uint32_t* pixels, int width, int height, int stride, uint32_t transparentColor);
+
+/**
+ * Create a resample source from 32 bit straight alpha pixels (0xAARRGGBB)
+ *
+ * stride is the distance between two source rows in pixels
+ * If the allocation fails it returns NULL
+*/
+ResampleSource* CreateResampleSourceAlpha(const uint32_t* pixels, int width, int height, int stride);
+
+/**
+ * Cleans up a resample source
+*/
+void CloseResampleSource(ResampleSource* source);
+
+/**
+ * Resamples the source into width x height target pixels (0x00RRGGBB) with the separable filter
+ *
+ * Target pixels covered less then half by opaque source pixels are set to the transparent color of the source,
+ * all others get the coverage weighted color of the opaque source pixels.
+ * Returns 0 if the scratch memory could not be allocated.
+*/
+int ResampleSprite(const ResampleSource* source, uint32_t* target, int width, int height, int stride, ResampleFilter filter);
+
+/**
+ * Resamples the source into width x height premultiplied alpha target pixels (0xAARRGGBB) with the separable filter
+ *
+ * The coverage of keyed source pixels becomes the alpha, so colour-keyed edges turn into smooth translucent edges.
+ * Returns 0 if the scratch memory could not be allocated.
+*/
+int ResampleSpritePremultiplied(const ResampleSource* source, uint32_t* target, int width, int height, int stride, ResampleFilter filter);
+
+/**
+ * Scalar reference of ResampleSprite()
+*/
+int ResampleSpriteScalar(const ResampleSource* source, uint32_t* target, int width, int height, int stride, ResampleFilter filter);
+
+#endif
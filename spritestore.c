@@ -0,0 +1,545 @@
+#include "spritestore.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SPRITESTORE_SSE2
+#endif
+
+// Count of precomputed decrementor factors, decSteps larger then this are calculated on the fly
+#define DECAY_TABLE_SIZE 256
+
+// Logarithmic decrementor factors log(step + 1) / log(step + 2) indexed by the decrement step
+static double decayTable[DECAY_TABLE_SIZE];
+// Indicates if the decayTable was already filled
+static int decayTableReady = 0;
+
+/**
+ * Fills the decayTable, so that the hot loop does not call log() for every sprite
+ *
+ * Filling the table multiple times (e.g. from two threads) is harmless as the values are always the same
+*/
+static void initDecayTable() {
+  if (decayTableReady) return;
+  for (int i = 0; i < DECAY_TABLE_SIZE; i++) {
+    decayTable[i] = log(i + 1) / log(i + 2);
+  }
+  decayTableReady = 1;
+}
+
+/**
+ * Create a sprite store with space for capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteStore* CreateSpriteStore(int capacity) {
+  initDecayTable();
+
+  SpriteStore* store = calloc(1, sizeof(SpriteStore));
+  if (!store) return NULL;
+
+  // Round the capacity up to a full AVX2 register, so that kernels never have to care about
+  // the arrays ending in the middle of a vector (the padding is just never read back)
+  int padded = ((capacity > 0 ? capacity : 1) + 7) & ~7;
+
+  store->xPos = calloc(padded, sizeof(int));
+  store->yPos = calloc(padded, sizeof(int));
+  store->prevX = calloc(padded, sizeof(int));
+  store->prevY = calloc(padded, sizeof(int));
+  store->xMov = calloc(padded, sizeof(int));
+  store->yMov = calloc(padded, sizeof(int));
+  store->inc = calloc(padded, sizeof(int));
+  store->baseInc = calloc(padded, sizeof(int));
+  store->decSteps = calloc(padded, sizeof(int));
+  store->baseDecScale = calloc(padded, sizeof(double));
+  store->width = calloc(padded, sizeof(int));
+  store->height = calloc(padded, sizeof(int));
+  store->order = calloc(padded, sizeof(int));
+  store->count = 0;
+  store->total = 0;
+  store->capacity = capacity;
+
+  if (!store->xPos || !store->yPos || !store->prevX || !store->prevY || !store->xMov || !store->yMov || !store->inc || !store->baseInc ||
+      !store->decSteps || !store->baseDecScale || !store->width || !store->height || !store->order) {
+    CloseSpriteStore(store);
+    return NULL;
+  }
+  return store;
+}
+
+/**
+ * Cleans up the sprite store and all its arrays
+*/
+void CloseSpriteStore(SpriteStore* store) {
+  if (store) {
+    free(store->xPos);
+    free(store->yPos);
+    free(store->prevX);
+    free(store->prevY);
+    free(store->xMov);
+    free(store->yMov);
+    free(store->inc);
+    free(store->baseInc);
+    free(store->decSteps);
+    free(store->baseDecScale);
+    free(store->width);
+    free(store->height);
+    free(store->order);
+    free(store);
+  }
+}
+
+/**
+ * Append a sprite to the store, all positions, speeds and sizes are in fixed point units
+ *
+ * The sprite is active unless sprites are parked, then it is parked as well.
+ * Returns the index of the sprite or -1 if the store is full
+*/
+int AddSprite(
+  SpriteStore* store,
+  int xPos,
+  int yPos,
+  int xMov,
+  int yMov,
+  int bounceIncrement,
+  double bounceDecrementScale,
+  int width,
+  int height) {
+
+  if (store->total >= store->capacity) return -1;
+
+  int i = store->total++;
+  // Active sprites are always the first count sprites, behind a parked sprite the new sprite is parked too
+  if (store->count == i) store->count++;
+  store->xPos[i] = xPos;
+  store->yPos[i] = yPos;
+  // A new sprite has no previous step, it is rendered at its spawn position
+  store->prevX[i] = xPos;
+  store->prevY[i] = yPos;
+  store->xMov[i] = xMov;
+  store->yMov[i] = yMov;
+  store->inc[i] = 0;
+  store->decSteps[i] = 1;
+  store->baseInc[i] = bounceIncrement;
+  store->baseDecScale[i] = bounceDecrementScale;
+  store->width[i] = width;
+  store->height[i] = height;
+  // New sprites are appended to the end of the sweep order, the next insertion sort moves them into place
+  store->order[i] = i;
+  return i;
+}
+
+/**
+ * Copies the complete state of the sprite at index out of the store
+*/
+void ReadSpriteState(const SpriteStore* store, int index, SpriteState* state) {
+  state->xPos = store->xPos[index];
+  state->yPos = store->yPos[index];
+  state->prevX = store->prevX[index];
+  state->prevY = store->prevY[index];
+  state->xMov = store->xMov[index];
+  state->yMov = store->yMov[index];
+  state->inc = store->inc[index];
+  state->baseInc = store->baseInc[index];
+  state->decSteps = store->decSteps[index];
+  state->baseDecScale = store->baseDecScale[index];
+  state->width = store->width[index];
+  state->height = store->height[index];
+}
+
+/**
+ * Writes the complete state into the sprite at index
+*/
+static void writeSpriteState(SpriteStore* store, int index, const SpriteState* state) {
+  store->xPos[index] = state->xPos;
+  store->yPos[index] = state->yPos;
+  store->prevX[index] = state->prevX;
+  store->prevY[index] = state->prevY;
+  store->xMov[index] = state->xMov;
+  store->yMov[index] = state->yMov;
+  store->inc[index] = state->inc;
+  store->baseInc[index] = state->baseInc;
+  store->decSteps[index] = state->decSteps;
+  store->baseDecScale[index] = state->baseDecScale;
+  store->width[index] = state->width;
+  store->height[index] = state->height;
+}
+
+/**
+ * Appends a sprite with the complete state (including the previous position and the speed addition)
+ *
+ * The sprite is active unless sprites are parked, then it is parked as well.
+ * Returns the index of the sprite or -1 if the store is full
+*/
+int AddSpriteState(SpriteStore* store, const SpriteState* state) {
+  if (store->total >= store->capacity) return -1;
+
+  int i = store->total++;
+  if (store->count == i) store->count++;
+  writeSpriteState(store, i, state);
+  // Appended to the end of the sweep order like AddSprite(), the next insertion sort moves it into place
+  store->order[i] = i;
+  return i;
+}
+
+/**
+ * Removes the sprite at index, the last sprite takes over its index
+ *
+ * The sweep order keeps the order of the remaining sprites. Meant for stores without parked sprites,
+ * a parked last sprite would become active in place of the removed one.
+*/
+void RemoveSprite(SpriteStore* store, int index) {
+  int last = store->total - 1;
+  if (index < 0 || index > last) return;
+
+  if (index != last) {
+    SpriteState state;
+    ReadSpriteState(store, last, &state);
+    writeSpriteState(store, index, &state);
+  }
+  // Drop the removed index from the sweep order and rename the moved sprite, the order stays sorted
+  int* order = store->order;
+  int kept = 0;
+  for (int r = 0; r < store->total; r++) {
+    if (order[r] == index) continue;
+    order[kept++] = order[r] == last ? index : order[r];
+  }
+  store->total = last;
+  if (store->count > last) store->count = last;
+}
+
+/**
+ * Removes all sprites from index count on, the sweep order keeps the order of the remaining sprites
+*/
+void TruncateSprites(SpriteStore* store, int count) {
+  if (count < 0) count = 0;
+  if (count >= store->total) return;
+
+  int* order = store->order;
+  int kept = 0;
+  for (int r = 0; r < store->total; r++) {
+    if (order[r] < count) order[kept++] = order[r];
+  }
+  store->total = count;
+  if (store->count > count) store->count = count;
+}
+
+/**
+ * Sets the count of active sprites (clamped to the added sprites), the sprites behind it are parked
+ *
+ * Parked sprites keep their state and continue from it once they are active again.
+ * The sweep order is partitioned, so the active sprites stay in front in their sorted order.
+*/
+void ParkSprites(SpriteStore* store, int active) {
+  if (active < 0) active = 0;
+  if (active > store->total) active = store->total;
+  if (active == store->count) return;
+
+  // The active sprites keep their sorted order in front, the parked sprites are just appended by index
+  // Resumed sprites end up behind the active ones, the next insertion sort moves them into place
+  int* order = store->order;
+  int kept = 0;
+  for (int r = 0; r < store->total; r++) {
+    if (order[r] < active) order[kept++] = order[r];
+  }
+  for (int i = active; i < store->total; i++) order[kept++] = i;
+
+  // Resumed sprites have no previous step, they are rendered at their parked position
+  for (int i = store->count; i < active; i++) {
+    store->prevX[i] = store->xPos[i];
+    store->prevY[i] = store->yPos[i];
+  }
+  store->count = active;
+}
+
+/**
+ * Decrements the speed addition of all boosted sprites
+ *
+ * Logarithm the difference between log(a) and log(a+1) gets smaller when a is getting larger
+ * therefore its quite good to create a smooth animation, because if a (aka decStep) is small
+ * it won't decrement much from inc
+ *
+ * This pass is kept scalar, only sprites which recently bounced have a boost, so most iterations just skip
+*/
+static void decaySprites(SpriteStore* store) {
+  for (int i = 0; i < store->count; i++) {
+    if (store->inc[i] > 0) {
+      int step = store->decSteps[i];
+      double factor = step < DECAY_TABLE_SIZE ? decayTable[step] : log(step + 1) / log(step + 2);
+      store->inc[i] *= store->baseDecScale[i] * factor;
+      // Increment decrement steps
+      store->decSteps[i]++;
+      // Check boundaries
+      store->inc[i] = store->inc[i] <= 0 ? 0 : store->inc[i];
+    }
+  }
+}
+
+/**
+ * Moves and bounces the sprites in range [from, to) one at a time
+*/
+static void integrateRange(SpriteStore* store, SpriteBounds bounds, int from, int to) {
+  for (int i = from; i < to; i++) {
+    // Convert the incrementors operator in the operator of the current move state
+    int xInc = (store->xMov[i] >= 0) ? store->inc[i] : -store->inc[i];
+    int yInc = (store->yMov[i] >= 0) ? store->inc[i] : -store->inc[i];
+
+    // Move sprite
+    store->xPos[i] += store->xMov[i] + xInc;
+    store->yPos[i] += store->yMov[i] + yInc;
+
+    // Check if position in bound, if not movement is inverted
+    if (store->xPos[i] + store->width[i] > bounds.right || store->xPos[i] < bounds.left) {
+      store->inc[i] = store->baseInc[i];
+      store->decSteps[i] = 1;
+      store->xMov[i] = - store->xMov[i];
+
+      // The sprite crossed the border during the step, the motion after the time of impact is reflected
+      // Sprites that already started outside (e.g. pushed out by a collision) are just corrected to the border
+      if (store->xPos[i] + store->width[i] > bounds.right)
+        store->xPos[i] = store->prevX[i] + store->width[i] > bounds.right
+          ? bounds.right - store->width[i]
+          : 2 * (bounds.right - store->width[i]) - store->xPos[i];
+      else if (store->xPos[i] < bounds.left)
+        store->xPos[i] = store->prevX[i] < bounds.left ? bounds.left : 2 * bounds.left - store->xPos[i];
+
+      // Check if the reflected motion is still out of boundaries (window smaller then the motion), then correct it to the border
+      if (store->xPos[i] + store->width[i] > bounds.right)
+        store->xPos[i] = bounds.right - store->width[i];
+      else if (store->xPos[i] < bounds.left)
+        store->xPos[i] = bounds.left;
+    }
+    // Check if position in bound, if not movement is inverted
+    if (store->yPos[i] + store->height[i] > bounds.bottom || store->yPos[i] < bounds.top) {
+      store->inc[i] = store->baseInc[i];
+      store->decSteps[i] = 1;
+      store->yMov[i] = - store->yMov[i];
+
+      // The sprite crossed the border during the step, the motion after the time of impact is reflected
+      // Sprites that already started outside (e.g. pushed out by a collision) are just corrected to the border
+      if (store->yPos[i] + store->height[i] > bounds.bottom)
+        store->yPos[i] = store->prevY[i] + store->height[i] > bounds.bottom
+          ? bounds.bottom - store->height[i]
+          : 2 * (bounds.bottom - store->height[i]) - store->yPos[i];
+      else if (store->yPos[i] < bounds.top)
+        store->yPos[i] = store->prevY[i] < bounds.top ? bounds.top : 2 * bounds.top - store->yPos[i];
+
+      // Check if the reflected motion is still out of boundaries (window smaller then the motion), then correct it to the border
+      if (store->yPos[i] + store->height[i] > bounds.bottom)
+        store->yPos[i] = bounds.bottom - store->height[i];
+      else if (store->yPos[i] < bounds.top)
+        store->yPos[i] = bounds.top;
+    }
+  }
+}
+
+#if defined(SPRITESTORE_SSE2)
+/**
+ * SSE2 has no blend instruction, so lanes are selected with and / andnot (mask ? a : b)
+*/
+static inline __m128i select128(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/**
+ * Negates all lanes where mask is set ((v ^ -1) - (-1) == -v)
+*/
+static inline __m128i negate128(__m128i mask, __m128i v) {
+  return _mm_sub_epi32(_mm_xor_si128(v, mask), mask);
+}
+
+/**
+ * Reflects the motion behind the hit border and clamps the lanes whose reflection is still out of range
+*/
+static inline __m128i reflect128(
+  __m128i pos, __m128i prev, __m128i size, __m128i low, __m128i high, __m128i hitLow, __m128i hitHigh) {
+  __m128i limit = _mm_sub_epi32(high, size);
+  // Lanes that already started outside are corrected to the border instead
+  __m128i highTarget = select128(_mm_cmpgt_epi32(_mm_add_epi32(prev, size), high), limit, _mm_sub_epi32(_mm_add_epi32(limit, limit), pos));
+  __m128i lowTarget = select128(_mm_cmplt_epi32(prev, low), low, _mm_sub_epi32(_mm_add_epi32(low, low), pos));
+  pos = select128(hitHigh, highTarget, select128(hitLow, lowTarget, pos));
+  __m128i overHigh = _mm_cmpgt_epi32(_mm_add_epi32(pos, size), high);
+  __m128i overLow = _mm_andnot_si128(overHigh, _mm_cmplt_epi32(pos, low));
+  return select128(overHigh, limit, select128(overLow, low, pos));
+}
+
+/**
+ * Moves and bounces 4 sprites per iteration, returns the first index that was not processed
+*/
+static int integrateSse2(SpriteStore* store, SpriteBounds bounds, int from) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i left = _mm_set1_epi32(bounds.left);
+  const __m128i top = _mm_set1_epi32(bounds.top);
+  const __m128i right = _mm_set1_epi32(bounds.right);
+  const __m128i bottom = _mm_set1_epi32(bounds.bottom);
+
+  int i = from;
+  for (; i + 4 <= store->count; i += 4) {
+    __m128i xPos = _mm_loadu_si128((const __m128i*)&store->xPos[i]);
+    __m128i yPos = _mm_loadu_si128((const __m128i*)&store->yPos[i]);
+    __m128i xMov = _mm_loadu_si128((const __m128i*)&store->xMov[i]);
+    __m128i yMov = _mm_loadu_si128((const __m128i*)&store->yMov[i]);
+    __m128i inc = _mm_loadu_si128((const __m128i*)&store->inc[i]);
+    __m128i width = _mm_loadu_si128((const __m128i*)&store->width[i]);
+    __m128i height = _mm_loadu_si128((const __m128i*)&store->height[i]);
+
+    // Apply the incrementor in the direction of the current movement
+    xPos = _mm_add_epi32(xPos, _mm_add_epi32(xMov, negate128(_mm_cmplt_epi32(xMov, zero), inc)));
+    yPos = _mm_add_epi32(yPos, _mm_add_epi32(yMov, negate128(_mm_cmplt_epi32(yMov, zero), inc)));
+
+    // Bounce on the x axis
+    __m128i xRight = _mm_add_epi32(xPos, width);
+    __m128i hitRight = _mm_cmpgt_epi32(xRight, right);
+    __m128i hitLeft = _mm_cmplt_epi32(xPos, left);
+    __m128i hitX = _mm_or_si128(hitRight, hitLeft);
+    xPos = reflect128(xPos, _mm_loadu_si128((const __m128i*)&store->prevX[i]), width, left, right, hitLeft, hitRight);
+    xMov = negate128(hitX, xMov);
+
+    // Bounce on the y axis
+    __m128i yBottom = _mm_add_epi32(yPos, height);
+    __m128i hitBottom = _mm_cmpgt_epi32(yBottom, bottom);
+    __m128i hitTop = _mm_cmplt_epi32(yPos, top);
+    __m128i hitY = _mm_or_si128(hitBottom, hitTop);
+    yPos = reflect128(yPos, _mm_loadu_si128((const __m128i*)&store->prevY[i]), height, top, bottom, hitTop, hitBottom);
+    yMov = negate128(hitY, yMov);
+
+    // Every bounce resets the boost
+    __m128i hit = _mm_or_si128(hitX, hitY);
+    inc = select128(hit, _mm_loadu_si128((const __m128i*)&store->baseInc[i]), inc);
+    __m128i decSteps = select128(hit, one, _mm_loadu_si128((const __m128i*)&store->decSteps[i]));
+
+    _mm_storeu_si128((__m128i*)&store->xPos[i], xPos);
+    _mm_storeu_si128((__m128i*)&store->yPos[i], yPos);
+    _mm_storeu_si128((__m128i*)&store->xMov[i], xMov);
+    _mm_storeu_si128((__m128i*)&store->yMov[i], yMov);
+    _mm_storeu_si128((__m128i*)&store->inc[i], inc);
+    _mm_storeu_si128((__m128i*)&store->decSteps[i], decSteps);
+  }
+  return i;
+}
+#endif
+
+#if defined(__AVX2__)
+/**
+ * Negates all lanes where mask is set ((v ^ -1) - (-1) == -v)
+*/
+static inline __m256i negate256(__m256i mask, __m256i v) {
+  return _mm256_sub_epi32(_mm256_xor_si256(v, mask), mask);
+}
+
+/**
+ * Reflects the motion behind the hit border and clamps the lanes whose reflection is still out of range
+*/
+static inline __m256i reflect256(
+  __m256i pos, __m256i prev, __m256i size, __m256i low, __m256i high, __m256i hitLow, __m256i hitHigh) {
+  __m256i limit = _mm256_sub_epi32(high, size);
+  // Lanes that already started outside are corrected to the border instead
+  __m256i highTarget = _mm256_blendv_epi8(_mm256_sub_epi32(_mm256_add_epi32(limit, limit), pos), limit,
+    _mm256_cmpgt_epi32(_mm256_add_epi32(prev, size), high));
+  __m256i lowTarget = _mm256_blendv_epi8(_mm256_sub_epi32(_mm256_add_epi32(low, low), pos), low, _mm256_cmpgt_epi32(low, prev));
+  pos = _mm256_blendv_epi8(_mm256_blendv_epi8(pos, lowTarget, hitLow), highTarget, hitHigh);
+  __m256i overHigh = _mm256_cmpgt_epi32(_mm256_add_epi32(pos, size), high);
+  __m256i overLow = _mm256_andnot_si256(overHigh, _mm256_cmpgt_epi32(low, pos));
+  return _mm256_blendv_epi8(_mm256_blendv_epi8(pos, low, overLow), limit, overHigh);
+}
+
+/**
+ * Moves and bounces 8 sprites per iteration, returns the first index that was not processed
+*/
+static int integrateAvx2(SpriteStore* store, SpriteBounds bounds, int from) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i left = _mm256_set1_epi32(bounds.left);
+  const __m256i top = _mm256_set1_epi32(bounds.top);
+  const __m256i right = _mm256_set1_epi32(bounds.right);
+  const __m256i bottom = _mm256_set1_epi32(bounds.bottom);
+
+  int i = from;
+  for (; i + 8 <= store->count; i += 8) {
+    __m256i xPos = _mm256_loadu_si256((const __m256i*)&store->xPos[i]);
+    __m256i yPos = _mm256_loadu_si256((const __m256i*)&store->yPos[i]);
+    __m256i xMov = _mm256_loadu_si256((const __m256i*)&store->xMov[i]);
+    __m256i yMov = _mm256_loadu_si256((const __m256i*)&store->yMov[i]);
+    __m256i inc = _mm256_loadu_si256((const __m256i*)&store->inc[i]);
+    __m256i width = _mm256_loadu_si256((const __m256i*)&store->width[i]);
+    __m256i height = _mm256_loadu_si256((const __m256i*)&store->height[i]);
+
+    // Apply the incrementor in the direction of the current movement
+    xPos = _mm256_add_epi32(xPos, _mm256_add_epi32(xMov, negate256(_mm256_cmpgt_epi32(zero, xMov), inc)));
+    yPos = _mm256_add_epi32(yPos, _mm256_add_epi32(yMov, negate256(_mm256_cmpgt_epi32(zero, yMov), inc)));
+
+    // Bounce on the x axis
+    __m256i hitRight = _mm256_cmpgt_epi32(_mm256_add_epi32(xPos, width), right);
+    __m256i hitLeft = _mm256_cmpgt_epi32(left, xPos);
+    __m256i hitX = _mm256_or_si256(hitRight, hitLeft);
+    xPos = reflect256(xPos, _mm256_loadu_si256((const __m256i*)&store->prevX[i]), width, left, right, hitLeft, hitRight);
+    xMov = negate256(hitX, xMov);
+
+    // Bounce on the y axis
+    __m256i hitBottom = _mm256_cmpgt_epi32(_mm256_add_epi32(yPos, height), bottom);
+    __m256i hitTop = _mm256_cmpgt_epi32(top, yPos);
+    __m256i hitY = _mm256_or_si256(hitBottom, hitTop);
+    yPos = reflect256(yPos, _mm256_loadu_si256((const __m256i*)&store->prevY[i]), height, top, bottom, hitTop, hitBottom);
+    yMov = negate256(hitY, yMov);
+
+    // Every bounce resets the boost
+    __m256i hit = _mm256_or_si256(hitX, hitY);
+    inc = _mm256_blendv_epi8(inc, _mm256_loadu_si256((const __m256i*)&store->baseInc[i]), hit);
+    __m256i decSteps = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)&store->decSteps[i]), one, hit);
+
+    _mm256_storeu_si256((__m256i*)&store->xPos[i], xPos);
+    _mm256_storeu_si256((__m256i*)&store->yPos[i], yPos);
+    _mm256_storeu_si256((__m256i*)&store->xMov[i], xMov);
+    _mm256_storeu_si256((__m256i*)&store->yMov[i], yMov);
+    _mm256_storeu_si256((__m256i*)&store->inc[i], inc);
+    _mm256_storeu_si256((__m256i*)&store->decSteps[i], decSteps);
+  }
+  return i;
+}
+#endif
+
+/**
+ * Keeps the current positions as previous positions for the render interpolation
+*/
+static void keepPositions(SpriteStore* store) {
+  memcpy(store->prevX, store->xPos, sizeof(int) * store->count);
+  memcpy(store->prevY, store->yPos, sizeof(int) * store->count);
+}
+
+/**
+ * Advances all sprites by one step and bounces them off the bounds (in fixed point units)
+ *
+ * The positions before the step are kept in prevX / prevY.
+ * Uses the widest available kernel (AVX2 if compiled with AVX2 support, SSE2 otherwise),
+ * the results are identical to IntegrateSpritesScalar()
+*/
+void IntegrateSprites(SpriteStore* store, SpriteBounds bounds) {
+  keepPositions(store);
+  decaySprites(store);
+
+  int i = 0;
+#if defined(__AVX2__)
+  i = integrateAvx2(store, bounds, i);
+#endif
+#if defined(SPRITESTORE_SSE2)
+  i = integrateSse2(store, bounds, i);
+#endif
+  // Process the remaining tail (or everything if no vector unit is available)
+  integrateRange(store, bounds, i, store->count);
+}
+
+/**
+ * Scalar reference implementation of IntegrateSprites()
+*/
+void IntegrateSpritesScalar(SpriteStore* store, SpriteBounds bounds) {
+  keepPositions(store);
+  decaySprites(store);
+  integrateRange(store, bounds, 0, store->count);
+}
@@ -0,0 +1,169 @@
+#ifndef SPRITESTORE_H
+#define SPRITESTORE_H
+
+// Fractional bits of the sub-pixel positions (24.8 fixed point)
+#define SPRITE_FIXED_SHIFT 8
+// One pixel in fixed point units
+#define SPRITE_FIXED_ONE (1 << SPRITE_FIXED_SHIFT)
+// Converts whole pixels into fixed point units
+#define SPRITE_TO_FIXED(pixels) ((pixels) * SPRITE_FIXED_ONE)
+
+/**
+ * Platform neutral boundary rect used by the sprite kernels
+ *
+ * Has the same layout as a win32 RECT (right and bottom are the outer edges)
+*/
+typedef struct {
+  int left;
+  int top;
+  int right;
+  int bottom;
+} SpriteBounds;
+
+/**
+ * Complete movement state of one sprite, used to move a sprite from one store into another
+ *
+ * All positions, speeds and sizes are in fixed point units like in the store
+*/
+typedef struct {
+  // Position of the sprite and its position before the last step
+  int xPos;
+  int yPos;
+  int prevX;
+  int prevY;
+  // Current speed of the sprite
+  int xMov;
+  int yMov;
+  // Current and base speed addition of the sprite
+  int inc;
+  int baseInc;
+  // Current speed addition decrementor step
+  int decSteps;
+  // Base scaler to slow down decrementor
+  double baseDecScale;
+  // Size of the sprite
+  int width;
+  int height;
+} SpriteState;
+
+/**
+ * Structure-of-arrays store holding the movement state of all sprites on a window
+ *
+ * Every attribute lives in its own contiguous array, the sprite index is the same for all arrays.
+ * This way the integration kernels can process 4 (SSE2) or 8 (AVX2) sprites per instruction
+ * instead of chasing one heap allocated state per sprite.
+ *
+ * Positions, speeds and sizes are 24.8 fixed point (SPRITE_FIXED_SHIFT), so slow sprites can move
+ * by fractions of a pixel per step. The integer kernels stay the same as for whole pixels.
+*/
+typedef struct {
+  // Position of the sprites
+  int* xPos;
+  int* yPos;
+  // Position of the sprites before the last step, the render position is interpolated between both
+  int* prevX;
+  int* prevY;
+  // Current speed of the sprites
+  int* xMov;
+  int* yMov;
+  // Current speed addition of the sprites
+  int* inc;
+  // Base speed addition of the sprites
+  int* baseInc;
+  // Current speed addition decrementor step
+  int* decSteps;
+  // Base scaler to slow down decrementor
+  double* baseDecScale;
+  // Size of the sprites
+  int* width;
+  int* height;
+  // Sprite indices sorted by x position, used by the collision sweep
+  // The sprites themselves are never reordered, so index i always refers to the same sprite (and image)
+  int* order;
+
+  // Count of active sprites, the sprites 0 to count - 1 are simulated
+  int count;
+  // Count of sprites added to the store, the sprites count to total - 1 are parked (keep their state but are not simulated)
+  int total;
+  // Count of sprites the arrays can hold
+  int capacity;
+} SpriteStore;
+
+/**
+ * Create a sprite store with space for capacity sprites
+ *
+ * If the allocation fails it returns NULL
+*/
+SpriteStore* CreateSpriteStore(int capacity);
+
+/**
+ * Cleans up the sprite store and all its arrays
+*/
+void CloseSpriteStore(SpriteStore* store);
+
+/**
+ * Append a sprite to the store, all positions, speeds and sizes are in fixed point units
+ *
+ * The sprite is active unless sprites are parked, then it is parked as well.
+ * Returns the index of the sprite or -1 if the store is full
+*/
+int AddSprite(
+  SpriteStore* store,
+  int xPos,
+  int yPos,
+  int xMov,
+  int yMov,
+  int bounceIncrement,
+  double bounceDecrementScale,
+  int width,
+  int height);
+
+/**
+ * Copies the complete state of the sprite at index out of the store
+*/
+void ReadSpriteState(const SpriteStore* store, int index, SpriteState* state);
+
+/**
+ * Appends a sprite with the complete state (including the previous position and the speed addition)
+ *
+ * The sprite is active unless sprites are parked, then it is parked as well.
+ * Returns the index of the sprite or -1 if the store is full
+*/
+int AddSpriteState(SpriteStore* store, const SpriteState* state);
+
+/**
+ * Removes the sprite at index, the last sprite takes over its index
+ *
+ * The sweep order keeps the order of the remaining sprites. Meant for stores without parked sprites,
+ * a parked last sprite would become active in place of the removed one.
+*/
+void RemoveSprite(SpriteStore* store, int index);
+
+/**
+ * Removes all sprites from index count on, the sweep order keeps the order of the remaining sprites
+*/
+void TruncateSprites(SpriteStore* store, int count);
+
+/**
+ * Sets the count of active sprites (clamped to the added sprites), the sprites behind it are parked
+ *
+ * Parked sprites keep their state and continue from it once they are active again.
+ * The sweep order is partitioned, so the active sprites stay in front in their sorted order.
+*/
+void ParkSprites(SpriteStore* store, int active);
+
+/**
+ * Advances all sprites by one step and bounces them off the bounds (in fixed point units)
+ *
+ * The positions before the step are kept in prevX / prevY.
+ * Uses the widest available kernel (AVX2 if compiled with AVX2 support, SSE2 otherwise),
+ * the results are identical to IntegrateSpritesScalar()
+*/
+void IntegrateSprites(SpriteStore* store, SpriteBounds bounds);
+
+/**
+ * Scalar reference implementation of IntegrateSprites()
+*/
+void IntegrateSpritesScalar(SpriteStore* store, SpriteBounds bounds);
+
+#endif
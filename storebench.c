@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spritestore.h"
+#include "framescheduler.h"
+#include "randomgenerator.h"
+
+/**
+ * Fills the store with count random sprites, some of them start outside the bounds or move further then the bounds per step
+*/
+static void fillStore(SpriteStore* store, int count, SpriteBounds bounds, uint64_t seed) {
+  RandomGenerator random;
+  SeedRandomGenerator(&random, seed);
+  int width = (bounds.right - bounds.left) >> SPRITE_FIXED_SHIFT;
+  int height = (bounds.bottom - bounds.top) >> SPRITE_FIXED_SHIFT;
+  for (int i = 0; i < count; i++) {
+    int size = SPRITE_TO_FIXED(16 + RandomBelow(&random, 112));
+    // Every 16th sprite is as fast as the bounds are wide, so its reflected motion is still out of the bounds
+    int speed = i % 16 == 0 ? SPRITE_TO_FIXED(width) : 1 + RandomBelow(&random, SPRITE_TO_FIXED(12));
+    AddSprite(
+      store,
+      bounds.left + SPRITE_TO_FIXED(RandomBelow(&random, width + 64) - 32),
+      bounds.top + SPRITE_TO_FIXED(RandomBelow(&random, height + 64) - 32),
+      RandomBelow(&random, 2) ? speed : -speed,
+      RandomBelow(&random, 2) ? speed : -speed,
+      SPRITE_TO_FIXED(RandomBelow(&random, 20)),
+      0.5 + RandomBelow(&random, 50) / 100.0,
+      size,
+      size
+    );
+  }
+}
+
+/**
+ * Pushes some sprites out of the bounds, like a collision resolved next to the border would do
+*/
+static void pushSprites(SpriteStore* a, SpriteStore* b, RandomGenerator* random) {
+  for (int i = RandomBelow(random, 7); i < a->count; i += 7) {
+    int dx = SPRITE_TO_FIXED(RandomBelow(random, 65) - 32);
+    int dy = SPRITE_TO_FIXED(RandomBelow(random, 65) - 32);
+    a->xPos[i] += dx;
+    a->yPos[i] += dy;
+    b->xPos[i] += dx;
+    b->yPos[i] += dy;
+  }
+}
+
+/**
+ * Returns the index of the first sprite whose state differs between both stores or -1 if they are identical
+*/
+static int compareStores(const SpriteStore* a, const SpriteStore* b) {
+  for (int i = 0; i < a->count; i++) {
+    if (a->xPos[i] != b->xPos[i] || a->yPos[i] != b->yPos[i] || a->prevX[i] != b->prevX[i] || a->prevY[i] != b->prevY[i] ||
+        a->xMov[i] != b->xMov[i] || a->yMov[i] != b->yMov[i] || a->inc[i] != b->inc[i] || a->decSteps[i] != b->decSteps[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Runs steps of the vector kernel and the scalar reference on the same sprites
+ *
+ * Returns the step the stores diverged in or -1, the time per step of both is written to vectorTime and scalarTime (in ms)
+*/
+static int runStores(int count, int steps, SpriteBounds bounds, double* vectorTime, double* scalarTime) {
+  SpriteStore* vector = CreateSpriteStore(count);
+  SpriteStore* scalar = CreateSpriteStore(count);
+  if (!vector || !scalar) {
+    fprintf(stderr, "the stores could not be created\n");
+    exit(1);
+  }
+  fillStore(vector, count, bounds, count);
+  fillStore(scalar, count, bounds, count);
+
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 3);
+  int diverged = -1;
+  *vectorTime = 0.0;
+  *scalarTime = 0.0;
+  for (int step = 0; step < steps && diverged < 0; step++) {
+    if (step % 50 == 49) pushSprites(vector, scalar, &random);
+
+    double start = FrameSchedulerNow();
+    IntegrateSprites(vector, bounds);
+    double middle = FrameSchedulerNow();
+    IntegrateSpritesScalar(scalar, bounds);
+    double end = FrameSchedulerNow();
+    *vectorTime += middle - start;
+    *scalarTime += end - middle;
+
+    int sprite = compareStores(vector, scalar);
+    if (sprite >= 0) {
+      fprintf(stderr, "%d sprites: sprite %d diverged in step %d\n", count, sprite, step);
+      diverged = step;
+    }
+  }
+  *vectorTime /= steps;
+  *scalarTime /= steps;
+
+  CloseSpriteStore(vector);
+  CloseSpriteStore(scalar);
+  return diverged;
+}
+
+/**
+ * Headless check and benchmark of the sprite integration kernels
+ *
+ * Not part of the screensaver build, it only needs the platform neutral sprite store:
+ * cc -O2 -mavx2 -o storebench storebench.c spritestore.c framescheduler.c randomgenerator.c -lm -lpthread
+ * ./storebench [sprites] [steps]
+ *
+ * IntegrateSprites() (AVX2 if compiled with -mavx2, SSE2 otherwise) and IntegrateSpritesScalar() run on the same
+ * sprites, including sprites starting outside the bounds, sprites faster then the bounds are wide and sprites
+ * pushed out of the bounds between the steps. Small counts cover the scalar tail behind the vector lanes.
+ * Prints the time per step of both kernels and exits with 1 if a kernel diverged from the scalar reference.
+*/
+int main(int argc, char** argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 100000;
+  int steps = argc > 2 ? atoi(argv[2]) : 1000;
+  if (count < 1 || steps < 1) {
+    fprintf(stderr, "usage: %s [sprites] [steps]\n", argv[0]);
+    return 1;
+  }
+
+#if defined(__AVX2__)
+  const char* kernel = "avx2";
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+  const char* kernel = "sse2";
+#else
+  const char* kernel = "scalar";
+#endif
+
+  SpriteBounds bounds = { .left = 0, .top = 0, .right = SPRITE_TO_FIXED(1920), .bottom = SPRITE_TO_FIXED(1080) };
+  int failed = 0;
+  double vectorTime, scalarTime;
+
+  // Every count up to two full AVX2 registers, so each tail length is covered
+  for (int small = 1; small <= 17; small++) {
+    if (runStores(small, 200, bounds, &vectorTime, &scalarTime) >= 0) failed = 1;
+  }
+
+  for (int sprites = count < 1000 ? count : 1000; ; sprites = sprites * 10 < count ? sprites * 10 : count) {
+    int diverged = runStores(sprites, steps, bounds, &vectorTime, &scalarTime);
+    if (diverged >= 0) failed = 1;
+    printf("%7d sprites: %s %.4f ms/step (%.2f ns/sprite, %.2f%% of a 60hz frame), scalar %.4f ms/step, x%.2f%s\n",
+      sprites, kernel, vectorTime, vectorTime * 1e6 / sprites, vectorTime / (1000.0 / 60.0) * 100.0,
+      scalarTime, vectorTime > 0.0 ? scalarTime / vectorTime : 0.0, diverged >= 0 ? ", DIVERGED" : "");
+    if (sprites == count) break;
+  }
+  return failed;
+}
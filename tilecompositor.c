@@ -0,0 +1,366 @@
+#include "tilecompositor.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+/**
+ * Atomically adds to the value and returns the previous value (full barrier)
+*/
+static long fetchAddAtomic(volatile long* value, long addend) {
+#ifdef _WIN32
+  return InterlockedExchangeAdd(value, addend);
+#else
+  return __atomic_fetch_add(value, addend, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/**
+ * Atomically reads the value
+*/
+static long loadAtomic(volatile long* value) {
+#ifdef _WIN32
+  return InterlockedCompareExchange(value, 0, 0);
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+ * Yields the rest of the timeslice while waiting for the helpers
+*/
+static void yieldThread() {
+#ifdef _WIN32
+  Sleep(0);
+#else
+  sched_yield();
+#endif
+}
+
+/**
+ * Grows the array to hold at least needed elements of size bytes, returns 0 if the allocation fails
+*/
+static int growArray(void** array, int* capacity, int needed, size_t size) {
+  if (needed <= *capacity) return 1;
+  int grown = *capacity > 0 ? *capacity : 16;
+  while (grown < needed) grown *= 2;
+  void* resized = realloc(*array, size * grown);
+  if (!resized) return 0;
+  *array = resized;
+  *capacity = grown;
+  return 1;
+}
+
+/**
+ * Returns the intersection of both rects (empty if right <= left or bottom <= top)
+*/
+static SpriteBounds intersectBounds(SpriteBounds a, SpriteBounds b) {
+  SpriteBounds result = {
+    .left = a.left > b.left ? a.left : b.left,
+    .top = a.top > b.top ? a.top : b.top,
+    .right = a.right < b.right ? a.right : b.right,
+    .bottom = a.bottom < b.bottom ? a.bottom : b.bottom
+  };
+  return result;
+}
+
+/**
+ * Returns 1 if the sprite overlaps the rect
+*/
+static int spriteOverlaps(const CompositorSprite* sprite, SpriteBounds rect) {
+  return sprite->x < rect.right && sprite->y < rect.bottom &&
+    sprite->x + sprite->sprite->width > rect.left && sprite->y + sprite->sprite->height > rect.top;
+}
+
+/**
+ * Create a compositor with helperCount helper threads
+ *
+ * 0 composes on the calling thread only, < 0 uses one helper per further logical processor.
+ * If the allocation or the thread creation fails it returns NULL
+*/
+TileCompositor* CreateTileCompositor(int helperCount) {
+  TileCompositor* compositor = calloc(1, sizeof(TileCompositor));
+  if (!compositor) return NULL;
+
+  // The calling thread renders tiles as well, so it doesn't need a helper of its own
+  if (helperCount < 0) helperCount = GetProcessorCount() - 1;
+  if (helperCount > MAX_WORKERS) helperCount = MAX_WORKERS;
+  if (helperCount > 0) {
+    compositor->pool = CreateWorkerPool(helperCount);
+    if (!compositor->pool) {
+      free(compositor);
+      return NULL;
+    }
+    compositor->helperCount = compositor->pool->threadCount;
+  }
+  return compositor;
+}
+
+/**
+ * Stops the helpers and cleans up the compositor
+*/
+void CloseTileCompositor(TileCompositor* compositor) {
+  if (compositor) {
+    if (compositor->pool) CloseWorkerPool(compositor->pool);
+    free(compositor->sprites);
+    free(compositor->rects);
+    free(compositor->marked);
+    free(compositor->binStart);
+    free(compositor->binItems);
+    free(compositor->jobs);
+    free(compositor);
+  }
+}
+
+/**
+ * Starts a frame composed into the target, the dirty rects are filled with the background pixel first
+*/
+void BeginComposition(TileCompositor* compositor, PixelBuffer* target, uint32_t background) {
+  compositor->target = target;
+  compositor->background = background;
+  compositor->spriteCount = 0;
+  compositor->rectCount = 0;
+}
+
+/**
+ * Adds a sprite drawn above all sprites added before
+ *
+ * Returns 0 if the sprite could not be added
+*/
+int AddCompositorSprite(TileCompositor* compositor, const CompiledSprite* sprite, int x, int y) {
+  if (!growArray((void**)&compositor->sprites, &compositor->spriteCapacity, compositor->spriteCount + 1, sizeof(CompositorSprite))) {
+    return 0;
+  }
+  compositor->sprites[compositor->spriteCount++] = (CompositorSprite){ .sprite = sprite, .x = x, .y = y };
+  return 1;
+}
+
+/**
+ * Adds a dirty rect of the target that is recomposed
+ *
+ * Returns 0 if the rect could not be added
+*/
+int AddCompositorRect(TileCompositor* compositor, SpriteBounds rect) {
+  SpriteBounds surface = { .left = 0, .top = 0, .right = compositor->target->width, .bottom = compositor->target->height };
+  rect = intersectBounds(rect, surface);
+  // Rects outside of the target have nothing to compose
+  if (rect.right <= rect.left || rect.bottom <= rect.top) return 1;
+
+  if (!growArray((void**)&compositor->rects, &compositor->rectCapacity, compositor->rectCount + 1, sizeof(SpriteBounds))) {
+    return 0;
+  }
+  compositor->rects[compositor->rectCount++] = rect;
+  return 1;
+}
+
+/**
+ * Composes the clip rect: fills the background and draws the sprites of the bin overlapping it in draw order
+ *
+ * Without bin (items NULL) all sprites of the frame are tested
+*/
+static void composeRect(TileCompositor* compositor, SpriteBounds clip, const int* items, int itemCount) {
+  FillPixelBuffer(compositor->target, clip, compositor->background);
+  for (int k = 0; k < itemCount; k++) {
+    const CompositorSprite* sprite = &compositor->sprites[items ? items[k] : k];
+    if (!spriteOverlaps(sprite, clip)) continue;
+    BlitCompiledSprite(compositor->target, sprite->sprite, sprite->x, sprite->y, clip);
+  }
+}
+
+/**
+ * Renders all dirty rects inside one tile
+*/
+static void renderTile(TileCompositor* compositor, int tile) {
+  int column = tile % compositor->columns;
+  int row = tile / compositor->columns;
+  SpriteBounds tileRect = {
+    .left = column * COMPOSITOR_TILE_SIZE,
+    .top = row * COMPOSITOR_TILE_SIZE,
+    .right = (column + 1) * COMPOSITOR_TILE_SIZE,
+    .bottom = (row + 1) * COMPOSITOR_TILE_SIZE
+  };
+  const int* items = &compositor->binItems[compositor->binStart[tile]];
+  int itemCount = compositor->binStart[tile + 1] - compositor->binStart[tile];
+
+  // Overlapping dirty rects are composed one after another, so the result is the same as without tiles
+  for (int r = 0; r < compositor->rectCount; r++) {
+    SpriteBounds clip = intersectBounds(compositor->rects[r], tileRect);
+    if (clip.right <= clip.left || clip.bottom <= clip.top) continue;
+    composeRect(compositor, clip, items, itemCount);
+  }
+}
+
+/**
+ * Takes jobs from the shared counter until all tiles of the frame are taken
+*/
+static void renderJobs(TileCompositor* compositor) {
+  for (;;) {
+    long job = fetchAddAtomic(&compositor->nextJob, 1);
+    if (job >= compositor->jobCount) break;
+    renderTile(compositor, compositor->jobs[job]);
+  }
+}
+
+/**
+ * Worker job of a helper, renders tiles until none is left and then signals the calling thread
+*/
+static void renderHelper(void* context) {
+  TileCompositor* compositor = context;
+  renderJobs(compositor);
+  fetchAddAtomic(&compositor->pending, -1);
+}
+
+/**
+ * Composes all dirty rects one after another on the calling thread (fallback if the bins could not be allocated)
+*/
+static void composeSerial(TileCompositor* compositor) {
+  for (int r = 0; r < compositor->rectCount; r++) {
+    composeRect(compositor, compositor->rects[r], NULL, compositor->spriteCount);
+  }
+}
+
+/**
+ * Returns the tile range overlapped by the rect (rect must be clipped to the target)
+*/
+static void tileRange(SpriteBounds rect, int* left, int* top, int* right, int* bottom) {
+  *left = rect.left / COMPOSITOR_TILE_SIZE;
+  *top = rect.top / COMPOSITOR_TILE_SIZE;
+  *right = (rect.right - 1) / COMPOSITOR_TILE_SIZE;
+  *bottom = (rect.bottom - 1) / COMPOSITOR_TILE_SIZE;
+}
+
+/**
+ * Bins the sprites of the frame into the marked tiles they overlap, every bin keeps the draw order
+ *
+ * Returns 0 if the bins could not be allocated
+*/
+static int binSprites(TileCompositor* compositor) {
+  int tiles = compositor->columns * compositor->rows;
+  int* binStart = compositor->binStart;
+  SpriteBounds surface = { .left = 0, .top = 0, .right = compositor->target->width, .bottom = compositor->target->height };
+
+  // First pass counts the entries per tile, second pass places them (counting sort, no per tile allocation)
+  memset(binStart, 0, sizeof(int) * (tiles + 1));
+  // Entries the sprites can take at any position, only depends on the sprites, so moving sprites never grow the bins
+  int worstCase = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < compositor->spriteCount; i++) {
+      const CompositorSprite* sprite = &compositor->sprites[i];
+      if (pass == 0) {
+        worstCase += ((sprite->sprite->width - 1) / COMPOSITOR_TILE_SIZE + 2) * ((sprite->sprite->height - 1) / COMPOSITOR_TILE_SIZE + 2);
+      }
+      SpriteBounds box = { .left = sprite->x, .top = sprite->y, .right = sprite->x + sprite->sprite->width, .bottom = sprite->y + sprite->sprite->height };
+      box = intersectBounds(box, surface);
+      if (box.right <= box.left || box.bottom <= box.top) continue;
+
+      int left, top, right, bottom;
+      tileRange(box, &left, &top, &right, &bottom);
+      for (int row = top; row <= bottom; row++) {
+        for (int column = left; column <= right; column++) {
+          int tile = row * compositor->columns + column;
+          // Tiles without dirty rect are not rendered, so they don't need a bin
+          if (!compositor->marked[tile]) continue;
+          if (pass == 0) binStart[tile]++;
+          else compositor->binItems[binStart[tile]++] = i;
+        }
+      }
+    }
+
+    if (pass == 0) {
+      // Convert the counts into offsets
+      int offset = 0;
+      for (int t = 0; t < tiles; t++) {
+        int count = binStart[t];
+        binStart[t] = offset;
+        offset += count;
+      }
+      binStart[tiles] = offset;
+      if (!growArray((void**)&compositor->binItems, &compositor->binCapacity, worstCase > offset ? worstCase : offset, sizeof(int)) &&
+          !growArray((void**)&compositor->binItems, &compositor->binCapacity, offset, sizeof(int))) return 0;
+    }
+  }
+
+  // Placing advanced every offset to the start of the next bin, shift them back
+  for (int t = tiles; t > 0; t--) binStart[t] = binStart[t - 1];
+  binStart[0] = 0;
+  return 1;
+}
+
+/**
+ * Composes all dirty rects of the frame and returns once every tile is rendered
+ *
+ * Returns 0 if the bins could not be allocated, the frame is then composed serially without tiles
+*/
+int ComposeTiles(TileCompositor* compositor) {
+  if (!compositor->target || compositor->rectCount == 0) return 1;
+
+  compositor->columns = (compositor->target->width + COMPOSITOR_TILE_SIZE - 1) / COMPOSITOR_TILE_SIZE;
+  compositor->rows = (compositor->target->height + COMPOSITOR_TILE_SIZE - 1) / COMPOSITOR_TILE_SIZE;
+  int tiles = compositor->columns * compositor->rows;
+
+  // Grow the per tile arrays, the marks of new tiles start cleared
+  if (tiles + 1 > compositor->tileCapacity) {
+    int capacity = tiles + 1;
+    unsigned char* marked = realloc(compositor->marked, capacity);
+    if (marked) compositor->marked = marked;
+    int* binStart = realloc(compositor->binStart, sizeof(int) * capacity);
+    if (binStart) compositor->binStart = binStart;
+    int* jobs = realloc(compositor->jobs, sizeof(int) * capacity);
+    if (jobs) compositor->jobs = jobs;
+    if (!marked || !binStart || !jobs) {
+      composeSerial(compositor);
+      return 0;
+    }
+    memset(marked, 0, capacity);
+    compositor->tileCapacity = capacity;
+  }
+
+  // Collect the tiles touched by any dirty rect, each tile becomes one job
+  long long area = 0;
+  compositor->jobCount = 0;
+  for (int r = 0; r < compositor->rectCount; r++) {
+    SpriteBounds rect = compositor->rects[r];
+    area += (long long)(rect.right - rect.left) * (rect.bottom - rect.top);
+
+    int left, top, right, bottom;
+    tileRange(rect, &left, &top, &right, &bottom);
+    for (int row = top; row <= bottom; row++) {
+      for (int column = left; column <= right; column++) {
+        int tile = row * compositor->columns + column;
+        if (compositor->marked[tile]) continue;
+        compositor->marked[tile] = 1;
+        compositor->jobs[compositor->jobCount++] = tile;
+      }
+    }
+  }
+
+  int binned = binSprites(compositor);
+  if (binned) {
+    // Small frames are composed on the calling thread, waking the helpers would take longer than the frame
+    int helpers = 0;
+    if (compositor->pool && area >= COMPOSITOR_PARALLEL_PIXELS) {
+      helpers = compositor->jobCount - 1 < compositor->helperCount ? compositor->jobCount - 1 : compositor->helperCount;
+    }
+
+    compositor->nextJob = 0;
+    compositor->pending = helpers;
+    for (int h = 0; h < helpers; h++) {
+      // A full queue only means less help, the tiles are still rendered by the other threads
+      if (!SubmitWorkerJob(compositor->pool, renderHelper, compositor)) fetchAddAtomic(&compositor->pending, -1);
+    }
+    renderJobs(compositor);
+    // The helpers finish the tiles they already took, the frame is complete once all of them returned
+    while (loadAtomic(&compositor->pending) > 0) yieldThread();
+  } else {
+    composeSerial(compositor);
+  }
+
+  // Clear the marks for the next frame
+  for (int j = 0; j < compositor->jobCount; j++) compositor->marked[compositor->jobs[j]] = 0;
+  return binned;
+}
@@ -0,0 +1,112 @@
+#ifndef TILECOMPOSITOR_H
+#define TILECOMPOSITOR_H
+
+#include "spriteblit.h"
+#include "workerpool.h"
+
+// Edge length of the square tiles in pixels, small enough to balance the load and large enough to keep the bins short
+#define COMPOSITOR_TILE_SIZE 128
+// Dirty area in pixels below which a frame is composed on the calling thread only (waking helpers costs more)
+#define COMPOSITOR_PARALLEL_PIXELS (256 * 256)
+
+/**
+ * Sprite drawn by the compositor at a position of the target
+*/
+typedef struct {
+  // Compiled sprite, not managed by the compositor
+  const CompiledSprite* sprite;
+  // Position of the top left corner in the target
+  int x;
+  int y;
+} CompositorSprite;
+
+/**
+ * Software compositor splitting the target into tiles that are rendered in parallel
+ *
+ * Every frame the sprites are binned into the tiles they overlap (in draw order, so the result is identical
+ * to drawing them one after another). The tiles touched by a dirty rect are then taken from a shared atomic
+ * counter by the calling thread and the helpers of the pool, so fast threads simply take more tiles.
+ * A tile is only ever written by one thread, no locks are taken while rendering.
+ *
+ * One compositor is used by one thread at a time (e.g. shared by all windows of the ui thread).
+*/
+typedef struct {
+  // Helpers rendering tiles next to the calling thread (NULL if composing on the calling thread only)
+  WorkerPool* pool;
+  // Count of helper threads in the pool
+  int helperCount;
+
+  // Target and background of the current frame
+  PixelBuffer* target;
+  uint32_t background;
+  // Sprites of the current frame in draw order
+  CompositorSprite* sprites;
+  int spriteCount;
+  int spriteCapacity;
+  // Dirty rects of the current frame (clipped to the target)
+  SpriteBounds* rects;
+  int rectCount;
+  int rectCapacity;
+
+  // Tile grid of the current target
+  int columns;
+  int rows;
+  // Size of the per tile arrays
+  int tileCapacity;
+  // Set for tiles touched by a dirty rect (cleared again after every frame)
+  unsigned char* marked;
+  // First entry of every tile in binItems (tiles + 1 elements)
+  int* binStart;
+  // Sprite indices of all bins, every bin in draw order
+  int* binItems;
+  int binCapacity;
+  // Tiles touched by a dirty rect, each one is a job
+  int* jobs;
+  int jobCount;
+
+  // Index of the next job to take
+  volatile long nextJob;
+  // Count of helpers still running on the current frame
+  volatile long pending;
+} TileCompositor;
+
+/**
+ * Create a compositor with helperCount helper threads
+ *
+ * 0 composes on the calling thread only, < 0 uses one helper per further logical processor.
+ * If the allocation or the thread creation fails it returns NULL
+*/
+TileCompositor* CreateTileCompositor(int helperCount);
+
+/**
+ * Stops the helpers and cleans up the compositor
+*/
+void CloseTileCompositor(TileCompositor* compositor);
+
+/**
+ * Starts a frame composed into the target, the dirty rects are filled with the background pixel first
+*/
+void BeginComposition(TileCompositor* compositor, PixelBuffer* target, uint32_t background);
+
+/**
+ * Adds a sprite drawn above all sprites added before
+ *
+ * Returns 0 if the sprite could not be added
+*/
+int AddCompositorSprite(TileCompositor* compositor, const CompiledSprite* sprite, int x, int y);
+
+/**
+ * Adds a dirty rect of the target that is recomposed
+ *
+ * Returns 0 if the rect could not be added
+*/
+int AddCompositorRect(TileCompositor* compositor, SpriteBounds rect);
+
+/**
+ * Composes all dirty rects of the frame and returns once every tile is rendered
+ *
+ * Returns 0 if the bins could not be allocated, the frame is then composed serially without tiles
+*/
+int ComposeTiles(TileCompositor* compositor);
+
+#endif
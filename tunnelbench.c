@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "broadphase.h"
+#include "randomgenerator.h"
+
+/**
+ * Start and end position of one sprite of a case, in pixels
+*/
+typedef struct {
+  int prevX, prevY, xPos, yPos, size;
+} BenchMotion;
+
+/**
+ * Fills the store with the sprites of the case (moving from their previous to their current position)
+*/
+static void placeSprites(SpriteStore* sprites, const BenchMotion* motions, int count) {
+  TruncateSprites(sprites, 0);
+  for (int i = 0; i < count; i++) {
+    const BenchMotion* m = &motions[i];
+    int xMov = m->xPos > m->prevX ? SPRITE_FIXED_ONE : m->xPos < m->prevX ? -SPRITE_FIXED_ONE : 0;
+    int yMov = m->yPos > m->prevY ? SPRITE_FIXED_ONE : m->yPos < m->prevY ? -SPRITE_FIXED_ONE : 0;
+    int index = AddSprite(sprites, SPRITE_TO_FIXED(m->xPos), SPRITE_TO_FIXED(m->yPos), xMov, yMov, 0, 1.0, SPRITE_TO_FIXED(m->size), SPRITE_TO_FIXED(m->size));
+    sprites->prevX[index] = SPRITE_TO_FIXED(m->prevX);
+    sprites->prevY[index] = SPRITE_TO_FIXED(m->prevY);
+  }
+}
+
+/**
+ * Time range in which the 1d intervals strictly overlap while moving linearly from their previous to their end position
+ *
+ * Returns 0 if they never overlap during the step
+*/
+static int overlapRange(double aPrev, double aEnd, double aSize, double bPrev, double bEnd, double bSize, double* from, double* to) {
+  // Gap between the left side of b and the left side of a, the intervals overlap while -bSize < gap < aSize
+  double start = bPrev - aPrev, motion = (bEnd - bPrev) - (aEnd - aPrev);
+  if (motion == 0.0) {
+    *from = 0.0;
+    *to = 1.0;
+    return start > -bSize && start < aSize;
+  }
+  double first = (aSize - start) / motion, second = (-bSize - start) / motion;
+  *from = first < second ? first : second;
+  *to = first < second ? second : first;
+  if (*from < 0.0) *from = 0.0;
+  if (*to > 1.0) *to = 1.0;
+  return *from < *to;
+}
+
+/**
+ * Returns 1 if a and b, apart at the start of the step, overlap at any time of the motion to their resolved end position
+ *
+ * After a correct resolution a pair only moves apart or along each other, a pair that passed through each other
+ * (or was pushed out on the far side) overlaps on its way.
+*/
+static int passedThrough(const SpriteStore* sprites, int a, int b) {
+  double fromX, toX, fromY, toY;
+  if (!overlapRange(sprites->prevX[a], sprites->xPos[a], sprites->width[a], sprites->prevX[b], sprites->xPos[b], sprites->width[b], &fromX, &toX)) return 0;
+  if (!overlapRange(sprites->prevY[a], sprites->yPos[a], sprites->height[a], sprites->prevY[b], sprites->yPos[b], sprites->height[b], &fromY, &toY)) return 0;
+  return (fromX > fromY ? fromX : fromY) < (toX < toY ? toX : toY);
+}
+
+/**
+ * Returns 1 if the boxes of a and b overlap (strictly) at the given positions
+*/
+static int overlapAt(int ax, int ay, int aSize, int bx, int by, int bSize) {
+  return ax < bx + bSize && bx < ax + aSize && ay < by + bSize && by < ay + aSize;
+}
+
+/**
+ * Returns 1 if the sprite moves further then its own size on one axis
+*/
+static int movedBeyondSize(const BenchMotion* motion) {
+  return abs(motion->xPos - motion->prevX) > motion->size || abs(motion->yPos - motion->prevY) > motion->size;
+}
+
+/**
+ * Resolves the case with both broadphase kinds and checks the result, returns 0 if it failed
+ *
+ * No pair with a fast sprite apart at the start of the step may pass through each other, both kinds must resolve the same
+ * positions and movements and, if requested, the pair must have been resolved at its time of impact.
+*/
+static int checkCase(const char* name, SpriteStore* sweep, SpriteStore* grid, Broadphase* sweepPhase, Broadphase* gridPhase,
+  const BenchMotion* motions, int count, int expectSwept) {
+  placeSprites(sweep, motions, count);
+  placeSprites(grid, motions, count);
+  HandleCollisions(sweepPhase, sweep);
+  HandleCollisions(gridPhase, grid);
+
+  int ok = 1;
+  size_t size = sizeof(int) * count;
+  if (memcmp(sweep->xPos, grid->xPos, size) != 0 || memcmp(sweep->yPos, grid->yPos, size) != 0 ||
+      memcmp(sweep->xMov, grid->xMov, size) != 0 || memcmp(sweep->yMov, grid->yMov, size) != 0) {
+    fprintf(stderr, "%s: the sweep and the grid resolved different positions\n", name);
+    ok = 0;
+  }
+  if (expectSwept >= 0 && (sweepPhase->sweptCount > 0) != expectSwept) {
+    fprintf(stderr, "%s: %d pairs resolved at their time of impact, expected %s\n", name, sweepPhase->sweptCount, expectSwept ? "some" : "none");
+    ok = 0;
+  }
+  for (int a = 0; a < count; a++) {
+    for (int b = a + 1; b < count; b++) {
+      const BenchMotion* ma = &motions[a];
+      const BenchMotion* mb = &motions[b];
+      if (overlapAt(ma->prevX, ma->prevY, ma->size, mb->prevX, mb->prevY, mb->size)) continue;
+      // Slow pairs may clip a corner during the step, only sprites moving further then their size can tunnel
+      if (!movedBeyondSize(ma) && !movedBeyondSize(mb)) continue;
+      if (passedThrough(sweep, a, b)) {
+        fprintf(stderr, "%s: sprites %d and %d passed through each other, end (%d, %d) and (%d, %d)\n", name, a, b,
+          sweep->xPos[a] >> SPRITE_FIXED_SHIFT, sweep->yPos[a] >> SPRITE_FIXED_SHIFT, sweep->xPos[b] >> SPRITE_FIXED_SHIFT, sweep->yPos[b] >> SPRITE_FIXED_SHIFT);
+        ok = 0;
+      }
+    }
+  }
+  return ok;
+}
+
+/**
+ * Headless check of the continuous collision resolution of fast sprites
+ *
+ * Not part of the screensaver build, it only needs the platform neutral broadphase:
+ * cc -O2 -o tunnelbench tunnelbench.c broadphase.c spritestore.c randomgenerator.c -lm
+ * ./tunnelbench [rounds] [max distance]
+ *
+ * Runs fixed cases of sprites moving further then their size in one step (passing through, ending overlapped on
+ * the far side, head on, vertical and corner hits, next to slow pairs) and random pairs with random fast motions.
+ * No pair with a fast sprite that was apart at the start of the step may overlap anywhere on the way to its
+ * resolved end position, the sweep and the grid must resolve identically. Exits with 1 if a sprite tunnelled.
+*/
+int main(int argc, char** argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 100000;
+  int distance = argc > 2 ? atoi(argv[2]) : 400;
+  if (rounds < 0 || distance < 1) {
+    fprintf(stderr, "usage: %s [rounds] [max distance]\n", argv[0]);
+    return 1;
+  }
+
+  SpriteStore* sweep = CreateSpriteStore(8);
+  SpriteStore* grid = CreateSpriteStore(8);
+  Broadphase* sweepPhase = CreateBroadphase(BROADPHASE_SWEEP, 8);
+  Broadphase* gridPhase = CreateBroadphase(BROADPHASE_GRID, 8);
+  if (!sweep || !grid || !sweepPhase || !gridPhase) return 1;
+
+  int failed = 0;
+  {
+    // Passes completely through the other sprite, no overlap at the end
+    BenchMotion motions[] = { { 0, 100, 300, 100, 64 }, { 150, 100, 150, 100, 64 } };
+    failed |= !checkCase("passing", sweep, grid, sweepPhase, gridPhase, motions, 2, 1);
+  }
+  {
+    // Ends overlapping the other sprite on its far side, the overlap resolution alone would push it out there
+    BenchMotion motions[] = { { 0, 100, 190, 100, 64 }, { 150, 100, 150, 100, 64 } };
+    failed |= !checkCase("far side", sweep, grid, sweepPhase, gridPhase, motions, 2, 1);
+  }
+  {
+    // Both fast and head on, they end overlapped with swapped sides
+    BenchMotion motions[] = { { 0, 100, 170, 100, 64 }, { 200, 100, 30, 100, 64 } };
+    failed |= !checkCase("head on", sweep, grid, sweepPhase, gridPhase, motions, 2, 1);
+  }
+  {
+    BenchMotion motions[] = { { 100, 0, 100, 190, 32 }, { 100, 150, 100, 150, 64 } };
+    failed |= !checkCase("vertical", sweep, grid, sweepPhase, gridPhase, motions, 2, 1);
+  }
+  {
+    BenchMotion motions[] = { { 0, 0, 170, 170, 32 }, { 100, 100, 100, 100, 32 } };
+    failed |= !checkCase("corner", sweep, grid, sweepPhase, gridPhase, motions, 2, 1);
+  }
+  {
+    // Hits at the very end of the step, the reflected boxes would still touch
+    BenchMotion motions[] = { { 0, 100, 86, 100, 20 }, { 106, 100, 106, 100, 64 } };
+    failed |= !checkCase("late impact", sweep, grid, sweepPhase, gridPhase, motions, 2, 1);
+  }
+  {
+    // A slow pair overlapping at the end is left to the overlap resolution, the fast sprite passes the slow one
+    BenchMotion motions[] = { { 500, 500, 502, 500, 64 }, { 560, 500, 559, 500, 64 }, { 0, 300, 400, 300, 32 }, { 200, 300, 200, 300, 32 } };
+    failed |= !checkCase("mixed", sweep, grid, sweepPhase, gridPhase, motions, 4, 1);
+  }
+  {
+    BenchMotion motions[] = { { 500, 500, 502, 500, 64 }, { 560, 500, 559, 500, 64 } };
+    failed |= !checkCase("slow", sweep, grid, sweepPhase, gridPhase, motions, 2, 0);
+  }
+
+  // Random pairs apart at the start, one or both moving up to distance pixels
+  RandomGenerator random;
+  SeedRandomGenerator(&random, 15);
+  int resolved = 0;
+  for (int round = 0; round < rounds && !failed; round++) {
+    BenchMotion motions[2];
+    do {
+      for (int i = 0; i < 2; i++) {
+        BenchMotion* m = &motions[i];
+        m->size = 8 + RandomBelow(&random, 64);
+        m->prevX = RandomBelow(&random, 600);
+        m->prevY = RandomBelow(&random, 600);
+        int moving = i == 0 || RandomBelow(&random, 2);
+        m->xPos = m->prevX + (moving ? RandomBelow(&random, 2 * distance + 1) - distance : 0);
+        m->yPos = m->prevY + (moving ? RandomBelow(&random, 2 * distance + 1) - distance : 0);
+      }
+    } while (overlapAt(motions[0].prevX, motions[0].prevY, motions[0].size, motions[1].prevX, motions[1].prevY, motions[1].size));
+    char name[32];
+    snprintf(name, sizeof(name), "random round %d", round);
+    failed |= !checkCase(name, sweep, grid, sweepPhase, gridPhase, motions, 2, -1);
+    resolved += sweepPhase->sweptCount;
+  }
+
+  printf("%s, %d random rounds (%d resolved at their time of impact)\n", failed ? "FAILED" : "all cases passed", rounds, resolved);
+  CloseBroadphase(sweepPhase);
+  CloseBroadphase(gridPhase);
+  CloseSpriteStore(sweep);
+  CloseSpriteStore(grid);
+  return failed;
+}
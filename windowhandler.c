@@ -1,32 +1,61 @@
 #include "windowhandler.h"
 
+/**
+ * Releases a partially created window state and its window, returns NULL
+ *
+ * The window is still hidden and has no GWLP_USERDATA yet, so its WM_NCDESTROY doesn't close the state a second time
+*/
+static WindowState* abortWindowState(WindowState* windowState) {
+  CloseWindowState(windowState);
+  return NULL;
+}
+
 /**
  * Create window state
  * 
  * Set hWindow to NULL to create a window
  * 
+ * If a world is provided the window shows the shard worldShard of it instead of its own scene, imageCount is then
+ * the capacity of the world. The first window of a world spawns all its sprites.
+ * 
  * This function must be called in the thread where you expect the WM_EXIT/WM_DESTROY messages in the eventloop,
  * the reason for this is that windows "binds" the created window to the thread it was created in
+ * 
+ * On failure the window and everything created so far is released and NULL is returned
 */
 WindowState* CreateWindowState(
   HINSTANCE hInstance,
   HWND hWindow,
   int imageCount, 
-  int movementSpeed,
+  double movementSpeed,
   double interval,
   int bounceIncrement,
   double bounceDecrementScale,
+  double stepRate,
+  uint64_t seed,
+  BroadphaseKind broadphase,
+  double loadBudget,
+  SpriteCache* spriteCache,
+  BmpDirectory* imageDirectory,
+  SpriteAnimation* animation,
+  TileCompositor* compositor,
+  SimulationWorld* world,
+  int worldShard,
   wchar_t* windowClass, 
   LPRECT monitorRect, 
   LPPOINT initCursorPos, 
   int cursorPositionThreshold,
   double relativeImageWidth,
   BOOL disableImageScale,
+  ResampleFilter imageFilter,
+  BOOL imageAlpha,
   int imageId,
+  int imageIdCount,
   COLORREF backgroundColor, 
   COLORREF transparentColor) {
 
-  WindowState* windowState = malloc(sizeof(WindowState));
+  // Zeroed, so a failure at any point releases exactly the resources created so far
+  WindowState* windowState = calloc(1, sizeof(WindowState));
   if (!windowState) return NULL;
 
   windowState->hInstance = hInstance;
@@ -35,19 +64,24 @@ WindowState* CreateWindowState(
   InitializeSRWLock(&windowState->initCursorPositionLock);
   windowState->exitBool = FALSE;
 
-  windowState->backgroundBrush = CreateSolidBrush(backgroundColor);
+  windowState->backgroundPixel = COLORREF_TO_PIXEL(backgroundColor);
   windowState->transparentColor = transparentColor;
   windowState->interval = interval;
+  windowState->frame = 0;
+  windowState->lastAdvance = 0.0;
+  windowState->tick = 0;
+  windowState->paintCost = 0;
   windowState->cursorPositionThreshold = cursorPositionThreshold;
+  windowState->registry = NULL;
   
-  // Create window
+  // Create window, it stays hidden until the state is complete
   if (hWindow==NULL) {
     // If no window handle is provided, create a new window with the size of the monitorRect
     windowState->hwnd = CreateWindowEx(
       0,                                      // Extended window style
       windowClass,                            // Window class name
       L"",                                    // Window title
-      WS_POPUP | WS_VISIBLE,                  // Window style
+      WS_POPUP,                               // Window style
       monitorRect->left,                      // X position
       monitorRect->top,                       // Y position
       monitorRect->right - monitorRect->left, // Width
@@ -67,7 +101,7 @@ WindowState* CreateWindowState(
         0,                      // No extended styles
         windowClass,            // Your custom window class
         L"",                    // Window title
-        WS_CHILD | WS_VISIBLE,  // Window style
+        WS_CHILD,               // Window style
         0,                      // X position relative to parent
         0,                      // Y position relative to parent
         rect.right - rect.left, // Width
@@ -80,35 +114,111 @@ WindowState* CreateWindowState(
       windowState->hwnd = hwndChild;
     }
   }
-  if (!windowState->hwnd) return NULL;
+  if (!windowState->hwnd) return abortWindowState(windowState);
 
   // Acquire created window rect
   RECT windowRect;
-  if (!GetWindowRect(windowState->hwnd, &windowRect)) return NULL;
+  if (!GetWindowRect(windowState->hwnd, &windowRect)) return abortWindowState(windowState);
+
+  // The window shows all sprites of the world, sprite i of the world shows image i
+  windowState->world = world;
+  windowState->worldShard = world ? worldShard : -1;
+  if (world) imageCount = world->capacity;
 
   // Set absolute image width to the relativeImageWidth * window size
-  int absoluteImageWidth = relativeImageWidth * (windowRect.right - windowRect.left);
+  // Images of a world have the same size on every monitor (relative to the narrowest one), so they keep it while crossing over
+  int referenceWidth = windowRect.right - windowRect.left;
+  for (int s = 0; world && s < world->shardCount; s++) {
+    int shardWidth = world->shards[s].region.right - world->shards[s].region.left;
+    if (s == 0 || shardWidth < referenceWidth) referenceWidth = shardWidth;
+  }
+  int absoluteImageWidth = relativeImageWidth * referenceWidth;
 
   // Allocate image state array
   windowState->images = malloc(sizeof(ImageState*) * imageCount);
-  if (!windowState->images) return NULL;
-
-  // Create all image states and add them to the array
-  windowState->imageCount = imageCount;
-  for (int i = 0; i < windowState->imageCount; i++) {
+  if (!windowState->images) return abortWindowState(windowState);
+
+  // Windows are numbered in creation order, the number identifies the window in traces and recordings
+  static int windowCount = 0;
+  int windowId = windowCount++;
+
+  // Create the simulation holding the movement and collision state of all images
+  SimulationConfig simulationConfig = {
+    .movementSpeed = movementSpeed,
+    .bounceIncrement = bounceIncrement,
+    .bounceDecrementScale = bounceDecrementScale,
+    .stepRate = stepRate,
+    .seed = seed + windowId // Every window gets its own scene, but the same seed always reproduces all of them
+  };
+  // The simulation of a window showing a world stays empty, it only identifies the window in traces
+  windowState->simulation = CreateSimulation(world ? 0 : imageCount, broadphase, simulationConfig);
+  if (!windowState->simulation) return abortWindowState(windowState);
+  windowState->simulation->id = windowId;
+
+  // Create the governor keeping the window within its share of the frame time (a budget of 0 disables it)
+  // The sprites of a world belong to all its monitors, so the governor of its windows only gets the frame divider levels
+  // (a single sprite has neither collision nor sprite levels)
+  windowState->governor = CreateLoadGovernor(loadBudget / 100.0, interval, world ? 1 : imageCount);
+  if (!windowState->governor) return abortWindowState(windowState);
+
+  // Allocate the snapshots handing the sprite positions to the ui thread
+  windowState->snapshots = world ? world->shards[worldShard].snapshots : CreateSnapshotBuffer(imageCount);
+  if (!windowState->snapshots) return abortWindowState(windowState);
+  windowState->painted = CreateSpriteSnapshot(imageCount);
+  if (!windowState->painted) return abortWindowState(windowState);
+
+  // Create the dirty region collecting the changed rectangles between frames
+  windowState->dirty = CreateDirtyRegion(MAX_DIRTY_RECTS);
+  if (!windowState->dirty) return abortWindowState(windowState);
+
+  // Create the painter resources, the back buffer surface is allocated on the first paint
+  windowState->backBuffer = CreateRenderTarget(&GdiRenderTargetBackend);
+  if (!windowState->backBuffer) return abortWindowState(windowState);
+  windowState->compositor = compositor;
+  windowState->updateRegion = CreateRectRgn(0, 0, 0, 0);
+  if (!windowState->updateRegion) return abortWindowState(windowState);
+
+  // Sprites are spawned relative to the window origin, the same space the client rect uses
+  SpriteBounds spawnBounds = {
+    .left = 0,
+    .top = 0,
+    .right = windowRect.right - windowRect.left,
+    .bottom = windowRect.bottom - windowRect.top
+  };
+
+  // The world is spawned once by its first window, before any window loop of the world runs
+  BOOL spawnWorld = world && world->total == 0;
+
+  // Create all image states and add them to the array, the count only covers the images created so far
+  ImageSource imageSource = { .instance = windowState->hInstance, .directory = imageDirectory };
+  for (int i = 0; i < imageCount; i++) {
     windowState->images[i] = 
       CreateImageState(
-        windowState->hInstance,
-        windowRect,
-        movementSpeed,
-        bounceIncrement,
-        bounceDecrementScale, 
+        &imageSource,
+        spriteCache,
+        animation,
         absoluteImageWidth,
         disableImageScale,
-        imageId
+        imageFilter,
+        imageAlpha,
+        // The images cycle through the consecutive bitmap resources starting at imageId
+        imageId + i % imageIdCount,
+        transparentColor
       );
+    if (!windowState->images[i]) return abortWindowState(windowState);
+    windowState->imageCount++;
+
+    int width = windowState->images[i]->width;
+    int height = windowState->images[i]->height;
+    // Add the movement state of the image to the simulation (index is the same as the image index)
+    if (spawnWorld) SpawnWorldSprite(world, width, height);
+    else if (!world) SpawnSprite(windowState->simulation, spawnBounds, width, height);
   }
 
+  // Record the spawned scene and all following steps if a recording is requested through the environment
+  // Replays run a single window simulation, the windows of a world are not recorded
+  if (!world) StartSimulationRecordingFromEnvironment(windowState->simulation);
+
   SetWindowLongPtr(windowState->hwnd, GWLP_USERDATA, (LONG_PTR)windowState);
 
   // Start initialization of the window
@@ -144,7 +254,6 @@ void DestroyWindowStateWindow(WindowState* windowState) {
  */
 void CloseWindowState(WindowState* windowState) {
   if (windowState) {
-    DeleteObject(windowState->backgroundBrush);
     if (windowState->hwnd) {
       HWND hwnd = windowState->hwnd;
       windowState->hwnd = NULL;
@@ -154,371 +263,385 @@ void CloseWindowState(WindowState* windowState) {
       CloseImageState(windowState->images[i]);
     }
     free(windowState->images);
+    CloseSimulation(windowState->simulation);
+    CloseLoadGovernor(windowState->governor);
+    if (!windowState->world) CloseSnapshotBuffer(windowState->snapshots);
+    CloseSpriteSnapshot(windowState->painted);
+    CloseDirtyRegion(windowState->dirty);
+    CloseRenderTarget(windowState->backBuffer);
+    if (windowState->updateRegion) DeleteObject(windowState->updateRegion);
+    free(windowState->regionData);
     free(windowState);
   }
 }
 
 /**
- * Create an image state from loaded bitmap resource
+ * Allocates a 32 bit top-down DIB section selected into a memory device context as surface
+*/
+static int allocateGdiSurface(RenderTarget* target, int width, int height) {
+  GdiSurface* surface = malloc(sizeof(GdiSurface));
+  if (!surface) return 0;
+
+  BITMAPINFO bitmapInfo = {0};
+  bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bitmapInfo.bmiHeader.biWidth = width;
+  bitmapInfo.bmiHeader.biHeight = -height; // Negative height makes the DIB top-down
+  bitmapInfo.bmiHeader.biPlanes = 1;
+  bitmapInfo.bmiHeader.biBitCount = 32;
+  bitmapInfo.bmiHeader.biCompression = BI_RGB;
+  void* bits = NULL;
+
+  surface->hdc = CreateCompatibleDC(NULL);
+  surface->bitmap = CreateDIBSection(NULL, &bitmapInfo, DIB_RGB_COLORS, &bits, NULL, 0);
+  if (!surface->hdc || !surface->bitmap) {
+    if (surface->bitmap) DeleteObject(surface->bitmap);
+    if (surface->hdc) DeleteDC(surface->hdc);
+    free(surface);
+    return 0;
+  }
+  surface->oldBitmap = SelectObject(surface->hdc, surface->bitmap);
+
+  target->surface = surface;
+  target->buffer.pixels = bits;
+  target->buffer.width = width;
+  target->buffer.height = height;
+  target->buffer.stride = width;
+  return 1;
+}
+
+/**
+ * Releases the DIB section and the memory device context of the surface
+*/
+static void releaseGdiSurface(RenderTarget* target) {
+  GdiSurface* surface = target->surface;
+  if (surface) {
+    // Unselect the DIB section, otherwise it can't be deleted
+    SelectObject(surface->hdc, surface->oldBitmap);
+    DeleteObject(surface->bitmap);
+    DeleteDC(surface->hdc);
+    free(surface);
+  }
+}
+
+/**
+ * Render target backend allocating the surface as DIB section (the surface is a GdiSurface)
  * 
- * If bitmap is not found or the operation fails it returns NULL
+ * The surface can be blitted to a window directly through its hdc
 */
-ImageState* CreateImageState(
-  HINSTANCE instance,
-  RECT windowRect,
-  int movement, 
-  int bounceIncrement, 
-  double bounceDecrementScale,
-  int imageWidth,
-  BOOL disableImageScale,
-  int imageId) {
+const RenderTargetBackend GdiRenderTargetBackend = {
+  .allocate = allocateGdiSurface,
+  .release = releaseGdiSurface
+};
 
-  // Load bitmap handle
-  HBITMAP origBitmapHandle = LoadBitmap((HINSTANCE)instance, MAKEINTRESOURCE(imageId));
-  if (!origBitmapHandle) return NULL;
+/**
+ * Loads the bitmap resource as top-down 32 bit pixels (whatever format the resource has)
+ * 
+ * No gdi resources are kept afterwards. If the bitmap is not found or the operation fails it returns NULL
+*/
+static uint32_t* loadResourcePixels(HINSTANCE instance, int resource, int* width, int* height) {
+  // Load bitmap handle as DIB section, unlike LoadBitmap this keeps the alpha channel of 32 bit bitmaps
+  HBITMAP bitmapHandle = LoadImage(instance, MAKEINTRESOURCE(resource), IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION);
+  if (!bitmapHandle) return NULL;
   // Create temporary bitmap object
-  BITMAP origBitmap = (BITMAP){0};
-  // Load image data into the origBitmap object
-  GetObject(origBitmapHandle, sizeof(origBitmap), &origBitmap);
-  // Create device context for original bitmap image
-  HDC origBitmapHdc = CreateCompatibleDC(NULL);
-  // Select bitmap handle to the device context
-  HBITMAP oldBitmapHandle = SelectObject(origBitmapHdc, origBitmapHandle);
-
-  // Scale is based on the imageWidth provided, that way the WindowState 
-  // can calculate a size of the image based on the size of the window
-  int scaledWidth = imageWidth;
-  // The height is calculated by obtaining the scale factor of the width and then applying it to the original height
-  int scaledHeight = ((double)imageWidth / (double)origBitmap.bmWidth) * origBitmap.bmHeight;
+  BITMAP bitmap = (BITMAP){0};
+  // Load image data into the bitmap object
+  GetObject(bitmapHandle, sizeof(bitmap), &bitmap);
+
+  // Read the original pixels as top-down 32 bit DIB, whatever format the resource has
+  BITMAPINFO bitmapInfo = {0};
+  bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bitmapInfo.bmiHeader.biWidth = bitmap.bmWidth;
+  bitmapInfo.bmiHeader.biHeight = -bitmap.bmHeight; // Negative height makes the DIB top-down
+  bitmapInfo.bmiHeader.biPlanes = 1;
+  bitmapInfo.bmiHeader.biBitCount = 32;
+  bitmapInfo.bmiHeader.biCompression = BI_RGB;
+  uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)bitmap.bmWidth * bitmap.bmHeight);
+  HDC screenHdc = GetDC(NULL);
+  int read = pixels && screenHdc &&
+    GetDIBits(screenHdc, bitmapHandle, 0, bitmap.bmHeight, pixels, &bitmapInfo, DIB_RGB_COLORS) == bitmap.bmHeight;
+  if (screenHdc) ReleaseDC(NULL, screenHdc);
+  // Cleanup bitmap handle, only the pixel copy is used from here on
+  DeleteObject(bitmapHandle);
+  if (!read) {
+    free(pixels);
+    return NULL;
+  }
+  *width = bitmap.bmWidth;
+  *height = bitmap.bmHeight;
+  return pixels;
+}
 
-  // Create image state object
-  ImageState *imageState = malloc(sizeof(ImageState));
-  if (!imageState) return NULL;
+/**
+ * Resamples top-down 32 bit pixels to the key width and compiles them into the format of the key
+ * 
+ * If the operation fails it returns NULL
+*/
+static CompiledSprite* compileScaledSprite(const SpriteKey* key, const uint32_t* pixels, int width, int height) {
+  int alphaSprite = key->format == SPRITE_FORMAT_PREMULTIPLIED;
 
-  // Set image state attributes
-  imageState->xPos = 5 + (rand() % (windowRect.right - windowRect.left - scaledWidth - 10)); // Rand start position (+ 5 pixel border)
-  imageState->yPos = 5 + (rand() % (windowRect.bottom - windowRect.top - scaledHeight - 10)); // Rand start position (+ 5 pixel border)
-  imageState->xMov = movement * (rand() % 2 ? -1 : 1); // Random move start direction
-  imageState->yMov = movement * (rand() % 2 ? -1 : 1); // Random move start direction
-  imageState->inc = 0;
-  imageState->decSteps = 1;
-  imageState->baseInc = bounceIncrement;
-  imageState->baseDecScale = bounceDecrementScale;
-  InitializeSRWLock(&imageState->lock);
-
-  // If image scale is disabled, use the original handle, hdc and bitmap
-  if (disableImageScale) {
-    imageState->bitmapHdc = origBitmapHdc;
-    imageState->bitmapHandle = origBitmapHandle;
-    imageState->bitmap = origBitmap;
-    imageState->oldBitmapHandle = oldBitmapHandle;
+  // A width of 0 keeps the original size, colour-keyed pixels are then compiled directly
+  if (key->width == 0 && !alphaSprite) {
+    return CompileSprite(pixels, width, height, width, key->transparentColor);
+  }
 
-    return imageState;
+  // Scale is based on the width of the key, that way the WindowState 
+  // can calculate a size of the image based on the size of the window
+  int scaledWidth = key->width;
+  // The height is calculated by obtaining the scale factor of the width and then applying it to the original height
+  int scaledHeight = ((double)key->width / (double)width) * height;
+  if (scaledHeight < 1) scaledHeight = 1;
+  ResampleFilter filter = key->filter;
+  if (key->width == 0) {
+    // Native size, the nearest filter is then an exact copy that only converts the pixel format
+    scaledWidth = width;
+    scaledHeight = height;
+    filter = RESAMPLE_NEAREST;
   }
 
-  // Create scaled bitmap handle
-  imageState->bitmapHandle = CreateCompatibleBitmap(GetDC(NULL), scaledWidth, scaledHeight);
-  // Create scaled device context
-  imageState->bitmapHdc = CreateCompatibleDC(NULL);
-  // Select scaled bitmap handle to the device context
-  imageState->oldBitmapHandle = SelectObject(imageState->bitmapHdc, imageState->bitmapHandle);
-
-  // Halftone scaling can be used to create a slight blur when scaling (looks more round)
-  // however when the image background is not the same color as the window background, this does not look good
-  // SetStretchBltMode(imageState->bitmapHdc, HALFTONE);
-  // SetBrushOrgEx(imageState->bitmapHdc, 0, 0, NULL);  // Necessary for HALFTONE
-
-  // Draw and scale the original image to the device context
-  StretchBlt(
-    imageState->bitmapHdc, 0, 0, scaledWidth, scaledHeight,
-    origBitmapHdc, 0, 0, origBitmap.bmWidth, origBitmap.bmHeight, SRCCOPY
-  );
-
-  // Create bitmap object
-  imageState->bitmap = (BITMAP){0};
-  // Load scaled image data into the bitmap object
-  GetObject(imageState->bitmapHandle, sizeof(imageState->bitmap), &imageState->bitmap);
-
-  // Unselect original bitmap handle
-  SelectObject(origBitmapHdc, oldBitmapHandle);
-  // Cleanup original bitmap handle
-  DeleteObject(origBitmapHandle);
-  // Cleanup original bitmap hdc
-  DeleteDC(origBitmapHdc);
+  // Bitmaps without alpha channel leave the fourth byte 0, those use the colour key as coverage
+  int hasAlpha = 0;
+  for (int i = 0; alphaSprite && !hasAlpha && i < width * height; i++) hasAlpha = (pixels[i] >> 24) != 0;
+
+  // Resample in software instead of StretchBlt, the resampler treats keyed pixels as uncovered,
+  // so filtered edges keep the image color instead of bleeding the transparent color into the image
+  CompiledSprite* sprite = NULL;
+  ResampleSource* source = hasAlpha
+    ? CreateResampleSourceAlpha(pixels, width, height, width)
+    : CreateResampleSource(pixels, width, height, width, key->transparentColor);
+  uint32_t* scaledPixels = malloc(sizeof(uint32_t) * (size_t)scaledWidth * scaledHeight);
+  if (source && scaledPixels && alphaSprite) {
+    // The edge coverage becomes alpha, translucent edge pixels are blended when painting
+    if (ResampleSpritePremultiplied(source, scaledPixels, scaledWidth, scaledHeight, scaledWidth, filter)) {
+      sprite = CompileAlphaSprite(scaledPixels, scaledWidth, scaledHeight, scaledWidth);
+    }
+  } else if (source && scaledPixels) {
+    if (ResampleSprite(source, scaledPixels, scaledWidth, scaledHeight, scaledWidth, filter)) {
+      // Compile the scaled pixels into opaque spans, the transparent color is tested here once instead of on every paint
+      sprite = CompileSprite(scaledPixels, scaledWidth, scaledHeight, scaledWidth, key->transparentColor);
+    }
+  }
 
-  return imageState;
+  free(scaledPixels);
+  CloseResampleSource(source);
+  return sprite;
 }
 
 /**
- * Cleans up an image state and its associated resources
+ * Loads the bmp file, resamples it to the key width and compiles it
  * 
- * This function must be called from the thread the imageState was created on!
- */
-void CloseImageState(ImageState *imageState) {
-  if (imageState) {
-    // Unselect bitmap handle
-    SelectObject(imageState->bitmapHdc, imageState->oldBitmapHandle);
-    // Cleanup bitmap handle
-    DeleteObject(imageState->bitmapHandle);
-    // Cleanup bitmap hdc
-    DeleteDC(imageState->bitmapHdc);
-    free(imageState);
+ * The file is memory-mapped, colour-keyed images of native size are compiled straight from the mapped rows.
+ * If the file is not a valid bmp or the operation fails it returns NULL
+*/
+static CompiledSprite* loadFileSprite(const SpriteKey* key, const char* path) {
+  BmpImage* image = OpenBmpImage(path, NULL);
+  if (!image) return NULL;
+  const BmpView* view = &image->view;
+
+  CompiledSprite* sprite = NULL;
+  if (key->width == 0 && key->format == SPRITE_FORMAT_COLORKEY) {
+    // Nothing to scale or convert, the spans are compiled from the rows in the mapping without any copy
+    sprite = CompileSpriteRows(view->rows, view->bitsPerPixel / 8, view->width, view->height, view->stride, key->transparentColor);
+  } else {
+    uint32_t* pixels = malloc(sizeof(uint32_t) * (size_t)view->width * view->height);
+    if (pixels) {
+      ReadBmpPixels(view, pixels, view->width);
+      sprite = compileScaledSprite(key, pixels, view->width, view->height);
+    }
+    free(pixels);
   }
+  CloseBmpImage(image);
+  return sprite;
 }
 
 /**
- * Insertion sort based on the x position of the image state
+ * Loads the image of the key (bitmap resource or bmp file), resamples it to the key width and compiles it
+ * 
+ * Used as loader of the sprite cache, the context is the ImageSource.
+ * No gdi resources or file mappings are kept afterwards. If the image is not found or the operation fails it returns NULL
 */
-void insertionSort(ImageState* imageStates[], int imageStatesLength) {
-  int i, j;
-  ImageState* key;
-  for (i = 0; i < imageStatesLength; i++) {
-    key = imageStates[i];
-    j = i - 1;
-
-    // Reverse iterate and move elements up as long as they are larger then the key
-    while (j >= 0 && imageStates[j]->xPos > key->xPos) {
-      // Move current element (imageStates[j]) one element up
-      imageStates[j + 1] = imageStates[j];
-      j--;
-    }
-    // Set the last element which was moved up to the key
-    imageStates[j + 1] = key;
+static CompiledSprite* loadScaledSprite(const SpriteKey* key, void* context) {
+  const ImageSource* source = (const ImageSource*)context;
+  if (source->directory) {
+    if (key->resource < 0 || key->resource >= source->directory->count) return NULL;
+    return loadFileSprite(key, source->directory->paths[key->resource]);
   }
+
+  int width, height;
+  uint32_t* pixels = loadResourcePixels(source->instance, key->resource, &width, &height);
+  if (!pixels) return NULL;
+  CompiledSprite* sprite = compileScaledSprite(key, pixels, width, height);
+  free(pixels);
+  return sprite;
 }
 
 /**
- * Algorithm to resolve the collision of two objects
+ * Create an image state from loaded bitmap resource (or the bmp file of the image directory)
+ * 
+ * The scaled sprite is taken from the cache, so identical images (same resource, width and color key)
+ * are only loaded and scaled once and share their pixels
+ * 
+ * If an animation is provided it is played instead of the bitmap, images of the same width share its decoded frames
+ * 
+ * If bitmap is not found or the operation fails it returns NULL
 */
-void resolveCollision(ImageState* objectA, ImageState* objectB) {
-
-  // Retrieve minimum translation vector for x by taking the min right side - max left side
-  int overlapX = min(
-    objectA->xPos + objectA->bitmap.bmWidth, // Right side A
-    objectB->xPos + objectB->bitmap.bmWidth // Right side B
-  ) - max(
-    objectA->xPos, // Left side A
-    objectB->xPos // Left side B
-  );
-
-  // Retrieve minimum translation vector for y by taking the min bottom side - max top side
-  int overlapY = min(
-    objectA->yPos + objectA->bitmap.bmHeight, // Bottom side A
-    objectB->yPos + objectB->bitmap.bmHeight // Bottom side B
-  ) - max(
-    objectA->yPos, // Top side A
-    objectB->yPos // Top side B
-  );
-
-  // Check for the smaller overlap
-  // This is very important, because we want to resolve the collision always at the minimum overlap,
-  // otherwise a 1px collision on y could cause a 10px movment on the x axis
-  if (overlapX < overlapY) {
-    // Decollide by moving the objects both by the overlapped side
-    // We check what object is at the right side to ensure that the objects don't apply the overlap to the wrong side
-    if (objectA->xPos > objectB->xPos) {
-      // ObjectA is on the right side, so we move it to the right and B to the left
-      objectA->xPos += (overlapX / 2) + 1;
-      objectB->xPos -= (overlapX / 2) + 1;
-    } else {
-      // ObjectB is on the right side, so we move it to the right and A to the left
-      objectA->xPos -= (overlapX / 2) + 1;
-      objectB->xPos += (overlapX / 2) + 1;
-    }
-    // Change movement direction
-    objectA->xMov = - objectA->xMov;
-    objectB->xMov = - objectB->xMov;
-  } else {
-    // Decollide by moving the objects both by the overlapped side
-    // We check what object is at the bottom side to ensure that the objects don't apply the overlap to the wrong side
-    if (objectA->yPos > objectB->yPos) {
-      // ObjectA is on the bottom side, so we move it to the bottom and B to the top
-      objectA->yPos += (overlapY / 2) + 1;
-      objectB->yPos -= (overlapY / 2) + 1;
-    } else {
-      // ObjectB is on the bottom side, so we move it to the bottom and A to the top
-      objectA->yPos -= (overlapY / 2) + 1;
-      objectB->yPos += (overlapY / 2) + 1;
+ImageState* CreateImageState(
+  const ImageSource* source,
+  SpriteCache* cache,
+  SpriteAnimation* animation,
+  int imageWidth,
+  BOOL disableImageScale,
+  ResampleFilter imageFilter,
+  BOOL imageAlpha,
+  int imageId,
+  COLORREF transparentColor) {
+
+  ImageState* imageState = calloc(1, sizeof(ImageState));
+  if (!imageState) return NULL;
+
+  if (animation) {
+    // Animations are always alpha blended, their frames carry an alpha channel
+    imageState->animation = AcquireAnimationTrack(animation, disableImageScale ? 0 : imageWidth, imageFilter);
+    if (!imageState->animation) {
+      free(imageState);
+      return NULL;
     }
-    // Change movement direction
-    objectA->yMov = - objectA->yMov;
-    objectB->yMov = - objectB->yMov;
+    imageState->width = imageState->animation->width;
+    imageState->height = imageState->animation->height;
+    return imageState;
   }
-  // Add movment boost
-  objectA->inc = objectA->baseInc;
-  objectB->inc = objectB->baseInc;
+
+  SpriteKey key = {
+    .resource = imageId,
+    .width = disableImageScale ? 0 : imageWidth, // Native size is requested with a width of 0
+    .format = imageAlpha ? SPRITE_FORMAT_PREMULTIPLIED : SPRITE_FORMAT_COLORKEY,
+    .filter = imageFilter,
+    .transparentColor = COLORREF_TO_PIXEL(transparentColor)
+  };
+  imageState->cache = cache;
+  imageState->sprite = AcquireCachedSprite(cache, key, loadScaledSprite, (void*)source);
+  if (!imageState->sprite) {
+    free(imageState);
+    return NULL;
+  }
+  imageState->width = imageState->sprite->width;
+  imageState->height = imageState->sprite->height;
+  return imageState;
 }
 
 /**
- * Checks for collisions on the images and updates their movement appropriately
- * 
- * Sweep & prune like algorithm is used to check for collisions
- * the main axis is sorted with insertion sort because it is very efficient for "almost-sorted" lists
+ * Cleans up an image state and its associated resources
  * 
- * Algorithm is not very efficient but omits O(n^2) average speed by using the sorted list to "split" the collision detection into sections
-*/
-void HandleCollisions(ImageState* imageStates[], int imageStatesLength) {
-  // Sort all images by x axis
-  insertionSort(imageStates, imageStatesLength);
-  // Now iterate over all the images once
-  // Because the list is sorted we only need to iterate over every image once,
-  // checking all images after i. We know that images before i already checked the collision with i
-  for (int i = 0; i < imageStatesLength; i++) {
-    // Create some abstraction aliases
-    int localLeft = imageStates[i]->xPos;
-    int localRight = imageStates[i]->xPos + imageStates[i]->bitmap.bmWidth;
-    int localTop = imageStates[i]->yPos;
-    int localBottom = imageStates[i]->yPos+imageStates[i]->bitmap.bmHeight;
-
-    // Iterate over all images and check for collision with the local image
-    for (int j = i + 1; j < imageStatesLength; j++) {
-      // Create some abstraction aliases
-      int remoteLeft = imageStates[j]->xPos;
-      int remoteRight = imageStates[j]->xPos + imageStates[j]->bitmap.bmWidth;
-      int remoteTop = imageStates[j]->yPos;
-      int remoteBottom = imageStates[j]->yPos+imageStates[j]->bitmap.bmHeight;
-
-      // If the remote image left side is not colliding with the local right side
-      // the iteration can be aborted because no more remote images will collide (we know that because the list is sorted by x axis)
-      if (localRight < remoteLeft) break;
-
-      // Check if y axis collides, we already know that x collides because the loop didn't break
-      if (localBottom >= remoteTop && localTop <= remoteBottom) {
-        // If a collision is detected on both axes we resolve the collision
-        resolveCollision(imageStates[i], imageStates[j]);
-      }
-    }
+ * This function must be called from the thread the imageState was created on!
+ */
+void CloseImageState(ImageState *imageState) {
+  if (imageState) {
+    if (imageState->animation) ReleaseAnimationTrack(imageState->animation);
+    else ReleaseCachedSprite(imageState->cache, imageState->sprite);
+    free(imageState);
   }
 }
 
 /**
- * Updates the position of the provided image state
+ * Advances the simulation of the window by the elapsed time in ms
  * 
- * When colliding with the handler window it will bounce of with a logarithmic-decreasing boost
+ * When colliding with the handler window the sprites will bounce of with a logarithmic-decreasing boost
  * 
- * This function is synchronizing updates to mutable components of the image state with a unique lock
+ * The client rect is acquired once per call, the simulation itself doesn't depend on any window system.
+ * Returns the interpolation factor of the render positions (see AdvanceSimulation())
 */
-void UpdateImagePosition(HWND hwnd, ImageState *imageState) {
+int UpdateImagePositions(HWND hwnd, Simulation* simulation, double elapsed) {
   // If handle is not valid anymore, skip it
-  if (!hwnd) return;
+  if (!hwnd) return 0;
   
   // Get client rect
   RECT windowRect;
   GetClientRect(hwnd, &windowRect);
 
-  // Acquire unique lock
-  AcquireSRWLockExclusive(&imageState->lock);
-
-  if (imageState->inc>0) {
-    // Decrement incrementor with a logarithmic decrementation
-    // Logarithm the difference between log(a) and log(a+1) gets smaller when a is getting larger
-    // therefore its quite good to create a smooth animation, because if a (aka decStep) is small
-    // it won't decrement much from inc
-    imageState->inc *= imageState->baseDecScale * (log(imageState->decSteps + 1) / log(imageState->decSteps + 2));
-    // Decrement decrement steps
-    imageState->decSteps++;
-    // Check boundaries
-    imageState->inc = imageState->inc<=0 ? 0 : imageState->inc;
+  SpriteBounds bounds = {
+    .left = windowRect.left,
+    .top = windowRect.top,
+    .right = windowRect.right,
+    .bottom = windowRect.bottom
+  };
+  return AdvanceSimulation(simulation, bounds, elapsed);
+}
+
+/**
+ * Executes one iteration of the window processor loop (executed on a worker of the frame pacer)
+ * 
+ * Returns FALSE once exitBool is set, which stops the loop
+*/
+static int stepWindowLoop(void* context) {
+  WindowState* windowState = (WindowState*)context;
+
+  // Run loop until exitBool is set
+  if (InterlockedCompareExchange(&windowState->exitBool, FALSE, FALSE)) {
+    return FALSE;
   }
 
-  // Convert the incrementors operator in the operator of the current move state
-  int xInc = (imageState->xMov >= 0) ? imageState->inc : -imageState->inc;
-  int yInc = (imageState->yMov >= 0) ? imageState->inc : -imageState->inc;
-
-  // Move image
-  imageState->xPos += imageState->xMov + xInc;
-  imageState->yPos += imageState->yMov + yInc;
-
-  // Check if position in bound, if not movement is inverted
-  if (imageState->xPos + imageState->bitmap.bmWidth > windowRect.right || imageState->xPos < windowRect.left) {
-    imageState->inc = imageState->baseInc;
-    imageState->decSteps = 1;
-    imageState->xMov = - imageState->xMov;
-
-    // Check if image is out of boundaries and if yes correct it to the border of the window
-    if (imageState->xPos + imageState->bitmap.bmWidth > windowRect.right)
-      imageState->xPos = windowRect.right - imageState->bitmap.bmWidth;
-    else if (imageState->xPos < windowRect.left)
-      imageState->xPos = windowRect.left;
+  // Ticks skipped by the load governor neither advance nor present, the next frame catches up the elapsed time
+  if (++windowState->tick % windowState->governor->frameDivider != 0) return TRUE;
+
+  double now = FrameSchedulerNow();
+  double postStart;
+  if (windowState->world) {
+    // The first window of the world due advances it and publishes the frames of all its monitors,
+    // a window due while another one advances paints the frames already published
+    SyncSimulationWorld(windowState->world, now);
+    postStart = FrameSchedulerNow();
+    ++windowState->frame;
+  } else {
+    // Run the fixed simulation steps that fell due since the last iteration
+    double elapsed = windowState->lastAdvance > 0.0 ? now - windowState->lastAdvance : 0.0;
+    windowState->lastAdvance = now;
+    int alpha = UpdateImagePositions(windowState->hwnd, windowState->simulation, elapsed);
+
+    // Publish the interpolated positions of the whole frame to the ui thread
+    // The triple buffer never blocks, so the painter and the window loop don't wait on each other
+    postStart = FrameSchedulerNow();
+    PublishSnapshot(windowState->snapshots, windowState->simulation->sprites, alpha, ++windowState->frame);
   }
-  // Check if position in bound, if not movement is inverted
-  if (imageState->yPos + imageState->bitmap.bmHeight > windowRect.bottom || imageState->yPos < windowRect.top) {
-    imageState->inc = imageState->baseInc;
-    imageState->decSteps = 1;
-    imageState->yMov = - imageState->yMov;
-
-    // Check if image is out of boundaries and if yes correct it to the border of the window
-    if (imageState->yPos + imageState->bitmap.bmHeight > windowRect.bottom)
-      imageState->yPos = windowRect.bottom - imageState->bitmap.bmHeight;
-    else if (imageState->yPos < windowRect.top)
-      imageState->yPos = windowRect.top;
+
+  // PostMessage is calling the Windows UI system message queue and is thread-safe
+  PostMessage(windowState->hwnd, WM_INVALIDATE_RECT, 0, 0);
+  double postEnd = FrameSchedulerNow();
+  RecordTrace(TRACE_POST_INVALIDATE, windowState->simulation->id, windowState->frame, postStart, postEnd);
+
+  // Feed the cost of the frame (this iteration plus the paints since the last one) into the load governor
+  double cost = postEnd - now + InterlockedExchange64(&windowState->paintCost, 0) / 1000.0;
+  // The simulation of a world window is empty, for it the governor only lowers the frame rate
+  if (GovernFrame(windowState->governor, cost) && !windowState->world) {
+    // Skipped collision passes lower the cost of the steps, the skipped frames catch up all their steps
+    SetCollisionDivider(windowState->simulation, windowState->governor->collisionDivider);
+    // The parked images disappear with the next published frame, their last rects are invalidated with it
+    SetActiveSprites(windowState->simulation, windowState->governor->activeSprites);
   }
+  return TRUE;
+}
 
-  // Release unique lock
-  ReleaseSRWLockExclusive(&imageState->lock);
+/**
+ * Finishes the window processor loop (executed on the pacer thread once the last iteration completed)
+*/
+static void finishWindowLoop(void* context) {
+  WindowState* windowState = (WindowState*)context;
+  // Send an exit message to the eventloop
+  PostMessage(windowState->hwnd, WM_EXIT, 0, 0);
 }
 
 /**
  * Start window processor loop
  * 
- * This function can be run in a seperate thread, the provided window state is synchronized with its lock member.
- * The provided void ptr must be a valid window state.
+ * The loop is registered as task on the shared frame pacer, which executes one iteration every interval
+ * on one of its workers. Iterations of one window never overlap.
+ * Returns FALSE if the task could not be registered.
  * 
  * Messages are sent to the eventloop "listening" on the thread the WindowState was created!
 */
-DWORD WINAPI StartWindowLoop(LPVOID lpParam) {
-  WindowState* windowState = (WindowState*)lpParam;
-
-  // Initialize parameters used for the high precision timer
-  LARGE_INTEGER start, freq, now;
-  // Acquire frequency (ticks per second) 
-  QueryPerformanceFrequency(&freq);
-  // Acquire ticks since system start
-  QueryPerformanceCounter(&start);
-
-  double elapsed = 0.0;
- 
-  while (TRUE) {
-    // Run loop until exitBool is set
-    if (InterlockedCompareExchange(&windowState->exitBool, FALSE, FALSE)) {
-      break;
-    }
-
-    // Acquire ticks since system start
-    QueryPerformanceCounter(&now);
-
-    // Rerender and calculate the position of all images on the window
-    for (int i = 0; i < windowState->imageCount; i++) {
-      UpdateImagePosition(windowState->hwnd, windowState->images[i]);
-    }
-
-    // Handle image collisions
-    HandleCollisions(windowState->images, windowState->imageCount);
-
-    // PostMessage is calling the Windows UI system message queue and is thread-safe
-    PostMessage(windowState->hwnd, WM_INVALIDATE_RECT, 0, 0);
-    
-    // Calculate tick difference between now and the start buffer and convert it to seconds by dividing by frequency
-    elapsed = ((double)(now.QuadPart - start.QuadPart) / freq.QuadPart) * 1000;
-
-    // The windows Sleep() syscall is extremly unprecise and can cause weird behavior, like rounding down / ignoring 
-    // low intervals (like <20ms). Therefore we use a busy-spinner here, which essentially spins an empty loop
-    // until the time elapsed. In order to not fully starve the cpu, we use a Sleep(0) yielding control to the kernel, which can 
-    // then send this thread sleeping for 1 tick if there are other busy or more important threads.
-    while(elapsed < windowState->interval) {
-      // Yield control to kernel for 0-1 ticks
-      Sleep(0);
-      // Take elapsed snapshot for comparison
-      QueryPerformanceCounter(&now);
-      elapsed = ((double)(now.QuadPart - start.QuadPart) / freq.QuadPart) * 1000;
-    }
-
-    // Reset start counter
-    QueryPerformanceCounter(&start);
-  }
-  // Send an exit message to the eventloop
-  PostMessage(windowState->hwnd, WM_EXIT, 0, 0);
-  return 0;
+BOOL StartWindowLoop(FramePacer* pacer, WindowState* windowState) {
+  // The windows Sleep() syscall is extremly unprecise (rounds to the ~15.6ms system tick), therefore a single pacer
+  // thread sleeps on a high resolution waitable timer until shortly before the earliest deadline of all windows
+  // and only spins for the short remaining tail. Each window keeps its own interval (e.g. the monitor refresh rate).
+  return AddPacedTask(pacer, windowState->interval, stepWindowLoop, finishWindowLoop, windowState);
 }
 
 /**
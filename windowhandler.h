@@ -3,54 +3,80 @@
 
 #include <windows.h>
 
+#include "simulation.h"
+#include "simulationrecord.h"
+#include "simulationworld.h"
+#include "framepacer.h"
+#include "spriteblit.h"
+#include "spritecache.h"
+#include "dirtyregion.h"
+#include "rendertarget.h"
+#include "framesnapshot.h"
+#include "frametrace.h"
+#include "windowregistry.h"
+#include "loadgovernor.h"
+#include "tilecompositor.h"
+#include "spriteanimation.h"
+#include "bmpimage.h"
+
 #define WM_INITSTATE (WM_USER + 1)
 #define WM_INVALIDATE_RECT (WM_USER + 2)
 #define WM_EXIT (WM_USER + 3)
 
+// Maximum count of dirty rectangles invalidated per frame, more rectangles collapse into their bounding box
+#define MAX_DIRTY_RECTS 32
+
+// Converts a COLORREF (0x00BBGGRR) into a 32 bit DIB pixel (0x00RRGGBB)
+#define COLORREF_TO_PIXEL(color) (((uint32_t)GetRValue(color) << 16) | ((uint32_t)GetGValue(color) << 8) | (uint32_t)GetBValue(color))
+
 /**
  * Represents a single images (bitmap) state
+ *
+ * The movement state of the image lives in the sprite store of the windows simulation at the same index as the image
 */
 typedef struct {
-  // Mutex lock to synchronize access to the image state
-  SRWLOCK lock;
-  // Position of the image
-  int xPos;
-  int yPos;
-  // Current speed of the image
-  int xMov;
-  int yMov;
-  // Current speed addition of the image
-  int inc;
-  // Base speed addition of the image
-  int baseInc;
-  // Current speed addition decrementor step
-  int decSteps;
-  // Base scaler to slow down decrementor
-  double baseDecScale;
-  // Bitmap metadata
-  BITMAP bitmap;
-  // Bitmap handle
-  HBITMAP bitmapHandle;
-  // Old bitmap handle, this is used to unselect the bitmapHandle from the hdc on cleanup
-  HBITMAP oldBitmapHandle;
-  // Bitmap device context
-  HDC bitmapHdc;
+  // Bitmap precompiled into opaque and translucent spans, transparent pixels are already removed (shared through the cache)
+  // NULL if the image is animated
+  CompiledSprite* sprite;
+  // Cache the sprite was acquired from, not managed by the struct
+  SpriteCache* cache;
+  // Track of the animation played instead of the bitmap (shared by all images of the same size), NULL for static images
+  AnimationTrack* animation;
+  // Size of the image in pixels
+  int width;
+  int height;
 } ImageState;
 
 /**
- * Create an image state from loaded bitmap resource
+ * Source the images are loaded from
+*/
+typedef struct {
+  // Instance holding the bitmap resources
+  HINSTANCE instance;
+  // Bmp files loaded instead of the bitmap resources (the image id is the index of the file), NULL loads the resources
+  BmpDirectory* directory;
+} ImageSource;
+
+/**
+ * Create an image state from loaded bitmap resource (or the bmp file of the image directory)
+ * 
+ * The scaled sprite is taken from the cache, so identical images (same resource, width and color key)
+ * are only loaded and scaled once and share their pixels
+ * 
+ * If an animation is provided it is played instead of the bitmap, images of the same width share its decoded frames
  * 
  * If bitmap is not found or the operation fails it returns NULL
 */
 ImageState* CreateImageState(
-  HINSTANCE instance,
-  RECT windowRect,
-  int movement, 
-  int bounceIncrement, 
-  double bounceDecrementScale,
+  const ImageSource* source,
+  SpriteCache* cache,
+  SpriteAnimation* animation,
   int imageWidth,
   BOOL disableImageScale,
-  int imageId);
+  ResampleFilter imageFilter,
+  BOOL imageAlpha,
+  int imageId,
+  COLORREF transparentColor);
 
 /**
  * Cleans up an image state and its associated resources
@@ -59,6 +85,25 @@ ImageState* CreateImageState(
  */
 void CloseImageState(ImageState *state);
 
+/**
+ * Surface of the gdi render target backend, a 32 bit DIB section selected into a memory device context
+*/
+typedef struct {
+  // Memory device context the DIB section is selected into
+  HDC hdc;
+  // DIB section holding the pixels
+  HBITMAP bitmap;
+  // Old bitmap handle, this is used to unselect the bitmap from the hdc on cleanup
+  HBITMAP oldBitmap;
+} GdiSurface;
+
+/**
+ * Render target backend allocating the surface as DIB section (the surface is a GdiSurface)
+ * 
+ * The surface can be blitted to a window directly through its hdc
+*/
+extern const RenderTargetBackend GdiRenderTargetBackend;
+
 /**
  * Represents one window state
 */
@@ -68,11 +113,44 @@ typedef struct {
 
   // Interval the process loop iterates (in ms)
   double interval;
+  // Number of the last frame published by the process loop
+  long long frame;
+  // Time of the last process loop iteration in ms (0 before the first one), the simulation advances by the difference
+  double lastAdvance;
+  // Count of pacer ticks of the process loop, ticks skipped by the governor included
+  long long tick;
+  // Governor lowering the frame rate and the live images while the window exceeds its load budget (only used by the window loop)
+  LoadGovernor* governor;
+  // Paint cost in us since the last presented frame, added by the ui thread and taken by the window loop
+  volatile LONG64 paintCost;
 
   // Array of images on the window
   ImageState** images;
   // Count of images on the window
   int imageCount;
+  // Movement and collision state of all images, sprite i belongs to images[i] (only accessed by the window loop)
+  Simulation* simulation;
+  // Triple buffer publishing the sprite positions of every frame from the window loop to the ui thread
+  // For a window of a world it is the buffer of its shard, owned by the world
+  SnapshotBuffer* snapshots;
+  // World spanning the monitors the window shows a shard of (NULL if the window simulates its own scene), not managed by the struct
+  SimulationWorld* world;
+  // Shard of the world shown by the window (-1 without world)
+  int worldShard;
+  // Copy of the last invalidated frame, its rects are invalidated again with the next frame (only used on the ui thread)
+  SpriteSnapshot* painted;
+  // Rectangles invalidated for the next paint (only used on the ui thread)
+  DirtyRegion* dirty;
+  // Persistent back buffer the window is composed in, only reallocated when the window size changes
+  RenderTarget* backBuffer;
+  // Compositor rendering the back buffer in parallel tiles, shared by all windows of the ui thread and not managed by the struct
+  TileCompositor* compositor;
+  // Reusable region receiving the update region of the painter (only used on the ui thread)
+  HRGN updateRegion;
+  // Reusable buffer for the update region rectangles of the painter (only used on the ui thread)
+  RGNDATA* regionData;
+  // Size of regionData in bytes
+  DWORD regionDataSize;
 
   // Reference pointer to initial cursor position, not managed by the struct
   LPPOINT initCursorPosition;
@@ -80,13 +158,15 @@ typedef struct {
   SRWLOCK initCursorPositionLock;
   // Threshold for the cursor position relative to initCursorPosition until a WM_DESTROY message is sent
   int cursorPositionThreshold;
+  // Registry tracking all windows of the eventloop (NULL until the window is registered), not managed by the struct
+  WindowRegistry* registry;
 
   // Window class to use for the window
   wchar_t* windowClass;
   // Color that is transparented on images
   COLORREF transparentColor;
-  // Color brush for background of the window
-  HBRUSH backgroundBrush;
+  // Background color of the window as DIB pixel
+  uint32_t backgroundPixel;
   // Window handle of the associated window
   // This handle is set to NULL upon destruction of the window to handle the destruction gracefully (not leading to undefined behavior)
   HWND hwnd;
@@ -99,6 +179,9 @@ typedef struct {
  * 
  * Set hWindow to NULL to create a window
  * 
+ * If a world is provided the window shows the shard worldShard of it instead of its own scene, imageCount is then
+ * the capacity of the world. The first window of a world spawns all its sprites.
+ * 
  * This function must be called in the thread where you expect the WM_EXIT/WM_DESTROY messages in the eventloop,
  * the reason for this is that windows "binds" the created window to the thread it was created in
 */
@@ -106,17 +189,30 @@ WindowState* CreateWindowState(
   HINSTANCE hInstance,
   HWND hWindow,
   int imageCount, 
-  int movementSpeed,
+  double movementSpeed,
   double interval,
   int bounceIncrement,
   double bounceDecrementScale,
+  double stepRate,
+  uint64_t seed,
+  BroadphaseKind broadphase,
+  double loadBudget,
+  SpriteCache* spriteCache,
+  BmpDirectory* imageDirectory,
+  SpriteAnimation* animation,
+  TileCompositor* compositor,
+  SimulationWorld* world,
+  int worldShard,
   wchar_t* windowClass, 
   LPRECT monitorRect, 
   LPPOINT initCursorPos, 
   int cursorPositionThreshold,
   double relativeImageWidth,
   BOOL disableImageScale,
+  ResampleFilter imageFilter,
+  BOOL imageAlpha,
   int imageId,
+  int imageIdCount,
   COLORREF backgroundColor, 
   COLORREF transparentColor);
 
@@ -142,10 +238,11 @@ void CloseWindowState(WindowState* windowState);
 /**
  * Start window processor loop
  * 
- * This function can be run in a seperate thread, the provided window state is synchronized with its lock member.
- * The provided void ptr must be a valid window state.
+ * The loop is registered as task on the shared frame pacer, which executes one iteration every interval
+ * on one of its workers. Iterations of one window never overlap.
+ * Returns FALSE if the task could not be registered.
 */
-DWORD WINAPI StartWindowLoop(LPVOID lpParam);
+BOOL StartWindowLoop(FramePacer* pacer, WindowState* windowState);
 
 /**
  * Triggers a exit of the window process loop which will close the loop and send a WM_EXIT message to the eventloop
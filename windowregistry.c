@@ -0,0 +1,183 @@
+#include "windowregistry.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Create an empty registry reading its displays from the source (source may be NULL)
+ *
+ * If the allocation fails it returns NULL
+*/
+WindowRegistry* CreateWindowRegistry(const DisplaySource* source) {
+  WindowRegistry* registry = calloc(1, sizeof(WindowRegistry));
+  if (!registry) return NULL;
+  if (source) registry->source = *source;
+  return registry;
+}
+
+/**
+ * Cleans up the registry, the registered windows are not touched
+*/
+void CloseWindowRegistry(WindowRegistry* registry) {
+  if (registry) {
+    free(registry->windows);
+    free(registry->displays);
+    free(registry);
+  }
+}
+
+/**
+ * Registers the window of the display with the key and rect
+ *
+ * Returns 0 if the registry could not grow
+*/
+int RegisterWindow(WindowRegistry* registry, void* window, uint64_t key, SpriteBounds rect) {
+  if (registry->count == registry->capacity) {
+    // Grow by doubling, a handful of monitors is the common case
+    int capacity = registry->capacity ? registry->capacity * 2 : REGISTRY_INITIAL_DISPLAYS;
+    RegisteredWindow* windows = realloc(registry->windows, sizeof(RegisteredWindow) * capacity);
+    if (!windows) return 0;
+    registry->windows = windows;
+    registry->capacity = capacity;
+  }
+  registry->windows[registry->count++] = (RegisteredWindow){ .window = window, .key = key, .rect = rect, .closing = 0 };
+  return 1;
+}
+
+/**
+ * Removes the window from the registry, the order of the other windows is kept
+ *
+ * Returns the count of windows still registered or -1 if the window was not registered
+ * (e.g. a window destroyed because its loop could not be started)
+*/
+int UnregisterWindow(WindowRegistry* registry, void* window) {
+  for (int i = 0; i < registry->count; i++) {
+    if (registry->windows[i].window != window) continue;
+    // Close the gap, the count is small so shifting is cheaper than any bookkeeping
+    memmove(&registry->windows[i], &registry->windows[i + 1], sizeof(RegisteredWindow) * (registry->count - i - 1));
+    registry->count--;
+    return registry->count;
+  }
+  return -1;
+}
+
+/**
+ * Returns the window of the display with the key that is not closing or NULL if there is none
+*/
+void* FindRegisteredWindow(const WindowRegistry* registry, uint64_t key) {
+  for (int i = 0; i < registry->count; i++) {
+    if (!registry->windows[i].closing && registry->windows[i].key == key) return registry->windows[i].window;
+  }
+  return NULL;
+}
+
+/**
+ * Marks all registered windows as closing and calls the remove procedure of the source on each one
+ * that wasn't closing yet
+ *
+ * The registry is shut down, later refreshes don't create, move or close any window.
+*/
+void CloseRegisteredWindows(WindowRegistry* registry) {
+  // A display change while the windows are closing (e.g. a monitor waking up) must not bring the screensaver back
+  registry->shuttingDown = 1;
+  // Iterate backwards, so a remove procedure unregistering its window synchronously doesn't skip any window
+  for (int i = registry->count - 1; i >= 0; i--) {
+    if (registry->windows[i].closing) continue;
+    registry->windows[i].closing = 1;
+    if (registry->source.remove) registry->source.remove(registry->windows[i].window, registry->source.context);
+  }
+}
+
+/**
+ * Returns 1 if both rects are equal
+*/
+static int equalRects(SpriteBounds a, SpriteBounds b) {
+  return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+/**
+ * Reads all displays of the source into the displays buffer, growing the buffer until all displays fit
+ *
+ * Returns the count of displays or -1 on failure
+*/
+static int enumerateDisplays(WindowRegistry* registry) {
+  DisplaySource* source = &registry->source;
+  for (;;) {
+    int count = source->enumerate(registry->displays, registry->displayCapacity, source->context);
+    if (count < 0 || count <= registry->displayCapacity) return count;
+
+    // More displays than the buffer holds, grow it to the reported count and enumerate again
+    DisplayInfo* displays = realloc(registry->displays, sizeof(DisplayInfo) * count);
+    if (!displays) return -1;
+    registry->displays = displays;
+    registry->displayCapacity = count;
+  }
+}
+
+/**
+ * Synchronizes the windows with the displays currently reported by the source
+ *
+ * Windows of removed displays are closed, windows of moved displays are moved and new displays get a new window.
+ * Calling it again without a display change does nothing, so it can be triggered by every window receiving
+ * the display change. If the source reports no display at all or the registry is shutting down the windows are kept.
+ * Returns the count of added, moved and removed windows or -1 if the displays could not be enumerated.
+*/
+int RefreshWindowRegistry(WindowRegistry* registry) {
+  DisplaySource* source = &registry->source;
+  if (!source->enumerate || registry->shuttingDown) return 0;
+
+  int displayCount = enumerateDisplays(registry);
+  if (displayCount < 0) return -1;
+  // No display at all is reported while the display driver resets or all displays sleep,
+  // the windows are kept instead of closing the whole event loop
+  if (displayCount == 0) return 0;
+  DisplayInfo* displays = registry->displays;
+  int changes = 0;
+
+  // Close the windows of removed displays and move the windows of displays whose rect changed
+  // Iterate backwards, so a remove procedure unregistering its window synchronously doesn't skip any window
+  for (int i = registry->count - 1; i >= 0; i--) {
+    RegisteredWindow* entry = &registry->windows[i];
+    if (entry->closing) continue;
+
+    int d = 0;
+    while (d < displayCount && displays[d].key != entry->key) d++;
+
+    if (d == displayCount) {
+      entry->closing = 1;
+      if (source->remove) source->remove(entry->window, source->context);
+      changes++;
+    } else if (!equalRects(entry->rect, displays[d].rect)) {
+      entry->rect = displays[d].rect;
+      if (source->move) source->move(entry->window, &displays[d], source->context);
+      changes++;
+    }
+  }
+
+  // Create the windows of new displays, closing windows of a display that was reconnected are not reused
+  for (int d = 0; d < displayCount; d++) {
+    if (FindRegisteredWindow(registry, displays[d].key) || !source->add) continue;
+
+    void* window = source->add(&displays[d], source->context);
+    if (!window) continue;
+    if (!RegisterWindow(registry, window, displays[d].key, displays[d].rect)) {
+      // Untracked windows would never be closed, so the window is closed right away
+      if (source->remove) source->remove(window, source->context);
+      continue;
+    }
+    changes++;
+  }
+  return changes;
+}
+
+/**
+ * Derives a display key from the device name of the display (FNV-1a)
+*/
+uint64_t DisplayKey(const wchar_t* deviceName) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (; *deviceName; deviceName++) {
+    hash ^= (uint64_t)*deviceName;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
@@ -0,0 +1,136 @@
+#ifndef WINDOWREGISTRY_H
+#define WINDOWREGISTRY_H
+
+#include <stdint.h>
+#include <wchar.h>
+
+#include "spritestore.h"
+
+// Initial count of displays read from the display source, the buffer grows if more displays are connected
+#define REGISTRY_INITIAL_DISPLAYS 8
+
+/**
+ * One display reported by a display source
+*/
+typedef struct {
+  // Stable key of the display (e.g. the hash of the device name), a window belongs to the display with its key
+  uint64_t key;
+  // Rect of the display on the virtual desktop
+  SpriteBounds rect;
+  // Refresh interval of the display in ms
+  double interval;
+} DisplayInfo;
+
+/**
+ * Source of the connected displays and the procedures creating, moving and closing their windows
+ *
+ * On windows the displays are enumerated with EnumDisplayMonitors, the registry itself doesn't depend on
+ * any window system, so it can be driven by a fake source as well.
+*/
+typedef struct {
+  // Writes up to capacity displays into displays and returns the count of connected displays (< 0 on failure)
+  int (*enumerate)(DisplayInfo* displays, int capacity, void* context);
+  // Creates the window of a new display, returns NULL on failure
+  void* (*add)(const DisplayInfo* display, void* context);
+  // Moves the window of a display whose rect changed, the window keeps its simulation and sprites
+  void (*move)(void* window, const DisplayInfo* display, void* context);
+  // Starts closing the window of a removed display, it stays registered until UnregisterWindow() is called
+  void (*remove)(void* window, void* context);
+  // Argument passed to all procedures
+  void* context;
+} DisplaySource;
+
+/**
+ * Window tracked by the registry
+*/
+typedef struct {
+  // Window of the display (WindowState on windows), not managed by the registry
+  void* window;
+  // Key of the display the window belongs to
+  uint64_t key;
+  // Rect of the display the window was created or last moved on
+  SpriteBounds rect;
+  // Set once the window is closing, closing windows are not matched with displays anymore
+  int closing;
+} RegisteredWindow;
+
+/**
+ * Registry of all windows of the event loop
+ *
+ * Windows can be added and removed one by one at any time, so a display change only creates the windows
+ * of new displays and closes the windows of removed displays, all other windows keep running untouched.
+ * The registry is not synchronized, it is only used on the thread running the event loop.
+*/
+typedef struct {
+  // Registered windows, in registration order
+  RegisteredWindow* windows;
+  // Count of registered windows (including closing ones)
+  int count;
+  // Size of the windows array
+  int capacity;
+  // Buffer receiving the displays of the source
+  DisplayInfo* displays;
+  // Size of the displays buffer
+  int displayCapacity;
+  // Source of the displays, windows are only registered manually if it has no enumerate procedure
+  DisplaySource source;
+  // Set once all windows are closing (the screensaver exits), display changes don't create windows anymore
+  int shuttingDown;
+} WindowRegistry;
+
+/**
+ * Create an empty registry reading its displays from the source (source may be NULL)
+ *
+ * If the allocation fails it returns NULL
+*/
+WindowRegistry* CreateWindowRegistry(const DisplaySource* source);
+
+/**
+ * Cleans up the registry, the registered windows are not touched
+*/
+void CloseWindowRegistry(WindowRegistry* registry);
+
+/**
+ * Registers the window of the display with the key and rect
+ *
+ * Returns 0 if the registry could not grow
+*/
+int RegisterWindow(WindowRegistry* registry, void* window, uint64_t key, SpriteBounds rect);
+
+/**
+ * Removes the window from the registry, the order of the other windows is kept
+ *
+ * Returns the count of windows still registered or -1 if the window was not registered
+ * (e.g. a window destroyed because its loop could not be started)
+*/
+int UnregisterWindow(WindowRegistry* registry, void* window);
+
+/**
+ * Returns the window of the display with the key that is not closing or NULL if there is none
+*/
+void* FindRegisteredWindow(const WindowRegistry* registry, uint64_t key);
+
+/**
+ * Marks all registered windows as closing and calls the remove procedure of the source on each one
+ * that wasn't closing yet
+ *
+ * The registry is shut down, later refreshes don't create, move or close any window.
+*/
+void CloseRegisteredWindows(WindowRegistry* registry);
+
+/**
+ * Synchronizes the windows with the displays currently reported by the source
+ *
+ * Windows of removed displays are closed, windows of moved displays are moved and new displays get a new window.
+ * Calling it again without a display change does nothing, so it can be triggered by every window receiving
+ * the display change. If the source reports no display at all or the registry is shutting down the windows are kept.
+ * Returns the count of added, moved and removed windows or -1 if the displays could not be enumerated.
+*/
+int RefreshWindowRegistry(WindowRegistry* registry);
+
+/**
+ * Derives a display key from the device name of the display (FNV-1a)
+*/
+uint64_t DisplayKey(const wchar_t* deviceName);
+
+#endif
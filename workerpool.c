@@ -0,0 +1,206 @@
+#include "workerpool.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Platform synchronisation state of the pool
+*/
+typedef struct {
+#ifdef _WIN32
+  SRWLOCK lock;
+  CONDITION_VARIABLE available;
+  HANDLE threads[MAX_WORKERS];
+#else
+  pthread_mutex_t lock;
+  pthread_cond_t available;
+  pthread_t threads[MAX_WORKERS];
+#endif
+} WorkerPlatform;
+
+/**
+ * Returns the count of logical processors of the system (at least 1)
+*/
+int GetProcessorCount() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int count = (int)info.dwNumberOfProcessors;
+#else
+  int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return count > 0 ? count : 1;
+}
+
+/**
+ * Acquires the lock of the pool
+*/
+static void lockPool(WorkerPlatform* platform) {
+#ifdef _WIN32
+  AcquireSRWLockExclusive(&platform->lock);
+#else
+  pthread_mutex_lock(&platform->lock);
+#endif
+}
+
+/**
+ * Releases the lock of the pool
+*/
+static void unlockPool(WorkerPlatform* platform) {
+#ifdef _WIN32
+  ReleaseSRWLockExclusive(&platform->lock);
+#else
+  pthread_mutex_unlock(&platform->lock);
+#endif
+}
+
+/**
+ * Blocks on the condition variable until a job is queued (lock must be held)
+*/
+static void waitAvailable(WorkerPlatform* platform) {
+#ifdef _WIN32
+  SleepConditionVariableSRW(&platform->available, &platform->lock, INFINITE, 0);
+#else
+  pthread_cond_wait(&platform->available, &platform->lock);
+#endif
+}
+
+/**
+ * Wakes one (or all) workers waiting on the condition variable
+*/
+static void signalAvailable(WorkerPlatform* platform, int all) {
+#ifdef _WIN32
+  if (all) WakeAllConditionVariable(&platform->available);
+  else WakeConditionVariable(&platform->available);
+#else
+  if (all) pthread_cond_broadcast(&platform->available);
+  else pthread_cond_signal(&platform->available);
+#endif
+}
+
+/**
+ * Worker thread loop, takes jobs from the queue until the pool exits
+*/
+#ifdef _WIN32
+static DWORD WINAPI runWorker(LPVOID param) {
+#else
+static void* runWorker(void* param) {
+#endif
+  WorkerPool* pool = param;
+  WorkerPlatform* platform = pool->platform;
+
+  while (1) {
+    lockPool(platform);
+    while (pool->count == 0 && !pool->exit) waitAvailable(platform);
+    if (pool->count == 0) {
+      // Exit is only taken once the queue is drained
+      unlockPool(platform);
+      break;
+    }
+    WorkerTask task = pool->queue[pool->head];
+    pool->head = (pool->head + 1) % WORKER_QUEUE_SIZE;
+    pool->count--;
+    unlockPool(platform);
+
+    task.job(task.context);
+  }
+  return 0;
+}
+
+/**
+ * Create a pool with the provided count of worker threads (<= 0 uses one worker per logical processor)
+ *
+ * If the allocation or the thread creation fails it returns NULL
+*/
+WorkerPool* CreateWorkerPool(int threadCount) {
+  if (threadCount <= 0) threadCount = GetProcessorCount();
+  if (threadCount > MAX_WORKERS) threadCount = MAX_WORKERS;
+
+  WorkerPool* pool = calloc(1, sizeof(WorkerPool));
+  if (!pool) return NULL;
+  WorkerPlatform* platform = calloc(1, sizeof(WorkerPlatform));
+  if (!platform) {
+    free(pool);
+    return NULL;
+  }
+  pool->platform = platform;
+
+#ifdef _WIN32
+  InitializeSRWLock(&platform->lock);
+  InitializeConditionVariable(&platform->available);
+#else
+  pthread_mutex_init(&platform->lock, NULL);
+  pthread_cond_init(&platform->available, NULL);
+#endif
+
+  for (int i = 0; i < threadCount; i++) {
+#ifdef _WIN32
+    platform->threads[i] = CreateThread(NULL, 0, runWorker, pool, 0, NULL);
+    int created = platform->threads[i] != NULL;
+#else
+    int created = pthread_create(&platform->threads[i], NULL, runWorker, pool) == 0;
+#endif
+    if (!created) break;
+    pool->threadCount++;
+  }
+  if (pool->threadCount < threadCount) {
+    CloseWorkerPool(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+/**
+ * Finishes all queued jobs, stops the workers and cleans up the pool
+*/
+void CloseWorkerPool(WorkerPool* pool) {
+  if (pool) {
+    WorkerPlatform* platform = pool->platform;
+    lockPool(platform);
+    pool->exit = 1;
+    signalAvailable(platform, 1);
+    unlockPool(platform);
+
+    for (int i = 0; i < pool->threadCount; i++) {
+#ifdef _WIN32
+      WaitForSingleObject(platform->threads[i], INFINITE);
+      CloseHandle(platform->threads[i]);
+#else
+      pthread_join(platform->threads[i], NULL);
+#endif
+    }
+#ifndef _WIN32
+    pthread_cond_destroy(&platform->available);
+    pthread_mutex_destroy(&platform->lock);
+#endif
+    free(platform);
+    free(pool);
+  }
+}
+
+/**
+ * Queues a job for execution on the next free worker
+ *
+ * Returns 0 if the queue is full (the job is not executed then)
+*/
+int SubmitWorkerJob(WorkerPool* pool, WorkerJob job, void* context) {
+  WorkerPlatform* platform = pool->platform;
+  lockPool(platform);
+  if (pool->count == WORKER_QUEUE_SIZE || pool->exit) {
+    unlockPool(platform);
+    return 0;
+  }
+  WorkerTask* task = &pool->queue[(pool->head + pool->count) % WORKER_QUEUE_SIZE];
+  task->job = job;
+  task->context = context;
+  pool->count++;
+  signalAvailable(platform, 0);
+  unlockPool(platform);
+  return 1;
+}
@@ -0,0 +1,68 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+// Maximum count of worker threads in a pool
+#define MAX_WORKERS 64
+// Count of jobs that can be queued at once
+#define WORKER_QUEUE_SIZE 256
+
+/**
+ * Job executed on a worker thread
+*/
+typedef void (*WorkerJob)(void* context);
+
+/**
+ * Queued job with its context
+*/
+typedef struct {
+  // Function to execute
+  WorkerJob job;
+  // Argument passed to the function
+  void* context;
+} WorkerTask;
+
+/**
+ * Fixed pool of worker threads executing queued jobs
+ *
+ * Idle workers block on a condition variable, so the pool only uses cpu time for actual jobs.
+*/
+typedef struct {
+  // Ring buffer of queued jobs
+  WorkerTask queue[WORKER_QUEUE_SIZE];
+  // Index of the oldest queued job
+  int head;
+  // Count of queued jobs
+  int count;
+  // Count of worker threads
+  int threadCount;
+  // Set when the pool is closing, workers exit once the queue is empty
+  int exit;
+  // Platform lock, condition variable and thread handles
+  void* platform;
+} WorkerPool;
+
+/**
+ * Returns the count of logical processors of the system (at least 1)
+*/
+int GetProcessorCount();
+
+/**
+ * Create a pool with the provided count of worker threads (<= 0 uses one worker per logical processor)
+ *
+ * If the allocation or the thread creation fails it returns NULL
+*/
+WorkerPool* CreateWorkerPool(int threadCount);
+
+/**
+ * Finishes all queued jobs, stops the workers and cleans up the pool
+*/
+void CloseWorkerPool(WorkerPool* pool);
+
+/**
+ * Queues a job for execution on the next free worker
+ *
+ * Returns 0 if the queue is full (the job is not executed then)
+*/
+int SubmitWorkerJob(WorkerPool* pool, WorkerJob job, void* context);
+
+#endif
@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulationworld.h"
+#include "framescheduler.h"
+#include "workerpool.h"
+
+// Maximum count of monitors of a synthetic layout
+#define BENCH_MAX_MONITORS 9
+
+/**
+ * Synthetic monitor layout on the virtual desktop
+*/
+typedef struct {
+  // Name printed with the results
+  const char* name;
+  // Monitor rects in pixels
+  SpriteBounds monitors[BENCH_MAX_MONITORS];
+  int count;
+} BenchLayout;
+
+/**
+ * State of one world sprite collected by id after a step
+*/
+typedef struct {
+  // Position and speed in fixed point units
+  int xPos;
+  int yPos;
+  int xMov;
+  int yMov;
+  // Shard owning the sprite (-1 if the sprite was not found)
+  int shard;
+} BenchSprite;
+
+/**
+ * Display change applied to a layout while it runs
+*/
+typedef struct {
+  // Name printed with the results
+  const char* name;
+  // Index of the layout the world is created on
+  int layout;
+  // Monitor removed after a third of the steps (-1 removes none)
+  int removed;
+  // Monitor moved to rect after two thirds of the steps (-1 moves none)
+  int moved;
+  SpriteBounds rect;
+} BenchChange;
+
+/**
+ * Result of running a layout
+*/
+typedef struct {
+  // Average duration of a step in ms
+  double stepTime;
+  // Sprites handed between shards and halo copies per step
+  double handoffs;
+  double haloCopies;
+  // Overlapping pairs left after a step per step, of sprites owned by different shards and by the same shard
+  double crossOverlaps;
+  double shardOverlaps;
+} BenchResult;
+
+/**
+ * Collects the state of every sprite by id and checks the invariants of the world, returns 0 if one is violated
+ *
+ * Every spawned sprite is owned by exactly one shard, no halo copy survived the step and the center
+ * of every sprite lies in the region of its owner (or in a gap next to it, never in another region)
+*/
+static int collectWorld(const SimulationWorld* world, BenchSprite* sprites) {
+  for (int id = 0; id < world->total; id++) sprites[id].shard = -1;
+
+  for (int s = 0; s < world->shardCount; s++) {
+    const WorldShard* shard = &world->shards[s];
+    const SpriteStore* store = shard->simulation->sprites;
+    if (store->count != store->total || store->count != shard->owned) {
+      fprintf(stderr, "shard %d keeps %d sprites, %d active and %d owned\n", s, store->total, store->count, shard->owned);
+      return 0;
+    }
+    for (int i = 0; i < store->count; i++) {
+      int id = shard->ids[i];
+      if (id < 0 || id >= world->total) {
+        fprintf(stderr, "shard %d holds the unknown id %d\n", s, id);
+        return 0;
+      }
+      if (sprites[id].shard >= 0) {
+        fprintf(stderr, "sprite %d is owned by shard %d and %d\n", id, sprites[id].shard, s);
+        return 0;
+      }
+      int centerX = store->xPos[i] + store->width[i] / 2;
+      int centerY = store->yPos[i] + store->height[i] / 2;
+      for (int t = 0; t < world->shardCount && !shard->detached; t++) {
+        SpriteBounds region = world->shards[t].fixedRegion;
+        if (t != s && !world->shards[t].detached && centerX >= region.left && centerX < region.right && centerY >= region.top && centerY < region.bottom) {
+          fprintf(stderr, "sprite %d is owned by shard %d but its center lies in shard %d\n", id, s, t);
+          return 0;
+        }
+      }
+      sprites[id] = (BenchSprite){ .xPos = store->xPos[i], .yPos = store->yPos[i], .xMov = store->xMov[i], .yMov = store->yMov[i], .shard = s };
+    }
+  }
+
+  for (int id = 0; id < world->total; id++) {
+    if (sprites[id].shard < 0) {
+      fprintf(stderr, "sprite %d was lost\n", id);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Publishes the world and checks that every sprite shows up on all monitors its box overlaps, returns 0 if one is missing
+*/
+static int checkPublished(SimulationWorld* world) {
+  PublishSimulationWorld(world, SPRITE_FIXED_ONE);
+  for (int s = 0; s < world->shardCount; s++) {
+    WorldShard* shard = &world->shards[s];
+    const SpriteSnapshot* snapshot = AcquireSnapshot(shard->snapshots);
+    if (snapshot->frame != world->frame) {
+      fprintf(stderr, "shard %d published frame %lld instead of %lld\n", s, snapshot->frame, world->frame);
+      return 0;
+    }
+    for (int i = 1; i < snapshot->count; i++) {
+      if (snapshot->image[i - 1] >= snapshot->image[i]) {
+        fprintf(stderr, "shard %d published the sprites out of id order\n", s);
+        return 0;
+      }
+    }
+
+    for (int o = 0; o < world->shardCount; o++) {
+      const WorldShard* owner = &world->shards[o];
+      // A detached shard neither shows the sprites of the world nor shows up in it
+      if (o != s && (owner->detached || shard->detached)) continue;
+      const SpriteStore* store = owner->simulation->sprites;
+      for (int i = 0; i < store->count; i++) {
+        // The current positions are published with a factor of SPRITE_FIXED_ONE
+        int x = (store->xPos[i] + SPRITE_FIXED_ONE / 2) >> SPRITE_FIXED_SHIFT;
+        int y = (store->yPos[i] + SPRITE_FIXED_ONE / 2) >> SPRITE_FIXED_SHIFT;
+        int right = x + (store->width[i] >> SPRITE_FIXED_SHIFT);
+        int bottom = y + (store->height[i] >> SPRITE_FIXED_SHIFT);
+        if (x >= shard->region.right || y >= shard->region.bottom || right <= shard->region.left || bottom <= shard->region.top) continue;
+
+        int found = 0;
+        for (int k = 0; k < snapshot->count && !found; k++) {
+          found = snapshot->image[k] == owner->ids[i] &&
+            snapshot->xPos[k] == x - shard->region.left && snapshot->yPos[k] == y - shard->region.top;
+        }
+        if (!found) {
+          fprintf(stderr, "sprite %d of shard %d overlaps shard %d but is not published there\n", owner->ids[i], o, s);
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static int compareX(const void* a, const void* b) {
+  int x = ((const BenchSprite*)a)->xPos, y = ((const BenchSprite*)b)->xPos;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Counts the pairs of sprites still overlapping after a step (all sprites are size pixels wide and high)
+ *
+ * The shards resolve a pair crossing a border each with their own halo, so a pair can be left overlapping where
+ * the shards saw different neighbours. Sorts the sprites into the scratch array and sweeps them along the x axis.
+*/
+static void countOverlaps(const BenchSprite* sprites, int count, int size, BenchSprite* scratch, long long* cross, long long* shard) {
+  int fixedSize = SPRITE_TO_FIXED(size);
+  memcpy(scratch, sprites, sizeof(BenchSprite) * count);
+  qsort(scratch, count, sizeof(BenchSprite), compareX);
+  for (int i = 0; i < count; i++) {
+    for (int j = i + 1; j < count && scratch[j].xPos < scratch[i].xPos + fixedSize; j++) {
+      if (scratch[i].yPos >= scratch[j].yPos + fixedSize || scratch[j].yPos >= scratch[i].yPos + fixedSize) continue;
+      if (scratch[i].shard != scratch[j].shard) (*cross)++;
+      else (*shard)++;
+    }
+  }
+}
+
+/**
+ * Returns 1 if the point (fixed point) lies inside the region of an attached shard
+*/
+static int insideWorld(const SimulationWorld* world, int x, int y) {
+  for (int s = 0; s < world->shardCount; s++) {
+    SpriteBounds region = world->shards[s].fixedRegion;
+    if (!world->shards[s].detached && x >= region.left && x < region.right && y >= region.top && y < region.bottom) return 1;
+  }
+  return 0;
+}
+
+/**
+ * Applies the display change due at the step and checks the sprites right after it, returns 0 on failure
+ *
+ * The removed shard handed over all its sprites, the sprites of the attached shards lie completely inside
+ * the attached regions and the sprites of a detached shard completely inside its own region.
+*/
+static int applyChange(SimulationWorld* world, const BenchChange* change, int step, int steps, BenchSprite* sprites) {
+  int changed = 0;
+  if (change->removed >= 0 && step == steps / 3) {
+    RemoveWorldShard(world, change->removed);
+    if (world->shards[change->removed].simulation->sprites->count > 0) {
+      fprintf(stderr, "%s: the removed shard %d kept its sprites\n", change->name, change->removed);
+      return 0;
+    }
+    changed = 1;
+  }
+  if (change->moved >= 0 && step == steps * 2 / 3) {
+    MoveWorldShard(world, change->moved, change->rect);
+    changed = 1;
+  }
+
+  for (int s = 0; s < world->shardCount && changed; s++) {
+    const WorldShard* shard = &world->shards[s];
+    const SpriteStore* store = shard->simulation->sprites;
+    SpriteBounds region = shard->fixedRegion;
+    for (int i = 0; i < store->count; i++) {
+      int left = store->xPos[i], top = store->yPos[i];
+      int right = left + store->width[i] - 1, bottom = top + store->height[i] - 1;
+      int inside = shard->detached ?
+        left >= region.left && top >= region.top && right < region.right && bottom < region.bottom :
+        insideWorld(world, left, top) && insideWorld(world, right, top) && insideWorld(world, left, bottom) && insideWorld(world, right, bottom);
+      if (!inside) {
+        fprintf(stderr, "%s: sprite %d of shard %d lies outside the %s\n", change->name, shard->ids[i], s, shard->detached ? "region of its shard" : "world");
+        return 0;
+      }
+    }
+  }
+  return collectWorld(world, sprites);
+}
+
+/**
+ * Runs the layout for steps with the helpers and collects the final sprite states, returns 0 on failure
+ *
+ * If a change is provided (may be NULL), its monitors are removed and moved during the run
+*/
+static int runLayout(const BenchLayout* layout, const BenchChange* change, int spritesPerMonitor, int size, int steps, int helpers, BenchSprite* sprites, BenchResult* result) {
+  SimulationConfig config = { .movementSpeed = 6.0, .bounceIncrement = 10, .bounceDecrementScale = 1.0, .stepRate = 60.0, .seed = 7 };
+  int capacity = spritesPerMonitor * layout->count;
+  BenchSprite* scratch = malloc(sizeof(BenchSprite) * capacity);
+  SimulationWorld* world = scratch ? CreateSimulationWorld(layout->monitors, layout->count, capacity, BROADPHASE_SWEEP, config, helpers) : NULL;
+  if (!world) {
+    free(scratch);
+    fprintf(stderr, "%s: the world could not be created\n", layout->name);
+    return 0;
+  }
+  for (int i = 0; i < capacity; i++) {
+    if (SpawnWorldSprite(world, size, size) != i) {
+      fprintf(stderr, "%s: sprite %d could not be spawned\n", layout->name, i);
+      CloseSimulationWorld(world);
+      free(scratch);
+      return 0;
+    }
+  }
+
+  int ok = collectWorld(world, sprites);
+  double stepTime = 0.0;
+  long long handoffs = 0, crossOverlaps = 0, shardOverlaps = 0;
+  for (int step = 0; step < steps && ok; step++) {
+    if (change && !applyChange(world, change, step, steps, sprites)) {
+      ok = 0;
+      break;
+    }
+    long long before = 0;
+    for (int s = 0; s < world->shardCount; s++) before += world->shards[s].handoffs;
+    double start = FrameSchedulerNow();
+    StepSimulationWorld(world);
+    stepTime += FrameSchedulerNow() - start;
+    long long after = 0;
+    for (int s = 0; s < world->shardCount; s++) after += world->shards[s].handoffs;
+    handoffs += after - before;
+
+    ok = collectWorld(world, sprites);
+    if (ok) countOverlaps(sprites, capacity, size, scratch, &crossOverlaps, &shardOverlaps);
+    // Publishing every step would dominate the checked run, every 16th frame covers all kinds of overlaps as well
+    if (ok && step % 16 == 0) ok = checkPublished(world);
+  }
+
+  long long haloCopies = 0;
+  for (int s = 0; s < world->shardCount; s++) haloCopies += world->shards[s].haloCopies;
+  result->stepTime = steps > 0 ? stepTime / steps : 0.0;
+  result->handoffs = steps > 0 ? (double)handoffs / steps : 0.0;
+  result->haloCopies = steps > 0 ? (double)haloCopies / steps : 0.0;
+  result->crossOverlaps = steps > 0 ? (double)crossOverlaps / steps : 0.0;
+  result->shardOverlaps = steps > 0 ? (double)shardOverlaps / steps : 0.0;
+  CloseSimulationWorld(world);
+  free(scratch);
+  return ok;
+}
+
+/**
+ * Checks that a window syncing while another thread holds the world returns without advancing it, returns 0 on failure
+*/
+static int checkSync(const BenchLayout* layout) {
+  SimulationConfig config = { .movementSpeed = 6.0, .bounceIncrement = 10, .bounceDecrementScale = 1.0, .stepRate = 60.0, .seed = 7 };
+  SimulationWorld* world = CreateSimulationWorld(layout->monitors, layout->count, layout->count, BROADPHASE_SWEEP, config, 0);
+  if (!world) return 0;
+  for (int i = 0; i < layout->count; i++) SpawnWorldSprite(world, 64, 64);
+
+  int first = SyncSimulationWorld(world, 100.0);
+  // Another window advancing the world holds it like this
+  world->busy = 1;
+  long long frame = world->frame;
+  int blocked = SyncSimulationWorld(world, 200.0);
+  int skipped = world->frame == frame && world->lastAdvance == 100.0;
+  world->busy = 0;
+  int released = SyncSimulationWorld(world, 200.0);
+  int ok = first && !blocked && skipped && released && world->frame == frame + 1;
+  printf("sync     %s\n", ok ? "a busy world is skipped, the next sync advances it" : "FAILED");
+  CloseSimulationWorld(world);
+  return ok;
+}
+
+/**
+ * Runs the layout (with the change, may be NULL) serially and with the helpers, prints the results and returns 0 if a check failed
+*/
+static int runCase(const char* name, const BenchLayout* layout, const BenchChange* change, int spritesPerMonitor, int size, int steps, int helpers,
+  BenchSprite* serial, BenchSprite* parallel) {
+
+  BenchResult serialResult, parallelResult;
+  if (!runLayout(layout, change, spritesPerMonitor, size, steps, 0, serial, &serialResult) ||
+      !runLayout(layout, change, spritesPerMonitor, size, steps, helpers, parallel, &parallelResult)) {
+    printf("%-8s FAILED\n", name);
+    return 0;
+  }
+
+  int sprites = spritesPerMonitor * layout->count;
+  int diverged = -1;
+  for (int id = 0; id < sprites && diverged < 0; id++) {
+    if (memcmp(&serial[id], &parallel[id], sizeof(BenchSprite)) != 0) diverged = id;
+  }
+  // Sprites only cross a border if there is one, a multi monitor layout without handoffs never tested the queue
+  int crossed = layout->count == 1 || serialResult.handoffs > 0.0;
+
+  int resolvedHelpers = helpers < 0 ? GetProcessorCount() - 1 : helpers;
+  printf("%-8s %d monitors, %5d sprites: %.3f ms/step serial, %.3f ms/step with %d helpers (x%.2f), %.2f handoffs and %.1f halo copies per step, %.2f overlaps across borders (%.2f within shards) per step%s%s\n",
+    name, layout->count, sprites, serialResult.stepTime, parallelResult.stepTime, resolvedHelpers,
+    parallelResult.stepTime > 0.0 ? serialResult.stepTime / parallelResult.stepTime : 0.0,
+    serialResult.handoffs, serialResult.haloCopies, serialResult.crossOverlaps, serialResult.shardOverlaps,
+    diverged >= 0 ? ", DIVERGED" : "", crossed ? "" : ", NO HANDOFF");
+  if (diverged >= 0) fprintf(stderr, "%s: sprite %d differs between the serial and the parallel run\n", name, diverged);
+  return diverged < 0 && crossed;
+}
+
+/**
+ * Headless check and benchmark of the desktop spanning world on synthetic monitor layouts
+ *
+ * Not part of the screensaver build, it only needs the platform neutral simulation modules:
+ * cc -O2 -o worldbench worldbench.c simulationworld.c simulation.c simulationrecord.c spritestore.c broadphase.c randomgenerator.c framesnapshot.c dirtyregion.c framescheduler.c frametrace.c workerpool.c -lm -lpthread
+ * ./worldbench [sprites per monitor] [sprite size] [steps] [helpers]
+ *
+ * Every layout (single monitor, dual, a 3x3 video wall, mixed sizes and an L shape with a gap) is run on the calling
+ * thread only and with the helpers (< 0 one per further logical processor). After every step the invariants are checked:
+ * no sprite is lost or duplicated, every sprite is owned by the shard its center lies in and the published frames
+ * show every sprite on all monitors it overlaps. Both runs must end in exactly the same state.
+ * The display changes of a running world are checked the same way: a monitor unplugged from the wall and from
+ * the gap layout (its sprites must move to the remaining monitors), a monitor whose resolution is lowered and one
+ * moved onto its neighbour (it is detached and keeps its sprites on its own).
+ * A window syncing while the world is busy must return without advancing it.
+ * Prints the step time of both runs, the handoffs and halo copies per step and the pairs left overlapping after a step
+ * (across a border and within a shard, reported only) and exits with 1 if a check failed.
+*/
+int main(int argc, char** argv) {
+  int spritesPerMonitor = argc > 1 ? atoi(argv[1]) : 200;
+  int size = argc > 2 ? atoi(argv[2]) : 64;
+  int steps = argc > 3 ? atoi(argv[3]) : 1000;
+  int helpers = argc > 4 ? atoi(argv[4]) : -1;
+  if (spritesPerMonitor < 1 || size < 1 || steps < 1) {
+    fprintf(stderr, "usage: %s [sprites per monitor] [sprite size] [steps] [helpers]\n", argv[0]);
+    return 1;
+  }
+
+  BenchLayout layouts[] = {
+    { .name = "single", .count = 1, .monitors = { { 0, 0, 1920, 1080 } } },
+    { .name = "dual", .count = 2, .monitors = { { 0, 0, 1920, 1080 }, { 1920, 0, 3840, 1080 } } },
+    { .name = "wall3x3", .count = 9, .monitors = {
+      { 0, 0, 1920, 1080 }, { 1920, 0, 3840, 1080 }, { 3840, 0, 5760, 1080 },
+      { 0, 1080, 1920, 2160 }, { 1920, 1080, 3840, 2160 }, { 3840, 1080, 5760, 2160 },
+      { 0, 2160, 1920, 3240 }, { 1920, 2160, 3840, 3240 }, { 3840, 2160, 5760, 3240 } } },
+    // A primary monitor with a smaller one on the right and a portrait monitor on the left (negative coordinates)
+    { .name = "mixed", .count = 3, .monitors = { { 0, 0, 2560, 1440 }, { 2560, 0, 4480, 1080 }, { -1080, -240, 0, 1680 } } },
+    // Two monitors 100 pixels apart and one below the first, leaving a gap and an empty corner
+    { .name = "gap", .count = 3, .monitors = { { 0, 0, 1920, 1080 }, { 2020, 0, 3940, 1080 }, { 0, 1080, 1920, 2160 } } }
+  };
+  int layoutCount = sizeof(layouts) / sizeof(layouts[0]);
+  BenchChange changes[] = {
+    // The center of the wall is unplugged, then the monitor right of it lowers its resolution
+    { .name = "unplug", .layout = 2, .removed = 4, .moved = 5, .rect = { 3840, 1080, 5120, 1800 } },
+    // The first monitor of the gap layout is unplugged, its sprites have to cross the gap
+    { .name = "ungap", .layout = 4, .removed = 0, .moved = -1 },
+    // The second monitor is moved halfway onto the first one
+    { .name = "overlap", .layout = 1, .removed = -1, .moved = 1, .rect = { 960, 0, 2880, 1080 } }
+  };
+  int changeCount = sizeof(changes) / sizeof(changes[0]);
+
+  BenchSprite* serial = malloc(sizeof(BenchSprite) * spritesPerMonitor * BENCH_MAX_MONITORS);
+  BenchSprite* parallel = malloc(sizeof(BenchSprite) * spritesPerMonitor * BENCH_MAX_MONITORS);
+  if (!serial || !parallel) return 1;
+
+  int failed = !checkSync(&layouts[1]);
+  for (int l = 0; l < layoutCount; l++) {
+    if (!runCase(layouts[l].name, &layouts[l], NULL, spritesPerMonitor, size, steps, helpers, serial, parallel)) failed = 1;
+  }
+  for (int c = 0; c < changeCount; c++) {
+    if (!runCase(changes[c].name, &layouts[changes[c].layout], &changes[c], spritesPerMonitor, size, steps, helpers, serial, parallel)) failed = 1;
+  }
+
+  free(serial);
+  free(parallel);
+  return failed;
+}